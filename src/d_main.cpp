@@ -118,6 +118,7 @@
 #include "vm.h"
 #include "types.h"
 #include "r_data/r_vanillatrans.h"
+#include "swrenderer/r_swbenchmark.h"
 
 EXTERN_CVAR(Bool, hud_althud)
 void DrawHUD();
@@ -669,6 +670,12 @@ void D_Display ()
 	bool wipe;
 	bool hw2d;
 
+	if (R_BenchmarkActive())
+	{
+		R_BenchmarkFrame();		// offscreen rendering only
+		return;
+	}
+
 	if (nodrawers || screen == NULL)
 		return; 				// for comparative timing / profiling
 	
@@ -2696,6 +2703,11 @@ void D_DoomMain (void)
 					G_TimeDemo(v);
 					D_DoomLoop();	// never returns
 				}
+				else if ((v = Args->CheckValue("-benchrender")) != NULL)
+				{
+					R_BenchmarkDemo(v);
+					D_DoomLoop();	// never returns
+				}
 				else
 				{
 					if (gameaction != ga_loadgame && gameaction != ga_loadgamehidecon)
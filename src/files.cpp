@@ -36,11 +36,23 @@
 // This also pulls in windows.h
 #include "LzmaDec.h"
 
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <vector>
+
 #include "files.h"
 #include "i_system.h"
 #include "templates.h"
 #include "m_misc.h"
 
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
 
 //==========================================================================
 //
@@ -204,6 +216,58 @@ char *FileReader::GetsFromBuffer(const char * bufptr, char *strbuf, int len)
 	return strbuf;
 }
 
+//==========================================================================
+//
+// FileReader :: ReadAt
+//
+// Memory backed readers can always be read from any position. For files
+// this needs pread, since the position of the FILE must not be touched.
+// Windows has no equivalent that leaves the file pointer alone.
+//
+//==========================================================================
+
+bool FileReader::CanReadAt() const
+{
+#ifdef _WIN32
+	return GetBuffer() != NULL;
+#else
+	return GetBuffer() != NULL || File != NULL;
+#endif
+}
+
+long FileReader::ReadAt(void *buffer, long len, long offset)
+{
+	if (offset < 0 || offset >= Length || len <= 0) return 0;
+	if (len > Length - offset) len = Length - offset;
+
+	const char *mem = GetBuffer();
+	if (mem != NULL)
+	{
+		memcpy(buffer, mem + offset, len);
+		return len;
+	}
+
+#ifndef _WIN32
+	if (File != NULL)
+	{
+		long done = 0;
+		while (done < len)
+		{
+			ssize_t r = pread(fileno(File), (char *)buffer + done, len - done, StartPos + offset + done);
+			if (r <= 0) break;
+			done += (long)r;
+		}
+		return done;
+	}
+#endif
+
+	long pos = Tell();
+	Seek(offset, SEEK_SET);
+	len = Read(buffer, len);
+	Seek(pos, SEEK_SET);
+	return len;
+}
+
 long FileReader::CalcFileLen() const
 {
 	long endpos;
@@ -553,6 +617,77 @@ char *MemoryReader::Gets(char *strbuf, int len)
 	return GetsFromBuffer(bufptr, strbuf, len);
 }
 
+//==========================================================================
+//
+// MappedFileReader
+//
+// maps a complete file into the address space
+//
+//==========================================================================
+
+MappedFileReader *MappedFileReader::Open(const char *filename)
+{
+	// 32 bit builds only map files that leave enough address space for everything else.
+	const uint64_t maxsize = sizeof(void*) > 4 ? (uint64_t)LONG_MAX : 256u << 20;
+
+#ifdef _WIN32
+	HANDLE file = CreateFileA(filename, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, NULL, OPEN_EXISTING, FILE_FLAG_RANDOM_ACCESS, NULL);
+	if (file == INVALID_HANDLE_VALUE)
+		return NULL;
+
+	LARGE_INTEGER size;
+	if (!GetFileSizeEx(file, &size) || size.QuadPart <= 0 || (uint64_t)size.QuadPart > maxsize)
+	{
+		CloseHandle(file);
+		return NULL;
+	}
+
+	HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+	void *data = mapping != NULL ? MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0) : NULL;
+	if (data == NULL)
+	{
+		if (mapping != NULL) CloseHandle(mapping);
+		CloseHandle(file);
+		return NULL;
+	}
+
+	MappedFileReader *reader = new MappedFileReader((const char *)data, (long)size.QuadPart);
+	reader->hFile = file;
+	reader->hMapping = mapping;
+	return reader;
+#else
+	int fd = open(filename, O_RDONLY);
+	if (fd == -1)
+		return NULL;
+
+	struct stat info;
+	if (fstat(fd, &info) != 0 || !S_ISREG(info.st_mode) || info.st_size <= 0 || (uint64_t)info.st_size > maxsize)
+	{
+		close(fd);
+		return NULL;
+	}
+
+	// The mapping stays valid after the descriptor is closed.
+	void *data = mmap(NULL, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (data == MAP_FAILED)
+		return NULL;
+
+	return new MappedFileReader((const char *)data, (long)info.st_size);
+#endif
+}
+
+MappedFileReader::~MappedFileReader()
+{
+#ifdef _WIN32
+	UnmapViewOfFile(bufptr);
+	CloseHandle(hMapping);
+	CloseHandle(hFile);
+#else
+	munmap((void *)bufptr, Length);
+#endif
+}
+
 //==========================================================================
 //
 // MemoryArrayReader
@@ -609,6 +744,327 @@ char *MemoryArrayReader::Gets(char *strbuf, int len)
     return GetsFromBuffer((char*)&buf[0], strbuf, len);
 }
 
+//==========================================================================
+//
+// FileReadQueue
+//
+// The I/O threads behind FileReadBatch. Each request is read by one
+// thread, so a batch with several requests is read concurrently.
+//
+// Other exit handlers, like the music stream's, may still read while the
+// threads shut down. Everything that is queued by then still gets read,
+// and batches started afterwards are read on the calling thread.
+//
+//==========================================================================
+
+namespace
+{
+	struct FQueuedRead
+	{
+		FileReadBatch *Batch;
+		int Index;
+	};
+
+	std::mutex IOMutex;
+	std::condition_variable IOWorkCondition;
+	std::condition_variable IODoneCondition;
+	std::vector<std::thread> IOThreads;
+	TArray<FQueuedRead> IOQueue;
+	bool IOStop;
+	bool IOShutdown;
+}
+
+class FileReadQueue
+{
+public:
+	// Returns false once the threads are shut down
+	static bool Push(FileReadBatch *batch)
+	{
+		std::unique_lock<std::mutex> lock(IOMutex);
+		if (IOShutdown)
+			return false;
+
+		if (IOThreads.empty())
+		{
+			atterm(Shutdown);
+			IOStop = false;
+			// Reads mostly wait for the disk, so the thread count does not depend on the cores
+			for (int i = 0; i < 4; i++)
+				IOThreads.push_back(std::thread(WorkerMain));
+		}
+
+		for (unsigned i = 0; i < batch->Requests.Size(); i++)
+		{
+			if (batch->Requests[i].BytesRead < 0)
+			{
+				IOQueue.Push({ batch, (int)i });
+				batch->Pending++;
+			}
+		}
+		IOWorkCondition.notify_all();
+		return true;
+	}
+
+	static void Wait(FileReadBatch *batch)
+	{
+		std::unique_lock<std::mutex> lock(IOMutex);
+		IODoneCondition.wait(lock, [=]() { return batch->Pending == 0; });
+	}
+
+	static bool IsDone(const FileReadBatch *batch)
+	{
+		std::unique_lock<std::mutex> lock(IOMutex);
+		return batch->Pending == 0;
+	}
+
+private:
+	static void WorkerMain()
+	{
+		std::unique_lock<std::mutex> lock(IOMutex);
+		while (true)
+		{
+			IOWorkCondition.wait(lock, []() { return IOStop || IOQueue.Size() > 0; });
+			if (IOQueue.Size() == 0)
+				break;
+
+			FQueuedRead read = IOQueue[0];
+			IOQueue.Delete(0);
+			lock.unlock();
+
+			FileReadBatch::Request &request = read.Batch->Requests[read.Index];
+			long result = request.Reader->ReadAt(request.Buffer, request.Length, request.Offset);
+
+			lock.lock();
+			request.BytesRead = result;
+			read.Batch->Pending--;
+			IODoneCondition.notify_all();
+		}
+	}
+
+	static void Shutdown()
+	{
+		std::unique_lock<std::mutex> lock(IOMutex);
+		IOStop = true;
+		IOShutdown = true;
+		IOWorkCondition.notify_all();
+		lock.unlock();
+
+		for (auto &thread : IOThreads)
+			thread.join();
+		IOThreads.clear();
+	}
+};
+
+//==========================================================================
+//
+// FileReadBatch
+//
+//==========================================================================
+
+int FileReadBatch::Add(FileReader *reader, long offset, long length, void *buffer)
+{
+	assert(!Started);
+	return Requests.Push({ reader, offset, length, buffer, -1 });
+}
+
+void FileReadBatch::Start()
+{
+	if (Started)
+		return;
+	Started = true;
+
+	// Anything that would have to seek is read right here
+	bool async = false;
+	for (auto &request : Requests)
+	{
+		if (request.Length <= 0)
+		{
+			request.BytesRead = 0;
+		}
+		else if (!request.Reader->CanReadAt())
+		{
+			request.BytesRead = request.Reader->ReadAt(request.Buffer, request.Length, request.Offset);
+		}
+		else
+		{
+			async = true;
+		}
+	}
+
+	if (async && !FileReadQueue::Push(this))
+	{
+		for (auto &request : Requests)
+		{
+			if (request.BytesRead < 0)
+				request.BytesRead = request.Reader->ReadAt(request.Buffer, request.Length, request.Offset);
+		}
+	}
+}
+
+bool FileReadBatch::IsDone() const
+{
+	return !Started || FileReadQueue::IsDone(this);
+}
+
+bool FileReadBatch::Wait()
+{
+	if (!Started)
+		Start();
+	FileReadQueue::Wait(this);
+
+	for (auto &request : Requests)
+	{
+		if (request.BytesRead != request.Length)
+			return false;
+	}
+	return true;
+}
+
+//==========================================================================
+//
+// BufferedFileReader
+//
+//==========================================================================
+
+BufferedFileReader::BufferedFileReader(FileReader *source, bool ownsource, long readahead)
+: Source(source), OwnsSource(ownsource), ReadAhead(MAX(readahead, 4096L))
+{
+	Length = Source->GetLength();
+	FilePos = Source->Tell();
+}
+
+BufferedFileReader::~BufferedFileReader()
+{
+	FinishBlock(Blocks[0]);
+	FinishBlock(Blocks[1]);
+	if (OwnsSource) delete Source;
+}
+
+void BufferedFileReader::StartBlock(Block &block, long pos)
+{
+	block.Pos = pos;
+	block.Size = MIN(ReadAhead, Length - pos);
+	if (block.Size <= 0)
+	{
+		block.Size = 0;
+		return;
+	}
+	block.Data.Resize(ReadAhead);
+	block.Batch = new FileReadBatch;
+	block.Batch->Add(Source, pos, block.Size, &block.Data[0]);
+	block.Batch->Start();
+}
+
+void BufferedFileReader::FinishBlock(Block &block)
+{
+	if (block.Batch != nullptr)
+	{
+		block.Batch->Wait();
+		block.Size = MAX(block.Batch->BytesRead(0), 0L);
+		delete block.Batch;
+		block.Batch = nullptr;
+	}
+}
+
+// Makes Blocks[0] contain FilePos and queues the block after it
+bool BufferedFileReader::FetchBlock()
+{
+	FinishBlock(Blocks[0]);
+	if (FilePos >= Blocks[1].Pos && FilePos < Blocks[1].Pos + Blocks[1].Size)
+	{
+		FinishBlock(Blocks[1]);
+		std::swap(Blocks[0].Data, Blocks[1].Data);
+		Blocks[0].Pos = Blocks[1].Pos;
+		Blocks[0].Size = Blocks[1].Size;
+	}
+	else
+	{
+		// Seeked somewhere else
+		FinishBlock(Blocks[1]);
+		StartBlock(Blocks[0], FilePos);
+		FinishBlock(Blocks[0]);
+	}
+	Blocks[1].Size = 0;
+
+	if (FilePos < Blocks[0].Pos || FilePos >= Blocks[0].Pos + Blocks[0].Size)
+		return false;
+
+	StartBlock(Blocks[1], Blocks[0].Pos + Blocks[0].Size);
+	return true;
+}
+
+long BufferedFileReader::Tell() const
+{
+	return FilePos;
+}
+
+long BufferedFileReader::Seek(long offset, int origin)
+{
+	switch (origin)
+	{
+	case SEEK_CUR:
+		offset += FilePos;
+		break;
+
+	case SEEK_END:
+		offset += Length;
+		break;
+	}
+	FilePos = clamp<long>(offset, 0, Length);
+	return 0;
+}
+
+long BufferedFileReader::Read(void *buffer, long len)
+{
+	if (len > Length - FilePos) len = Length - FilePos;
+	if (len <= 0) return 0;
+
+	long done = 0;
+	while (done < len)
+	{
+		Block &block = Blocks[0];
+		if (block.Batch == nullptr && FilePos >= block.Pos && FilePos < block.Pos + block.Size)
+		{
+			long count = MIN(len - done, block.Pos + block.Size - FilePos);
+			memcpy((uint8_t *)buffer + done, &block.Data[FilePos - block.Pos], count);
+			done += count;
+			FilePos += count;
+		}
+		else if (!FetchBlock())
+		{
+			break;
+		}
+	}
+	return done;
+}
+
+char *BufferedFileReader::Gets(char *strbuf, int len)
+{
+	if (len <= 0 || FilePos >= Length) return NULL;
+
+	int i = 0;
+	while (i < len - 1)
+	{
+		char c;
+		if (Read(&c, 1) != 1) break;
+		strbuf[i++] = c;
+		if (c == '\n') break;
+	}
+	if (i == 0) return NULL;
+	strbuf[i] = 0;
+	return strbuf;
+}
+
+long BufferedFileReader::ReadAt(void *buffer, long len, long offset)
+{
+	return Source->ReadAt(buffer, len, offset);
+}
+
+bool BufferedFileReader::CanReadAt() const
+{
+	return Source->CanReadAt();
+}
+
 //==========================================================================
 //
 // FileWriter (the motivation here is to have a buffer writing subclass)
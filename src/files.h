@@ -117,6 +117,11 @@ public:
 	FILE *GetFile () const { return File; }
 	virtual const char *GetBuffer() const { return NULL; }
 
+	// Positional read relative to the start of this reader. Does not change the current position.
+	// Only safe to call from other threads while nothing else uses the reader if CanReadAt returns true.
+	virtual long ReadAt (void *buffer, long len, long offset);
+	virtual bool CanReadAt () const;
+
 	FileReader &operator>> (uint8_t &v)
 	{
 		Read (&v, 1);
@@ -374,6 +379,25 @@ protected:
 	const char * bufptr;
 };
 
+// Read-only memory mapping of an entire file.
+// Resource files opened through this return pointers into the mapping for
+// all lumps that are stored uncompressed instead of copying them to the heap.
+class MappedFileReader : public MemoryReader
+{
+public:
+	// Returns NULL if the file cannot be mapped. The caller should then fall back to a FileReader.
+	static MappedFileReader *Open(const char *filename);
+	~MappedFileReader();
+
+private:
+	MappedFileReader(const char *buffer, long length) : MemoryReader(buffer, length) {}
+
+#ifdef _WIN32
+	void *hFile = nullptr;
+	void *hMapping = nullptr;
+#endif
+};
+
 class MemoryArrayReader : public FileReader
 {
 public:
@@ -394,6 +418,84 @@ protected:
 };
 
 
+// A set of positional reads that are carried out together by the I/O threads.
+//
+// Offsets are relative to the start of the reader, as with Seek(offset, SEEK_SET). Readers
+// that cannot read concurrently (see FileReader::CanReadAt) are read on the calling thread
+// when the batch is started. Readers and buffers must stay valid until Wait returns.
+class FileReadBatch
+{
+public:
+	FileReadBatch() {}
+	~FileReadBatch() { Wait(); }
+
+	// Returns the index of the request
+	int Add (FileReader *reader, long offset, long length, void *buffer);
+	void Start ();
+	bool IsDone () const;
+
+	// Blocks until everything has been read. Returns false if any request came up short
+	bool Wait ();
+
+	unsigned Size () const { return Requests.Size(); }
+	long BytesRead (int index) const { return Requests[index].BytesRead; }
+
+private:
+	struct Request
+	{
+		FileReader *Reader;
+		long Offset;
+		long Length;
+		void *Buffer;
+		long BytesRead;
+	};
+
+	TArray<Request> Requests;
+	int Pending = 0;
+	bool Started = false;
+
+	FileReadBatch (const FileReadBatch &) = delete;
+	FileReadBatch &operator= (const FileReadBatch &) = delete;
+
+	friend class FileReadQueue;
+};
+
+// Reads a file front to back in blocks of the given size and keeps the next block
+// in flight on the I/O threads, so that consumers reading small pieces at a time
+// neither wait for the disk nor cause a system call per read.
+class BufferedFileReader : public FileReader
+{
+public:
+	BufferedFileReader (FileReader *source, bool ownsource, long readahead = 64 * 1024);
+	~BufferedFileReader ();
+
+	virtual long Tell () const;
+	virtual long Seek (long offset, int origin);
+	virtual long Read (void *buffer, long len);
+	virtual char *Gets (char *strbuf, int len);
+	virtual long ReadAt (void *buffer, long len, long offset);
+	virtual bool CanReadAt () const;
+
+private:
+	struct Block
+	{
+		TArray<uint8_t> Data;
+		long Pos = 0;
+		long Size = 0;
+		FileReadBatch *Batch = nullptr;
+	};
+
+	void StartBlock (Block &block, long pos);
+	void FinishBlock (Block &block);
+	bool FetchBlock ();
+
+	FileReader *Source;
+	bool OwnsSource;
+	long ReadAhead;
+	Block Blocks[2];	// The current block and the one after it
+};
+
+
 class FileWriter
 {
 protected:
@@ -49,6 +49,7 @@
 #include "p_saveg.h"
 #include "p_tick.h"
 #include "d_main.h"
+#include "swrenderer/r_swbenchmark.h"
 #include "wi_stuff.h"
 #include "hu_stuff.h"
 #include "st_stuff.h"
@@ -2926,6 +2927,7 @@ bool G_CheckDemoStatus (void)
 				// Trying to get back to a stable state after timing a demo
 				// seems to cause problems. I don't feel like fixing that
 				// right now.
+				R_BenchmarkReport();
 				I_FatalError ("timed %i gametics in %i realtics (%.1f fps)\n"
 							  "(This is not really an error.)", gametic,
 							  endtime, (float)gametic/(float)endtime*(float)TICRATE);
@@ -135,6 +135,7 @@ struct FLevelLocals
 	int			DefaultEnvironment;		// Default sound environment.
 
 	TArray<DVector2>	Scrolls;		// NULL if no DScrollers in this level
+	TArray<sector_t *>	movedsectors;	// Sectors whose plane heights changed since the renderer last updated its vertex buffer
 
 	int8_t		WallVertLight;			// Light diffs for vert/horiz walls
 	int8_t		WallHorizLight;
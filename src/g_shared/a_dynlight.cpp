@@ -75,6 +75,7 @@
 #include "c_cvars.h"
 #include "gl/system//gl_interface.h"
 #include "vm.h"
+#include "memarena.h"
 
 extern int currentrenderer;
 
@@ -414,7 +415,7 @@ void ADynamicLight::UpdateLocation()
 		if (X() != oldx || Y() != oldy || radius != oldradius)
 		{
 			//Update the light lists
-			LinkLight();
+			if (radius != m_linkRadius || !IsLinkValid()) LinkLight();
 		}
 	}
 }
@@ -459,6 +460,35 @@ size_t ADynamicLight::PointerSubstitution (DObject *old, DObject *notOld)
 	return ret;
 }
 
+//=============================================================================
+//
+// Light nodes are taken from a freelist, like the sector nodes
+//
+//=============================================================================
+
+static FLightNode *freelightnodes;
+static FMemArena lightnodearena(64 * sizeof(FLightNode));
+
+static FLightNode *GetLightNode()
+{
+	FLightNode *node = freelightnodes;
+	if (node != nullptr)
+	{
+		freelightnodes = node->nextTarget;
+	}
+	else
+	{
+		node = (FLightNode *)lightnodearena.Alloc(sizeof(FLightNode));
+	}
+	return node;
+}
+
+static void PutLightNode(FLightNode *node)
+{
+	node->nextTarget = freelightnodes;
+	freelightnodes = node;
+}
+
 //=============================================================================
 //
 // These have been copied from the secnode code and modified for the light links
@@ -488,7 +518,7 @@ FLightNode * AddLightNode(FLightNode ** thread, void * linkto, ADynamicLight * l
 	// Couldn't find an existing node for this sector. Add one at the head
 	// of the list.
 	
-	node = new FLightNode;
+	node = GetLightNode();
 	
 	node->targ = linkto;
 	node->lightsource = light; 
@@ -531,7 +561,7 @@ static FLightNode * DeleteLightNode(FLightNode * node)
 		
 		// Return this node to the freelist
 		tn=node->nextTarget;
-		delete node;
+		PutLightNode(node);
 		return(tn);
     }
 	return(NULL);
@@ -583,6 +613,7 @@ static TArray<LightLinkEntry> collected_ss;
 void ADynamicLight::CollectWithinRadius(const DVector3 &opos, subsector_t *subSec, float radius)
 {
 	if (!subSec) return;
+	double linkradius = sqrt(radius);
 	collected_ss.Clear();
 	collected_ss.Push({ subSec, opos });
 	subSec->validcount = ::validcount;
@@ -606,12 +637,19 @@ void ADynamicLight::CollectWithinRadius(const DVector3 &opos, subsector_t *subSe
 
 			// check distance from x/y to seg and if within radius add this seg and, if present the opposing subsector (lather/rinse/repeat)
 			// If out of range we do not need to bother with this seg.
-			if (DistToSeg(pos, seg) <= radius)
+			double segdist = DistToSeg(pos, seg);
+			m_linkMarginXY = MIN(m_linkMarginXY, fabs(sqrt(segdist) - linkradius));
+			if (segdist <= radius)
 			{
 				if (seg->sidedef && seg->linedef && seg->linedef->validcount != ::validcount)
 				{
+					double seg_dx = seg->v2->fX() - seg->v1->fX();
+					double seg_dy = seg->v2->fY() - seg->v1->fY();
+					double side = (pos.Y - seg->v1->fY()) * seg_dx + (seg->v1->fX() - pos.X) * seg_dy;
+					m_linkMarginXY = MIN(m_linkMarginXY, fabs(side) / sqrt(seg_dx * seg_dx + seg_dy * seg_dy));
+
 					// light is in front of the seg
-					if ((pos.Y - seg->v1->fY()) * (seg->v2->fX() - seg->v1->fX()) + (seg->v1->fX() - pos.X) * (seg->v2->fY() - seg->v1->fY()) <= 0)
+					if (side <= 0)
 					{
 						seg->linedef->validcount = validcount;
 						touching_sides = AddLightNode(&seg->sidedef->lighthead, seg->sidedef, this, touching_sides);
@@ -655,6 +693,7 @@ void ADynamicLight::CollectWithinRadius(const DVector3 &opos, subsector_t *subSe
 		if (!sec->PortalBlocksSight(sector_t::ceiling))
 		{
 			line_t *other = subSec->firstline->linedef;
+			m_linkMarginZ = MIN(m_linkMarginZ, fabs(sec->GetPortalPlaneZ(sector_t::ceiling) - (Z() + radius)));
 			if (sec->GetPortalPlaneZ(sector_t::ceiling) < Z() + radius)
 			{
 				DVector2 refpos = other->v1->fPos() + other->Delta() / 2 + sec->GetPortalDisplacement(sector_t::ceiling);
@@ -669,6 +708,7 @@ void ADynamicLight::CollectWithinRadius(const DVector3 &opos, subsector_t *subSe
 		if (!sec->PortalBlocksSight(sector_t::floor))
 		{
 			line_t *other = subSec->firstline->linedef;
+			m_linkMarginZ = MIN(m_linkMarginZ, fabs(sec->GetPortalPlaneZ(sector_t::floor) - (Z() - radius)));
 			if (sec->GetPortalPlaneZ(sector_t::floor) > Z() - radius)
 			{
 				DVector2 refpos = other->v1->fPos() + other->Delta() / 2 + sec->GetPortalDisplacement(sector_t::floor);
@@ -684,6 +724,24 @@ void ADynamicLight::CollectWithinRadius(const DVector3 &opos, subsector_t *subSe
 	shadowmapped = hitonesidedback && !(lightflags & LF_NOSHADOWMAP);
 }
 
+//==========================================================================
+//
+// Checks if the light is still linked to the same things it would be
+// linked to at its current position. CollectWithinRadius only compares
+// the light's distance to segs and lines and its height to portal planes,
+// so none of the results can change while the light has moved less than
+// the smallest difference found in these tests.
+//
+//==========================================================================
+
+static const double LinkMarginEpsilon = 1. / 65536.;
+
+bool ADynamicLight::IsLinkValid() const
+{
+	DVector3 delta = Pos() - m_linkPos;
+	return delta.XY().LengthSquared() < m_linkMarginXY * m_linkMarginXY && m_linkMarginXY > 0 && fabs(delta.Z) < m_linkMarginZ;
+}
+
 //==========================================================================
 //
 // Link the light into the world
@@ -714,6 +772,11 @@ void ADynamicLight::LinkLight()
 		node = node->nextTarget;
 	}
 
+	m_linkPos = Pos();
+	m_linkRadius = radius;
+	m_linkMarginXY = DBL_MAX;
+	m_linkMarginZ = DBL_MAX;
+
 	if (radius>0)
 	{
 		// passing in radius*radius allows us to do a distance check without any calls to sqrt
@@ -722,6 +785,10 @@ void ADynamicLight::LinkLight()
 		CollectWithinRadius(Pos(), subSec, float(radius*radius));
 
 	}
+	
+	// Leave some room for rounding errors
+	m_linkMarginXY -= LinkMarginEpsilon;
+	m_linkMarginZ -= LinkMarginEpsilon;
 		
 	// Now delete any nodes that won't be used. These are the ones where
 	// m_thing is still NULL.
@@ -110,6 +110,7 @@ public:
 private:
 	double DistToSeg(const DVector3 &pos, seg_t *seg);
 	void CollectWithinRadius(const DVector3 &pos, subsector_t *subSec, float radius);
+	bool IsLinkValid() const;
 
 protected:
 	DVector3 m_off;
@@ -118,6 +119,13 @@ protected:
 	FCycler m_cycler;
 	subsector_t * subsector;
 
+	// Position and radius of the last LinkLight call. As long as the light stays closer
+	// than the margins to this position none of the tests deciding what it touches can change.
+	DVector3 m_linkPos;
+	double m_linkRadius = 0;
+	double m_linkMarginXY = 0;
+	double m_linkMarginZ = 0;
+
 public:
 	int m_tickCount;
 	uint8_t lighttype;
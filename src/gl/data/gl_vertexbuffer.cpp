@@ -27,6 +27,7 @@
 
 #include "gl/system/gl_system.h"
 #include "doomtype.h"
+#include "parallel_for.h"
 #include "p_local.h"
 #include "r_state.h"
 #include "m_argv.h"
@@ -38,6 +39,7 @@
 #include "gl/data/gl_data.h"
 #include "gl/data/gl_vertexbuffer.h"
 
+CVAR(Bool, gl_threadedplaneupdate, true, CVAR_ARCHIVE | CVAR_GLOBALCONFIG)
 
 //==========================================================================
 //
@@ -478,16 +480,37 @@ void FFlatVertexBuffer::CheckPlanes(sector_t *sector)
 
 //==========================================================================
 //
-// checks the validity of all planes attached to this sector
-// and updates them if possible.
+// Updates the planes of all sectors that moved since the last call.
+// The sectors get collected by the sector_t plane height setters.
+// Each sector owns a separate range of the buffer, including the copies
+// for its fake floors and 3D floors, so the updates can run in parallel.
 //
 //==========================================================================
 
-void FFlatVertexBuffer::CheckUpdate(sector_t *sector)
+void FFlatVertexBuffer::UpdateMovedPlanes()
 {
-	CheckPlanes(sector);
-	sector_t *hs = sector->GetHeightSec();
-	if (hs != NULL) CheckPlanes(hs);
-	for (unsigned i = 0; i < sector->e->XFloor.ffloors.Size(); i++)
-		CheckPlanes(sector->e->XFloor.ffloors[i]->model);
-}
\ No newline at end of file
+	auto &moved = level.movedsectors;
+	int count = moved.Size();
+	if (count == 0)
+		return;
+
+	// Not worth waking up the other threads for a few doors and lifts
+	const int MIN_THREADED_SECTORS = 64;
+
+	if (gl_threadedplaneupdate && count >= MIN_THREADED_SECTORS)
+	{
+		parallel_for(0, count, 1, [&](int i)
+		{
+			CheckPlanes(moved[i]);
+		});
+	}
+	else
+	{
+		for (int i = 0; i < count; i++)
+			CheckPlanes(moved[i]);
+	}
+
+	for (auto sec : moved)
+		sec->planesmoved = false;
+	moved.Clear();
+}
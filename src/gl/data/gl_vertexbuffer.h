@@ -138,7 +138,7 @@ public:
 	void BindVBO();
 
 	void CreateVBO();
-	void CheckUpdate(sector_t *sector);
+	void UpdateMovedPlanes();
 
 	FFlatVertex *GetBuffer()
 	{
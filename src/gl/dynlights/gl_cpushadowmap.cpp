@@ -0,0 +1,523 @@
+//
+//---------------------------------------------------------------------------
+//
+// Copyright(C) 2017 The GZDoom Development Team
+// All rights reserved.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program.  If not, see http://www.gnu.org/licenses/
+//
+//--------------------------------------------------------------------------
+//
+/*
+** gl_cpushadowmap.cpp
+** CPU implementation of the 1D shadow map ray tests
+**
+**/
+
+#include <math.h>
+#include <string.h>
+#include <algorithm>
+#ifndef NO_SSE
+#include <emmintrin.h>
+#endif
+#include "gl/system/gl_system.h"
+#include "r_defs.h"
+#include "gl/dynlights/gl_cpushadowmap.h"
+#include "parallel_for.h"
+#include "doomstat.h"
+#include "c_cvars.h"
+#include "c_dispatch.h"
+#include "a_dynlight.h"
+#include "stats.h"
+
+EXTERN_CVAR(Int, gl_shadowmap_quality)
+
+/*
+	All functions in this file are written to do the exact same floating point operations, in the
+	same order, as shadowmap.fp. Do not "simplify" the math (for example turning the overlap test
+	into a slab test or reusing the ray normal between the functions) as that changes the rounding.
+
+	The 3D overlap test in the shader gets a z extent of -1 to 1 and a ray with z=0. All the z terms
+	then cancel out exactly, leaving the three 2D separating axis tests used here.
+
+	The SSE version traces four rays at once. They share one traversal stack where each entry carries
+	a mask of the rays that still need to visit the node. The stack depth of a node only depends on the
+	path from the root (one extra slot per left turn), so the 16 entry overflow rule cuts off exactly
+	the same nodes for every ray as the scalar traversal does.
+*/
+
+//==========================================================================
+//
+//
+//
+//==========================================================================
+
+bool FCPUShadowMap::OverlapRayAABB(float startx, float starty, float endx, float endy, const AABBTreeNode &node) const
+{
+	float cx = (startx + endx) * 0.5f;
+	float cy = (starty + endy) * 0.5f;
+	float wx = endx - cx;
+	float wy = endy - cy;
+	float hx = (node.aabb_right - node.aabb_left) * 0.5f;
+	float hy = (node.aabb_bottom - node.aabb_top) * 0.5f;
+
+	cx -= (node.aabb_right + node.aabb_left) * 0.5f;
+	cy -= (node.aabb_bottom + node.aabb_top) * 0.5f;
+
+	float vx = fabsf(wx);
+	float vy = fabsf(wy);
+
+	if (fabsf(cx) > vx + hx || fabsf(cy) > vy + hy)
+		return false; // disjoint
+
+	if (fabsf(cx * wy - cy * wx) > hx * vy + hy * vx)
+		return false; // disjoint
+
+	return true; // overlap
+}
+
+float FCPUShadowMap::IntersectRayLine(float startx, float starty, int line_index, float raydeltax, float raydeltay, float rayd, float raydist2) const
+{
+	const float epsilon = 0.0000001f;
+	const AABBTreeLine &line = mTree->lines[line_index];
+
+	float raynormalx = raydeltay;
+	float raynormaly = -raydeltax;
+
+	float den = raynormalx * line.dx + raynormaly * line.dy;
+	if (fabsf(den) > epsilon)
+	{
+		float t_line = (rayd - (raynormalx * line.x + raynormaly * line.y)) / den;
+		if (t_line >= 0.0f && t_line <= 1.0f)
+		{
+			float linehitdeltax = line.x + line.dx * t_line - startx;
+			float linehitdeltay = line.y + line.dy * t_line - starty;
+			float t = (raydeltax * linehitdeltax + raydeltay * linehitdeltay) / raydist2;
+			return t > 0.0f ? t : 1.0f;
+		}
+	}
+
+	return 1.0f;
+}
+
+float FCPUShadowMap::RayTest(float startx, float starty, float endx, float endy) const
+{
+	float raydeltax = endx - startx;
+	float raydeltay = endy - starty;
+	float raydist2 = raydeltax * raydeltax + raydeltay * raydeltay;
+	float raynormalx = raydeltay;
+	float raynormaly = -raydeltax;
+	float rayd = raynormalx * startx + raynormaly * starty;
+	if (raydist2 < 1.0f || mTree->nodes.Size() == 0)
+		return 1.0f;
+
+	const AABBTreeNode *nodes = &mTree->nodes[0];
+	float t = 1.0f;
+
+	int stack[StackSize];
+	int stack_pos = 1;
+	stack[0] = mTree->nodes.Size() - 1;
+	while (stack_pos > 0)
+	{
+		int node_index = stack[stack_pos - 1];
+		const AABBTreeNode &node = nodes[node_index];
+
+		if (!OverlapRayAABB(startx, starty, endx, endy, node))
+		{
+			stack_pos--;
+		}
+		else if (node.line_index != -1)
+		{
+			t = std::min(IntersectRayLine(startx, starty, node.line_index, raydeltax, raydeltay, rayd, raydist2), t);
+			stack_pos--;
+		}
+		else if (stack_pos == StackSize)
+		{
+			stack_pos--; // stack overflow
+		}
+		else
+		{
+			stack[stack_pos - 1] = node.left_node;
+			stack[stack_pos] = node.right_node;
+			stack_pos++;
+		}
+	}
+
+	return t;
+}
+
+//==========================================================================
+//
+// Four rays sharing the start position (the light)
+//
+//==========================================================================
+
+void FCPUShadowMap::RayTest4(float startx, float starty, const float *endx, const float *endy, float *result) const
+{
+#ifndef NO_SSE
+	if (mTree->nodes.Size() == 0)
+	{
+		for (int i = 0; i < 4; i++)
+			result[i] = 1.0f;
+		return;
+	}
+
+	const __m128 signmask = _mm_set1_ps(-0.0f);
+	const __m128 half = _mm_set1_ps(0.5f);
+	const __m128 zero = _mm_setzero_ps();
+	const __m128 one = _mm_set1_ps(1.0f);
+	const __m128 epsilon = _mm_set1_ps(0.0000001f);
+
+	__m128 sx = _mm_set1_ps(startx);
+	__m128 sy = _mm_set1_ps(starty);
+	__m128 ex = _mm_loadu_ps(endx);
+	__m128 ey = _mm_loadu_ps(endy);
+
+	__m128 raydeltax = _mm_sub_ps(ex, sx);
+	__m128 raydeltay = _mm_sub_ps(ey, sy);
+	__m128 raydist2 = _mm_add_ps(_mm_mul_ps(raydeltax, raydeltax), _mm_mul_ps(raydeltay, raydeltay));
+	__m128 raynormalx = raydeltay;
+	__m128 raynormaly = _mm_xor_ps(raydeltax, signmask);
+	__m128 rayd = _mm_add_ps(_mm_mul_ps(raynormalx, sx), _mm_mul_ps(raynormaly, sy));
+
+	// Overlap test terms that only depend on the ray
+	__m128 cx0 = _mm_mul_ps(_mm_add_ps(sx, ex), half);
+	__m128 cy0 = _mm_mul_ps(_mm_add_ps(sy, ey), half);
+	__m128 wx = _mm_sub_ps(ex, cx0);
+	__m128 wy = _mm_sub_ps(ey, cy0);
+	__m128 vx = _mm_andnot_ps(signmask, wx);
+	__m128 vy = _mm_andnot_ps(signmask, wy);
+
+	int active = _mm_movemask_ps(_mm_cmpnlt_ps(raydist2, one));
+
+	const AABBTreeNode *nodes = &mTree->nodes[0];
+	const AABBTreeLine *lines = &mTree->lines[0];
+	__m128 t = one;
+
+	int stack[StackSize];
+	int stack_mask[StackSize];
+	int stack_pos = 0;
+	if (active != 0)
+	{
+		stack[0] = mTree->nodes.Size() - 1;
+		stack_mask[0] = active;
+		stack_pos = 1;
+	}
+
+	while (stack_pos > 0)
+	{
+		int node_index = stack[stack_pos - 1];
+		const AABBTreeNode &node = nodes[node_index];
+
+		__m128 hx = _mm_set1_ps((node.aabb_right - node.aabb_left) * 0.5f);
+		__m128 hy = _mm_set1_ps((node.aabb_bottom - node.aabb_top) * 0.5f);
+		__m128 cx = _mm_sub_ps(cx0, _mm_set1_ps((node.aabb_right + node.aabb_left) * 0.5f));
+		__m128 cy = _mm_sub_ps(cy0, _mm_set1_ps((node.aabb_bottom + node.aabb_top) * 0.5f));
+
+		__m128 disjoint = _mm_cmpgt_ps(_mm_andnot_ps(signmask, cx), _mm_add_ps(vx, hx));
+		disjoint = _mm_or_ps(disjoint, _mm_cmpgt_ps(_mm_andnot_ps(signmask, cy), _mm_add_ps(vy, hy)));
+		disjoint = _mm_or_ps(disjoint, _mm_cmpgt_ps(
+			_mm_andnot_ps(signmask, _mm_sub_ps(_mm_mul_ps(cx, wy), _mm_mul_ps(cy, wx))),
+			_mm_add_ps(_mm_mul_ps(hx, vy), _mm_mul_ps(hy, vx))));
+
+		int overlap = stack_mask[stack_pos - 1] & ~_mm_movemask_ps(disjoint);
+
+		if (overlap == 0)
+		{
+			stack_pos--;
+		}
+		else if (node.line_index != -1)
+		{
+			const AABBTreeLine &line = lines[node.line_index];
+			__m128 linex = _mm_set1_ps(line.x);
+			__m128 liney = _mm_set1_ps(line.y);
+			__m128 linedx = _mm_set1_ps(line.dx);
+			__m128 linedy = _mm_set1_ps(line.dy);
+
+			__m128 den = _mm_add_ps(_mm_mul_ps(raynormalx, linedx), _mm_mul_ps(raynormaly, linedy));
+			__m128 t_line = _mm_div_ps(_mm_sub_ps(rayd, _mm_add_ps(_mm_mul_ps(raynormalx, linex), _mm_mul_ps(raynormaly, liney))), den);
+			__m128 hit = _mm_cmpgt_ps(_mm_andnot_ps(signmask, den), epsilon);
+			hit = _mm_and_ps(hit, _mm_cmpge_ps(t_line, zero));
+			hit = _mm_and_ps(hit, _mm_cmple_ps(t_line, one));
+
+			__m128 linehitdeltax = _mm_sub_ps(_mm_add_ps(linex, _mm_mul_ps(linedx, t_line)), sx);
+			__m128 linehitdeltay = _mm_sub_ps(_mm_add_ps(liney, _mm_mul_ps(linedy, t_line)), sy);
+			__m128 linet = _mm_div_ps(_mm_add_ps(_mm_mul_ps(raydeltax, linehitdeltax), _mm_mul_ps(raydeltay, linehitdeltay)), raydist2);
+			hit = _mm_and_ps(hit, _mm_cmpgt_ps(linet, zero));
+
+			// Lanes that did not overlap the node keep their current t
+			static const int lanemasks[16][4] =
+			{
+				{ 0, 0, 0, 0 }, { -1, 0, 0, 0 }, { 0, -1, 0, 0 }, { -1, -1, 0, 0 },
+				{ 0, 0, -1, 0 }, { -1, 0, -1, 0 }, { 0, -1, -1, 0 }, { -1, -1, -1, 0 },
+				{ 0, 0, 0, -1 }, { -1, 0, 0, -1 }, { 0, -1, 0, -1 }, { -1, -1, 0, -1 },
+				{ 0, 0, -1, -1 }, { -1, 0, -1, -1 }, { 0, -1, -1, -1 }, { -1, -1, -1, -1 }
+			};
+			__m128 lanes = _mm_castsi128_ps(_mm_loadu_si128((const __m128i*)lanemasks[overlap]));
+			hit = _mm_and_ps(hit, lanes);
+
+			__m128 linemin = _mm_min_ps(t, linet);
+			t = _mm_or_ps(_mm_and_ps(hit, linemin), _mm_andnot_ps(hit, t));
+			stack_pos--;
+		}
+		else if (stack_pos == StackSize)
+		{
+			stack_pos--; // stack overflow
+		}
+		else
+		{
+			stack[stack_pos - 1] = node.left_node;
+			stack_mask[stack_pos - 1] = overlap;
+			stack[stack_pos] = node.right_node;
+			stack_mask[stack_pos] = overlap;
+			stack_pos++;
+		}
+	}
+
+	_mm_storeu_ps(result, t);
+#else
+	for (int i = 0; i < 4; i++)
+		result[i] = RayTest(startx, starty, endx[i], endy[i]);
+#endif
+}
+
+//==========================================================================
+//
+// Same texel to direction mapping as the shadowmap.fp main function
+//
+//==========================================================================
+
+void FCPUShadowMap::RenderLight(float lightx, float lighty, float radius, int quality, float *row, bool simd) const
+{
+	if (!(radius > 0.0f))
+	{
+		for (int i = 0; i < quality; i++)
+			row[i] = 1.0f;
+		return;
+	}
+
+	float q = (float)quality;
+	int quadrant = (int)(q / 4.0f);
+
+	int i = 0;
+	while (i < quality)
+	{
+		int count = (simd && quality - i >= 4) ? 4 : 1;
+
+		float endx[4], endy[4], t[4];
+		for (int j = 0; j < count; j++)
+		{
+			float x = (float)(i + j) + 0.5f;
+			float px, py;
+			switch ((i + j) / quadrant)
+			{
+			default:
+			case 0: px = (x - q / 8.0f) / (q / 8.0f); py = 1.0f; break;
+			case 1: px = 1.0f; py = (x - (q / 4.0f + q / 8.0f)) / (q / 8.0f); break;
+			case 2: px = -(x - (q / 2.0f + q / 8.0f)) / (q / 8.0f); py = -1.0f; break;
+			case 3: px = -1.0f; py = -(x - (q * 3.0f / 4.0f + q / 8.0f)) / (q / 8.0f); break;
+			}
+			endx[j] = lightx + px * radius;
+			endy[j] = lighty + py * radius;
+		}
+
+		if (count == 4)
+			RayTest4(lightx, lighty, endx, endy, t);
+		else
+			t[0] = RayTest(lightx, lighty, endx[0], endy[0]);
+
+		for (int j = 0; j < count; j++)
+		{
+			float deltax = (endx[j] - lightx) * t[j];
+			float deltay = (endy[j] - lighty) * t[j];
+			row[i + j] = deltax * deltax + deltay * deltay;
+		}
+		i += count;
+	}
+}
+
+void FCPUShadowMap::RenderLights(const float *lights, int count, int quality, float *rows, bool simd) const
+{
+	parallel_for(0, count, 1, [&](int index)
+	{
+		const float *light = lights + index * 4;
+		RenderLight(light[0], light[1], light[3], quality, rows + index * quality, simd);
+	});
+}
+
+//==========================================================================
+//
+// Percentage closer filtering as done by main.fp with nearest sampling
+//
+//==========================================================================
+
+namespace
+{
+	float ShadowDirToU(float dirx, float diry)
+	{
+		if (fabsf(dirx) > fabsf(diry))
+		{
+			if (dirx >= 0.0f)
+				return diry / dirx * 0.125f + (0.25f + 0.125f);
+			else
+				return diry / dirx * 0.125f + (0.75f + 0.125f);
+		}
+		else
+		{
+			if (diry >= 0.0f)
+				return dirx / diry * 0.125f + 0.125f;
+			else
+				return dirx / diry * 0.125f + (0.50f + 0.125f);
+		}
+	}
+
+	float SampleShadowmap(const float *row, int quality, float dirx, float diry)
+	{
+		float u = ShadowDirToU(dirx, diry);
+		float dist2 = dirx * dirx + diry * diry;
+
+		// GL_NEAREST with GL_CLAMP_TO_EDGE
+		float pos = u * quality;
+		int x = (pos >= 0.0f) ? (int)pos : 0;
+		if (x >= quality) x = quality - 1;
+		return row[x] > dist2 ? 1.0f : 0.0f;
+	}
+}
+
+float FCPUShadowMap::Attenuation(const float *row, int quality, float lightx, float lighty, float x, float y)
+{
+	float rayx = x - lightx;
+	float rayy = y - lighty;
+	float length = sqrtf(rayx * rayx + rayy * rayy);
+	if (length < 3.0f)
+		return 1.0f;
+
+	float dirx = rayx / length;
+	float diry = rayy / length;
+
+	rayx -= dirx * 2.0f; // Shadow acne margin
+	rayy -= diry * 2.0f;
+	float scale = std::min(length / 50.0f, 1.0f); // avoid sampling behind light
+	dirx *= scale;
+	diry *= scale;
+	float normalx = -diry;
+	float normaly = dirx;
+	float biasx = dirx * 10.0f;
+	float biasy = diry * 10.0f;
+
+	const int stepcount = 3;
+	float sum = 0.0f;
+	for (int i = -stepcount; i <= stepcount; i++)
+	{
+		float s = (float)i;
+		float a = fabsf(s);
+		sum += SampleShadowmap(row, quality, rayx + normalx * s - biasx * a, rayy + normaly * s - biasy * a);
+	}
+	return sum / (stepcount * 2 + 1);
+}
+
+//==========================================================================
+//
+// Benchmarks the scalar, SSE and multithreaded shadow map generation
+// for the lights in the current level
+//
+//==========================================================================
+
+CCMD(bench_shadowmap)
+{
+	if (gamestate != GS_LEVEL)
+	{
+		Printf("bench_shadowmap can only be used inside a level\n");
+		return;
+	}
+
+	int iterations = argv.argc() > 1 ? atoi(argv[1]) : 10;
+	if (iterations <= 0)
+		return;
+
+	cycle_t treetime;
+	treetime.Reset();
+	treetime.Clock();
+	LevelAABBTree tree;
+	treetime.Unclock();
+
+	// Same light selection as FShadowMap::UploadLights. Use all lights if the level has no shadowmapped ones.
+	TArray<float> lights;
+	for (int pass = 0; pass < 2 && lights.Size() == 0; pass++)
+	{
+		TThinkerIterator<ADynamicLight> it(STAT_DLIGHT);
+		while (auto light = it.Next())
+		{
+			if (pass == 0 && !light->shadowmapped)
+				continue;
+
+			lights.Push((float)light->X());
+			lights.Push((float)light->Y());
+			lights.Push((float)light->Z());
+			lights.Push(light->GetRadius());
+			if (lights.Size() == 1024 * 4)
+				break;
+		}
+	}
+
+	int count = lights.Size() / 4;
+	if (count == 0)
+	{
+		Printf("No dynamic lights in this level\n");
+		return;
+	}
+
+	int quality = gl_shadowmap_quality;
+	FCPUShadowMap shadowmap(&tree);
+
+	TArray<float> scalarrows, simdrows, threadrows;
+	scalarrows.Resize(count * quality);
+	simdrows.Resize(count * quality);
+	threadrows.Resize(count * quality);
+
+	cycle_t scalartime, simdtime, threadtime;
+	scalartime.Reset();
+	simdtime.Reset();
+	threadtime.Reset();
+	for (int i = 0; i < iterations; i++)
+	{
+		scalartime.Clock();
+		for (int j = 0; j < count; j++)
+			shadowmap.RenderLight(lights[j * 4], lights[j * 4 + 1], lights[j * 4 + 3], quality, &scalarrows[j * quality], false);
+		scalartime.Unclock();
+
+		simdtime.Clock();
+		for (int j = 0; j < count; j++)
+			shadowmap.RenderLight(lights[j * 4], lights[j * 4 + 1], lights[j * 4 + 3], quality, &simdrows[j * quality], true);
+		simdtime.Unclock();
+
+		threadtime.Clock();
+		shadowmap.RenderLights(&lights[0], count, quality, &threadrows[0]);
+		threadtime.Unclock();
+	}
+
+	int simdmismatches = 0, threadmismatches = 0;
+	for (int i = 0; i < count * quality; i++)
+	{
+		if (memcmp(&scalarrows[i], &simdrows[i], sizeof(float)) != 0) simdmismatches++;
+		if (memcmp(&scalarrows[i], &threadrows[i], sizeof(float)) != 0) threadmismatches++;
+	}
+
+	double rays = (double)count * quality;
+	Printf("%d lights, quality %d, %u nodes, %u lines (tree built in %.2f ms)\n", count, quality, tree.nodes.Size(), tree.lines.Size(), treetime.TimeMS());
+	Printf("scalar: %.3f ms (%.1f Mrays/s)\n", scalartime.TimeMS() / iterations, rays * iterations / (scalartime.TimeMS() * 1000.0));
+	Printf("sse: %.3f ms (%.1f Mrays/s)\n", simdtime.TimeMS() / iterations, rays * iterations / (simdtime.TimeMS() * 1000.0));
+	Printf("threaded: %.3f ms (%.1f Mrays/s)\n", threadtime.TimeMS() / iterations, rays * iterations / (threadtime.TimeMS() * 1000.0));
+	Printf("texels differing from scalar: sse=%d threaded=%d\n", simdmismatches, threadmismatches);
+}
@@ -0,0 +1,39 @@
+
+#pragma once
+
+#include "gl/dynlights/gl_aabbtree.h"
+
+// CPU implementation of the 1D shadow map generated by shadowmap.fp.
+//
+// The ray tests walk the same LevelAABBTree node and line arrays that get uploaded to the GPU,
+// in the same order and with the same single precision math as the shader. The scalar and the
+// SSE versions produce bit identical results. The GPU may fuse multiply-adds, so a comparison
+// against a texture read back from OpenGL can differ in the last bits of a texel.
+class FCPUShadowMap
+{
+public:
+	FCPUShadowMap(const LevelAABBTree *tree) : mTree(tree) { }
+
+	// Shoot a ray from ray_start to ray_end and return the closest hit as a fractional value between 0 and 1 (shadowmap.fp rayTest)
+	float RayTest(float startx, float starty, float endx, float endy) const;
+
+	// Ray test four rays from the same start position at once. Writes the results to t[0..3]
+	void RayTest4(float startx, float starty, const float *endx, const float *endy, float *t) const;
+
+	// Renders the shadow map texel row for one light. Row must hold quality floats
+	void RenderLight(float lightx, float lighty, float radius, int quality, float *row, bool simd = true) const;
+
+	// Renders rows for a list of lights laid out as x, y, z, radius (the FShadowMap light list) using all cores
+	void RenderLights(const float *lights, int count, int quality, float *rows, bool simd = true) const;
+
+	// Percentage closer filtered light attenuation for a world position (shadowmapAttenuation in main.fp)
+	static float Attenuation(const float *row, int quality, float lightx, float lighty, float x, float y);
+
+private:
+	bool OverlapRayAABB(float startx, float starty, float endx, float endy, const AABBTreeNode &node) const;
+	float IntersectRayLine(float startx, float starty, int line_index, float raydeltax, float raydeltay, float rayd, float raydist2) const;
+
+	const LevelAABBTree *mTree;
+
+	enum { StackSize = 16 };
+};
@@ -23,6 +23,7 @@
 #include "gl/system/gl_system.h"
 #include "gl/shaders/gl_shader.h"
 #include "gl/dynlights/gl_shadowmap.h"
+#include "gl/dynlights/gl_cpushadowmap.h"
 #include "gl/dynlights/gl_dynlight.h"
 #include "gl/system/gl_interface.h"
 #include "gl/system/gl_debug.h"
@@ -34,6 +35,7 @@
 #include "r_state.h"
 #include "g_levellocals.h"
 #include "stats.h"
+#include "c_dispatch.h"
 
 /*
 	The 1D shadow maps are stored in a 1024x1024 texture as float depth values (R32F).
@@ -73,6 +75,7 @@ namespace
 	cycle_t UpdateCycles;
 	int LightsProcessed;
 	int LightsShadowmapped;
+	bool VerifyNextUpdate;
 }
 
 ADD_STAT(shadowmap)
@@ -125,6 +128,12 @@ void FShadowMap::Update()
 	glViewport(0, 0, gl_shadowmap_quality, 1024);
 	GLRenderer->RenderScreenQuad();
 
+	if (VerifyNextUpdate)
+	{
+		VerifyNextUpdate = false;
+		VerifyWithCPU();
+	}
+
 	const auto &viewport = GLRenderer->mScreenViewport;
 	glViewport(viewport.left, viewport.top, viewport.width, viewport.height);
 
@@ -139,6 +148,48 @@ void FShadowMap::Update()
 	UpdateCycles.Unclock();
 }
 
+//==========================================================================
+//
+// Reads back the shadow map texture and compares it with the CPU version.
+// The shadow map framebuffer must be bound.
+//
+//==========================================================================
+
+CCMD(gl_shadowmap_verify)
+{
+	VerifyNextUpdate = true;
+}
+
+void FShadowMap::VerifyWithCPU()
+{
+	int quality = gl_shadowmap_quality;
+
+	TArray<float> gpurows, cpurows;
+	gpurows.Resize(quality * 1024);
+	cpurows.Resize(quality * 1024);
+
+	glPixelStorei(GL_PACK_ALIGNMENT, 4);
+	glReadPixels(0, 0, quality, 1024, GL_RED, GL_FLOAT, &gpurows[0]);
+
+	FCPUShadowMap cpu(mAABBTree.get());
+	cpu.RenderLights(&mLights[0], 1024, quality, &cpurows[0]);
+
+	int exact = 0, close = 0, different = 0;
+	float maxerror = 0.0f;
+	for (int i = 0; i < quality * 1024; i++)
+	{
+		float gpu = gpurows[i];
+		float ref = cpurows[i];
+		float error = fabsf(gpu - ref) / MAX(fabsf(ref), 1.0f);
+		if (gpu == ref) exact++;
+		else if (error < 0.001f) close++;
+		else different++;
+		maxerror = MAX(maxerror, error);
+	}
+
+	Printf("Shadow map texels: %d identical, %d within 0.1%%, %d different (max relative error %f)\n", exact, close, different, maxerror);
+}
+
 bool FShadowMap::ShadowTest(ADynamicLight *light, const DVector3 &pos)
 {
 	if (light->shadowmapped && light->radius > 0.0 && IsEnabled() && mAABBTree)
@@ -36,6 +36,9 @@ private:
 	// Upload light list to the GPU
 	void UploadLights();
 
+	// Compare the shadow map texture with the CPU reference implementation (gl_shadowmap_verify)
+	void VerifyWithCPU();
+
 	// OpenGL storage buffer with the list of lights in the shadow map texture
 	int mLightList = 0;
 
@@ -34,7 +34,17 @@
 #include "gl/renderer/gl_lightdata.h"
 #include "gl/scene/gl_drawinfo.h"
 #include "gl/textures/gl_translate.h"
+#include "gl/shaders/gl_shader.h"
+#include "textures/textureatlas.h"
 #include "vectors.h"
+#include "c_dispatch.h"
+#include "files.h"
+#include "stats.h"
+#include "v_video.h"
+
+CVAR(Bool, gl_2d_atlas, true, CVAR_ARCHIVE | CVAR_GLOBALCONFIG)
+CVAR(Bool, gl_2d_reorder, true, CVAR_ARCHIVE | CVAR_GLOBALCONFIG)
+EXTERN_CVAR(Int, gl_texture_hqresize)
 
 //==========================================================================
 //
@@ -47,9 +57,31 @@ int F2DDrawer::AddData(const F2DDrawer::DataGeneric *data)
 	int addr = mData.Reserve(data->mLen);
 	memcpy(&mData[addr], data, data->mLen);
 	mLastLineCmd = -1;
+	mBatchesValid = false;
 	return addr;
 }
 
+//==========================================================================
+//
+// Small images are drawn from an atlas page instead of their own texture
+// so that the draws can share a texture binding.
+//
+//==========================================================================
+
+static bool GetAtlasEntry(FTexture *img, FMaterial *gltex, FAtlasEntry &entry)
+{
+	// Upscaling would be applied to the whole page. Hires replacements never need
+	// to be checked because they are not used for clamped textures.
+	if (!gl_2d_atlas || gl_texture_hqresize != 0)
+		return false;
+
+	// Brightmaps and custom shaders need the image's own material
+	if (gltex->GetLayers() > 1 || img->gl_info.shaderindex >= FIRST_USER_SHADER)
+		return false;
+
+	return FTextureAtlas::Get(img, entry);
+}
+
 //==========================================================================
 //
 // Draws a texture
@@ -105,6 +137,16 @@ void F2DDrawer::AddTexture(FTexture *img, DrawParms &parms)
 		u2 = gltex->GetUR();
 		v2 = gltex->GetVB();
 
+		FAtlasEntry entry;
+		FMaterial *pagetex;
+		if (GetAtlasEntry(img, gltex, entry) && (pagetex = FMaterial::ValidateTexture(entry.Page, false)) != nullptr)
+		{
+			dg.mTexture = pagetex;
+			u1 = entry.U1;
+			v1 = entry.V1;
+			u2 = entry.U2;
+			v2 = entry.V2;
+		}
 	}
 	else
 	{
@@ -115,6 +157,7 @@ void F2DDrawer::AddTexture(FTexture *img, DrawParms &parms)
 		v2 = 0.f;
 	}
 
+	double uwidth = u2 - u1;
 	if (parms.flipX) 
 		std::swap(u1, u2);
 
@@ -125,8 +168,8 @@ void F2DDrawer::AddTexture(FTexture *img, DrawParms &parms)
 		x += parms.windowleft * xscale;
 		w -= (parms.texwidth - wi + parms.windowleft) * xscale;
 
-		u1 = float(u1 + parms.windowleft / parms.texwidth);
-		u2 = float(u2 - (parms.texwidth - wi) / parms.texwidth);
+		u1 = float(u1 + uwidth * parms.windowleft / parms.texwidth);
+		u2 = float(u2 - uwidth * (parms.texwidth - wi) / parms.texwidth);
 	}
 
 	PalEntry color;
@@ -336,6 +379,7 @@ void F2DDrawer::AddLine(int x1, int y1, int x2, int y2, int palcolor, uint32_t c
 	{
 		DataGeneric *dg = (DataGeneric *)&mData[mLastLineCmd];
 		dg->mVertCount += 2;
+		mBatchesValid = false;
 	}
 }
 
@@ -355,13 +399,239 @@ void F2DDrawer::AddPixel(int x1, int y1, int palcolor, uint32_t color)
 
 	dg.mType = DrawTypePixel;
 	dg.mLen = (sizeof(dg) + 7) & ~7;
-	dg.mVertCount = 2;
+	dg.mVertCount = 1;
 	dg.mVertIndex = (int)mVertices.Reserve(1);
 	mVertices[dg.mVertIndex].Set(x1, y1, 0, 0, 0, p);
 	AddData(&dg);
 }
 
 
+//==========================================================================
+//
+// Batching
+//
+// Commands with the same state are drawn with a single call. All primitives
+// are converted to triangles (or lines and points) so that they can share a
+// draw call. A command can also be moved in front of earlier commands if it
+// does not overlap any of them, which leaves the image unchanged but lets
+// text and other interleaved graphics share far more batches.
+//
+//==========================================================================
+
+enum
+{
+	MaxLookahead = 256,		// commands checked for each batch
+	MaxSkipped = 32,		// commands a later one may be moved in front of
+	RecordVersion = 1
+};
+
+struct F2DBounds
+{
+	float x1, y1, x2, y2;
+
+	bool Overlaps(const F2DBounds &other) const
+	{
+		return x1 < other.x2 && other.x1 < x2 && y1 < other.y2 && other.y1 < y2;
+	}
+
+	void Add(const F2DBounds &other)
+	{
+		x1 = MIN(x1, other.x1);
+		y1 = MIN(y1, other.y1);
+		x2 = MAX(x2, other.x2);
+		y2 = MAX(y2, other.y2);
+	}
+};
+
+struct F2DCommand
+{
+	int Offset;
+	F2DBounds Bounds;
+	bool Done;
+};
+
+struct F2DStats
+{
+	int Commands = 0;
+	int Batches = 0;
+	int Vertices = 0;
+	double BatchMS = 0;
+};
+
+static F2DStats FrameStats, LastFrameStats;
+static uint64_t StatsFrameTime;
+
+//==========================================================================
+//
+// Only the state the commands were recorded with is compared, so this
+// must not dereference the materials. bench_2d uses recorded pointers.
+//
+//==========================================================================
+
+bool F2DDrawer::CanMerge(const DataGeneric *a, const DataGeneric *b)
+{
+	if (a->mType != b->mType) return false;
+
+	switch (a->mType)
+	{
+	case DrawTypeTexture:
+	{
+		auto ta = static_cast<const DataTexture*>(a);
+		auto tb = static_cast<const DataTexture*>(b);
+
+		// The color overlay is a second pass with a different state.
+		return ta->mVertCount == 4 && tb->mVertCount == 4 && ta->mTexture == tb->mTexture && ta->mTranslation == tb->mTranslation &&
+			ta->mRenderStyle == tb->mRenderStyle && ta->mMasked == tb->mMasked && ta->mAlphaTexture == tb->mAlphaTexture &&
+			!memcmp(ta->mScissor, tb->mScissor, sizeof(ta->mScissor));
+	}
+
+	case DrawTypeFlatFill:
+		return static_cast<const DataFlatFill*>(a)->mTexture == static_cast<const DataFlatFill*>(b)->mTexture;
+
+	case DrawTypePoly:
+	{
+		auto pa = static_cast<const DataSimplePoly*>(a);
+		auto pb = static_cast<const DataSimplePoly*>(b);
+		FColormap colormap = pa->mColormap;
+		return pa->mTexture == pb->mTexture && pa->mLightLevel == pb->mLightLevel && pa->mFlatColor == pb->mFlatColor && colormap == pb->mColormap;
+	}
+
+	default:
+		// Dims, lines and pixels only use the vertex colors.
+		return true;
+	}
+}
+
+//==========================================================================
+//
+//
+//
+//==========================================================================
+
+void F2DDrawer::BuildBatches(const TArray<uint8_t> &data, const TArray<FSimpleVertex> &vertices, bool reorder, TArray<FBatch> &batches, TArray<FSimpleVertex> &batchvertices)
+{
+	batches.Clear();
+	batchvertices.Clear();
+
+	// The 2D vertices store the screen y coordinate in z.
+	TArray<F2DCommand> commands;
+	for (unsigned i = 0; i < data.Size();)
+	{
+		auto dg = (const DataGeneric *)&data[i];
+		const FSimpleVertex *v = &vertices[dg->mVertIndex];
+
+		F2DCommand cmd;
+		cmd.Offset = i;
+		cmd.Done = false;
+		cmd.Bounds = { v->x, v->z, v->x, v->z };
+		for (int j = 1; j < dg->mVertCount; j++)
+		{
+			cmd.Bounds.Add({ v[j].x, v[j].z, v[j].x, v[j].z });
+		}
+		if (dg->mType == DrawTypeLine || dg->mType == DrawTypePixel)
+		{
+			cmd.Bounds.x2 += 1;
+			cmd.Bounds.y2 += 1;
+		}
+		commands.Push(cmd);
+		i += dg->mLen;
+	}
+
+	auto addvertices = [&](const DataGeneric *dg)
+	{
+		const FSimpleVertex *v = &vertices[dg->mVertIndex];
+		switch (dg->mType)
+		{
+		case DrawTypeTexture:
+		case DrawTypeFlatFill:
+		{
+			// Strips of 4 vertices. The color overlay is a second strip.
+			FSimpleVertex *out = &batchvertices[batchvertices.Reserve(dg->mVertCount / 4 * 6)];
+			for (int i = 0; i < dg->mVertCount; i += 4, v += 4)
+			{
+				*out++ = v[0];
+				*out++ = v[1];
+				*out++ = v[2];
+				*out++ = v[2];
+				*out++ = v[1];
+				*out++ = v[3];
+			}
+			break;
+		}
+
+		case DrawTypeDim:
+		case DrawTypePoly:
+		{
+			// Fans
+			FSimpleVertex *out = &batchvertices[batchvertices.Reserve((dg->mVertCount - 2) * 3)];
+			for (int i = 1; i < dg->mVertCount - 1; i++)
+			{
+				*out++ = v[0];
+				*out++ = v[i];
+				*out++ = v[i + 1];
+			}
+			break;
+		}
+
+		default:
+			memcpy(&batchvertices[batchvertices.Reserve(dg->mVertCount)], v, dg->mVertCount * sizeof(FSimpleVertex));
+			break;
+		}
+	};
+
+	TArray<F2DBounds> skipped;
+	for (unsigned i = 0; i < commands.Size(); i++)
+	{
+		if (commands[i].Done) continue;
+
+		auto first = (const DataGeneric *)&data[commands[i].Offset];
+		FBatch batch = { commands[i].Offset, (int)batchvertices.Size(), 0 };
+		addvertices(first);
+		commands[i].Done = true;
+
+		// A later command with the same state joins the batch if nothing it skips over overlaps it.
+		// Everything it does overlap must stay in front of it, so such commands are skipped as well.
+		F2DBounds skippedarea;
+		skipped.Clear();
+		unsigned end = MIN(commands.Size(), i + 1 + MaxLookahead);
+		for (unsigned j = i + 1; j < end; j++)
+		{
+			F2DCommand &cmd = commands[j];
+			if (cmd.Done) continue;
+
+			auto dg = (const DataGeneric *)&data[cmd.Offset];
+			bool blocked = false;
+			if (skipped.Size() > 0 && cmd.Bounds.Overlaps(skippedarea))
+			{
+				for (auto &bounds : skipped)
+				{
+					if (cmd.Bounds.Overlaps(bounds))
+					{
+						blocked = true;
+						break;
+					}
+				}
+			}
+
+			if (!blocked && CanMerge(first, dg))
+			{
+				addvertices(dg);
+				cmd.Done = true;
+			}
+			else
+			{
+				if (!reorder || skipped.Size() == MaxSkipped) break;
+				if (skipped.Size() == 0) skippedarea = cmd.Bounds;
+				else skippedarea.Add(cmd.Bounds);
+				skipped.Push(cmd.Bounds);
+			}
+		}
+
+		batch.mVertCount = batchvertices.Size() - batch.mVertIndex;
+		batches.Push(batch);
+	}
+}
+
 //==========================================================================
 //
 //
@@ -373,15 +643,58 @@ void F2DDrawer::Draw()
 	F2DDrawer::EDrawType lasttype = DrawTypeTexture;
 
 	if (mData.Size() == 0) return;
+
+	if (mRecordFile.IsNotEmpty())
+	{
+		SaveCommands(mRecordFile);
+		mRecordFile = "";
+	}
+
+	if (screen->FrameTime != StatsFrameTime)
+	{
+		LastFrameStats = FrameStats;
+		FrameStats = F2DStats();
+		StatsFrameTime = screen->FrameTime;
+	}
+
+	// The list is drawn once per eye in stereo 3D.
+	if (!mBatchesValid)
+	{
+		cycle_t timer;
+		timer.Reset();
+		timer.Clock();
+		BuildBatches(mData, mVertices, gl_2d_reorder, mBatches, mBatchVertices);
+		timer.Unclock();
+		mBatchesValid = true;
+
+		for (unsigned i = 0; i < mData.Size(); i += ((DataGeneric *)&mData[i])->mLen)
+		{
+			FrameStats.Commands++;
+		}
+		FrameStats.Batches += mBatches.Size();
+		FrameStats.Vertices += mBatchVertices.Size();
+		FrameStats.BatchMS += timer.TimeMS();
+	}
+
+	// Pages that got new images must be uploaded again
+	TArray<FTexture *> changedpages;
+	FTextureAtlas::GetChangedPages(changedpages);
+	for (auto page : changedpages)
+	{
+		FMaterial *pagetex = FMaterial::ValidateTexture(page, false);
+		if (pagetex != nullptr) pagetex->Clean(true);
+	}
+	if (changedpages.Size() > 0) FMaterial::ClearLastTexture();
+
 	int8_t savedlightmode = glset.lightmode;
 	// lightmode is only relevant for automap subsectors,
 	// but We cannot use the software light mode here because it doesn't properly calculate the light for 2D rendering.
 	if (glset.lightmode == 8) glset.lightmode = 0;
 
-	set(&mVertices[0], mVertices.Size());
-	for (unsigned i = 0; i < mData.Size();)
+	set(&mBatchVertices[0], mBatchVertices.Size());
+	for (auto &batch : mBatches)
 	{
-		DataGeneric *dg = (DataGeneric *)&mData[i];
+		DataGeneric *dg = (DataGeneric *)&mData[batch.mCommand];
 		// DrawTypePoly may not use the color part of the vertex buffer because it needs to use gl_SetColor to produce proper output.
 		if (lasttype == DrawTypePoly && dg->mType != DrawTypePoly)
 		{
@@ -402,6 +715,8 @@ void F2DDrawer::Draw()
 		case DrawTypeTexture:
 		{
 			DataTexture *dt = static_cast<DataTexture*>(dg);
+			// A command with a color overlay is always a batch of its own, with the overlay in the second half.
+			int count = dt->mVertCount > 4 ? batch.mVertCount / 2 : batch.mVertCount;
 
 			gl_SetRenderStyle(dt->mRenderStyle, !dt->mMasked, false);
 			gl_RenderState.SetMaterial(dt->mTexture, CLAMP_XY_NOMIP, dt->mTranslation, -1, dt->mAlphaTexture);
@@ -413,7 +728,7 @@ void F2DDrawer::Draw()
 			gl_RenderState.AlphaFunc(GL_GEQUAL, 0.f);
 			gl_RenderState.Apply();
 
-			glDrawArrays(GL_TRIANGLE_STRIP, dt->mVertIndex, 4);
+			glDrawArrays(GL_TRIANGLES, batch.mVertIndex, count);
 
 			gl_RenderState.BlendEquation(GL_FUNC_ADD);
 			if (dt->mVertCount > 4)
@@ -421,7 +736,7 @@ void F2DDrawer::Draw()
 				gl_RenderState.SetTextureMode(TM_MASK);
 				gl_RenderState.BlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 				gl_RenderState.Apply();
-				glDrawArrays(GL_TRIANGLE_STRIP, dt->mVertIndex + 4, 4);
+				glDrawArrays(GL_TRIANGLES, batch.mVertIndex + count, count);
 			}
 
 			const auto &viewport = GLRenderer->mScreenViewport;
@@ -440,7 +755,7 @@ void F2DDrawer::Draw()
 			gl_RenderState.SetMaterial(dsp->mTexture, CLAMP_NONE, 0, -1, false);
 			gl_RenderState.SetObjectColor(dsp->mFlatColor|0xff000000);
 			gl_RenderState.Apply();
-			glDrawArrays(GL_TRIANGLE_FAN, dsp->mVertIndex, dsp->mVertCount);
+			glDrawArrays(GL_TRIANGLES, batch.mVertIndex, batch.mVertCount);
 			gl_RenderState.SetObjectColor(0xffffffff);
 			break;
 		}
@@ -450,7 +765,7 @@ void F2DDrawer::Draw()
 			DataFlatFill *dff = static_cast<DataFlatFill*>(dg);
 			gl_RenderState.SetMaterial(dff->mTexture, CLAMP_NONE, 0, -1, false);
 			gl_RenderState.Apply();
-			glDrawArrays(GL_TRIANGLE_STRIP, dg->mVertIndex, dg->mVertCount);
+			glDrawArrays(GL_TRIANGLES, batch.mVertIndex, batch.mVertCount);
 			break;
 		}
 
@@ -459,26 +774,25 @@ void F2DDrawer::Draw()
 			gl_RenderState.BlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 			gl_RenderState.AlphaFunc(GL_GREATER, 0);
 			gl_RenderState.Apply();
-			glDrawArrays(GL_TRIANGLE_FAN, dg->mVertIndex, dg->mVertCount);
+			glDrawArrays(GL_TRIANGLES, batch.mVertIndex, batch.mVertCount);
 			gl_RenderState.EnableTexture(true);
 			break;
 
 		case DrawTypeLine:
 			gl_RenderState.EnableTexture(false);
 			gl_RenderState.Apply();
-			glDrawArrays(GL_LINES, dg->mVertIndex, dg->mVertCount);
+			glDrawArrays(GL_LINES, batch.mVertIndex, batch.mVertCount);
 			gl_RenderState.EnableTexture(true);
 			break;
 
 		case DrawTypePixel:
 			gl_RenderState.EnableTexture(false);
 			gl_RenderState.Apply();
-			glDrawArrays(GL_POINTS, dg->mVertIndex, dg->mVertCount);
+			glDrawArrays(GL_POINTS, batch.mVertIndex, batch.mVertCount);
 			gl_RenderState.EnableTexture(true);
 			break;
 
 		}
-		i += dg->mLen;
 	}
 	gl_RenderState.SetVertexBuffer(GLRenderer->mVBO);
 	glset.lightmode = savedlightmode;
@@ -489,4 +803,155 @@ void F2DDrawer::Clear()
 	mVertices.Clear();
 	mData.Clear();
 	mLastLineCmd = -1;
+	mBatchesValid = false;
+}
+
+//==========================================================================
+//
+// Recording of the command list
+//
+// The commands are saved as they are, including the material pointers,
+// which the batching only compares.
+//
+//==========================================================================
+
+void F2DDrawer::SaveCommands(const char *filename)
+{
+	FileWriter *fw = FileWriter::Open(filename);
+	if (fw == nullptr)
+	{
+		Printf("Could not open %s\n", filename);
+		return;
+	}
+
+	uint32_t header[] = { MAKE_ID('2','D','C','L'), RecordVersion, sizeof(FSimpleVertex), sizeof(void *), mData.Size(), mVertices.Size() };
+	size_t vertexbytes = mVertices.Size() * sizeof(FSimpleVertex);
+	bool success = fw->Write(header, sizeof(header)) == sizeof(header) &&
+		fw->Write(&mData[0], mData.Size()) == mData.Size() &&
+		fw->Write(&mVertices[0], vertexbytes) == vertexbytes;
+	delete fw;
+
+	if (success) Printf("Recorded %u bytes of 2D commands and %u vertices to %s\n", mData.Size(), mVertices.Size(), filename);
+	else Printf("Could not write %s\n", filename);
+}
+
+//==========================================================================
+//
+// Batches a recorded command list with and without reordering. This does
+// not need a renderer.
+//
+//==========================================================================
+
+void F2DDrawer::BenchmarkBatching(const char *filename, int iterations)
+{
+	FileReader fr;
+	if (!fr.Open(filename))
+	{
+		Printf("Could not open %s\n", filename);
+		return;
+	}
+
+	uint32_t header[6];
+	if (fr.Read(header, sizeof(header)) != sizeof(header) || header[0] != MAKE_ID('2','D','C','L') || header[1] != RecordVersion ||
+		header[2] != sizeof(FSimpleVertex) || header[3] != sizeof(void *) || header[4] == 0 || header[5] == 0)
+	{
+		Printf("%s is not a 2D command recording of this build\n", filename);
+		return;
+	}
+
+	TArray<uint8_t> data(header[4], true);
+	TArray<FSimpleVertex> vertices(header[5], true);
+	long vertexbytes = long(vertices.Size() * sizeof(FSimpleVertex));
+	if (fr.Read(&data[0], data.Size()) != (long)data.Size() || fr.Read(&vertices[0], vertexbytes) != vertexbytes)
+	{
+		Printf("%s is truncated\n", filename);
+		return;
+	}
+
+	// BuildBatches expects what the Add functions create: quads for textures and flat fills,
+	// fans of at least one triangle for dims and polygons, pairs for lines.
+	auto isvalid = [](const DataGeneric *dg)
+	{
+		switch (dg->mType)
+		{
+		case DrawTypeTexture:
+			return dg->mLen >= sizeof(DataTexture) && dg->mVertCount % 4 == 0;
+		case DrawTypeFlatFill:
+			return dg->mLen >= sizeof(DataFlatFill) && dg->mVertCount % 4 == 0;
+		case DrawTypePoly:
+			return dg->mLen >= sizeof(DataSimplePoly) && dg->mVertCount >= 3;
+		case DrawTypeDim:
+			return dg->mVertCount >= 3;
+		case DrawTypeLine:
+			return dg->mVertCount % 2 == 0;
+		case DrawTypePixel:
+			return true;
+		default:
+			return false;
+		}
+	};
+
+	int numcommands = 0;
+	for (unsigned i = 0; i < data.Size(); numcommands++)
+	{
+		auto dg = (const DataGeneric *)&data[i];
+		if (data.Size() - i < sizeof(DataGeneric) || dg->mLen < sizeof(DataGeneric) || dg->mLen > data.Size() - i ||
+			dg->mVertIndex < 0 || dg->mVertCount < 1 || unsigned(dg->mVertIndex) > vertices.Size() ||
+			unsigned(dg->mVertCount) > vertices.Size() - dg->mVertIndex || !isvalid(dg))
+		{
+			Printf("%s is damaged\n", filename);
+			return;
+		}
+		i += dg->mLen;
+	}
+
+	TArray<FBatch> batches;
+	TArray<FSimpleVertex> batchvertices;
+	cycle_t timer;
+	Printf("%d commands, %u vertices\n", numcommands, vertices.Size());
+	for (int pass = 0; pass < 2; pass++)
+	{
+		bool reorder = pass == 1;
+		timer.Reset();
+		timer.Clock();
+		for (int i = 0; i < iterations; i++)
+		{
+			BuildBatches(data, vertices, reorder, batches, batchvertices);
+		}
+		timer.Unclock();
+		Printf("%-10s %6u batches  %7u vertices  %8.3f ms\n", reorder ? "reordered" : "merged", batches.Size(), batchvertices.Size(), timer.TimeMS() / iterations);
+	}
+}
+
+//==========================================================================
+//
+//
+//
+//==========================================================================
+
+ADD_STAT(draw2d)
+{
+	FString out;
+	out.Format("2D: %d commands, %d batches, %d vertices, %.3f ms batching",
+		LastFrameStats.Commands, LastFrameStats.Batches, LastFrameStats.Vertices, LastFrameStats.BatchMS);
+	return out;
+}
+
+CCMD(record2d)
+{
+	if (GLRenderer == nullptr || GLRenderer->m2DDrawer == nullptr)
+	{
+		Printf("record2d requires the OpenGL renderer\n");
+		return;
+	}
+	GLRenderer->m2DDrawer->Record(argv.argc() > 1 ? argv[1] : "2dcommands.dat");
+}
+
+CCMD(bench_2d)
+{
+	int iterations = argv.argc() > 2 ? atoi(argv[2]) : 100;
+	if (iterations <= 0)
+		return;
+
+	F2DDrawer::BenchmarkBatching(argv.argc() > 1 ? argv[1] : "2dcommands.dat", iterations);
 }
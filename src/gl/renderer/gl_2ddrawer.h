@@ -2,6 +2,7 @@
 #define __2DDRAWER_H
 
 #include "tarray.h"
+#include "zstring.h"
 #include "gl/data/gl_vertexbuffer.h"
 
 class F2DDrawer : public FSimpleVertexBuffer
@@ -48,11 +49,28 @@ class F2DDrawer : public FSimpleVertexBuffer
 		PalEntry mFlatColor;
 	};
 
+	// A single draw call made of one or more commands with the same state
+	struct FBatch
+	{
+		int mCommand;		// offset of the first command in mData, which provides the state
+		int mVertIndex;		// in mBatchVertices
+		int mVertCount;
+	};
+
 	TArray<FSimpleVertex> mVertices;
 	TArray<uint8_t> mData;
 	int mLastLineCmd = -1;	// consecutive lines can be batched into a single draw call so keep this info around.
+
+	TArray<FBatch> mBatches;
+	TArray<FSimpleVertex> mBatchVertices;	// all primitives converted to triangles, lines or points in batch order
+	bool mBatchesValid = false;
+	FString mRecordFile;
 	
 	int AddData(const DataGeneric *data);
+
+	static bool CanMerge(const DataGeneric *a, const DataGeneric *b);
+	static void BuildBatches(const TArray<uint8_t> &data, const TArray<FSimpleVertex> &vertices, bool reorder, TArray<FBatch> &batches, TArray<FSimpleVertex> &batchvertices);
+	void SaveCommands(const char *filename);
 	
 public:
 	void AddTexture(FTexture *img, DrawParms &parms);
@@ -69,6 +87,11 @@ public:
 		
 	void Draw();
 	void Clear();
+
+	// Writes the command list of the next Draw call to a file, which BenchmarkBatching can
+	// load without a renderer. The recording is only valid for the build that made it.
+	void Record(const char *filename) { mRecordFile = filename; }
+	static void BenchmarkBatching(const char *filename, int iterations);
 };
 
 
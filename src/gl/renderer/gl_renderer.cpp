@@ -51,6 +51,7 @@
 #include "gl/data/gl_vertexbuffer.h"
 #include "gl/scene/gl_drawinfo.h"
 #include "gl/scene/gl_portal.h"
+#include "gl/scene/gl_setupthreads.h"
 #include "gl/shaders/gl_shader.h"
 #include "gl/shaders/gl_ambientshader.h"
 #include "gl/shaders/gl_bloomshader.h"
@@ -102,6 +103,7 @@ FGLRenderer::FGLRenderer(OpenGLFrameBuffer *fb)
 	mViewVector = FVector2(0,0);
 	mVBO = nullptr;
 	mSkyVBO = nullptr;
+	mSetupThreads = nullptr;
 	gl_spriteindex = 0;
 	mShaderManager = nullptr;
 	gllight = glpart2 = glpart = mirrortexture = nullptr;
@@ -179,6 +181,7 @@ void FGLRenderer::Initialize(int width, int height)
 
 	mVBO = new FFlatVertexBuffer(width, height);
 	mSkyVBO = new FSkyVertexBuffer;
+	mSetupThreads = new GLSetupThreads;
 	if (!gl.legacyMode) mLights = new FLightBuffer();
 	else mLights = NULL;
 	gl_RenderState.SetVertexBuffer(mVBO);
@@ -199,12 +202,14 @@ FGLRenderer::~FGLRenderer()
 
 	gl_FlushModels();
 	AActor::DeleteAllAttachedLights();
+	gl_StopUpsampledTextureQueue();
 	FMaterial::FlushAll();
 	if (m2DDrawer != nullptr) delete m2DDrawer;
 	if (mShaderManager != NULL) delete mShaderManager;
 	if (mSamplerManager != NULL) delete mSamplerManager;
 	if (mVBO != NULL) delete mVBO;
 	if (mSkyVBO != NULL) delete mSkyVBO;
+	if (mSetupThreads != NULL) delete mSetupThreads;
 	if (mLights != NULL) delete mLights;
 	if (glpart2) delete glpart2;
 	if (glpart) delete glpart;
@@ -18,6 +18,7 @@ struct FDrawInfo;
 class FShaderManager;
 class GLPortal;
 class FLightBuffer;
+class GLSetupThreads;
 class FSamplerManager;
 class DPSprite;
 class FGLRenderBuffers;
@@ -145,6 +146,7 @@ public:
 
 	FFlatVertexBuffer *mVBO;
 	FSkyVertexBuffer *mSkyVBO;
+	GLSetupThreads *mSetupThreads;
 	FLightBuffer *mLights;
 	F2DDrawer *m2DDrawer;
 
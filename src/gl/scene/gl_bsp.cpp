@@ -40,6 +40,7 @@
 #include "gl/data/gl_vertexbuffer.h"
 #include "gl/scene/gl_scenedrawer.h"
 #include "gl/scene/gl_portal.h"
+#include "gl/scene/gl_setupthreads.h"
 #include "gl/scene/gl_wall.h"
 #include "gl/utility/gl_clock.h"
 
@@ -173,9 +174,18 @@ void GLSceneDrawer::AddLine (seg_t *seg, bool portalclip)
 		{
 			SetupWall.Clock();
 
-			GLWall wall(this);
-			wall.sub = currentsubsector;
-			wall.Process(seg, currentsector, backsector);
+			GLSetupThreads *setup = GLRenderer->mSetupThreads;
+			if (setup->Active())
+			{
+				if (backsector == &bs) backsector = setup->KeepSector(&bs);
+				setup->AddWall(seg, currentsubsector, currentsector, backsector);
+			}
+			else
+			{
+				GLWall wall(this);
+				wall.sub = currentsubsector;
+				wall.Process(seg, currentsector, backsector);
+			}
 			rendered_lines++;
 
 			SetupWall.Unclock();
@@ -351,6 +361,8 @@ void GLSceneDrawer::AddSpecialPortalLines(subsector_t * sub, sector_t * sector,
 
 void GLSceneDrawer::RenderThings(subsector_t * sub, sector_t * sector)
 {
+	GLSetupThreads *setup = GLRenderer->mSetupThreads;
+
 	SetupSprite.Clock();
 	sector_t * sec=sub->sector;
 	// Handle all things in sector.
@@ -371,8 +383,15 @@ void GLSceneDrawer::RenderThings(subsector_t * sub, sector_t * sector)
 			}
 		}
 
-		GLSprite sprite(this);
-		sprite.Process(thing, sector, false);
+		if (setup->Active())
+		{
+			setup->AddThing(thing, sector, false);
+		}
+		else
+		{
+			GLSprite sprite(this);
+			sprite.Process(thing, sector, false);
+		}
 	}
 	
 	for (msecnode_t *node = sec->sectorportal_thinglist; node; node = node->m_snext)
@@ -389,8 +408,15 @@ void GLSceneDrawer::RenderThings(subsector_t * sub, sector_t * sector)
 			}
 		}
 
-		GLSprite sprite(this);
-		sprite.Process(thing, sector, true);
+		if (setup->Active())
+		{
+			setup->AddThing(thing, sector, true);
+		}
+		else
+		{
+			GLSprite sprite(this);
+			sprite.Process(thing, sector, true);
+		}
 	}
 	SetupSprite.Unclock();
 }
@@ -411,6 +437,7 @@ void GLSceneDrawer::DoSubsector(subsector_t * sub)
 	sector_t * sector;
 	sector_t * fakesector;
 	sector_t fake;
+	GLSetupThreads *setup = GLRenderer->mSetupThreads;
 	
 #ifdef _DEBUG
 	if (sub->sector->sectornum==931)
@@ -436,6 +463,7 @@ void GLSceneDrawer::DoSubsector(subsector_t * sub)
 	if (clipper.IsBlocked()) return;	// if we are inside a stacked sector portal which hasn't unclipped anything yet.
 
 	fakesector=gl_FakeFlat(sector, &fake, in_area, false);
+	if (fakesector == &fake && setup->Active()) fakesector = setup->KeepSector(&fake);
 
 	if (GLRenderer->mClipPortal)
 	{
@@ -449,11 +477,6 @@ void GLSceneDrawer::DoSubsector(subsector_t * sub)
 		}
 	}
 
-	if (sector->validcount != validcount)
-	{
-		GLRenderer->mVBO->CheckUpdate(sector);
-	}
-
 	// [RH] Add particles
 	//int shade = LIGHT2SHADE((floorlightlevel + ceilinglightlevel)/2 + r_actualextralight);
 	if (gl_render_things)
@@ -462,8 +485,15 @@ void GLSceneDrawer::DoSubsector(subsector_t * sub)
 
 		for (i = ParticlesInSubsec[sub->Index()]; i != NO_PARTICLE; i = Particles[i].snext)
 		{
-			GLSprite sprite(this);
-			sprite.ProcessParticle(&Particles[i], fakesector);
+			if (setup->Active())
+			{
+				setup->AddParticle(&Particles[i], fakesector);
+			}
+			else
+			{
+				GLSprite sprite(this);
+				sprite.ProcessParticle(&Particles[i], fakesector);
+			}
 		}
 		SetupSprite.Unclock();
 	}
@@ -503,6 +533,7 @@ void GLSceneDrawer::DoSubsector(subsector_t * sub)
 					// the planes of this subsector are faked to belong to another sector
 					// This means we need the heightsec parts and light info of the render sector, not the actual one.
 					fakesector = gl_FakeFlat(sector, &fake, in_area, false);
+					if (fakesector == &fake && setup->Active()) fakesector = setup->KeepSector(&fake);
 				}
 
 				uint8_t &srf = gl_drawinfo->sectorrenderflags[sub->render_sector->sectornum];
@@ -511,8 +542,15 @@ void GLSceneDrawer::DoSubsector(subsector_t * sub)
 					srf |= SSRF_PROCESSED;
 
 					SetupFlat.Clock();
-					GLFlat flat(this);
-					flat.ProcessSector(fakesector);
+					if (setup->Active())
+					{
+						setup->AddSector(fakesector);
+					}
+					else
+					{
+						GLFlat flat(this);
+						flat.ProcessSector(fakesector);
+					}
 					SetupFlat.Unclock();
 				}
 				// mark subsector as processed - but mark for rendering only if it has an actual area.
@@ -37,6 +37,10 @@
 
 #include "gl/scene/gl_clipper.h"
 #include "g_levellocals.h"
+#include "doomstat.h"
+#include "d_player.h"
+#include "c_dispatch.h"
+#include "stats.h"
 
 unsigned Clipper::starttime;
 
@@ -47,77 +51,51 @@ Clipper::Clipper()
 
 //-----------------------------------------------------------------------------
 //
-// RemoveRange
+// Clear
 //
 //-----------------------------------------------------------------------------
 
-void Clipper::RemoveRange(ClipNode * range)
+void Clipper::Clear()
 {
-	if (range == cliphead)
-	{
-		cliphead = cliphead->next;
-	}
-	else
-	{
-		if (range->prev) range->prev->next = range->next;
-		if (range->next) range->next->prev = range->prev;
-	}
-	
-	Free(range);
+	blocked = false;
+	clipnodes.Clear();
+	silhouette.Clear();
+	starttime++;
 }
 
 //-----------------------------------------------------------------------------
 //
-// Clear
+// SetSilhouette
 //
 //-----------------------------------------------------------------------------
 
-void Clipper::Clear()
+void Clipper::SetSilhouette()
 {
-	ClipNode *node = cliphead;
-	ClipNode *temp;
-	
-	blocked = false;
-	while (node != NULL)
+	if (silhouette.Size() == 0)
 	{
-		temp = node;
-		node = node->next;
-		Free(temp);
+		silhouette = clipnodes;
 	}
-	node = silhouette;
-
-	while (node != NULL)
-	{
-		temp = node;
-		node = node->next;
-		Free(temp);
-	}
-	
-	cliphead = NULL;
-	silhouette = NULL;
-	starttime++;
 }
 
 //-----------------------------------------------------------------------------
 //
-// SetSilhouette
+// Returns the index of the first range whose end is not before angle.
+// All ranges in front of it can neither contain nor touch anything
+// starting at angle.
 //
 //-----------------------------------------------------------------------------
 
-void Clipper::SetSilhouette()
+unsigned Clipper::FindFirstEndingAfter(const TArray<ClipNode> &nodes, angle_t angle) const
 {
-	ClipNode *node = cliphead;
-	ClipNode *last = NULL;
-
-	while (node != NULL)
+	unsigned first = 0;
+	unsigned last = nodes.Size();
+	while (first < last)
 	{
-		ClipNode *snode = NewRange(node->start, node->end);
-		if (silhouette == NULL) silhouette = snode;
-		snode->prev = last;
-		if (last != NULL) last->next = snode;
-		last = snode;
-		node = node->next;
+		unsigned mid = (first + last) / 2;
+		if (nodes[mid].end < angle) first = mid + 1;
+		else last = mid;
 	}
+	return first;
 }
 
 //-----------------------------------------------------------------------------
@@ -128,18 +106,17 @@ void Clipper::SetSilhouette()
 
 bool Clipper::IsRangeVisible(angle_t startAngle, angle_t endAngle)
 {
-	ClipNode *ci;
-	ci = cliphead;
-	
-	if (endAngle==0 && ci && ci->start==0) return false;
+	unsigned count = clipnodes.Size();
+	if (count == 0) return true;
+
+	if (endAngle==0 && clipnodes[0].start==0) return false;
 	
-	while (ci != NULL && ci->start < endAngle)
+	// Only the first range reaching endAngle can contain the whole range.
+	// All ranges after it start even later.
+	unsigned i = FindFirstEndingAfter(clipnodes, endAngle);
+	if (i < count && clipnodes[i].start < endAngle && startAngle >= clipnodes[i].start)
 	{
-		if (startAngle >= ci->start && endAngle <= ci->end)
-		{
-			return false;
-		}
-		ci = ci->next;
+		return false;
 	}
 	
 	return true;
@@ -153,99 +130,66 @@ bool Clipper::IsRangeVisible(angle_t startAngle, angle_t endAngle)
 
 void Clipper::AddClipRange(angle_t start, angle_t end)
 {
-	ClipNode *node, *temp, *prevNode;
+	unsigned i;
 
-	if (cliphead)
+	if (clipnodes.Size() > 0)
 	{
 		//check to see if range contains any old ranges
-		node = cliphead;
-		while (node != NULL && node->start < end)
+		i = FindFirstEndingAfter(clipnodes, start);
+		while (i < clipnodes.Size() && clipnodes[i].start < end)
 		{
-			if (node->start >= start && node->end <= end)
+			if (clipnodes[i].start >= start && clipnodes[i].end <= end)
 			{
-				temp = node;
-				node = node->next;
-				RemoveRange(temp);
+				clipnodes.Delete(i);
 			}
-			else if (node->start<=start && node->end>=end)
+			else if (clipnodes[i].start<=start && clipnodes[i].end>=end)
 			{
 				return;
 			}
 			else
 			{
-				node = node->next;
+				i++;
 			}
 		}
 		
 		//check to see if range overlaps a range (or possibly 2)
-		node = cliphead;
-		while (node != NULL && node->start <= end)
+		i = FindFirstEndingAfter(clipnodes, start);
+		if (i < clipnodes.Size() && clipnodes[i].start <= end)
 		{
-			if (node->end >= start)
+			// we found the first overlapping node
+			ClipNode &node = clipnodes[i];
+			if (node.start > start)
 			{
-				// we found the first overlapping node
-				if (node->start > start)
-				{
-					// the new range overlaps with this node's start point
-					node->start = start;
-				}
-
-				if (node->end < end) 
-				{
-					node->end = end;
-				}
-
-				ClipNode *node2 = node->next;
-				while (node2 && node2->start <= node->end)
-				{
-					if (node2->end > node->end) node->end = node2->end;
-					ClipNode *delnode = node2;
-					node2 = node2->next;
-					RemoveRange(delnode);
-				}
-				return;
+				// the new range overlaps with this node's start point
+				node.start = start;
 			}
-			node = node->next;		
-		}
-		
-		//just add range
-		node = cliphead;
-		prevNode = NULL;
-		temp = NewRange(start, end);
-		
-		while (node != NULL && node->start < end)
-		{
-			prevNode = node;
-			node = node->next;
-		}
-		
-		temp->next = node;
-		if (node == NULL)
-		{
-			temp->prev = prevNode;
-			if (prevNode) prevNode->next = temp;
-			if (!cliphead) cliphead = temp;
-		}
-		else
-		{
-			if (node == cliphead)
+
+			if (node.end < end) 
 			{
-				cliphead->prev = temp;
-				cliphead = temp;
+				node.end = end;
 			}
-			else
+
+			unsigned j = i + 1;
+			while (j < clipnodes.Size() && clipnodes[j].start <= node.end)
 			{
-				temp->prev = prevNode;
-				prevNode->next = temp;
-				node->prev = temp;
+				if (clipnodes[j].end > node.end) node.end = clipnodes[j].end;
+				j++;
 			}
+			clipnodes.Delete(i + 1, j - i - 1);
+			return;
+		}
+		
+		//just add range
+		i = 0;
+		while (i < clipnodes.Size() && clipnodes[i].start < end)
+		{
+			i++;
 		}
+		clipnodes.Insert(i, NewRange(start, end));
 	}
 	else
 	{
-		temp = NewRange(start, end);
-		cliphead = temp;
-		return;
+		clipnodes.Push(NewRange(start, end));
 	}
 }
 
@@ -258,26 +202,26 @@ void Clipper::AddClipRange(angle_t start, angle_t end)
 
 void Clipper::RemoveClipRange(angle_t start, angle_t end)
 {
-	ClipNode *node;
+	unsigned i;
 
-	if (silhouette)
+	if (silhouette.Size() > 0)
 	{
-		node = silhouette;
-		while (node != NULL && node->end <= start)
+		i = 0;
+		while (i < silhouette.Size() && silhouette[i].end <= start)
 		{
-			node = node->next;
+			i++;
 		}
-		if (node != NULL && node->start <= start)
+		if (i < silhouette.Size() && silhouette[i].start <= start)
 		{
-			if (node->end >= end) return;
-			start = node->end;
-			node = node->next;
+			if (silhouette[i].end >= end) return;
+			start = silhouette[i].end;
+			i++;
 		}
-		while (node != NULL && node->start < end)
+		while (i < silhouette.Size() && silhouette[i].start < end)
 		{
-			DoRemoveClipRange(start, node->start);
-			start = node->end;
-			node = node->next;
+			DoRemoveClipRange(start, silhouette[i].start);
+			start = silhouette[i].end;
+			i++;
 		}
 		if (start >= end) return;
 	}
@@ -292,50 +236,44 @@ void Clipper::RemoveClipRange(angle_t start, angle_t end)
 
 void Clipper::DoRemoveClipRange(angle_t start, angle_t end)
 {
-	ClipNode *node, *temp;
+	unsigned i;
 
-	if (cliphead)
+	if (clipnodes.Size() > 0)
 	{
 		//check to see if range contains any old ranges
-		node = cliphead;
-		while (node != NULL && node->start < end)
+		i = FindFirstEndingAfter(clipnodes, start);
+		while (i < clipnodes.Size() && clipnodes[i].start < end)
 		{
-			if (node->start >= start && node->end <= end)
+			if (clipnodes[i].start >= start && clipnodes[i].end <= end)
 			{
-				temp = node;
-				node = node->next;
-				RemoveRange(temp);
+				clipnodes.Delete(i);
 			}
 			else
 			{
-				node = node->next;
+				i++;
 			}
 		}
 		
 		//check to see if range overlaps a range (or possibly 2)
-		node = cliphead;
-		while (node != NULL)
+		for (i = FindFirstEndingAfter(clipnodes, start); i < clipnodes.Size() && clipnodes[i].start <= end; i++)
 		{
-			if (node->start >= start && node->start <= end)
+			ClipNode &node = clipnodes[i];
+			if (node.start >= start)
 			{
-				node->start = end;
+				node.start = end;
 				break;
 			}
-			else if (node->end >= start && node->end <= end)
+			else if (node.end <= end)
 			{
-				node->end=start;
+				node.end = start;
 			}
-			else if (node->start < start && node->end > end)
+			else
 			{
-				temp = NewRange(end, node->end);
-				node->end=start;
-				temp->next=node->next;
-				temp->prev=node;
-				node->next=temp;
-				if (temp->next) temp->next->prev=temp;
+				ClipNode tail = NewRange(end, node.end);
+				node.end = start;
+				clipnodes.Insert(i + 1, tail);
 				break;
 			}
-			node = node->next;
 		}
 	}
 }
@@ -439,3 +377,80 @@ bool Clipper::CheckBox(const float *bspcoord)
 	return SafeCheckRange(angle2, angle1);
 }
 
+
+//-----------------------------------------------------------------------------
+//
+// CPU only timing harness for the clipper.
+//
+// Walks the BSP from the current view position for a full turn, occluding
+// with one-sided walls only. No GL calls are made, so this also works
+// with a null video driver.
+//
+//-----------------------------------------------------------------------------
+
+static void BenchClipperNode(Clipper &clipper, void *node, int &visiblesegs)
+{
+	while (!((size_t)node & 1))  // Keep going until found a subsector
+	{
+		node_t *bsp = (node_t *)node;
+
+		int side = R_PointOnSide(r_viewpoint.Pos, bsp);
+		BenchClipperNode(clipper, bsp->children[side], visiblesegs);
+
+		side ^= 1;
+		if (!clipper.CheckBox(bsp->bbox[side]))
+			return;
+
+		node = bsp->children[side];
+	}
+
+	subsector_t *sub = (subsector_t *)((uint8_t *)node - 1);
+	seg_t *seg = sub->firstline;
+	for (uint32_t i = 0; i < sub->numlines; i++, seg++)
+	{
+		angle_t startAngle = clipper.GetClipAngle(seg->v2);
+		angle_t endAngle = clipper.GetClipAngle(seg->v1);
+
+		// Back side, i.e. backface culling	- read: endAngle >= startAngle!
+		if (startAngle - endAngle < ANGLE_180 || !clipper.SafeCheckRange(startAngle, endAngle))
+			continue;
+
+		visiblesegs++;
+		if (seg->sidedef != nullptr && seg->backsector == nullptr)
+			clipper.SafeAddClipRange(startAngle, endAngle);
+	}
+}
+
+CCMD(bench_glclipper)
+{
+	if (gamestate != GS_LEVEL || level.nodes.Size() == 0)
+	{
+		Printf("bench_glclipper can only be used inside a level\n");
+		return;
+	}
+
+	int frames = argv.argc() > 1 ? atoi(argv[1]) : 360;
+	if (frames <= 0)
+		return;
+
+	DRotator savedangles = r_viewpoint.Angles;
+	Clipper clipper;
+	cycle_t cycles;
+	cycles.Reset();
+	int visiblesegs = 0;
+
+	for (int i = 0; i < frames; i++)
+	{
+		r_viewpoint.Angles.Yaw = savedangles.Yaw + 360. * i / frames;
+
+		cycles.Clock();
+		angle_t a1 = DAngle(47.).BAMs(); // What FrustumAngle returns for a level view at 90 degrees and 4:3
+		clipper.Clear();
+		clipper.SafeAddClipRangeRealAngles(r_viewpoint.Angles.Yaw.BAMs() + a1, r_viewpoint.Angles.Yaw.BAMs() - a1);
+		BenchClipperNode(clipper, level.HeadNode(), visiblesegs);
+		cycles.Unclock();
+	}
+	r_viewpoint.Angles = savedangles;
+
+	Printf("%d frames: %.3f ms per frame, %d visible segs\n", frames, cycles.TimeMS() / frames, visiblesegs);
+}
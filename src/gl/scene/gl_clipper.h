@@ -4,7 +4,7 @@
 #include "doomtype.h"
 #include "xs_Float.h"
 #include "r_utility.h"
-#include "memarena.h"
+#include "tarray.h"
 
 angle_t R_PointToPseudoAngle(double x, double y);
 
@@ -18,7 +18,6 @@ class ClipNode
 {
 	friend class Clipper;
 	
-	ClipNode *prev, *next;
 	angle_t start, end;
 
 	bool operator== (const ClipNode &other)
@@ -31,17 +30,25 @@ class ClipNode
 class Clipper
 {
 	static unsigned starttime;
-	FMemArena nodearena;
-	ClipNode * freelist = nullptr;
 
-	ClipNode * clipnodes = nullptr;
-	ClipNode * cliphead = nullptr;
-	ClipNode * silhouette = nullptr;	// will be preserved even when RemoveClipRange is called
+	// The clip ranges are kept in flat arrays sorted by angle. Both start and end
+	// angles are ascending, so lookups can use a binary search and updates only
+	// move a few array elements instead of chasing list pointers.
+	TArray<ClipNode> clipnodes;
+	TArray<ClipNode> silhouette;	// will be preserved even when RemoveClipRange is called
 	bool blocked = false;
 
 	static angle_t AngleToPseudo(angle_t ang);
+	static ClipNode NewRange(angle_t start, angle_t end)
+	{
+		ClipNode c;
+		c.start = start;
+		c.end = end;
+		return c;
+	}
+
+	unsigned FindFirstEndingAfter(const TArray<ClipNode> &nodes, angle_t angle) const;
 	bool IsRangeVisible(angle_t startangle, angle_t endangle);
-	void RemoveRange(ClipNode * cn);
 	void AddClipRange(angle_t startangle, angle_t endangle);
 	void RemoveClipRange(angle_t startangle, angle_t endangle);
 	void DoRemoveClipRange(angle_t start, angle_t end);
@@ -52,33 +59,6 @@ public:
 
 	void Clear();
 
-	void Free(ClipNode *node)
-	{
-		node->next = freelist;
-		freelist = node;
-	}
-
-	ClipNode * GetNew()
-	{
-		if (freelist)
-		{
-			ClipNode * p = freelist;
-			freelist = p->next;
-			return p;
-		}
-		else return (ClipNode*)nodearena.Alloc(sizeof(ClipNode));
-	}
-
-	ClipNode * NewRange(angle_t start, angle_t end)
-	{
-		ClipNode * c = GetNew();
-
-		c->start = start;
-		c->end = end;
-		c->next = c->prev = NULL;
-		return c;
-	}
-
 	void SetSilhouette();
 
 	bool SafeCheckRange(angle_t startAngle, angle_t endAngle)
@@ -48,6 +48,7 @@
 #include "gl/shaders/gl_shader.h"
 #include "gl/stereo3d/scoped_color_mask.h"
 #include "gl/renderer/gl_quaddrawer.h"
+#include "r_data/r_radixsort.h"
 
 FDrawInfo * gl_drawinfo;
 
@@ -606,41 +607,45 @@ inline int GLDrawList::CompareSprites(SortNode * a,SortNode * b)
 
 //==========================================================================
 //
-//
-//
-//==========================================================================
-static GLDrawList * gd;
-int CompareSprite(const void * a,const void * b)
-{
-	return gd->CompareSprites(*(SortNode**)a,*(SortNode**)b);
-}
-
-//==========================================================================
-//
-//
+// Sorts by depth (far to near) and sprite index, which is the same order
+// CompareSprites defines, using a key based radix sort
 //
 //==========================================================================
 SortNode * GLDrawList::SortSpriteList(SortNode * head)
 {
 	SortNode * n;
-	int count;
 	unsigned i;
 
 	static TArray<SortNode*> sortspritelist;
+	static TArray<FRadixSortItem> sortitems;
+	static FRadixSorter sorter;
 
 	SortNode * parent=head->parent;
+	bool compatsort = !!(i_compatflags & COMPATF_SPRITESORT);
 
 	sortspritelist.Clear();
-	for(count=0,n=head;n;n=n->next) sortspritelist.Push(n);
-	gd=this;
-	qsort(&sortspritelist[0],sortspritelist.Size(),sizeof(SortNode *),CompareSprite);
-	for(i=0;i<sortspritelist.Size();i++)
+	sortitems.Clear();
+	for(n=head;n;n=n->next)
+	{
+		GLSprite * s=&sprites[drawitems[n->itemindex].index];
+		uint32_t depthkey = ~FRadixSorter::IntKey(s->depth);
+		uint32_t indexkey = FRadixSorter::IntKey(s->index);
+		if (!compatsort) indexkey = ~indexkey;
+
+		FRadixSortItem item;
+		item.Key = FRadixSorter::MakeKey(depthkey, indexkey);
+		item.Value = sortspritelist.Push(n);
+		sortitems.Push(item);
+	}
+	sorter.Sort(sortitems);
+	for(i=0;i<sortitems.Size();i++)
 	{
-		sortspritelist[i]->next=NULL;
-		if (parent) parent->equal=sortspritelist[i];
-		parent=sortspritelist[i];
+		SortNode * sn = sortspritelist[sortitems[i].Value];
+		sn->next=NULL;
+		if (parent) parent->equal=sn;
+		parent=sn;
 	}
-	return sortspritelist[0];
+	return sortspritelist[sortitems[0].Value];
 }
 
 //==========================================================================
@@ -981,6 +986,38 @@ void GLDrawList::AddSprite(GLSprite * sprite)
 	drawitems.Push(GLDrawItem(GLDIT_SPRITE,sprites.Push(*sprite)));
 }
 
+//==========================================================================
+//
+// Appends a list that was filled by a scene setup thread.
+// Its sprites were numbered from 0 and get moved behind spriteindexbase.
+//
+//==========================================================================
+void GLDrawList::Append(GLDrawList &other, int spriteindexbase)
+{
+	unsigned wallbase = walls.Size();
+	unsigned flatbase = flats.Size();
+	unsigned spritebase = sprites.Size();
+
+	for (auto &wall : other.walls) walls.Push(wall);
+	for (auto &flat : other.flats) flats.Push(flat);
+	for (auto &sprite : other.sprites)
+	{
+		unsigned i = sprites.Push(sprite);
+		if (sprites[i].actor != nullptr) sprites[i].index += spriteindexbase;
+	}
+	for (auto &item : other.drawitems)
+	{
+		int index = item.index;
+		switch (item.rendertype)
+		{
+		case GLDIT_WALL:	index += wallbase; break;
+		case GLDIT_FLAT:	index += flatbase; break;
+		case GLDIT_SPRITE:	index += spritebase; break;
+		}
+		drawitems.Push(GLDrawItem(item.rendertype, index));
+	}
+}
+
 
 //==========================================================================
 //
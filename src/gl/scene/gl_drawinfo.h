@@ -134,6 +134,7 @@ public:
 	void AddWall(GLWall * wall);
 	void AddFlat(GLFlat * flat);
 	void AddSprite(GLSprite * sprite);
+	void Append(GLDrawList &other, int spriteindexbase);
 	void Reset();
 	void SortWalls();
 	void SortFlats();
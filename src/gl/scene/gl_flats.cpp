@@ -51,6 +51,7 @@
 #include "gl/scene/gl_drawinfo.h"
 #include "gl/shaders/gl_shader.h"
 #include "gl/scene/gl_scenedrawer.h"
+#include "gl/scene/gl_setupthreads.h"
 #include "gl/textures/gl_material.h"
 #include "gl/utility/gl_clock.h"
 #include "gl/utility/gl_convert.h"
@@ -493,7 +494,7 @@ inline void GLFlat::PutFlat(bool fog)
 		list = masked ? GLDL_MASKEDFLATS : GLDL_PLAINFLATS;
 	}
 	dynlightindex = -1;	// make sure this is always initialized to something proper.
-	gl_drawinfo->drawlists[list].AddFlat (this);
+	gl_GetDrawList(list).AddFlat (this);
 }
 
 //==========================================================================
@@ -537,7 +538,8 @@ void GLFlat::Process(sector_t * model, int whichplane, bool fog)
 	z = plane.plane.ZatPoint(0.f, 0.f);
 	
 	PutFlat(fog);
-	rendered_flats++;
+	if (gl_setupthread != nullptr) gl_setupthread->RenderedFlats++;
+	else rendered_flats++;
 }
 
 //==========================================================================
@@ -626,7 +628,9 @@ void GLFlat::ProcessSector(sector_t * frontsector)
 		{
 			if (port->mType == PORTS_STACKEDSECTORTHING)
 			{
-				gl_drawinfo->AddFloorStack(sector);	// stacked sector things require visplane merging.
+				// stacked sector things require visplane merging.
+				if (gl_setupthread != nullptr) gl_setupthread->FloorStacks.Push(sector);
+				else gl_drawinfo->AddFloorStack(sector);
 			}
 			alpha = frontsector->GetAlpha(sector_t::floor);
 		}
@@ -686,7 +690,8 @@ void GLFlat::ProcessSector(sector_t * frontsector)
 		{
 			if (port->mType == PORTS_STACKEDSECTORTHING)
 			{
-				gl_drawinfo->AddCeilingStack(sector);
+				if (gl_setupthread != nullptr) gl_setupthread->CeilingStacks.Push(sector);
+				else gl_drawinfo->AddCeilingStack(sector);
 			}
 			alpha = frontsector->GetAlpha(sector_t::ceiling);
 		}
@@ -62,6 +62,7 @@
 #include "gl/scene/gl_drawinfo.h"
 #include "gl/scene/gl_portal.h"
 #include "gl/scene/gl_scenedrawer.h"
+#include "gl/scene/gl_setupthreads.h"
 #include "gl/shaders/gl_shader.h"
 #include "gl/stereo3d/gl_stereo3d.h"
 #include "gl/stereo3d/scoped_view_shifter.h"
@@ -272,9 +273,12 @@ void GLSceneDrawer::CreateScene()
 	GLRenderer->gl_spriteindex=0;
 	Bsp.Clock();
 	GLRenderer->mVBO->Map();
+	GLRenderer->mVBO->UpdateMovedPlanes();
 	SetView();
 	validcount++;	// used for processing sidedefs only once by the renderer.
+	GLRenderer->mSetupThreads->Begin();
 	RenderBSPNode (level.HeadNode());
+	GLRenderer->mSetupThreads->Run(this);
 	if (GLRenderer->mCurrentPortal != NULL) GLRenderer->mCurrentPortal->RenderAttached();
 	Bsp.Unclock();
 
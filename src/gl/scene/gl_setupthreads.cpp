@@ -0,0 +1,342 @@
+//
+//---------------------------------------------------------------------------
+//
+// Copyright(C) 2017 The GZDoom Development Team
+// All rights reserved.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program.  If not, see http://www.gnu.org/licenses/
+//
+//--------------------------------------------------------------------------
+//
+/*
+** gl_setupthreads.cpp
+** Runs the wall, flat and sprite setup of a scene on several threads
+**
+**/
+
+#include "p_local.h"
+#include "p_effect.h"
+#include "c_cvars.h"
+#include "gl/system/gl_interface.h"
+#include "gl/renderer/gl_renderer.h"
+#include "gl/scene/gl_scenedrawer.h"
+#include "gl/scene/gl_setupthreads.h"
+#include "gl/utility/gl_clock.h"
+
+CVAR(Bool, gl_scene_multithreaded, false, 0)
+
+thread_local GLSetupThread *gl_setupthread;
+
+//==========================================================================
+//
+//
+//
+//==========================================================================
+
+void GLSetupThread::Clear()
+{
+	for (auto &list : drawlists) list.Reset();
+	Portals.Clear();
+	MissingTextures.Clear();
+	FloorStacks.Clear();
+	CeilingStacks.Clear();
+	FlyCheat.Clear();
+	SpriteIndex = 0;
+	RenderedFlats = 0;
+	RenderedSprites = 0;
+	TexSplits = 0;
+}
+
+//==========================================================================
+//
+//
+//
+//==========================================================================
+
+GLSetupThreads::GLSetupThreads()
+{
+	// the main thread always is thread 0.
+	Threads.push_back(std::unique_ptr<GLSetupThread>(new GLSetupThread));
+}
+
+GLSetupThreads::~GLSetupThreads()
+{
+	StopThreads();
+}
+
+//==========================================================================
+//
+// Decides whether the scene that is about to be set up queues its jobs.
+// The deferred buffer mode allocates vertices from the VBO while the
+// items get put into the lists and legacy mode splits them into its own
+// lists, so both need the single threaded setup.
+//
+//==========================================================================
+
+void GLSetupThreads::Begin()
+{
+	mActive = gl_scene_multithreaded && !gl.legacyMode && gl.buffermethod != BM_DEFERRED;
+}
+
+//==========================================================================
+//
+// gl_FakeFlat's result may live on the caller's stack. Jobs run after the
+// walk, so they get a copy that lives until the scene has been set up.
+//
+//==========================================================================
+
+sector_t *GLSetupThreads::KeepSector(sector_t *fake)
+{
+	if (NumFakeSectors == FakeSectors.Size())
+	{
+		FakeSectors.Push(new sector_t);
+	}
+	sector_t *copy = FakeSectors[NumFakeSectors++];
+	*copy = *fake;
+	return copy;
+}
+
+//==========================================================================
+//
+//
+//
+//==========================================================================
+
+void GLSetupThreads::AddWall(seg_t *seg, subsector_t *sub, sector_t *front, sector_t *back)
+{
+	Job job = { JOB_WALL, 0, front, back, sub, seg, nullptr, nullptr };
+	Jobs.Push(job);
+}
+
+void GLSetupThreads::AddSector(sector_t *sector)
+{
+	Job job = { JOB_SECTOR, 0, sector, nullptr, nullptr, nullptr, nullptr, nullptr };
+	Jobs.Push(job);
+}
+
+void GLSetupThreads::AddThing(AActor *thing, sector_t *sector, int thruportal)
+{
+	Job job = { JOB_THING, thruportal, sector, nullptr, nullptr, nullptr, thing, nullptr };
+	Jobs.Push(job);
+}
+
+void GLSetupThreads::AddParticle(particle_t *particle, sector_t *sector)
+{
+	Job job = { JOB_PARTICLE, 0, sector, nullptr, nullptr, nullptr, nullptr, particle };
+	Jobs.Push(job);
+}
+
+//==========================================================================
+//
+// Runs the queued jobs in contiguous slices, one per thread, and merges
+// the results into gl_drawinfo in thread order.
+//
+//==========================================================================
+
+void GLSetupThreads::Run(GLSceneDrawer *drawer)
+{
+	if (!mActive) return;
+	mActive = false;
+
+	size_t numThreads = std::thread::hardware_concurrency();
+	if (numThreads == 0) numThreads = 4;
+	if (numThreads != Threads.size())
+	{
+		StopThreads();
+		StartThreads(numThreads);
+	}
+
+	mDrawer = drawer;
+	std::unique_lock<std::mutex> start_lock(start_mutex);
+	for (size_t i = 0; i < numThreads; i++)
+	{
+		Threads[i]->Start = unsigned(Jobs.Size() * i / numThreads);
+		Threads[i]->End = unsigned(Jobs.Size() * (i + 1) / numThreads);
+	}
+	run_id++;
+	start_lock.unlock();
+
+	if (Threads.size() > 1)
+	{
+		start_condition.notify_all();
+	}
+
+	ProcessJobs(Threads[0].get());
+
+	if (Threads.size() > 1)
+	{
+		std::unique_lock<std::mutex> end_lock(end_mutex);
+		finished_threads++;
+		end_condition.wait(end_lock, [&]() { return finished_threads == Threads.size(); });
+		finished_threads = 0;
+	}
+
+	for (auto &thread : Threads)
+	{
+		Merge(thread.get());
+		thread->Clear();
+	}
+	Jobs.Clear();
+	NumFakeSectors = 0;
+	mDrawer = nullptr;
+}
+
+//==========================================================================
+//
+//
+//
+//==========================================================================
+
+void GLSetupThreads::ProcessJobs(GLSetupThread *thread)
+{
+	gl_setupthread = thread;
+	for (unsigned i = thread->Start; i < thread->End; i++)
+	{
+		Job &job = Jobs[i];
+		switch (job.Type)
+		{
+		case JOB_WALL:
+		{
+			GLWall wall(mDrawer);
+			wall.sub = job.Sub;
+			wall.Process(job.Seg, job.Front, job.Back);
+			break;
+		}
+
+		case JOB_SECTOR:
+		{
+			GLFlat flat(mDrawer);
+			flat.ProcessSector(job.Front);
+			break;
+		}
+
+		case JOB_THING:
+		{
+			GLSprite sprite(mDrawer);
+			sprite.Process(job.Thing, job.Front, job.ThruPortal);
+			break;
+		}
+
+		case JOB_PARTICLE:
+		{
+			GLSprite sprite(mDrawer);
+			sprite.ProcessParticle(job.Particle, job.Front);
+			break;
+		}
+		}
+	}
+	gl_setupthread = nullptr;
+}
+
+//==========================================================================
+//
+// Appends one thread's lists and does the work it had to leave to the
+// main thread. Sprite indices continue the global numbering so that
+// sorting ties get resolved the same way as without threads.
+//
+//==========================================================================
+
+void GLSetupThreads::Merge(GLSetupThread *thread)
+{
+	int spritebase = GLRenderer->gl_spriteindex;
+	for (int i = 0; i < GLDL_TYPES; i++)
+	{
+		gl_drawinfo->drawlists[i].Append(thread->drawlists[i], spritebase);
+	}
+	GLRenderer->gl_spriteindex += thread->SpriteIndex;
+
+	rendered_flats += thread->RenderedFlats;
+	rendered_sprites += thread->RenderedSprites;
+	render_texsplit += thread->TexSplits;
+
+	for (auto thing : thread->FlyCheat)
+	{
+		thing->flags7 |= MF7_FLYCHEAT;
+	}
+	for (auto &mt : thread->MissingTextures)
+	{
+		if (mt.upper) gl_drawinfo->AddUpperMissingTexture(mt.side, mt.sub, mt.height);
+		else gl_drawinfo->AddLowerMissingTexture(mt.side, mt.sub, mt.height);
+	}
+	for (auto sec : thread->FloorStacks)
+	{
+		gl_drawinfo->AddFloorStack(sec);
+	}
+	for (auto sec : thread->CeilingStacks)
+	{
+		gl_drawinfo->AddCeilingStack(sec);
+	}
+	for (auto &pw : thread->Portals)
+	{
+		pw.wall.PutPortal(pw.type);
+	}
+}
+
+//==========================================================================
+//
+//
+//
+//==========================================================================
+
+void GLSetupThreads::StartThreads(size_t numThreads)
+{
+	while (Threads.size() < numThreads)
+	{
+		std::unique_ptr<GLSetupThread> thread(new GLSetupThread);
+		GLSetupThread *setupthread = thread.get();
+		int start_run_id = run_id;
+		thread->thread = std::thread([=]()
+		{
+			int last_run_id = start_run_id;
+			while (true)
+			{
+				std::unique_lock<std::mutex> start_lock(start_mutex);
+				start_condition.wait(start_lock, [&]() { return run_id != last_run_id || shutdown_flag; });
+				if (shutdown_flag)
+					break;
+				last_run_id = run_id;
+				start_lock.unlock();
+
+				ProcessJobs(setupthread);
+
+				std::unique_lock<std::mutex> end_lock(end_mutex);
+				finished_threads++;
+				end_lock.unlock();
+				end_condition.notify_all();
+			}
+		});
+		Threads.push_back(std::move(thread));
+	}
+}
+
+//==========================================================================
+//
+//
+//
+//==========================================================================
+
+void GLSetupThreads::StopThreads()
+{
+	std::unique_lock<std::mutex> lock(start_mutex);
+	shutdown_flag = true;
+	lock.unlock();
+	start_condition.notify_all();
+	while (Threads.size() > 1)
+	{
+		Threads.back()->thread.join();
+		Threads.pop_back();
+	}
+	lock.lock();
+	shutdown_flag = false;
+}
@@ -0,0 +1,159 @@
+//
+//---------------------------------------------------------------------------
+//
+// Copyright(C) 2017 The GZDoom Development Team
+// All rights reserved.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program.  If not, see http://www.gnu.org/licenses/
+//
+//--------------------------------------------------------------------------
+//
+
+#ifndef __GL_SETUPTHREADS_H
+#define __GL_SETUPTHREADS_H
+
+#include <memory>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include "gl/scene/gl_drawinfo.h"
+
+class GLSceneDrawer;
+struct particle_t;
+
+//==========================================================================
+//
+// Output of one scene setup thread.
+//
+// Walls, flats and sprites go into the thread's own draw lists. Everything
+// that touches shared state is queued here and done by the main thread
+// after the lists have been merged.
+//
+//==========================================================================
+
+struct GLSetupThread
+{
+	struct PortalWall
+	{
+		GLWall wall;
+		int type;
+
+		PortalWall(const GLWall &w, int t) : wall(w), type(t) {}
+	};
+
+	struct MissingTexture
+	{
+		side_t *side;
+		subsector_t *sub;
+		float height;
+		bool upper;
+	};
+
+	GLDrawList drawlists[GLDL_TYPES];
+	TArray<PortalWall> Portals;
+	TArray<MissingTexture> MissingTextures;
+	TArray<sector_t *> FloorStacks;
+	TArray<sector_t *> CeilingStacks;
+	TArray<AActor *> FlyCheat;
+
+	int SpriteIndex = 0;
+	int RenderedFlats = 0;
+	int RenderedSprites = 0;
+	int TexSplits = 0;
+
+	unsigned Start = 0;
+	unsigned End = 0;
+	std::thread thread;
+
+	void Clear();
+};
+
+// Set while a thread runs setup jobs, null on the main thread otherwise.
+extern thread_local GLSetupThread *gl_setupthread;
+
+inline GLDrawList &gl_GetDrawList(int list)
+{
+	return gl_setupthread != nullptr ? gl_setupthread->drawlists[list] : gl_drawinfo->drawlists[list];
+}
+
+//==========================================================================
+//
+// The main thread walks the BSP and does all clipping. If multithreaded
+// setup is active, the Process calls it finds are queued as jobs and run
+// on all threads after the walk. The results are merged in job order, so
+// the draw lists come out the same as with the single threaded setup.
+//
+//==========================================================================
+
+class GLSetupThreads
+{
+	enum
+	{
+		JOB_WALL,
+		JOB_SECTOR,
+		JOB_THING,
+		JOB_PARTICLE,
+	};
+
+	struct Job
+	{
+		int Type;
+		int ThruPortal;
+		sector_t *Front;
+		sector_t *Back;
+		subsector_t *Sub;
+		seg_t *Seg;
+		AActor *Thing;
+		particle_t *Particle;
+	};
+
+public:
+	GLSetupThreads();
+	~GLSetupThreads();
+
+	void Begin();
+	bool Active() const { return mActive; }
+
+	sector_t *KeepSector(sector_t *fake);
+	void AddWall(seg_t *seg, subsector_t *sub, sector_t *front, sector_t *back);
+	void AddSector(sector_t *sector);
+	void AddThing(AActor *thing, sector_t *sector, int thruportal);
+	void AddParticle(particle_t *particle, sector_t *sector);
+
+	void Run(GLSceneDrawer *drawer);
+	void StopThreads();
+
+private:
+	void ProcessJobs(GLSetupThread *thread);
+	void Merge(GLSetupThread *thread);
+	void StartThreads(size_t numThreads);
+
+	bool mActive = false;
+	GLSceneDrawer *mDrawer = nullptr;
+	TArray<Job> Jobs;
+	TDeletingArray<sector_t *> FakeSectors;
+	unsigned NumFakeSectors = 0;
+
+	std::vector<std::unique_ptr<GLSetupThread>> Threads;
+	std::mutex start_mutex;
+	std::condition_variable start_condition;
+	std::mutex end_mutex;
+	std::condition_variable end_condition;
+	size_t finished_threads = 0;
+	int run_id = 0;
+	bool shutdown_flag = false;
+};
+
+#endif
@@ -53,6 +53,7 @@
 #include "gl/scene/gl_drawinfo.h"
 #include "gl/scene/gl_scenedrawer.h"
 #include "gl/scene/gl_portal.h"
+#include "gl/scene/gl_setupthreads.h"
 #include "gl/models/gl_models.h"
 #include "gl/shaders/gl_shader.h"
 #include "gl/textures/gl_material.h"
@@ -508,7 +509,7 @@ inline void GLSprite::PutSprite(bool translucent)
 	{
 		list = GLDL_MODELS;
 	}
-	gl_drawinfo->drawlists[list].AddSprite(this);
+	gl_GetDrawList(list).AddSprite(this);
 }
 
 //==========================================================================
@@ -750,7 +751,9 @@ void GLSprite::Process(AActor* thing, sector_t * sector, int thruportal)
 				if ((thingpos - r_viewpoint.Pos).LengthSquared() < clipdist * clipdist) return;
 			}
 		}
-		thing->flags7 |= MF7_FLYCHEAT;	// do this only once for the very first frame, but not if it gets into range again.
+		// do this only once for the very first frame, but not if it gets into range again.
+		if (gl_setupthread != nullptr) gl_setupthread->FlyCheat.Push(thing);
+		else thing->flags7 |= MF7_FLYCHEAT;
 	}
 
 	if (thruportal != 2 && GLRenderer->mClipPortal)
@@ -834,10 +837,9 @@ void GLSprite::Process(AActor* thing, sector_t * sector, int thruportal)
 		gltexture->GetSpriteRect(&r);
 
 		// [SP] SpriteFlip
-		if (thing->renderflags & RF_SPRITEFLIP)
-			thing->renderflags ^= RF_XFLIP;
+		bool xflip = !!(thing->renderflags & RF_XFLIP) ^ !!(thing->renderflags & RF_SPRITEFLIP);
 
-		if (mirror ^ !!(thing->renderflags & RF_XFLIP))
+		if (mirror ^ xflip)
 		{
 			r.left = -r.width - r.left;	// mirror the sprite's x-offset
 			ul = gltexture->GetSpriteUL();
@@ -849,9 +851,6 @@ void GLSprite::Process(AActor* thing, sector_t * sector, int thruportal)
 			ur = gltexture->GetSpriteUL();
 		}
 
-		if (thing->renderflags & RF_SPRITEFLIP) // [SP] Flip back
-			thing->renderflags ^= RF_XFLIP;
-
 		r.Scale(sprscale.X, sprscale.Y);
 
 		float rightfac = -r.left;
@@ -1074,7 +1073,7 @@ void GLSprite::Process(AActor* thing, sector_t * sector, int thruportal)
 	// end of light calculation
 
 	actor = thing;
-	index = GLRenderer->gl_spriteindex++;
+	index = gl_setupthread != nullptr ? gl_setupthread->SpriteIndex++ : GLRenderer->gl_spriteindex++;
 	particle = NULL;
 
 	const bool drawWithXYBillboard = (!(actor->renderflags & RF_FORCEYBILLBOARD)
@@ -1111,7 +1110,8 @@ void GLSprite::Process(AActor* thing, sector_t * sector, int thruportal)
 	}
 
 	PutSprite(hw_styleflags != STYLEHW_Solid);
-	rendered_sprites++;
+	if (gl_setupthread != nullptr) gl_setupthread->RenderedSprites++;
+	else rendered_sprites++;
 }
 
 
@@ -1253,7 +1253,8 @@ void GLSprite::ProcessParticle (particle_t *particle, sector_t *sector)//, int s
 		lightlist = NULL;
 
 	PutSprite(hw_styleflags != STYLEHW_Solid);
-	rendered_sprites++;
+	if (gl_setupthread != nullptr) gl_setupthread->RenderedSprites++;
+	else rendered_sprites++;
 }
 
 //==========================================================================
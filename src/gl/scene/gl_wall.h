@@ -140,6 +140,7 @@ public:
 
 	friend struct GLDrawList;
 	friend class GLPortal;
+	friend class GLSetupThreads;
 
 	GLSceneDrawer *mDrawer;
 	GLSeg glseg;
@@ -43,6 +43,7 @@
 #include "gl/scene/gl_drawinfo.h"
 #include "gl/scene/gl_portal.h"
 #include "gl/scene/gl_scenedrawer.h"
+#include "gl/scene/gl_setupthreads.h"
 #include "gl/textures/gl_material.h"
 #include "gl/utility/gl_clock.h"
 #include "gl/utility/gl_templates.h"
@@ -89,7 +90,7 @@ void GLWall::PutWall(bool translucent)
 	{
 		ViewDistance = (r_viewpoint.Pos - (seg->linedef->v1->fPos() + seg->linedef->Delta() / 2)).XY().LengthSquared();
 		if (gl.buffermethod == BM_DEFERRED) MakeVertices(true);
-		gl_drawinfo->drawlists[GLDL_TRANSLUCENT].AddWall(this);
+		gl_GetDrawList(GLDL_TRANSLUCENT).AddWall(this);
 	}
 	else
 	{
@@ -111,7 +112,7 @@ void GLWall::PutWall(bool translucent)
 			list = masked ? GLDL_MASKEDWALLS : GLDL_PLAINWALLS;
 		}
 		if (gl.buffermethod == BM_DEFERRED) MakeVertices(false);
-		gl_drawinfo->drawlists[list].AddWall(this);
+		gl_GetDrawList(list).AddWall(this);
 
 	}
 	lightlist = NULL;
@@ -122,6 +123,17 @@ void GLWall::PutPortal(int ptype)
 {
 	GLPortal * portal;
 
+	if (gl_setupthread != nullptr)
+	{
+		// The portal manager is not thread safe. Only make the data this wall
+		// points to permanent and leave the rest to the main thread.
+		if (ptype == PORTALTYPE_HORIZON) horizon = UniqueHorizons.Get(horizon);
+		else if (ptype == PORTALTYPE_PLANEMIRROR) planemirror = UniquePlaneMirrors.Get(planemirror);
+		gl_setupthread->Portals.Push(GLSetupThread::PortalWall(*this, ptype));
+		vertcount = 0;
+		return;
+	}
+
 	if (gl.buffermethod == BM_DEFERRED) MakeVertices(false);
 	switch (ptype)
 	{
@@ -1065,7 +1077,8 @@ void GLWall::DoMidTexture(seg_t * seg, bool drawfogboundary,
 
 				t=1;
 			}
-			render_texsplit+=t;
+			if (gl_setupthread != nullptr) gl_setupthread->TexSplits += t;
+			else render_texsplit+=t;
 		}
 		else
 		{
@@ -1638,7 +1651,8 @@ void GLWall::Process(seg_t *seg, sector_t * frontsector, sector_t * backsector)
 						// skip processing if the back is a malformed subsector
 						if (seg->PartnerSeg != NULL && !(seg->PartnerSeg->Subsector->hacked & 4))
 						{
-							gl_drawinfo->AddUpperMissingTexture(seg->sidedef, sub, bch1a);
+							if (gl_setupthread != nullptr) gl_setupthread->MissingTextures.Push({ seg->sidedef, sub, bch1a, true });
+							else gl_drawinfo->AddUpperMissingTexture(seg->sidedef, sub, bch1a);
 						}
 					}
 				}
@@ -1724,7 +1738,8 @@ void GLWall::Process(seg_t *seg, sector_t * frontsector, sector_t * backsector)
 					// skip processing if the back is a malformed subsector
 					if (seg->PartnerSeg != NULL && !(seg->PartnerSeg->Subsector->hacked & 4))
 					{
-						gl_drawinfo->AddLowerMissingTexture(seg->sidedef, sub, bfh1);
+						if (gl_setupthread != nullptr) gl_setupthread->MissingTextures.Push({ seg->sidedef, sub, bfh1, false });
+						else gl_drawinfo->AddLowerMissingTexture(seg->sidedef, sub, bfh1);
 					}
 				}
 			}
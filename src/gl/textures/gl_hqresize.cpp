@@ -47,6 +47,26 @@
 #include "gl/xbr/xbrz_old.h"
 
 #include "parallel_for.h"
+#include "m_crc32.h"
+#include "m_misc.h"
+#include "m_swap.h"
+#include "cmdlib.h"
+#include "files.h"
+#include "i_system.h"
+
+#include <zlib.h>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <vector>
+#include <algorithm>
+#include <sys/stat.h>
+#ifdef _WIN32
+#include <sys/utime.h>
+#else
+#include <utime.h>
+#endif
 
 CUSTOM_CVAR(Int, gl_texture_hqresize, 0, CVAR_ARCHIVE | CVAR_GLOBALCONFIG | CVAR_NOINITCALL)
 {
@@ -92,6 +112,14 @@ CUSTOM_CVAR(Int, gl_texture_hqresize_mt_height, 4, CVAR_ARCHIVE | CVAR_GLOBALCON
 	if (self > 1024) self = 1024;
 }
 
+// Keep upsampled textures in the cache directory so they only need to be created once
+CVAR(Bool, gl_texture_hqresize_cache, true, CVAR_ARCHIVE | CVAR_GLOBALCONFIG);
+CVAR(Bool, gl_texture_hqresize_cache_compress, true, CVAR_ARCHIVE | CVAR_GLOBALCONFIG);
+CVAR(Int, gl_texture_hqresize_cache_size, 256, CVAR_ARCHIVE | CVAR_GLOBALCONFIG);	// in megabytes, 0 for no limit
+
+// Set on the upsampling workers. They already run one image per core, so the scalers must not split the work any further.
+static thread_local bool UpsampleWorker;
+
 
 static void scale2x ( uint32_t* inputBuffer, uint32_t* outputBuffer, int inWidth, int inHeight )
 {
@@ -220,14 +248,6 @@ static unsigned char *hqNxAsmHelper( void (*hqNxFunction) ( int*, unsigned char*
 	outWidth = N * inWidth;
 	outHeight = N *inHeight;
 
-	static int initdone = false;
-
-	if (!initdone)
-	{
-		HQnX_asm::InitLUTs();
-		initdone = true;
-	}
-
 	HQnX_asm::CImage cImageIn;
 	cImageIn.SetImage(inputBuffer, inWidth, inHeight, 32);
 	cImageIn.Convert32To17();
@@ -247,13 +267,6 @@ static unsigned char *hqNxHelper( void (*hqNxFunction) ( unsigned*, unsigned*, i
 							  int &outWidth,
 							  int &outHeight )
 {
-	static int initdone = false;
-
-	if (!initdone)
-	{
-		hqxInit();
-		initdone = true;
-	}
 	outWidth = N * inWidth;
 	outHeight = N *inHeight;
 
@@ -281,7 +294,7 @@ static unsigned char *xbrzHelper( void (*xbrzFunction) ( size_t, const uint32_t*
 	const int thresholdWidth  = gl_texture_hqresize_mt_width;
 	const int thresholdHeight = gl_texture_hqresize_mt_height;
 	
-	if (gl_texture_hqresize_multithread
+	if (gl_texture_hqresize_multithread && !UpsampleWorker
 		&& inWidth  > thresholdWidth
 		&& inHeight > thresholdHeight)
 	{
@@ -309,96 +322,803 @@ static void xbrzOldScale(size_t factor, const uint32_t* src, uint32_t* trg, int
 
 
 //===========================================================================
-// 
-// [BB] Upsamples the texture in inputBuffer, frees inputBuffer and returns
-//  the upsampled buffer.
+//
+// Returns the scaler to use for a texture or 0 if it shouldn't be upsampled
 //
 //===========================================================================
-unsigned char *gl_CreateUpsampledTextureBuffer ( const FTexture *inputTexture, unsigned char *inputBuffer, const int inWidth, const int inHeight, int &outWidth, int &outHeight, bool hasAlpha )
-{
-	// [BB] Make sure that outWidth and outHeight denote the size of
-	// the returned buffer even if we don't upsample the input buffer.
-	outWidth = inWidth;
-	outHeight = inHeight;
 
+static int GetUpsampleType(const FTexture *inputTexture, const int inWidth, const int inHeight, bool hasAlpha)
+{
 	// [BB] Don't resample if the width or height of the input texture is bigger than gl_texture_hqresize_maxinputsize.
 	if ( ( inWidth > gl_texture_hqresize_maxinputsize ) || ( inHeight > gl_texture_hqresize_maxinputsize ) )
-		return inputBuffer;
+		return 0;
 
 	// [BB] Don't try to upsample textures based off FCanvasTexture.
 	if ( inputTexture->bHasCanvas )
-		return inputBuffer;
+		return 0;
 
 	// [BB] Don't upsample non-shader handled warped textures. Needs too much memory and time
 	if (gl.legacyMode && inputTexture->bWarped)
-		return inputBuffer;
+		return 0;
 
 	// already scaled?
 	if (inputTexture->Scale.X >= 2 && inputTexture->Scale.Y >= 2)
-		return inputBuffer;
+		return 0;
 
 	switch (inputTexture->UseType)
 	{
 	case FTexture::TEX_Sprite:
 	case FTexture::TEX_SkinSprite:
-		if (!(gl_texture_hqresize_targets & 2)) return inputBuffer;
+		if (!(gl_texture_hqresize_targets & 2)) return 0;
 		break;
 
 	case FTexture::TEX_FontChar:
-		if (!(gl_texture_hqresize_targets & 4)) return inputBuffer;
+		if (!(gl_texture_hqresize_targets & 4)) return 0;
 		break;
 
 	default:
-		if (!(gl_texture_hqresize_targets & 1)) return inputBuffer;
+		if (!(gl_texture_hqresize_targets & 1)) return 0;
 		break;
 	}
 
-	if (inputBuffer)
+	int type = gl_texture_hqresize;
+#ifdef HAVE_MMX
+	// hqNx MMX does not preserve the alpha channel so fall back to C-version for such textures
+	if (hasAlpha && type > 6 && type <= 9)
 	{
-		int type = gl_texture_hqresize;
-		outWidth = inWidth;
-		outHeight = inHeight;
+		type -= 3;
+	}
+#endif
+	return type;
+}
+
+//===========================================================================
+//
+// The hqNx lookup tables must be set up on the main thread before
+// any scaling can be done on the worker.
+//
+//===========================================================================
+
+static void InitUpscaler(int type)
+{
+	if (type >= 4 && type <= 6)
+	{
+		static bool initdone = false;
+		if (!initdone)
+		{
+			hqxInit();
+			initdone = true;
+		}
+	}
 #ifdef HAVE_MMX
-		// hqNx MMX does not preserve the alpha channel so fall back to C-version for such textures
-		if (hasAlpha && type > 6 && type <= 9)
+	else if (type >= 7 && type <= 9)
+	{
+		static bool initdone = false;
+		if (!initdone)
 		{
-			type -= 3;
+			HQnX_asm::InitLUTs();
+			initdone = true;
 		}
+	}
 #endif
+}
 
-		switch (type)
-		{
-		case 1:
-			return scaleNxHelper( &scale2x, 2, inputBuffer, inWidth, inHeight, outWidth, outHeight );
-		case 2:
-			return scaleNxHelper( &scale3x, 3, inputBuffer, inWidth, inHeight, outWidth, outHeight );
-		case 3:
-			return scaleNxHelper( &scale4x, 4, inputBuffer, inWidth, inHeight, outWidth, outHeight );
-		case 4:
-			return hqNxHelper( &hq2x_32, 2, inputBuffer, inWidth, inHeight, outWidth, outHeight );
-		case 5:
-			return hqNxHelper( &hq3x_32, 3, inputBuffer, inWidth, inHeight, outWidth, outHeight );
-		case 6:
-			return hqNxHelper( &hq4x_32, 4, inputBuffer, inWidth, inHeight, outWidth, outHeight );
+//===========================================================================
+//
+// Runs the selected scaler. Frees inputBuffer if a new buffer gets returned.
+//
+//===========================================================================
+
+static unsigned char *UpscaleBuffer(int type, unsigned char *inputBuffer, const int inWidth, const int inHeight, int &outWidth, int &outHeight)
+{
+	outWidth = inWidth;
+	outHeight = inHeight;
+
+	switch (type)
+	{
+	case 1:
+		return scaleNxHelper( &scale2x, 2, inputBuffer, inWidth, inHeight, outWidth, outHeight );
+	case 2:
+		return scaleNxHelper( &scale3x, 3, inputBuffer, inWidth, inHeight, outWidth, outHeight );
+	case 3:
+		return scaleNxHelper( &scale4x, 4, inputBuffer, inWidth, inHeight, outWidth, outHeight );
+	case 4:
+		return hqNxHelper( &hq2x_32, 2, inputBuffer, inWidth, inHeight, outWidth, outHeight );
+	case 5:
+		return hqNxHelper( &hq3x_32, 3, inputBuffer, inWidth, inHeight, outWidth, outHeight );
+	case 6:
+		return hqNxHelper( &hq4x_32, 4, inputBuffer, inWidth, inHeight, outWidth, outHeight );
 #ifdef HAVE_MMX
-		case 7:
-			return hqNxAsmHelper( &HQnX_asm::hq2x_32, 2, inputBuffer, inWidth, inHeight, outWidth, outHeight );
-		case 8:
-			return hqNxAsmHelper( &HQnX_asm::hq3x_32, 3, inputBuffer, inWidth, inHeight, outWidth, outHeight );
-		case 9:
-			return hqNxAsmHelper( &HQnX_asm::hq4x_32, 4, inputBuffer, inWidth, inHeight, outWidth, outHeight );
+	case 7:
+		return hqNxAsmHelper( &HQnX_asm::hq2x_32, 2, inputBuffer, inWidth, inHeight, outWidth, outHeight );
+	case 8:
+		return hqNxAsmHelper( &HQnX_asm::hq3x_32, 3, inputBuffer, inWidth, inHeight, outWidth, outHeight );
+	case 9:
+		return hqNxAsmHelper( &HQnX_asm::hq4x_32, 4, inputBuffer, inWidth, inHeight, outWidth, outHeight );
 #endif
-		case 10:
-		case 11:
-		case 12:
-			return xbrzHelper(xbrz::scale, type - 8, inputBuffer, inWidth, inHeight, outWidth, outHeight );
-			
-		case 13:
-		case 14:
-		case 15:
-			return xbrzHelper(xbrzOldScale, type - 11, inputBuffer, inWidth, inHeight, outWidth, outHeight );
-			
-		}
+	case 10:
+	case 11:
+	case 12:
+		return xbrzHelper(xbrz::scale, type - 8, inputBuffer, inWidth, inHeight, outWidth, outHeight );
+		
+	case 13:
+	case 14:
+	case 15:
+		return xbrzHelper(xbrzOldScale, type - 11, inputBuffer, inWidth, inHeight, outWidth, outHeight );
 	}
 	return inputBuffer;
 }
+
+//===========================================================================
+//
+// Disk cache for upsampled textures
+//
+// Results are keyed by a hash of the input pixels and the scaler so that
+// the same image gets found again regardless of the texture name or the
+// resource file it came from. The modification time of a file is updated
+// when it gets used, so the least recently used files are deleted first
+// when the cache grows beyond gl_texture_hqresize_cache_size.
+//
+//===========================================================================
+
+struct FUpsampleKey
+{
+	uint32_t Crc;
+	uint32_t Hash;
+	int Type;
+	int Width;
+	int Height;
+
+	bool operator==(const FUpsampleKey &other) const
+	{
+		return Crc == other.Crc && Hash == other.Hash && Type == other.Type && Width == other.Width && Height == other.Height;
+	}
+};
+
+struct FUpsampleCacheHeader
+{
+	char Magic[4];
+	uint32_t Version;
+	uint32_t Crc;
+	uint32_t Hash;
+	uint32_t Type;
+	uint32_t Width;
+	uint32_t Height;
+	uint32_t Compressed;
+	uint32_t DataSize;
+};
+
+enum
+{
+	HQCacheVersion = 1
+};
+
+static FUpsampleKey MakeUpsampleKey(int type, const unsigned char *buffer, const int width, const int height)
+{
+	FUpsampleKey key;
+	key.Crc = CalcCRC32(buffer, width * height * 4);
+	key.Hash = SuperFastHash((const char *)buffer, width * height * 4);
+	key.Type = type;
+	key.Width = width;
+	key.Height = height;
+	return key;
+}
+
+static std::atomic<int64_t> CacheBytes;		// approximate size of the disk cache
+static void TrimUpsampleCache(const FString &cachepath);
+
+// Must be called on the main thread before any worker needs a file name
+static const FString &GetCachePath()
+{
+	static FString cachepath;
+	if (cachepath.IsEmpty())
+	{
+		cachepath = M_GetCachePath(true);
+		cachepath << "/hqresize";
+		CreatePath(cachepath);
+		TrimUpsampleCache(cachepath);
+	}
+	return cachepath;
+}
+
+static void TouchCacheFile(const char *filename)
+{
+#ifdef _WIN32
+	_utime(filename, nullptr);
+#else
+	utime(filename, nullptr);
+#endif
+}
+
+//===========================================================================
+//
+// Deletes the least recently used files until the cache fits into
+// gl_texture_hqresize_cache_size again
+//
+//===========================================================================
+
+static void TrimUpsampleCache(const FString &cachepath)
+{
+	struct FCacheFile
+	{
+		FString Name;
+		time_t MTime;
+		int64_t Size;
+	};
+
+	TArray<FCacheFile> files;
+	int64_t total = 0;
+
+	findstate_t findstate;
+	FString mask = cachepath + "/*.hqr";
+	void *handle = I_FindFirst(mask, &findstate);
+	if (handle != (void *)-1)
+	{
+		do
+		{
+			if (!(I_FindAttr(&findstate) & FA_DIREC))
+			{
+				FCacheFile file;
+				file.Name = cachepath + "/" + I_FindName(&findstate);
+				struct stat info;
+				if (stat(file.Name, &info) == 0)
+				{
+					file.MTime = info.st_mtime;
+					file.Size = info.st_size;
+					total += file.Size;
+					files.Push(file);
+				}
+			}
+		} while (I_FindNext(handle, &findstate) == 0);
+		I_FindClose(handle);
+	}
+
+	int64_t limit = int64_t(gl_texture_hqresize_cache_size) << 20;
+	if (limit > 0 && total > limit)
+	{
+		std::sort(files.begin(), files.end(), [](const FCacheFile &a, const FCacheFile &b) { return a.MTime < b.MTime; });
+
+		// Trim a bit below the limit so that this does not run again for every new file
+		limit -= limit / 4;
+		for (unsigned int i = 0; i < files.Size() && total > limit; i++)
+		{
+			if (remove(files[i].Name) == 0)
+			{
+				total -= files[i].Size;
+			}
+		}
+	}
+	CacheBytes = total;
+}
+
+static FString GetCacheFileName(const FUpsampleKey &key)
+{
+	FString filename;
+	filename.Format("%s/%08x%08x-%d-%dx%d.hqr", GetCachePath().GetChars(), key.Crc, key.Hash, key.Type, key.Width, key.Height);
+	return filename;
+}
+
+static unsigned char *LoadCachedUpsample(const char *filename, const FUpsampleKey &key, int &outWidth, int &outHeight)
+{
+	FileReader fr;
+	if (!fr.Open(filename)) return nullptr;
+
+	FUpsampleCacheHeader header;
+	if (fr.Read(&header, sizeof(header)) != sizeof(header)) return nullptr;
+	if (memcmp(header.Magic, "HQRC", 4) || LittleLong(header.Version) != HQCacheVersion) return nullptr;
+	if (LittleLong(header.Crc) != key.Crc || LittleLong(header.Hash) != key.Hash || (int)LittleLong(header.Type) != key.Type) return nullptr;
+
+	int width = LittleLong(header.Width);
+	int height = LittleLong(header.Height);
+	long datasize = LittleLong(header.DataSize);
+	if (width <= 0 || height <= 0 || width > key.Width * 6 || height > key.Height * 6) return nullptr;
+	if (datasize <= 0 || datasize != fr.GetLength() - (long)sizeof(header)) return nullptr;
+
+	uLongf size = width * height * 4;
+	unsigned char *buffer = new unsigned char[size];
+	if (LittleLong(header.Compressed))
+	{
+		unsigned char *compressed = new unsigned char[datasize];
+		bool ok = fr.Read(compressed, datasize) == datasize && uncompress(buffer, &size, compressed, datasize) == Z_OK && size == uLongf(width * height * 4);
+		delete[] compressed;
+		if (!ok)
+		{
+			delete[] buffer;
+			return nullptr;
+		}
+	}
+	else if (datasize != (long)size || fr.Read(buffer, datasize) != datasize)
+	{
+		delete[] buffer;
+		return nullptr;
+	}
+
+	fr.Close();
+	TouchCacheFile(filename);
+
+	outWidth = width;
+	outHeight = height;
+	return buffer;
+}
+
+static void SaveCachedUpsample(const char *filename, const FUpsampleKey &key, const unsigned char *buffer, int width, int height, bool compress)
+{
+	uLongf size = width * height * 4;
+	uLongf datasize = size;
+	unsigned char *compressed = nullptr;
+	if (compress)
+	{
+		// Favor speed, most of the gain comes from the large transparent and flat areas anyway
+		datasize = compressBound(size);
+		compressed = new unsigned char[datasize];
+		if (compress2(compressed, &datasize, buffer, size, 1) != Z_OK || datasize >= size)
+		{
+			delete[] compressed;
+			compressed = nullptr;
+			datasize = size;
+		}
+	}
+
+	FUpsampleCacheHeader header;
+	memcpy(header.Magic, "HQRC", 4);
+	header.Version = LittleLong(uint32_t(HQCacheVersion));
+	header.Crc = LittleLong(key.Crc);
+	header.Hash = LittleLong(key.Hash);
+	header.Type = LittleLong(uint32_t(key.Type));
+	header.Width = LittleLong(uint32_t(width));
+	header.Height = LittleLong(uint32_t(height));
+	header.Compressed = LittleLong(uint32_t(compressed != nullptr));
+	header.DataSize = LittleLong(uint32_t(datasize));
+
+	// Write to a temporary file first so that an interrupted write never leaves a truncated cache entry behind.
+	// Several workers may write the same image, so each write gets its own name.
+	static std::atomic<unsigned> tempcount;
+	FString tempname;
+	tempname.Format("%s.%u.tmp", filename, tempcount++);
+	FileWriter *fw = FileWriter::Open(tempname);
+	if (fw != nullptr)
+	{
+		bool ok = fw->Write(&header, sizeof(header)) == sizeof(header) &&
+			fw->Write(compressed != nullptr ? compressed : buffer, datasize) == datasize;
+		delete fw;
+
+		if (ok && rename(tempname, filename) != 0)
+		{
+			// Windows does not replace existing files
+			remove(filename);
+			ok = rename(tempname, filename) == 0;
+		}
+		if (!ok) remove(tempname);
+		else CacheBytes += sizeof(header) + datasize;
+	}
+	delete[] compressed;
+}
+
+//===========================================================================
+//
+// Background upsampling
+//
+// One worker per core loads or creates the upsampled images queued at
+// precache time and writes new results to the disk cache. Queued images
+// are found again by texture and translation, so creating the hardware
+// texture neither has to decode nor hash the texture again.
+//
+//===========================================================================
+
+struct FUpsampleJob
+{
+	enum EState
+	{
+		Queued,
+		Running,
+		Done,
+		Cancelled
+	};
+
+	uint64_t Source = 0;			// texture and translation, only for upscale jobs
+	FUpsampleKey Key;				// the worker fills in the hashes for upscale jobs
+	bool HasAlpha = false;
+	bool UseCache = false;
+	bool Compress = false;
+	bool Upscale = false;			// false if Output only needs to be written to the disk cache
+	EState State = Queued;
+	unsigned char *Input = nullptr;
+	unsigned char *Output = nullptr;
+	int OutWidth = 0;
+	int OutHeight = 0;
+};
+
+static uint64_t MakeUpsampleSource(const FTexture *tex, int translation, bool expanded)
+{
+	return (uint64_t(uint32_t(MAX(translation, 0))) << 33) | (uint64_t(expanded) << 32) | uint32_t(tex->id.GetIndex());
+}
+
+static void RunUpsampleJob(FUpsampleJob *job)
+{
+	if (!job->Upscale)
+	{
+		SaveCachedUpsample(GetCacheFileName(job->Key), job->Key, job->Output, job->OutWidth, job->OutHeight, job->Compress);
+		return;
+	}
+
+	FString cachefile;
+	if (job->UseCache)
+	{
+		job->Key = MakeUpsampleKey(job->Key.Type, job->Input, job->Key.Width, job->Key.Height);
+		cachefile = GetCacheFileName(job->Key);
+		job->Output = LoadCachedUpsample(cachefile, job->Key, job->OutWidth, job->OutHeight);
+	}
+
+	if (job->Output != nullptr)
+	{
+		delete[] job->Input;
+	}
+	else
+	{
+		job->Output = UpscaleBuffer(job->Key.Type, job->Input, job->Key.Width, job->Key.Height, job->OutWidth, job->OutHeight);
+		if (cachefile.IsNotEmpty() && job->Output != nullptr)
+		{
+			SaveCachedUpsample(cachefile, job->Key, job->Output, job->OutWidth, job->OutHeight, job->Compress);
+		}
+	}
+	job->Input = nullptr;
+}
+
+class FUpsampleQueue
+{
+public:
+	~FUpsampleQueue()
+	{
+		Stop();
+	}
+
+	bool Add(FUpsampleJob *job);
+	FUpsampleJob *Claim(uint64_t source);
+	void Clear();
+	void Stop();
+
+	static void DeleteJob(FUpsampleJob *job);
+
+private:
+	void StartThreads();
+	void WorkerMain();
+
+	std::mutex Mutex;
+	std::condition_variable WorkCondition;
+	std::condition_variable DoneCondition;
+	std::vector<std::thread> Threads;
+	bool StopFlag = false;
+
+	TArray<FUpsampleJob *> Queue;				// jobs not yet picked up by a worker
+	unsigned int QueuePos = 0;
+	TMap<uint64_t, FUpsampleJob *> Results;		// upscale jobs by source until the texture gets created
+};
+
+static FUpsampleQueue *UpsampleQueue;
+
+void FUpsampleQueue::DeleteJob(FUpsampleJob *job)
+{
+	delete[] job->Input;
+	delete[] job->Output;
+	delete job;
+}
+
+void FUpsampleQueue::StartThreads()
+{
+	int numThreads = std::thread::hardware_concurrency();
+	if (numThreads < 1) numThreads = 1;
+
+	StopFlag = false;
+	for (int i = 0; i < numThreads; i++)
+	{
+		Threads.push_back(std::thread([this]() { WorkerMain(); }));
+	}
+}
+
+bool FUpsampleQueue::Add(FUpsampleJob *job)
+{
+	std::unique_lock<std::mutex> lock(Mutex);
+
+	if (job->Upscale)
+	{
+		if (Results.CheckKey(job->Source) != nullptr)
+		{
+			// Same texture was queued already
+			lock.unlock();
+			DeleteJob(job);
+			return false;
+		}
+		Results[job->Source] = job;
+	}
+	Queue.Push(job);
+
+	if (Threads.empty())
+	{
+		StartThreads();
+	}
+	WorkCondition.notify_one();
+	return true;
+}
+
+//===========================================================================
+//
+// Takes the job for a texture out of the queue and waits until it is done.
+// A job that no worker has picked up yet is moved to the front first.
+//
+//===========================================================================
+
+FUpsampleJob *FUpsampleQueue::Claim(uint64_t source)
+{
+	std::unique_lock<std::mutex> lock(Mutex);
+
+	FUpsampleJob **pjob = Results.CheckKey(source);
+	if (pjob == nullptr)
+		return nullptr;
+
+	FUpsampleJob *job = *pjob;
+	Results.Remove(source);
+
+	if (job->State == FUpsampleJob::Queued)
+	{
+		for (unsigned int i = QueuePos; i < Queue.Size(); i++)
+		{
+			if (Queue[i] == job)
+			{
+				Queue.Delete(i);
+				Queue.Insert(QueuePos, job);
+				break;
+			}
+		}
+	}
+
+	DoneCondition.wait(lock, [=]() { return job->State == FUpsampleJob::Done; });
+	return job;
+}
+
+void FUpsampleQueue::Clear()
+{
+	std::unique_lock<std::mutex> lock(Mutex);
+
+	TMap<uint64_t, FUpsampleJob *>::Iterator it(Results);
+	TMap<uint64_t, FUpsampleJob *>::Pair *pair;
+	while (it.NextPair(pair))
+	{
+		FUpsampleJob *job = pair->Value;
+		if (job->State == FUpsampleJob::Done) DeleteJob(job);
+		else job->State = FUpsampleJob::Cancelled;	// a worker deletes it
+	}
+	Results.Clear();
+}
+
+void FUpsampleQueue::Stop()
+{
+	if (Threads.empty())
+		return;
+
+	std::unique_lock<std::mutex> lock(Mutex);
+	StopFlag = true;
+	WorkCondition.notify_all();
+	lock.unlock();
+	for (auto &thread : Threads)
+	{
+		thread.join();
+	}
+	Threads.clear();
+
+	// Everything left in the queue is either a disk write or cancelled by now
+	Clear();
+	for (unsigned int i = QueuePos; i < Queue.Size(); i++)
+	{
+		DeleteJob(Queue[i]);
+	}
+	Queue.Clear();
+	QueuePos = 0;
+}
+
+void FUpsampleQueue::WorkerMain()
+{
+	UpsampleWorker = true;
+
+	std::unique_lock<std::mutex> lock(Mutex);
+	while (true)
+	{
+		WorkCondition.wait(lock, [this]() { return StopFlag || QueuePos < Queue.Size(); });
+		if (StopFlag)
+			break;
+
+		FUpsampleJob *job = Queue[QueuePos++];
+		if (QueuePos == Queue.Size())
+		{
+			Queue.Clear();
+			QueuePos = 0;
+		}
+
+		if (job->State == FUpsampleJob::Cancelled)
+		{
+			DeleteJob(job);
+			continue;
+		}
+
+		job->State = FUpsampleJob::Running;
+		lock.unlock();
+		RunUpsampleJob(job);
+		lock.lock();
+
+		if (job->Upscale && job->State == FUpsampleJob::Running)
+		{
+			job->State = FUpsampleJob::Done;
+			DoneCondition.notify_all();
+		}
+		else
+		{
+			DeleteJob(job);
+		}
+	}
+}
+
+//===========================================================================
+// 
+// [BB] Upsamples the texture in inputBuffer, frees inputBuffer and returns
+//  the upsampled buffer.
+//
+//===========================================================================
+unsigned char *gl_CreateUpsampledTextureBuffer ( const FTexture *inputTexture, unsigned char *inputBuffer, const int inWidth, const int inHeight, int &outWidth, int &outHeight, bool hasAlpha )
+{
+	// [BB] Make sure that outWidth and outHeight denote the size of
+	// the returned buffer even if we don't upsample the input buffer.
+	outWidth = inWidth;
+	outHeight = inHeight;
+
+	if (inputBuffer == nullptr)
+		return inputBuffer;
+
+	int type = GetUpsampleType(inputTexture, inWidth, inHeight, hasAlpha);
+	if (type == 0)
+		return inputBuffer;
+
+	InitUpscaler(type);
+
+	FUpsampleKey key;
+	FString cachefile;
+	unsigned char *outputBuffer;
+	if (gl_texture_hqresize_cache)
+	{
+		key = MakeUpsampleKey(type, inputBuffer, inWidth, inHeight);
+		cachefile = GetCacheFileName(key);
+		outputBuffer = LoadCachedUpsample(cachefile, key, outWidth, outHeight);
+		if (outputBuffer != nullptr)
+		{
+			delete[] inputBuffer;
+			return outputBuffer;
+		}
+	}
+
+	outputBuffer = UpscaleBuffer(type, inputBuffer, inWidth, inHeight, outWidth, outHeight);
+
+	if (cachefile.IsNotEmpty() && (outWidth != inWidth || outHeight != inHeight))
+	{
+		// The caller owns the buffer, so the worker has to write a copy.
+		FUpsampleJob *job = new FUpsampleJob;
+		job->Key = key;
+		job->Compress = gl_texture_hqresize_cache_compress;
+		job->Output = new unsigned char[outWidth * outHeight * 4];
+		job->OutWidth = outWidth;
+		job->OutHeight = outHeight;
+		memcpy(job->Output, outputBuffer, outWidth * outHeight * 4);
+		if (UpsampleQueue == nullptr) UpsampleQueue = new FUpsampleQueue;
+		UpsampleQueue->Add(job);
+	}
+	return outputBuffer;
+}
+
+//===========================================================================
+//
+// Checks if a texture of this size would get upsampled at all
+//
+//===========================================================================
+
+bool gl_CanUpsampleTexture(const FTexture *inputTexture, const int inWidth, const int inHeight)
+{
+	return GetUpsampleType(inputTexture, inWidth, inHeight, false) != 0;
+}
+
+//===========================================================================
+//
+// Queues upsampling of a texture on the worker threads. Takes ownership of
+// inputBuffer. The result gets picked up by gl_ClaimUpsampledTextureBuffer
+// when the texture is created.
+//
+//===========================================================================
+
+bool gl_QueueUpsampledTextureBuffer(const FTexture *inputTexture, int translation, bool expanded, unsigned char *inputBuffer, const int inWidth, const int inHeight, bool hasAlpha)
+{
+	int type = inputBuffer != nullptr ? GetUpsampleType(inputTexture, inWidth, inHeight, hasAlpha) : 0;
+	if (type == 0)
+	{
+		delete[] inputBuffer;
+		return false;
+	}
+
+	InitUpscaler(type);
+
+	FUpsampleJob *job = new FUpsampleJob;
+	job->Source = MakeUpsampleSource(inputTexture, translation, expanded);
+	job->Key.Type = type;
+	job->Key.Width = inWidth;
+	job->Key.Height = inHeight;
+	job->HasAlpha = hasAlpha;
+	if (gl_texture_hqresize_cache)
+	{
+		GetCachePath();
+		job->UseCache = true;
+		job->Compress = gl_texture_hqresize_cache_compress;
+	}
+	job->Upscale = true;
+	job->Input = inputBuffer;
+
+	if (UpsampleQueue == nullptr) UpsampleQueue = new FUpsampleQueue;
+	return UpsampleQueue->Add(job);
+}
+
+//===========================================================================
+//
+// Returns the upsampled image of a texture that was queued at precache
+// time, waiting for the worker if necessary, or null if there is none.
+//
+//===========================================================================
+
+unsigned char *gl_ClaimUpsampledTextureBuffer(const FTexture *inputTexture, int translation, bool expanded, const int inWidth, const int inHeight, int &outWidth, int &outHeight)
+{
+	if (UpsampleQueue == nullptr)
+		return nullptr;
+
+	FUpsampleJob *job = UpsampleQueue->Claim(MakeUpsampleSource(inputTexture, translation, expanded));
+	if (job == nullptr)
+		return nullptr;
+
+	// The settings may have changed since the texture was queued
+	unsigned char *outputBuffer = nullptr;
+	if (job->Key.Width == inWidth && job->Key.Height == inHeight &&
+		job->Key.Type == GetUpsampleType(inputTexture, inWidth, inHeight, job->HasAlpha))
+	{
+		outputBuffer = job->Output;
+		outWidth = job->OutWidth;
+		outHeight = job->OutHeight;
+		job->Output = nullptr;
+	}
+	FUpsampleQueue::DeleteJob(job);
+	return outputBuffer;
+}
+
+//===========================================================================
+//
+// Drops all queued results that were never used. This is also where the
+// disk cache gets trimmed if the last level added too much to it.
+//
+//===========================================================================
+
+void gl_ClearUpsampledTextureQueue()
+{
+	if (UpsampleQueue != nullptr) UpsampleQueue->Clear();
+
+	int64_t limit = int64_t(gl_texture_hqresize_cache_size) << 20;
+	if (gl_texture_hqresize_cache && limit > 0 && CacheBytes > limit)
+	{
+		TrimUpsampleCache(GetCachePath());
+	}
+}
+
+//===========================================================================
+//
+// Stops the workers. Called when the renderer shuts down.
+//
+//===========================================================================
+
+void gl_StopUpsampledTextureQueue()
+{
+	if (UpsampleQueue != nullptr)
+	{
+		delete UpsampleQueue;
+		UpsampleQueue = nullptr;
+	}
+}
@@ -21,6 +21,7 @@
 //
 
 #include "gl/system/gl_system.h"
+#include <mutex>
 #include "w_wad.h"
 #include "m_png.h"
 #include "sbar.h"
@@ -52,6 +53,7 @@ EXTERN_CVAR(Bool, gl_render_precise)
 EXTERN_CVAR(Int, gl_lightmode)
 EXTERN_CVAR(Bool, gl_precache)
 EXTERN_CVAR(Bool, gl_texture_usehires)
+EXTERN_CVAR(Int, gl_texture_hqresize)
 
 //===========================================================================
 //
@@ -97,9 +99,9 @@ FGLTexture::~FGLTexture()
 // Checks for the presence of a hires texture replacement and loads it
 //
 //==========================================================================
-unsigned char *FGLTexture::LoadHiresTexture(FTexture *tex, int *width, int *height)
+bool FGLTexture::CheckHiresTexture(FTexture *tex)
 {
-	if (bExpandFlag) return NULL;	// doesn't work for expanded textures
+	if (bExpandFlag) return false;	// doesn't work for expanded textures
 
 	if (HiresLump==-1) 
 	{
@@ -112,7 +114,12 @@ unsigned char *FGLTexture::LoadHiresTexture(FTexture *tex, int *width, int *heig
 			hirestexture = FTexture::CreateTexture(HiresLump, FTexture::TEX_Any);
 		}
 	}
-	if (hirestexture != NULL)
+	return hirestexture != NULL;
+}
+
+unsigned char *FGLTexture::LoadHiresTexture(FTexture *tex, int *width, int *height)
+{
+	if (CheckHiresTexture(tex))
 	{
 		int w=hirestexture->GetWidth();
 		int h=hirestexture->GetHeight();
@@ -186,8 +193,7 @@ void FGLTexture::CleanUnused(SpriteHits &usedtranslations)
 unsigned char * FGLTexture::CreateTexBuffer(int translation, int & w, int & h, FTexture *hirescheck, bool createexpanded, bool alphatrans)
 {
 	unsigned char * buffer;
-	int W, H;
-	int isTransparent = -1;
+	int isTransparent;
 
 
 	// Textures that are already scaled in the texture lump will not get replaced
@@ -201,6 +207,57 @@ unsigned char * FGLTexture::CreateTexBuffer(int translation, int & w, int & h, F
 		}
 	}
 
+	if (createexpanded)
+	{
+		// Pick up the image that was upsampled at precache time
+		buffer = gl_ClaimUpsampledTextureBuffer(tex, translation, bExpandFlag, tex->GetWidth() + 2 * bExpandFlag, tex->GetHeight() + 2 * bExpandFlag, w, h);
+		if (buffer)
+		{
+			return buffer;
+		}
+	}
+
+	buffer = CopyTexturePixels(translation, w, h, createexpanded, isTransparent);
+
+	// if we just want the texture for some checks there's no need for upsampling.
+	if (!createexpanded) return buffer;
+
+	// [BB] The hqnx upsampling (not the scaleN one) destroys partial transparency, don't upsamle textures using it.
+	// [BB] Potentially upsample the buffer.
+	return gl_CreateUpsampledTextureBuffer ( tex, buffer, w, h, w, h, !!isTransparent);
+}
+
+//===========================================================================
+// 
+//	Queues the upsampling of the untranslated texture on the worker threads
+//  so that creating the hardware texture later doesn't have to wait for it.
+//
+//===========================================================================
+
+bool FGLTexture::QueueUpsample(FTexture *hirescheck)
+{
+	if (tex->bHasCanvas || gl_texture_hqresize == 0) return false;
+	if (mHwTexture != NULL && mHwTexture->GetTextureHandle(0) != 0) return false;		// already created
+	if (!gl_CanUpsampleTexture(tex, tex->GetWidth() + 2 * bExpandFlag, tex->GetHeight() + 2 * bExpandFlag)) return false;
+	if (gl_texture_usehires && hirescheck != NULL && CheckHiresTexture(hirescheck)) return false;
+
+	int w, h, isTransparent;
+	unsigned char *buffer = CopyTexturePixels(0, w, h, true, isTransparent);
+	return gl_QueueUpsampledTextureBuffer(tex, 0, bExpandFlag, buffer, w, h, !!isTransparent);
+}
+
+//===========================================================================
+// 
+//	Copies the texture's pixels into a new RGBA buffer
+//
+//===========================================================================
+
+unsigned char * FGLTexture::CopyTexturePixels(int translation, int & w, int & h, bool createexpanded, int & isTransparent)
+{
+	unsigned char * buffer;
+	int W, H;
+
+	isTransparent = -1;
 	int exx = bExpandFlag && createexpanded;
 
 	W = w = tex->GetWidth() + 2 * exx;
@@ -246,13 +303,7 @@ unsigned char * FGLTexture::CreateTexBuffer(int translation, int & w, int & h, F
 		isTransparent = 0;
 		// This is not conclusive for setting the texture's transparency info.
 	}
-
-	// if we just want the texture for some checks there's no need for upsampling.
-	if (!createexpanded) return buffer;
-
-	// [BB] The hqnx upsampling (not the scaleN one) destroys partial transparency, don't upsamle textures using it.
-	// [BB] Potentially upsample the buffer.
-	return gl_CreateUpsampledTextureBuffer ( tex, buffer, W, H, w, h, !!isTransparent);
+	return buffer;
 }
 
 
@@ -736,6 +787,8 @@ void FMaterial::Bind(int clampmode, int translation)
 //===========================================================================
 void FMaterial::Precache()
 {
+	// Textures that need upsampling get created on first use, once the worker thread is done with them.
+	if (mBaseLayer->QueueUpsample(tex->Scale.X == 1 && tex->Scale.Y == 1 && !mExpanded ? tex : NULL)) return;
 	Bind(0, 0);
 }
 
@@ -834,6 +887,32 @@ void FMaterial::BindToFrameBuffer()
 	mBaseLayer->mHwTexture->BindToFrameBuffer();
 }
 
+static std::recursive_mutex ValidateMutex;	// the scene setup may run on several threads.
+
+//==========================================================================
+//
+// Transparency is only known after the texture has been decoded once.
+//
+//==========================================================================
+
+void FMaterial::CheckTransparent() const
+{
+	std::lock_guard<std::recursive_mutex> lock(ValidateMutex);
+	if (mBaseLayer->bIsTransparent == -1) 
+	{
+		if (!mBaseLayer->tex->bHasCanvas)
+		{
+			int w, h;
+			unsigned char *buffer = CreateTexBuffer(0, w, h);
+			delete [] buffer;
+		}
+		else
+		{
+			mBaseLayer->bIsTransparent = 0;
+		}
+	}
+}
+
 //==========================================================================
 //
 // Gets a texture from the texture manager and checks its validity for
@@ -851,6 +930,11 @@ again:
 		FMaterial *gltex = tex->gl_info.Material[expand];
 		if (gltex == NULL) 
 		{
+			std::lock_guard<std::recursive_mutex> lock(ValidateMutex);
+			if (tex->gl_info.bNoExpand) expand = false;
+			gltex = tex->gl_info.Material[expand];
+			if (gltex != NULL) return gltex;
+
 			if (expand)
 			{
 				if (tex->bWarped || tex->bHasCanvas || tex->gl_info.shaderindex >= FIRST_USER_SHADER)
@@ -899,7 +983,8 @@ void FMaterial::FlushAll()
 	{
 		for (int j = 0; j < 2; j++)
 		{
-			FGLTexture *gltex = TexMan.ByIndex(i)->gl_info.SystemTexture[j];
+			FTexture *tex = TexMan.ByIndexIfCreated(i);
+			FGLTexture *gltex = tex != NULL ? tex->gl_info.SystemTexture[j] : NULL;
 			if (gltex != NULL) gltex->Clean(true);
 		}
 	}
@@ -68,7 +68,9 @@ private:
 	uint8_t lastSampler;
 	int lastTranslation;
 
+	bool CheckHiresTexture(FTexture *hirescheck);
 	unsigned char * LoadHiresTexture(FTexture *hirescheck, int *width, int *height);
+	unsigned char * CopyTexturePixels(int translation, int & w, int & h, bool createexpanded, int & isTransparent);
 
 	FHardwareTexture *CreateHwTexture();
 
@@ -79,6 +81,7 @@ public:
 	~FGLTexture();
 
 	unsigned char * CreateTexBuffer(int translation, int & w, int & h, FTexture *hirescheck, bool createexpanded = true, bool alphatrans = false);
+	bool QueueUpsample(FTexture *hirescheck);
 
 	void Clean(bool all);
 	void CleanUnused(SpriteHits &usedtranslations);
@@ -239,21 +242,10 @@ public:
 
 
 
+	void CheckTransparent() const;
 	bool GetTransparent() const
 	{
-		if (mBaseLayer->bIsTransparent == -1) 
-		{
-			if (!mBaseLayer->tex->bHasCanvas)
-			{
-				int w, h;
-				unsigned char *buffer = CreateTexBuffer(0, w, h);
-				delete [] buffer;
-			}
-			else
-			{
-				mBaseLayer->bIsTransparent = 0;
-			}
-		}
+		if (mBaseLayer->bIsTransparent == -1) CheckTransparent();
 		return !!mBaseLayer->bIsTransparent;
 	}
 
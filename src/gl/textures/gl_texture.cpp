@@ -40,6 +40,7 @@
 #include "v_palette.h"
 #include "sc_man.h"
 #include "textures/skyboxtexture.h"
+#include "textures/precachedecoder.h"
 
 #include "gl/system/gl_interface.h"
 #include "gl/renderer/gl_renderer.h"
@@ -767,6 +768,9 @@ void gl_PrecacheTexture(uint8_t *texhitlist, TMap<PClassActor*, bool> &actorhitl
 	memset(modellist, 0, Models.Size());
 	memset(spritehitlist, 0, sizeof(SpriteHits**) * TexMan.NumTextures());
 
+	// Results from the last level that never got used are not needed anymore
+	gl_ClearUpsampledTextureQueue();
+
 	// this isn't done by the main code so it needs to be done here first:
 	// check skybox textures and mark the separate faces as used
 	for (int i = 0; i<TexMan.NumTextures(); i++)
@@ -859,7 +863,7 @@ void gl_PrecacheTexture(uint8_t *texhitlist, TMap<PClassActor*, bool> &actorhitl
 	int cnt = TexMan.NumTextures();
 	for (int i = cnt - 1; i >= 0; i--)
 	{
-		FTexture *tex = TexMan.ByIndex(i);
+		FTexture *tex = TexMan.ByIndexIfCreated(i);
 		if (tex != nullptr)
 		{
 			if (!texhitlist[i])
@@ -875,10 +879,22 @@ void gl_PrecacheTexture(uint8_t *texhitlist, TMap<PClassActor*, bool> &actorhitl
 
 	if (gl_precache)
 	{
-		// cache all used textures
+		// decode the images in the background in the same order they get used below
+		TArray<FTexture *> decodelist;
 		for (int i = cnt - 1; i >= 0; i--)
 		{
-			FTexture *tex = TexMan.ByIndex(i);
+			if ((texhitlist[i] & (FTextureManager::HIT_Wall | FTextureManager::HIT_Flat | FTextureManager::HIT_Sky)) ||
+				(spritehitlist[i] != nullptr && (*spritehitlist[i]).CountUsed() > 0))
+			{
+				decodelist.Push(TexMan.ByIndex(i));
+			}
+		}
+		FPrecacheDecoder::Start(decodelist);
+
+		// cache all used textures. The loop above has created all of them.
+		for (int i = cnt - 1; i >= 0; i--)
+		{
+			FTexture *tex = TexMan.ByIndexIfCreated(i);
 			if (tex != nullptr)
 			{
 				PrecacheTexture(tex, texhitlist[i]);
@@ -888,6 +904,7 @@ void gl_PrecacheTexture(uint8_t *texhitlist, TMap<PClassActor*, bool> &actorhitl
 				}
 			}
 		}
+		FPrecacheDecoder::Finish();
 
 		// cache all used models
 		FGLModelRenderer renderer;
@@ -915,7 +932,8 @@ CCMD(textureinfo)
 	int cntt = 0;
 	for (int i = 0; i < TexMan.NumTextures(); i++)
 	{
-		FTexture *tex = TexMan.ByIndex(i);
+		FTexture *tex = TexMan.ByIndexIfCreated(i);
+		if (tex == nullptr) continue;
 		if (tex->gl_info.SystemTexture[0] || tex->gl_info.SystemTexture[1] || tex->gl_info.Material[0] || tex->gl_info.Material[1])
 		{
 			int lump = tex->GetSourceLump();
@@ -29,6 +29,11 @@ void gl_GenerateGlobalBrightmapFromColormap();
 
 
 unsigned char *gl_CreateUpsampledTextureBuffer ( const FTexture *inputTexture, unsigned char *inputBuffer, const int inWidth, const int inHeight, int &outWidth, int &outHeight, bool hasAlpha );
+bool gl_CanUpsampleTexture(const FTexture *inputTexture, const int inWidth, const int inHeight);
+bool gl_QueueUpsampledTextureBuffer(const FTexture *inputTexture, int translation, bool expanded, unsigned char *inputBuffer, const int inWidth, const int inHeight, bool hasAlpha);
+unsigned char *gl_ClaimUpsampledTextureBuffer(const FTexture *inputTexture, int translation, bool expanded, const int inWidth, const int inHeight, int &outWidth, int &outHeight);
+void gl_ClearUpsampledTextureQueue();
+void gl_StopUpsampledTextureQueue();
 int CheckDDPK3(FTexture *tex);
 int CheckExternalFile(FTexture *tex, bool & hascolorkey);
 
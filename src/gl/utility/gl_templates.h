@@ -2,6 +2,7 @@
 #define __GL_BASIC
 
 #include <new>
+#include <mutex>
 #include "stats.h"
 
 
@@ -51,11 +52,13 @@ template<class T> class UniqueList
 {
 	TArray<T*> Array;
 	FreeList<T>	TheFreeList;
+	std::mutex Lock;	// the scene setup threads may look up portals at the same time.
 
 public:
 
 	T * Get(T * t)
 	{
+		std::lock_guard<std::mutex> lock(Lock);
 		for(unsigned i=0;i<Array.Size();i++)
 		{
 			if (!memcmp(t, Array[i], sizeof(T))) return Array[i];
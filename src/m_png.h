@@ -108,8 +108,41 @@ bool M_GetPNGText (PNGHandle *png, const char *keyword, char *buffer, size_t buf
 
 // The file must be positioned at the start of the first IDAT. It reads
 // image data into the provided buffer. Returns true on success.
+// scalarunfilter turns the SIMD unfilter off, for comparing the two.
 bool M_ReadIDAT (FileReader *file, uint8_t *buffer, int width, int height, int pitch,
-				 uint8_t bitdepth, uint8_t colortype, uint8_t interlace, unsigned int idatlen);
+				 uint8_t bitdepth, uint8_t colortype, uint8_t interlace, unsigned int idatlen, bool scalarunfilter = false);
+
+// Receives the rows of an image from M_ReadIDATRows as soon as they are
+// unfiltered. The row is only valid until the next call.
+struct FPNGRowSink
+{
+	virtual ~FPNGRowSink() {}
+	virtual void Row (int y, const uint8_t *row) = 0;
+};
+
+// Like M_ReadIDAT, but passes each row to the sink instead of storing the
+// whole image. Only works for images with 8 bits per sample that are not
+// interlaced. Returns false for everything else.
+bool M_ReadIDATRows (FileReader *file, FPNGRowSink *sink, int width, int height,
+				 uint8_t bitdepth, uint8_t colortype, uint8_t interlace, unsigned int idatlen, bool scalarunfilter = false);
+
+class FBitmap;
+
+// Decodes a complete PNG file into a new true color bitmap. Only the
+// passed reader is accessed, so it is safe to call from any thread as
+// long as every image has its own reader.
+bool M_DecodePNG (FileReader *file, FBitmap *bmp, bool scalarunfilter = false);
+
+struct FPNGDecodeJob
+{
+	FileReader *File;
+	FBitmap *Bitmap;
+	bool Success;
+};
+
+// Decodes several images at once on worker threads. The calling thread
+// decodes images as well, so nothing is started for a single image.
+void M_DecodePNGs (FPNGDecodeJob *jobs, int count);
 
 
 class FTexture;
@@ -304,6 +304,12 @@ FSerializer &Serialize(FSerializer &arc, const char *key, sector_t &p, sector_t
 			.Array("reflect", p.reflect, def->reflect, 2, true)
 			.EndObject();
 
+		// The plane heights were changed behind the setters' back.
+		if (arc.isReading() && !p.planesmoved)
+		{
+			p.MarkPlanesMoved();
+		}
+
 		if (arc.isReading() && !scroll.isZero())
 		{
 			if (level.Scrolls.Size() == 0)
@@ -1004,6 +1004,22 @@ DEFINE_ACTION_FUNCTION(_Sector, PlaneMoving)
 	ACTION_RETURN_BOOL(self->PlaneMoving(pos));
 }
 
+//=====================================================================================
+//
+// The renderers also change the planes of temporary sector copies,
+// those must not end up in the list.
+//
+//=====================================================================================
+
+void sector_t::MarkPlanesMoved()
+{
+	if (level.sectors.Size() > 0 && unsigned(this - &level.sectors[0]) < level.sectors.Size())
+	{
+		planesmoved = true;
+		level.movedsectors.Push(this);
+	}
+}
+
 //=====================================================================================
 //
 //
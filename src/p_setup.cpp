@@ -334,14 +334,14 @@ MapData *P_OpenMapData(const char * mapname, bool justcheck)
 					// The next lump is not part of this map anymore
 					if (index < 0) break;
 
-					map->MapLumps[index].Reader = Wads.ReopenLumpNum(lump_name + i);
+					map->MapLumps[index].LumpNum = lump_name + i;
 					strncpy(map->MapLumps[index].Name, lumpname, 8);
 				}
 			}
 			else
 			{
 				map->isText = true;
-				map->MapLumps[1].Reader = Wads.ReopenLumpNum(lump_name + 1);
+				map->MapLumps[1].LumpNum = lump_name + 1;
 				for(int i = 2;; i++)
 				{
 					const char * lumpname = Wads.GetLumpFullName(lump_name + i);
@@ -377,10 +377,12 @@ MapData *P_OpenMapData(const char * mapname, bool justcheck)
 						break;
 					}
 					else continue;
-					map->MapLumps[index].Reader = Wads.ReopenLumpNum(lump_name + i);
+					map->MapLumps[index].LumpNum = lump_name + i;
 					strncpy(map->MapLumps[index].Name, lumpname, 8);
 				}
 			}
+			// The lumps get opened when they are first accessed. Only loading
+			// the level needs all of them, so P_SetupLevel reads them in one go.
 			return map;
 		}
 		else
@@ -510,6 +512,80 @@ bool P_CheckMapData(const char *mapname)
 	return true;
 }
 
+//===========================================================================
+//
+// MapData :: OpenLump
+//
+// Lumps of a map in the global directory are only opened when needed.
+//
+//===========================================================================
+
+FileReader *MapData::OpenLump(unsigned int lumpindex)
+{
+	MapLump &maplump = MapLumps[lumpindex];
+	if (maplump.Reader == NULL && maplump.LumpNum >= 0)
+	{
+		maplump.Reader = Wads.ReopenLumpNum(maplump.LumpNum);
+	}
+	return maplump.Reader;
+}
+
+//===========================================================================
+//
+// MapData :: ReadLumps
+//
+// Opens all lumps of a map that is stored in a WAD in the global directory.
+// Plainly stored lumps in files that are not memory mapped are read by the
+// I/O threads in a single batch. Everything else, including compressed
+// lumps, goes through the lump cache.
+//
+//===========================================================================
+
+void MapData::ReadLumps()
+{
+	FileReadBatch batch;
+	TArray<int> batched;
+
+	for (int i = 0; i < ML_MAX; i++)
+	{
+		int lump = MapLumps[i].LumpNum;
+		if (lump < 0 || MapLumps[i].Reader != NULL) continue;
+
+		FileReader *wadreader = Wads.GetFileReader(Wads.GetLumpFile(lump));
+		int offset = Wads.GetLumpOffset(lump);
+		int size = Wads.LumpLength(lump);
+		if (wadreader != NULL && wadreader->GetBuffer() == NULL && offset >= 0 && size > 0)
+		{
+			MemoryArrayReader *reader = new MemoryArrayReader(NULL, 0);
+			reader->GetArray().Resize(size);
+			reader->UpdateLength();
+			batch.Add(wadreader, offset, size, &reader->GetArray()[0]);
+			batched.Push(i);
+			MapLumps[i].Reader = reader;
+		}
+	}
+	batch.Start();
+
+	for (int i = 0; i < ML_MAX; i++)
+	{
+		OpenLump(i);
+	}
+
+	if (!batch.Wait())
+	{
+		// Let the regular path deal with anything that came up short
+		for (unsigned j = 0; j < batched.Size(); j++)
+		{
+			MapLump &maplump = MapLumps[batched[j]];
+			if (batch.BytesRead(j) != maplump.Reader->GetLength())
+			{
+				delete maplump.Reader;
+				maplump.Reader = Wads.ReopenLumpNum(maplump.LumpNum);
+			}
+		}
+	}
+}
+
 //===========================================================================
 //
 // MapData :: GetChecksum
@@ -3485,6 +3561,19 @@ static void P_PrecacheLevel()
 		if (tex.Exists()) hitlist[tex.GetIndex()] |= FTextureManager::HIT_Wall;
 	}
 
+	// Let the compressed lumps of all textures get inflated while the renderer works through the list.
+	// The renderers go through it from the end, so the lumps get queued in the same order.
+	TArray<int> lumps;
+	for (i = cnt - 1; i >= 0; i--)
+	{
+		if (hitlist[i])
+		{
+			FTexture *tex = TexMan.ByIndex(i);
+			if (tex != nullptr && tex->GetSourceLump() >= 0) lumps.Push(tex->GetSourceLump());
+		}
+	}
+	Wads.PrefetchLumps(lumps);
+
 	Renderer->Precache(hitlist, actorhitlist);
 
 	delete[] hitlist;
@@ -3536,6 +3625,7 @@ void P_FreeLevelData ()
 	FBehavior::StaticUnloadModules ();
 	level.segs.Clear();
 	level.sectors.Clear();
+	level.movedsectors.Clear();
 	level.lines.Clear();
 	level.sides.Clear();
 	level.loadsectors.Clear();
@@ -3682,6 +3772,7 @@ void P_SetupLevel (const char *lumpname, int position)
 	{
 		I_Error("Unable to open map '%s'\n", lumpname);
 	}
+	map->ReadLumps();
 
 	// [ZZ] init per-map static handlers. we need to call this before everything is set up because otherwise scripts don't receive PlayerEntered event
 	//      (which happens at god-knows-what stage in this function, but definitely not the last part, because otherwise it'd work to put E_InitStaticHandlers before the player spawning)
@@ -38,6 +38,7 @@ struct MapData
 	{
 		char Name[8];
 		FileReader *Reader;
+		int LumpNum;			// Set instead of Reader until the lump gets opened
 	} MapLumps[ML_MAX];
 	bool HasBehavior;
 	bool Encrypted;
@@ -50,6 +51,7 @@ struct MapData
 	MapData()
 	{
 		memset(MapLumps, 0, sizeof(MapLumps));
+		for (auto &lump : MapLumps) lump.LumpNum = -1;
 		file = NULL;
 		resource = NULL;
 		lumpnum = -1;
@@ -72,7 +74,7 @@ struct MapData
 	{
 		if (lumpindex<countof(MapLumps))
 		{
-			file = MapLumps[lumpindex].Reader;
+			file = OpenLump(lumpindex);
 			file->Seek(0, SEEK_SET);
 		}
 	}
@@ -81,7 +83,7 @@ struct MapData
 	{
 		if (lumpindex<countof(MapLumps))
 		{
-			if (size == -1) size = MapLumps[lumpindex].Reader->GetLength();
+			if (size == -1) size = OpenLump(lumpindex)->GetLength();
 			Seek(lumpindex);
 			file->Read(buffer, size);
 		}
@@ -89,7 +91,7 @@ struct MapData
 
 	uint32_t Size(unsigned int lumpindex)
 	{
-		if (lumpindex<countof(MapLumps) && MapLumps[lumpindex].Reader)
+		if (lumpindex<countof(MapLumps) && OpenLump(lumpindex))
 		{
 			return MapLumps[lumpindex].Reader->GetLength();
 		}
@@ -97,6 +99,8 @@ struct MapData
 	}
 
 	void GetChecksum(uint8_t cksum[16]);
+	FileReader *OpenLump(unsigned int lumpindex);
+	void ReadLumps();
 };
 
 MapData * P_OpenMapData(const char * mapname, bool justcheck);
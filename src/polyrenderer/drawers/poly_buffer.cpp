@@ -21,6 +21,7 @@
 */
 
 #include <stddef.h>
+#include <float.h>
 #include "templates.h"
 #include "doomdef.h"
 #include "i_system.h"
@@ -50,6 +51,10 @@ void PolyZBuffer::Resize(int newwidth, int newheight)
 	height = newheight;
 	int count = BlockWidth() * BlockHeight();
 	values.resize(count * 64);
+
+	// The values themselves are not cleared, so the range of each block is unknown until it gets written again
+	blockmin.assign(count, -FLT_MAX);
+	blockmax.assign(count, FLT_MAX);
 }
 
 /////////////////////////////////////////////////////////////////////////////
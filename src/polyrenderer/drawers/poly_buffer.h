@@ -37,10 +37,16 @@ public:
 	int BlockHeight() const { return (height + 7) / 8; }
 	float *Values() { return values.data(); }
 
+	// Smallest and largest depth value stored in each 8x8 block
+	float *BlockMin() { return blockmin.data(); }
+	float *BlockMax() { return blockmax.data(); }
+
 private:
 	int width;
 	int height;
 	std::vector<float> values;
+	std::vector<float> blockmin;
+	std::vector<float> blockmax;
 };
 
 class PolyStencilBuffer
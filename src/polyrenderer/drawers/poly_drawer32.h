@@ -373,6 +373,12 @@ public:
 		}
 	}
 
+	// No specialized permutations for the non-SSE drawers
+	static TriDrawerFunc Select(const TriDrawTriangleArgs *args)
+	{
+		return &Execute;
+	}
+
 private:
 	template<typename ShadeModeT, typename FilterModeT>
 	FORCEINLINE static void DrawBlock(int destX, int destY, uint32_t mask0, uint32_t mask1, const TriDrawTriangleArgs *args)
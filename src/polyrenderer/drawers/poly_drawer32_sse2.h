@@ -363,37 +363,159 @@ public:
 			if (is_simple_shade)
 			{
 				if (is_nearest_filter)
-					DrawBlock<SimpleShade, NearestFilter>(x, y, mask0, mask1, args);
+					DrawBlock<SimpleShade, NearestFilter, RuntimeLight, DynamicLights>(x, y, mask0, mask1, args);
 				else
-					DrawBlock<SimpleShade, LinearFilter>(x, y, mask0, mask1, args);
+					DrawBlock<SimpleShade, LinearFilter, RuntimeLight, DynamicLights>(x, y, mask0, mask1, args);
 			}
 			else
 			{
 				if (is_nearest_filter)
-					DrawBlock<AdvancedShade, NearestFilter>(x, y, mask0, mask1, args);
+					DrawBlock<AdvancedShade, NearestFilter, RuntimeLight, DynamicLights>(x, y, mask0, mask1, args);
 				else
-					DrawBlock<AdvancedShade, LinearFilter>(x, y, mask0, mask1, args);
+					DrawBlock<AdvancedShade, LinearFilter, RuntimeLight, DynamicLights>(x, y, mask0, mask1, args);
 			}
 		}
 		else if (SamplerT::Mode == (int)Samplers::Fuzz)
 		{
-			DrawBlock<NoShade, NearestFilter>(x, y, mask0, mask1, args);
+			DrawBlock<NoShade, NearestFilter, RuntimeLight, DynamicLights>(x, y, mask0, mask1, args);
 		}
 		else // no linear filtering for translated, shaded, stencil, fill or skycap
 		{
 			if (is_simple_shade)
 			{
-				DrawBlock<SimpleShade, NearestFilter>(x, y, mask0, mask1, args);
+				DrawBlock<SimpleShade, NearestFilter, RuntimeLight, DynamicLights>(x, y, mask0, mask1, args);
 			}
 			else
 			{
-				DrawBlock<AdvancedShade, NearestFilter>(x, y, mask0, mask1, args);
+				DrawBlock<AdvancedShade, NearestFilter, RuntimeLight, DynamicLights>(x, y, mask0, mask1, args);
 			}
 		}
 	}
 
+	// Picks the drawer specialized for all the options of a draw call, so that no option is tested per block or pixel
+	static TriDrawerFunc Select(const TriDrawTriangleArgs *args)
+	{
+		using namespace TriScreenDrawerModes;
+
+		bool is_simple_shade = args->uniforms->SimpleShade();
+
+		if (SamplerT::Mode == (int)Samplers::Texture)
+		{
+			bool is_nearest_filter = args->uniforms->NearestFilter();
+
+			if (is_simple_shade)
+			{
+				if (is_nearest_filter)
+					return SelectLight<SimpleShade, NearestFilter>(args);
+				else
+					return SelectLight<SimpleShade, LinearFilter>(args);
+			}
+			else
+			{
+				if (is_nearest_filter)
+					return SelectLight<AdvancedShade, NearestFilter>(args);
+				else
+					return SelectLight<AdvancedShade, LinearFilter>(args);
+			}
+		}
+		else if (SamplerT::Mode == (int)Samplers::Fuzz)
+		{
+			return SelectLight<NoShade, NearestFilter>(args);
+		}
+		else
+		{
+			if (is_simple_shade)
+				return SelectLight<SimpleShade, NearestFilter>(args);
+			else
+				return SelectLight<AdvancedShade, NearestFilter>(args);
+		}
+	}
+
 private:
 	template<typename ShadeModeT, typename FilterModeT>
+	static TriDrawerFunc SelectLight(const TriDrawTriangleArgs *args)
+	{
+		using namespace TriScreenDrawerModes;
+
+		bool is_fixed_light = args->uniforms->FixedLight();
+		bool has_lights = args->uniforms->NumLights() > 0;
+
+		if (is_fixed_light)
+		{
+			if (has_lights)
+				return &DrawPermutation<ShadeModeT, FilterModeT, FixedLight, DynamicLights>;
+			else
+				return &DrawPermutation<ShadeModeT, FilterModeT, FixedLight, NoDynLights>;
+		}
+		else
+		{
+			if (has_lights)
+				return &DrawPermutation<ShadeModeT, FilterModeT, DiminishingLight, DynamicLights>;
+			else
+				return &DrawPermutation<ShadeModeT, FilterModeT, DiminishingLight, NoDynLights>;
+		}
+	}
+
+	template<typename ShadeModeT, typename FilterModeT, typename LightModeT, typename DynLightModeT>
+	static void DrawPermutation(int x, int y, uint32_t mask0, uint32_t mask1, const TriDrawTriangleArgs *args)
+	{
+		DrawBlock<ShadeModeT, FilterModeT, LightModeT, DynLightModeT>(x, y, mask0, mask1, args);
+	}
+
+	template<typename LightModeT>
+	FORCEINLINE static fixed_t VECTORCALL LightPos(float posW, float shade, float globVis, uint32_t light, uint32_t lightmask)
+	{
+		using namespace TriScreenDrawerModes;
+
+		if (LightModeT::Mode == (int)LightModes::Fixed)
+			return light << 8;
+
+		fixed_t lightpos = FRACUNIT - (fixed_t)(clamp(shade - MIN(24.0f / 32.0f, globVis * posW), 0.0f, 31.0f / 32.0f) * (float)FRACUNIT);
+		if (LightModeT::Mode == (int)LightModes::Runtime)
+			lightpos = (lightpos & lightmask) | ((light << 8) & ~lightmask);
+		return lightpos;
+	}
+
+	template<typename LightModeT>
+	FORCEINLINE static fixed_t VECTORCALL LightStep(fixed_t lightpos, float nextW, float shade, float globVis, uint32_t lightmask)
+	{
+		using namespace TriScreenDrawerModes;
+
+		if (LightModeT::Mode == (int)LightModes::Fixed)
+			return 0;
+
+		fixed_t lightnext = FRACUNIT - (fixed_t)(clamp(shade - MIN(24.0f / 32.0f, globVis * nextW), 0.0f, 31.0f / 32.0f) * (float)FRACUNIT);
+		fixed_t lightstep = (lightnext - lightpos) / 8;
+		if (LightModeT::Mode == (int)LightModes::Runtime)
+			lightstep = lightstep & lightmask;
+		return lightstep;
+	}
+
+	template<typename DynLightModeT>
+	FORCEINLINE static void VECTORCALL RowDynLight(const ScreenTriangleStepVariables &blockPosY, const ScreenTriangleStepVariables &blockPosX, const PolyLight *lights, int num_lights, __m128 worldnormal, uint32_t dynlightcolor, __m128i constantlight, __m128i &dynlight, __m128i &dynlightstep)
+	{
+		using namespace TriScreenDrawerModes;
+
+		if (DynLightModeT::Mode == (int)DynLightModes::None)
+		{
+			dynlight = constantlight;
+			dynlightstep = _mm_setzero_si128();
+			return;
+		}
+
+		__m128 mrcpW = _mm_set1_ps(1.0f / blockPosY.W);
+		__m128 worldpos = _mm_mul_ps(_mm_loadu_ps(&blockPosY.WorldX), mrcpW);
+		dynlight = CalcDynamicLight(lights, num_lights, worldpos, worldnormal, dynlightcolor);
+
+		mrcpW = _mm_set1_ps(1.0f / blockPosX.W);
+		worldpos = _mm_mul_ps(_mm_loadu_ps(&blockPosX.WorldX), mrcpW);
+		__m128i dynlightnext = CalcDynamicLight(lights, num_lights, worldpos, worldnormal, dynlightcolor);
+		dynlightstep = _mm_srai_epi16(_mm_sub_epi16(dynlightnext, dynlight), 3);
+		dynlight = _mm_max_epi16(_mm_min_epi16(_mm_add_epi16(dynlight, _mm_and_si128(dynlightstep, _mm_set_epi32(0xffff, 0xffff, 0, 0))), _mm_set1_epi16(256)), _mm_setzero_si128());
+		dynlightstep = _mm_slli_epi16(dynlightstep, 1);
+	}
+
+	template<typename ShadeModeT, typename FilterModeT, typename LightModeT, typename DynLightModeT>
 	FORCEINLINE static void VECTORCALL DrawBlock(int destX, int destY, uint32_t mask0, uint32_t mask1, const TriDrawTriangleArgs *args)
 	{
 		using namespace TriScreenDrawerModes;
@@ -408,6 +530,13 @@ private:
 		__m128 worldnormal = _mm_setr_ps(args->uniforms->Normal().X, args->uniforms->Normal().Y, args->uniforms->Normal().Z, 0.0f);
 		uint32_t dynlightcolor = args->uniforms->DynLightColor();
 
+		// Without dynamic lights the light contribution is the same for the whole block
+		__m128i constantlight;
+		if (DynLightModeT::Mode == (int)DynLightModes::None)
+			constantlight = CalcDynamicLight(lights, 0, _mm_setzero_ps(), worldnormal, dynlightcolor);
+		else
+			constantlight = _mm_setzero_si128();
+
 		// Calculate gradients
 		const ShadedTriVertex &v1 = *args->v1;
 		ScreenTriangleStepVariables gradientX = args->gradientX;
@@ -482,12 +611,7 @@ private:
 				int32_t posU = (int32_t)(blockPosY.U * rcpW);
 				int32_t posV = (int32_t)(blockPosY.V * rcpW);
 
-				fixed_t lightpos = FRACUNIT - (int)(clamp(shade - MIN(24.0f / 32.0f, globVis * blockPosY.W), 0.0f, 31.0f / 32.0f) * (float)FRACUNIT);
-				lightpos = (lightpos & lightmask) | ((light << 8) & ~lightmask);
-
-				__m128 mrcpW = _mm_set1_ps(1.0f / blockPosY.W);
-				__m128 worldpos = _mm_mul_ps(_mm_loadu_ps(&blockPosY.WorldX), mrcpW);
-				__m128i dynlight = CalcDynamicLight(lights, num_lights, worldpos, worldnormal, dynlightcolor);
+				fixed_t lightpos = LightPos<LightModeT>(blockPosY.W, shade, globVis, light, lightmask);
 
 				ScreenTriangleStepVariables blockPosX = blockPosY;
 				blockPosX.W += gradientX.W;
@@ -503,16 +627,10 @@ private:
 				int32_t stepU = (nextU - posU) / 8;
 				int32_t stepV = (nextV - posV) / 8;
 
-				fixed_t lightnext = FRACUNIT - (fixed_t)(clamp(shade - MIN(24.0f / 32.0f, globVis * blockPosX.W), 0.0f, 31.0f / 32.0f) * (float)FRACUNIT);
-				fixed_t lightstep = (lightnext - lightpos) / 8;
-				lightstep = lightstep & lightmask;
+				fixed_t lightstep = LightStep<LightModeT>(lightpos, blockPosX.W, shade, globVis, lightmask);
 
-				mrcpW = _mm_set1_ps(1.0f / blockPosX.W);
-				worldpos = _mm_mul_ps(_mm_loadu_ps(&blockPosX.WorldX), mrcpW);
-				__m128i dynlightnext = CalcDynamicLight(lights, num_lights, worldpos, worldnormal, dynlightcolor);
-				__m128i dynlightstep = _mm_srai_epi16(_mm_sub_epi16(dynlightnext, dynlight), 3);
-				dynlight = _mm_max_epi16(_mm_min_epi16(_mm_add_epi16(dynlight, _mm_and_si128(dynlightstep, _mm_set_epi32(0xffff,0xffff,0,0))), _mm_set1_epi16(256)), _mm_setzero_si128());
-				dynlightstep = _mm_slli_epi16(dynlightstep, 1);
+				__m128i dynlight, dynlightstep;
+				RowDynLight<DynLightModeT>(blockPosY, blockPosX, lights, num_lights, worldnormal, dynlightcolor, constantlight, dynlight, dynlightstep);
 
 				for (int ix = 0; ix < 4; ix++)
 				{
@@ -563,7 +681,8 @@ private:
 					// Store result
 					_mm_storel_epi64((__m128i*)(dest + ix * 2), outcolor);
 
-					dynlight = _mm_max_epi16(_mm_min_epi16(_mm_add_epi16(dynlight, dynlightstep), _mm_set1_epi16(256)), _mm_setzero_si128());
+					if (DynLightModeT::Mode != (int)DynLightModes::None)
+						dynlight = _mm_max_epi16(_mm_min_epi16(_mm_add_epi16(dynlight, dynlightstep), _mm_set1_epi16(256)), _mm_setzero_si128());
 				}
 
 				blockPosY.W += gradientY.W;
@@ -585,12 +704,7 @@ private:
 				int32_t posU = (int32_t)(blockPosY.U * rcpW);
 				int32_t posV = (int32_t)(blockPosY.V * rcpW);
 
-				fixed_t lightpos = FRACUNIT - (fixed_t)(clamp(shade - MIN(24.0f / 32.0f, globVis * blockPosY.W), 0.0f, 31.0f / 32.0f) * (float)FRACUNIT);
-				lightpos = (lightpos & lightmask) | ((light << 8) & ~lightmask);
-
-				__m128 mrcpW = _mm_set1_ps(1.0f / blockPosY.W);
-				__m128 worldpos = _mm_mul_ps(_mm_loadu_ps(&blockPosY.WorldX), mrcpW);
-				__m128i dynlight = CalcDynamicLight(lights, num_lights, worldpos, worldnormal, dynlightcolor);
+				fixed_t lightpos = LightPos<LightModeT>(blockPosY.W, shade, globVis, light, lightmask);
 
 				ScreenTriangleStepVariables blockPosX = blockPosY;
 				blockPosX.W += gradientX.W;
@@ -606,16 +720,10 @@ private:
 				int32_t stepU = (nextU - posU) / 8;
 				int32_t stepV = (nextV - posV) / 8;
 
-				fixed_t lightnext = FRACUNIT - (fixed_t)(clamp(shade - MIN(24.0f / 32.0f, globVis * blockPosX.W), 0.0f, 31.0f / 32.0f) * (float)FRACUNIT);
-				fixed_t lightstep = (lightnext - lightpos) / 8;
-				lightstep = lightstep & lightmask;
+				fixed_t lightstep = LightStep<LightModeT>(lightpos, blockPosX.W, shade, globVis, lightmask);
 
-				mrcpW = _mm_set1_ps(1.0f / blockPosX.W);
-				worldpos = _mm_mul_ps(_mm_loadu_ps(&blockPosX.WorldX), mrcpW);
-				__m128i dynlightnext = CalcDynamicLight(lights, num_lights, worldpos, worldnormal, dynlightcolor);
-				__m128i dynlightstep = _mm_srai_epi16(_mm_sub_epi16(dynlightnext, dynlight), 3);
-				dynlight = _mm_max_epi16(_mm_min_epi16(_mm_add_epi16(dynlight, _mm_and_si128(dynlightstep, _mm_set_epi32(0xffff, 0xffff, 0, 0))), _mm_set1_epi16(256)), _mm_setzero_si128());
-				dynlightstep = _mm_slli_epi16(dynlightstep, 1);
+				__m128i dynlight, dynlightstep;
+				RowDynLight<DynLightModeT>(blockPosY, blockPosX, lights, num_lights, worldnormal, dynlightcolor, constantlight, dynlight, dynlightstep);
 
 				for (int x = 0; x < 4; x++)
 				{
@@ -673,7 +781,8 @@ private:
 					if (mask0 & (1 << 31)) dest[x * 2] = desttmp[0];
 					if (mask0 & (1 << 30)) dest[x * 2 + 1] = desttmp[1];
 
-					dynlight = _mm_max_epi16(_mm_min_epi16(_mm_add_epi16(dynlight, dynlightstep), _mm_set1_epi16(256)), _mm_setzero_si128());
+					if (DynLightModeT::Mode != (int)DynLightModes::None)
+						dynlight = _mm_max_epi16(_mm_min_epi16(_mm_add_epi16(dynlight, dynlightstep), _mm_set1_epi16(256)), _mm_setzero_si128());
 
 					mask0 <<= 2;
 				}
@@ -695,12 +804,7 @@ private:
 				int32_t posU = (int32_t)(blockPosY.U * rcpW);
 				int32_t posV = (int32_t)(blockPosY.V * rcpW);
 
-				fixed_t lightpos = FRACUNIT - (fixed_t)(clamp(shade - MIN(24.0f / 32.0f, globVis * blockPosY.W), 0.0f, 31.0f / 32.0f) * (float)FRACUNIT);
-				lightpos = (lightpos & lightmask) | ((light << 8) & ~lightmask);
-
-				__m128 mrcpW = _mm_set1_ps(1.0f / blockPosY.W);
-				__m128 worldpos = _mm_mul_ps(_mm_loadu_ps(&blockPosY.WorldX), mrcpW);
-				__m128i dynlight = CalcDynamicLight(lights, num_lights, worldpos, worldnormal, dynlightcolor);
+				fixed_t lightpos = LightPos<LightModeT>(blockPosY.W, shade, globVis, light, lightmask);
 
 				ScreenTriangleStepVariables blockPosX = blockPosY;
 				blockPosX.W += gradientX.W;
@@ -716,16 +820,10 @@ private:
 				int32_t stepU = (nextU - posU) / 8;
 				int32_t stepV = (nextV - posV) / 8;
 
-				fixed_t lightnext = FRACUNIT - (fixed_t)(clamp(shade - MIN(24.0f / 32.0f, globVis * blockPosX.W), 0.0f, 31.0f / 32.0f) * (float)FRACUNIT);
-				fixed_t lightstep = (lightnext - lightpos) / 8;
-				lightstep = lightstep & lightmask;
+				fixed_t lightstep = LightStep<LightModeT>(lightpos, blockPosX.W, shade, globVis, lightmask);
 
-				mrcpW = _mm_set1_ps(1.0f / blockPosX.W);
-				worldpos = _mm_mul_ps(_mm_loadu_ps(&blockPosX.WorldX), mrcpW);
-				__m128i dynlightnext = CalcDynamicLight(lights, num_lights, worldpos, worldnormal, dynlightcolor);
-				__m128i dynlightstep = _mm_srai_epi16(_mm_sub_epi16(dynlightnext, dynlight), 3);
-				dynlight = _mm_max_epi16(_mm_min_epi16(_mm_add_epi16(dynlight, _mm_and_si128(dynlightstep, _mm_set_epi32(0xffff, 0xffff, 0, 0))), _mm_set1_epi16(256)), _mm_setzero_si128());
-				dynlightstep = _mm_slli_epi16(dynlightstep, 1);
+				__m128i dynlight, dynlightstep;
+				RowDynLight<DynLightModeT>(blockPosY, blockPosX, lights, num_lights, worldnormal, dynlightcolor, constantlight, dynlight, dynlightstep);
 
 				for (int x = 0; x < 4; x++)
 				{
@@ -783,7 +881,8 @@ private:
 					if (mask1 & (1 << 31)) dest[x * 2] = desttmp[0];
 					if (mask1 & (1 << 30)) dest[x * 2 + 1] = desttmp[1];
 
-					dynlight = _mm_max_epi16(_mm_min_epi16(_mm_add_epi16(dynlight, dynlightstep), _mm_set1_epi16(256)), _mm_setzero_si128());
+					if (DynLightModeT::Mode != (int)DynLightModes::None)
+						dynlight = _mm_max_epi16(_mm_min_epi16(_mm_add_epi16(dynlight, dynlightstep), _mm_set1_epi16(256)), _mm_setzero_si128());
 
 					mask1 <<= 2;
 				}
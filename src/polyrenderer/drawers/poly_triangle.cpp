@@ -116,6 +116,8 @@ void PolyTriangleThreadData::DrawElements(const PolyDrawArgs &drawargs)
 	args.stencilValues = PolyStencilBuffer::Instance()->Values();
 	args.stencilMasks = PolyStencilBuffer::Instance()->Masks();
 	args.zbuffer = PolyZBuffer::Instance()->Values();
+	args.zbufferMin = PolyZBuffer::Instance()->BlockMin();
+	args.zbufferMax = PolyZBuffer::Instance()->BlockMax();
 
 	bool ccw = !mirror;
 	const TriVertex *vinput = drawargs.Vertices();
@@ -174,6 +176,8 @@ void PolyTriangleThreadData::DrawArrays(const PolyDrawArgs &drawargs)
 	args.stencilValues = PolyStencilBuffer::Instance()->Values();
 	args.stencilMasks = PolyStencilBuffer::Instance()->Masks();
 	args.zbuffer = PolyZBuffer::Instance()->Values();
+	args.zbufferMin = PolyZBuffer::Instance()->BlockMin();
+	args.zbufferMax = PolyZBuffer::Instance()->BlockMax();
 
 	bool ccw = !mirror;
 	const TriVertex *vinput = drawargs.Vertices();
@@ -21,6 +21,8 @@
 */
 
 #include <stddef.h>
+#include <float.h>
+#include <vector>
 #include "templates.h"
 #include "doomdef.h"
 #include "i_system.h"
@@ -43,6 +45,10 @@
 #endif
 #include "poly_drawer8.h"
 #include "x86.h"
+#include "c_dispatch.h"
+#include "stats.h"
+#include <zlib.h>
+#include "swrenderer/r_swcolormaps.h"
 
 class TriangleBlock
 {
@@ -90,6 +96,8 @@ private:
 
 	// Depth buffer
 	float * RESTRICT zbuffer;
+	float * RESTRICT zbufferMin;
+	float * RESTRICT zbufferMax;
 	int32_t zbufferPitch;
 
 	// Triangle bounding block
@@ -129,6 +137,15 @@ private:
 	};
 	CoverageResult AreaCoverageTest(int x0, int y0, int x1, int y1);
 
+	enum class BlockDepthResult
+	{
+		hidden,
+		visible,
+		partial
+	};
+	BlockDepthResult BlockDepthTest(const TriDrawTriangleArgs *args);
+	void UpdateBlockDepthRange();
+
 	void CoverageTest();
 	void StencilEqualTest();
 	void StencilGreaterEqualTest();
@@ -154,6 +171,8 @@ TriangleBlock::TriangleBlock(const TriDrawTriangleArgs *args, PolyTriangleThread
 	stencilWriteValue = args->uniforms->StencilWriteValue();
 
 	zbuffer = args->zbuffer;
+	zbufferMin = args->zbufferMin;
+	zbufferMax = args->zbufferMax;
 	zbufferPitch = args->stencilPitch;
 
 	// 28.4 fixed-point coordinates
@@ -306,8 +325,7 @@ void TriangleBlock::RenderBlock(int x0, int y0, int x1, int y1)
 	bool writeStencil = args->uniforms->WriteStencil();
 	bool writeDepth = args->uniforms->WriteDepth();
 
-	int bmode = (int)args->uniforms->BlendMode();
-	auto drawFunc = args->destBgra ? ScreenTriangle::TriDrawers32[bmode] : ScreenTriangle::TriDrawers8[bmode];
+	TriDrawerFunc drawFunc = ScreenTriangle::GetTriDrawer(args);
 
 	// Loop through blocks
 	for (int y = start_miny; y < y1; y += q * num_cores)
@@ -342,13 +360,21 @@ void TriangleBlock::RenderBlock(int x0, int y0, int x1, int y1)
 			}
 			else
 			{
-				StencilGreaterEqualTest();
-				if (Mask0 == 0 && Mask1 == 0)
+				// Trivial reject or accept using the depth range of the block
+				BlockDepthResult depthResult = BlockDepthTest(args);
+				if (depthResult == BlockDepthResult::hidden)
 					continue;
 
-				DepthTest(args);
+				StencilGreaterEqualTest();
 				if (Mask0 == 0 && Mask1 == 0)
 					continue;
+
+				if (depthResult == BlockDepthResult::partial)
+				{
+					DepthTest(args);
+					if (Mask0 == 0 && Mask1 == 0)
+						continue;
+				}
 			}
 
 			if (writeColor)
@@ -356,7 +382,10 @@ void TriangleBlock::RenderBlock(int x0, int y0, int x1, int y1)
 			if (writeStencil)
 				StencilWrite();
 			if (writeDepth)
+			{
 				DepthWrite(args);
+				UpdateBlockDepthRange();
+			}
 		}
 	}
 }
@@ -463,6 +492,67 @@ void TriangleBlock::DepthTest(const TriDrawTriangleArgs *args)
 
 #endif
 
+TriangleBlock::BlockDepthResult TriangleBlock::BlockDepthTest(const TriDrawTriangleArgs *args)
+{
+	int block = (X >> 3) + (Y >> 3) * zbufferPitch;
+
+	const ShadedTriVertex &v1 = *args->v1;
+
+	float stepXW = args->gradientX.W;
+	float stepYW = args->gradientY.W;
+	float posYW = v1.w + stepXW * (X - v1.x) + stepYW * (Y - v1.y);
+
+	// The depth is linear in screen space, so the extremes are found at the block corners
+	float w0 = posYW;
+	float w1 = posYW + stepXW * 7.0f;
+	float w2 = posYW + stepYW * 7.0f;
+	float w3 = w1 + stepYW * 7.0f;
+	float minW = MIN(MIN(w0, w1), MIN(w2, w3));
+	float maxW = MAX(MAX(w0, w1), MAX(w2, w3));
+
+	// Leave a margin for the rounding differences to the incremental stepping in DepthTest
+	const float margin = 1.0f / 4096.0f;
+	if (maxW + fabs(maxW) * margin < zbufferMin[block])
+		return BlockDepthResult::hidden;
+	else if (minW - fabs(minW) * margin > zbufferMax[block])
+		return BlockDepthResult::visible;
+	else
+		return BlockDepthResult::partial;
+}
+
+void TriangleBlock::UpdateBlockDepthRange()
+{
+	int block = (X >> 3) + (Y >> 3) * zbufferPitch;
+	const float *depth = zbuffer + block * 64;
+
+#ifdef NO_SSE
+	float minval = depth[0];
+	float maxval = depth[0];
+	for (int i = 1; i < 64; i++)
+	{
+		minval = MIN(minval, depth[i]);
+		maxval = MAX(maxval, depth[i]);
+	}
+	zbufferMin[block] = minval;
+	zbufferMax[block] = maxval;
+#else
+	__m128 mmin = _mm_loadu_ps(depth);
+	__m128 mmax = mmin;
+	for (int i = 4; i < 64; i += 4)
+	{
+		__m128 values = _mm_loadu_ps(depth + i);
+		mmin = _mm_min_ps(mmin, values);
+		mmax = _mm_max_ps(mmax, values);
+	}
+	mmin = _mm_min_ps(mmin, _mm_shuffle_ps(mmin, mmin, _MM_SHUFFLE(1, 0, 3, 2)));
+	mmin = _mm_min_ps(mmin, _mm_shuffle_ps(mmin, mmin, _MM_SHUFFLE(2, 3, 0, 1)));
+	mmax = _mm_max_ps(mmax, _mm_shuffle_ps(mmax, mmax, _MM_SHUFFLE(1, 0, 3, 2)));
+	mmax = _mm_max_ps(mmax, _mm_shuffle_ps(mmax, mmax, _MM_SHUFFLE(2, 3, 0, 1)));
+	_mm_store_ss(zbufferMin + block, mmin);
+	_mm_store_ss(zbufferMax + block, mmax);
+#endif
+}
+
 void TriangleBlock::ClipTest()
 {
 	static const uint32_t clipxmask[8] =
@@ -1073,6 +1163,19 @@ void TriangleBlock::DepthWrite(const TriDrawTriangleArgs *args)
 
 EXTERN_CVAR(Bool, r_polyrenderer)
 
+CVAR(Bool, r_polypermutations, true, 0)
+
+TriDrawerFunc ScreenTriangle::GetTriDrawer(const TriDrawTriangleArgs *args)
+{
+	int bmode = (int)args->uniforms->BlendMode();
+	if (!args->destBgra)
+		return TriDrawers8[bmode];
+	else if (r_polypermutations)
+		return TriDrawerSelectors32[bmode](args);
+	else
+		return TriDrawers32[bmode];
+}
+
 void ScreenTriangle::Draw(const TriDrawTriangleArgs *args, PolyTriangleThreadData *thread)
 {
 	if (r_polyrenderer)
@@ -1568,6 +1671,34 @@ void(*ScreenTriangle::TriDrawers32[])(int, int, uint32_t, uint32_t, const TriDra
 	&TriScreenDrawer32<TriScreenDrawerModes::OpaqueBlend, TriScreenDrawerModes::FogBoundarySampler>::Execute      // FogBoundary
 };
 
+TriDrawerFunc(*ScreenTriangle::TriDrawerSelectors32[])(const TriDrawTriangleArgs *) =
+{
+	&TriScreenDrawer32<TriScreenDrawerModes::OpaqueBlend, TriScreenDrawerModes::TextureSampler>::Select,         // TextureOpaque
+	&TriScreenDrawer32<TriScreenDrawerModes::MaskedBlend, TriScreenDrawerModes::TextureSampler>::Select,         // TextureMasked
+	&TriScreenDrawer32<TriScreenDrawerModes::AddClampBlend, TriScreenDrawerModes::TextureSampler>::Select,       // TextureAdd
+	&TriScreenDrawer32<TriScreenDrawerModes::SubClampBlend, TriScreenDrawerModes::TextureSampler>::Select,       // TextureSub
+	&TriScreenDrawer32<TriScreenDrawerModes::RevSubClampBlend, TriScreenDrawerModes::TextureSampler>::Select,    // TextureRevSub
+	&TriScreenDrawer32<TriScreenDrawerModes::AddSrcColorBlend, TriScreenDrawerModes::TextureSampler>::Select,    // TextureAddSrcColor
+	&TriScreenDrawer32<TriScreenDrawerModes::OpaqueBlend, TriScreenDrawerModes::TranslatedSampler>::Select,      // TranslatedOpaque
+	&TriScreenDrawer32<TriScreenDrawerModes::MaskedBlend, TriScreenDrawerModes::TranslatedSampler>::Select,      // TranslatedMasked
+	&TriScreenDrawer32<TriScreenDrawerModes::AddClampBlend, TriScreenDrawerModes::TranslatedSampler>::Select,    // TranslatedAdd
+	&TriScreenDrawer32<TriScreenDrawerModes::SubClampBlend, TriScreenDrawerModes::TranslatedSampler>::Select,    // TranslatedSub
+	&TriScreenDrawer32<TriScreenDrawerModes::RevSubClampBlend, TriScreenDrawerModes::TranslatedSampler>::Select, // TranslatedRevSub
+	&TriScreenDrawer32<TriScreenDrawerModes::AddSrcColorBlend, TriScreenDrawerModes::TranslatedSampler>::Select, // TranslatedAddSrcColor
+	&TriScreenDrawer32<TriScreenDrawerModes::ShadedBlend, TriScreenDrawerModes::ShadedSampler>::Select,          // Shaded
+	&TriScreenDrawer32<TriScreenDrawerModes::AddClampShadedBlend, TriScreenDrawerModes::ShadedSampler>::Select,  // AddShaded
+	&TriScreenDrawer32<TriScreenDrawerModes::ShadedBlend, TriScreenDrawerModes::StencilSampler>::Select,         // Stencil
+	&TriScreenDrawer32<TriScreenDrawerModes::AddClampShadedBlend, TriScreenDrawerModes::StencilSampler>::Select, // AddStencil
+	&TriScreenDrawer32<TriScreenDrawerModes::OpaqueBlend, TriScreenDrawerModes::FillSampler>::Select,            // FillOpaque
+	&TriScreenDrawer32<TriScreenDrawerModes::AddClampBlend, TriScreenDrawerModes::FillSampler>::Select,          // FillAdd
+	&TriScreenDrawer32<TriScreenDrawerModes::SubClampBlend, TriScreenDrawerModes::FillSampler>::Select,          // FillSub
+	&TriScreenDrawer32<TriScreenDrawerModes::RevSubClampBlend, TriScreenDrawerModes::FillSampler>::Select,       // FillRevSub
+	&TriScreenDrawer32<TriScreenDrawerModes::AddSrcColorBlend, TriScreenDrawerModes::FillSampler>::Select,       // FillAddSrcColor
+	&TriScreenDrawer32<TriScreenDrawerModes::OpaqueBlend, TriScreenDrawerModes::SkycapSampler>::Select,          // Skycap
+	&TriScreenDrawer32<TriScreenDrawerModes::ShadedBlend, TriScreenDrawerModes::FuzzSampler>::Select,            // Fuzz
+	&TriScreenDrawer32<TriScreenDrawerModes::OpaqueBlend, TriScreenDrawerModes::FogBoundarySampler>::Select      // FogBoundary
+};
+
 void(*ScreenTriangle::RectDrawers8[])(const void *, int, int, int, const RectDrawArgs *, PolyTriangleThreadData *) =
 {
 	&RectScreenDrawer8<TriScreenDrawerModes::OpaqueBlend, TriScreenDrawerModes::TextureSampler>::Execute,         // TextureOpaque
@@ -1625,3 +1756,204 @@ void(*ScreenTriangle::RectDrawers32[])(const void *, int, int, int, const RectDr
 };
 
 int ScreenTriangle::FuzzStart = 0;
+
+//==========================================================================
+//
+// Microbenchmark for the truecolor triangle drawers. A fixed triangle soup
+// is drawn through every blend mode and drawer option, once with the
+// generic drawers and once with the specialized permutations. Both must
+// produce the same pixels.
+//
+//==========================================================================
+
+CCMD(bench_polydrawers)
+{
+	static const char *blendmodenames[] =
+	{
+		"TextureOpaque", "TextureMasked", "TextureAdd", "TextureSub", "TextureRevSub", "TextureAddSrcColor",
+		"TranslatedOpaque", "TranslatedMasked", "TranslatedAdd", "TranslatedSub", "TranslatedRevSub", "TranslatedAddSrcColor",
+		"Shaded", "AddShaded", "Stencil", "AddStencil",
+		"FillOpaque", "FillAdd", "FillSub", "FillRevSub", "FillAddSrcColor",
+		"Skycap", "Fuzz", "FogBoundary"
+	};
+
+	enum
+	{
+		width = 512,
+		height = 512,
+		texsize = 64,
+		numtriangles = 256
+	};
+
+	int iterations = argv.argc() > 1 ? MAX(atoi(argv[1]), 1) : 10;
+
+	uint32_t seed = 1234567;
+	auto random = [&]() -> uint32_t { seed = seed * 1664525 + 1013904223; return seed >> 8; };
+	auto frandom = [&](float minval, float maxval) -> float { return minval + (maxval - minval) * (random() & 0xffff) / 65535.0f; };
+
+	// Textures with some fully transparent texels for the masked modes
+	std::vector<uint32_t> texture32(texsize * texsize);
+	std::vector<uint8_t> texture8(texsize * texsize);
+	uint32_t translation[256];
+	for (auto &texel : texture32)
+		texel = (random() & 7) ? (0xff000000 | random()) : 0;
+	for (auto &texel : texture8)
+		texel = (uint8_t)random();
+	for (auto &entry : translation)
+		entry = 0xff000000 | random();
+
+	// Triangle soup in screen space, all with the winding the rasterizer expects
+	std::vector<ShadedTriVertex> vertices(numtriangles * 3);
+	for (int i = 0; i < numtriangles; i++)
+	{
+		ShadedTriVertex *v = &vertices[i * 3];
+		float cx = frandom(0.0f, (float)width);
+		float cy = frandom(0.0f, (float)height);
+		for (int j = 0; j < 3; j++)
+		{
+			v[j] = ShadedTriVertex();
+			v[j].x = cx + frandom(-96.0f, 96.0f);
+			v[j].y = cy + frandom(-96.0f, 96.0f);
+			v[j].w = frandom(1.0f / 1024.0f, 1.0f / 32.0f);
+			v[j].u = frandom(0.0f, 4.0f);
+			v[j].v = frandom(0.0f, 4.0f);
+			v[j].worldX = frandom(-256.0f, 256.0f);
+			v[j].worldY = frandom(-256.0f, 256.0f);
+			v[j].worldZ = frandom(0.0f, 128.0f);
+		}
+		float area = v[0].x * v[1].y - v[1].x * v[0].y + v[1].x * v[2].y - v[2].x * v[1].y + v[2].x * v[0].y - v[0].x * v[2].y;
+		if (area > 0.0f)
+			std::swap(v[1], v[2]);
+	}
+
+	// Block layout buffers. The stencil buffer is a uniform 0 so every covered pixel gets drawn.
+	int blockcount = (width / 8) * (height / 8);
+	std::vector<uint32_t> dest(width * height);
+	std::vector<uint8_t> stencilValues(blockcount * 64);
+	std::vector<uint32_t> stencilMasks(blockcount, 0xffffff00);
+	std::vector<float> zbuffer(blockcount * 64);
+	std::vector<float> zbufferMin(blockcount, -FLT_MAX);
+	std::vector<float> zbufferMax(blockcount, FLT_MAX);
+
+	PolyLight light;
+	light.color = 0xffc08040;
+	light.x = 0.0f;
+	light.y = 0.0f;
+	light.z = 64.0f;
+	light.radius = 256.0f / 300.0f;
+
+	FDynamicColormap *advancedColormap = GetSpecialLights(PalEntry(255, 255, 224, 192), PalEntry(0, 32, 32, 48), 0);
+
+	PolyTriangleThreadData thread(0, 1);
+	bool savedPermutations = r_polypermutations;
+
+	double totalGeneric = 0.0, totalSpecialized = 0.0;
+	int mismatches = 0;
+
+	for (int bmode = 0; bmode <= (int)TriBlendMode::FogBoundary; bmode++)
+	{
+		// The fuzz sampler scales by the view height
+		if (bmode == (int)TriBlendMode::Fuzz && viewheight <= 0)
+			continue;
+
+		bool texturesampler = bmode <= (int)TriBlendMode::TextureAddSrcColor;
+		bool palettesampler = (bmode >= (int)TriBlendMode::TranslatedOpaque && bmode <= (int)TriBlendMode::AddShaded);
+
+		double modeGeneric = 0.0, modeSpecialized = 0.0;
+		int permutations = 0;
+
+		for (int options = 0; options < 16; options++)
+		{
+			bool simpleshade = (options & 1) != 0;
+			bool nearestfilter = (options & 2) != 0;
+			bool fixedlight = (options & 4) != 0;
+			bool dynlights = (options & 8) != 0;
+
+			// Only the texture sampler can filter
+			if (!texturesampler && !nearestfilter)
+				continue;
+
+			PolyDrawArgs drawargs;
+			drawargs.SetStyle((TriBlendMode)bmode, 0.75, 0.5);
+			if (palettesampler)
+				drawargs.SetTexture(texture8.data(), texsize, texsize);
+			else
+				drawargs.SetTexture((const uint8_t *)texture32.data(), texsize, texsize);
+			drawargs.SetTranslation((const uint8_t *)translation);
+			drawargs.SetLight(simpleshade ? &NormalLight : advancedColormap, 160, 256.0, fixedlight);
+			drawargs.SetNearestFilter(nearestfilter);
+			drawargs.SetLights(dynlights ? &light : nullptr, dynlights ? 1 : 0);
+			drawargs.SetDynLightColor(dynlights ? 0x00101010 : 0);
+			drawargs.SetNormal(FVector3(0.0f, 0.0f, 1.0f));
+			drawargs.SetDepthTest(false);
+			drawargs.SetWriteDepth(false);
+			drawargs.SetWriteStencil(false);
+			drawargs.SetStencilTestValue(0);
+
+			TriDrawTriangleArgs args;
+			args.dest = (uint8_t *)dest.data();
+			args.pitch = width;
+			args.clipright = width;
+			args.clipbottom = height;
+			args.stencilValues = stencilValues.data();
+			args.stencilMasks = stencilMasks.data();
+			args.stencilPitch = width / 8;
+			args.zbuffer = zbuffer.data();
+			args.zbufferMin = zbufferMin.data();
+			args.zbufferMax = zbufferMax.data();
+			args.uniforms = &drawargs;
+			args.destBgra = true;
+
+			uint32_t checksums[2];
+			double times[2];
+			for (int pass = 0; pass < 2; pass++)
+			{
+				r_polypermutations = (pass == 1);
+
+				for (int i = 0; i < width * height; i++)
+					dest[i] = 0xff000000 | (i * 0x010203);
+
+				cycle_t timer;
+				timer.Reset();
+				timer.Clock();
+				for (int it = 0; it < iterations; it++)
+				{
+					for (int i = 0; i < numtriangles; i++)
+					{
+						args.v1 = &vertices[i * 3];
+						args.v2 = &vertices[i * 3 + 1];
+						args.v3 = &vertices[i * 3 + 2];
+						if (args.CalculateGradients())
+						{
+							TriangleBlock block(&args, &thread);
+							block.Render();
+						}
+					}
+				}
+				timer.Unclock();
+
+				times[pass] = timer.TimeMS();
+				checksums[pass] = crc32(0, (const uint8_t *)dest.data(), width * height * 4);
+			}
+
+			if (checksums[0] != checksums[1])
+			{
+				Printf("%s (%s shade, %s filter, %s light, %s): output differs\n", blendmodenames[bmode],
+					simpleshade ? "simple" : "advanced", nearestfilter ? "nearest" : "linear", fixedlight ? "fixed" : "diminishing", dynlights ? "dynlights" : "no dynlights");
+				mismatches++;
+			}
+
+			modeGeneric += times[0];
+			modeSpecialized += times[1];
+			permutations++;
+		}
+
+		Printf("%-22s generic %8.2f ms, specialized %8.2f ms (%d permutations)\n", blendmodenames[bmode], modeGeneric, modeSpecialized, permutations);
+		totalGeneric += modeGeneric;
+		totalSpecialized += modeSpecialized;
+	}
+
+	r_polypermutations = savedPermutations;
+
+	Printf("Total: generic %.2f ms, specialized %.2f ms, %d mismatches\n", totalGeneric, totalSpecialized, mismatches);
+}
@@ -56,6 +56,8 @@ struct TriDrawTriangleArgs
 	uint32_t *stencilMasks;
 	int32_t stencilPitch;
 	float *zbuffer;
+	float *zbufferMin;
+	float *zbufferMax;
 	const PolyDrawArgs *uniforms;
 	bool destBgra;
 	ScreenTriangleStepVariables gradientX;
@@ -133,16 +135,20 @@ enum class TriBlendMode
 	FogBoundary
 };
 
+typedef void(*TriDrawerFunc)(int, int, uint32_t, uint32_t, const TriDrawTriangleArgs *);
+
 class ScreenTriangle
 {
 public:
 	static void Draw(const TriDrawTriangleArgs *args, PolyTriangleThreadData *thread);
+	static TriDrawerFunc GetTriDrawer(const TriDrawTriangleArgs *args);
 	static void DrawSWRender(const TriDrawTriangleArgs *args, PolyTriangleThreadData *thread);
 	static void DrawSpan8(int y, int x0, int x1, const TriDrawTriangleArgs *args);
 	static void DrawSpan32(int y, int x0, int x1, const TriDrawTriangleArgs *args);
 
 	static void(*TriDrawers8[])(int, int, uint32_t, uint32_t, const TriDrawTriangleArgs *);
 	static void(*TriDrawers32[])(int, int, uint32_t, uint32_t, const TriDrawTriangleArgs *);
+	static TriDrawerFunc(*TriDrawerSelectors32[])(const TriDrawTriangleArgs *);
 	static void(*RectDrawers8[])(const void *, int, int, int, const RectDrawArgs *, PolyTriangleThreadData *);
 	static void(*RectDrawers32[])(const void *, int, int, int, const RectDrawArgs *, PolyTriangleThreadData *);
 
@@ -170,6 +176,15 @@ namespace TriScreenDrawerModes
 	struct SimpleShade { static const int Mode = (int)ShadeMode::Simple; };
 	struct AdvancedShade { static const int Mode = (int)ShadeMode::Advanced; };
 
+	enum class LightModes { Runtime, Diminishing, Fixed };
+	struct RuntimeLight { static const int Mode = (int)LightModes::Runtime; };
+	struct DiminishingLight { static const int Mode = (int)LightModes::Diminishing; };
+	struct FixedLight { static const int Mode = (int)LightModes::Fixed; };
+
+	enum class DynLightModes { Dynamic, None };
+	struct DynamicLights { static const int Mode = (int)DynLightModes::Dynamic; };
+	struct NoDynLights { static const int Mode = (int)DynLightModes::None; };
+
 	enum class Samplers { Texture, Fill, Shaded, Stencil, Translated, Skycap, Fuzz, FogBoundary };
 	struct TextureSampler { static const int Mode = (int)Samplers::Texture; };
 	struct FillSampler { static const int Mode = (int)Samplers::Fill; };
@@ -34,6 +34,7 @@
 #include "g_levellocals.h"
 #include "p_effect.h"
 #include "polyrenderer/scene/poly_light.h"
+#include "polyrenderer/scene/poly_plane.h"
 #include "polyrenderer/hardpoly/hardpolyrenderer.h"
 #include "swrenderer/scene/r_scene.h"
 #include "swrenderer/drawers/r_draw_rgba.h"
@@ -124,7 +125,9 @@ void PolyRenderer::RenderViewToCanvas(AActor *actor, DCanvas *canvas, int x, int
 	
 	RenderActorView(actor, dontmaplines);
 	Threads.MainThread()->FlushDrawQueue();
+	PolyDrawerWaitCycles.Clock();
 	DrawerThreads::WaitForWorkers();
+	PolyDrawerWaitCycles.Unclock();
 	
 	RenderTarget = screen;
 	R_ExecuteSetViewSize(Viewpoint, Viewwindow);
@@ -151,6 +154,7 @@ void PolyRenderer::RenderActorView(AActor *actor, bool dontmaplines)
 	R_SetupFrame(Viewpoint, Viewwindow, actor);
 	P_FindParticleSubsectors();
 	PO_LinkToSubsectors();
+	PolyPlaneVertexCache::Instance()->BeginFrame();
 
 	swrenderer::R_UpdateFuzzPosFrameStart();
 
@@ -113,6 +113,12 @@ void PolyRenderThread::PreparePolyObject(subsector_t *sub)
 	}
 }
 
+std::mutex &PolyRenderThread::PortalMutex()
+{
+	static std::mutex portalmutex;
+	return portalmutex;
+}
+
 /////////////////////////////////////////////////////////////////////////////
 
 PolyRenderThreads::PolyRenderThreads()
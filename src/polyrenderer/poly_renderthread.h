@@ -24,6 +24,7 @@
 
 #include <memory>
 #include <thread>
+#include <mutex>
 #include "swrenderer/r_memory.h"
 #include "polyrenderer/hardpoly/hardpolyrenderer.h"
 
@@ -61,6 +62,9 @@ public:
 	// Setup poly object in a threadsafe manner
 	void PreparePolyObject(subsector_t *sub);
 
+	// Portals are shared by all threads. Lock this while finding, adding or extending one.
+	static std::mutex &PortalMutex();
+
 private:
 	std::thread thread;
 	std::vector<DrawerCommandQueuePtr> UsedDrawQueues;
@@ -71,7 +71,7 @@ void RenderPolyPlane::RenderNormal(PolyRenderThread *thread, const PolyClipPlane
 			return;
 
 		PolyPlaneUVTransform transform = PolyPlaneUVTransform(ceiling ? fakeflat.FrontSector->planes[sector_t::ceiling].xform : fakeflat.FrontSector->planes[sector_t::floor].xform, tex);
-		TriVertex *vertices = CreatePlaneVertices(thread, fakeflat.Subsector, transform, ceiling ? fakeflat.FrontSector->ceilingplane : fakeflat.FrontSector->floorplane);
+		TriVertex *vertices = PolyPlaneVertexCache::Instance()->GetVertices(thread, fakeflat.Subsector, transform, ceiling ? fakeflat.FrontSector->ceilingplane : fakeflat.FrontSector->floorplane, ceiling);
 
 		PolyDrawArgs args;
 		SetLightLevel(thread, args, fakeflat, ceiling);
@@ -113,6 +113,7 @@ void RenderPolyPlane::RenderPortal(PolyRenderThread *thread, const PolyClipPlane
 		return;
 	}
 
+	std::unique_lock<std::mutex> lock(PolyRenderThread::PortalMutex());
 	for (auto &p : sectorPortals)
 	{
 		if (p->Portal == portal) // To do: what other criteria do we need to check for?
@@ -126,6 +127,7 @@ void RenderPolyPlane::RenderPortal(PolyRenderThread *thread, const PolyClipPlane
 		sectorPortals.push_back(std::unique_ptr<PolyDrawSectorPortal>(new PolyDrawSectorPortal(portal, ceiling)));
 		polyportal = sectorPortals.back().get();
 	}
+	lock.unlock();
 
 #if 0
 	// Calculate portal clipping
@@ -164,6 +166,7 @@ void RenderPolyPlane::RenderPortal(PolyRenderThread *thread, const PolyClipPlane
 
 	RenderSkyWalls(thread, args, fakeflat.Subsector, polyportal, ceiling, skyHeight);
 
+	lock.lock();
 	polyportal->Shape.push_back({ vertices, (int)fakeflat.Subsector->numlines });
 }
 
@@ -242,6 +245,7 @@ void RenderPolyPlane::RenderSkyWalls(PolyRenderThread *thread, PolyDrawArgs &arg
 
 		if (polyportal)
 		{
+			std::unique_lock<std::mutex> lock(PolyRenderThread::PortalMutex());
 			polyportal->Shape.push_back({ wallvert, 4 });
 		}
 	}
@@ -333,18 +337,18 @@ void RenderPolyPlane::SetDynLights(PolyRenderThread *thread, PolyDrawArgs &args,
 	args.SetNormal({ (float)normal.X, (float)normal.Y, (float)normal.Z });
 }
 
-TriVertex *RenderPolyPlane::CreatePlaneVertices(PolyRenderThread *thread, subsector_t *sub, const PolyPlaneUVTransform &transform, const secplane_t &plane)
+
+TriVertex *RenderPolyPlane::CreateSkyPlaneVertices(PolyRenderThread *thread, subsector_t *sub, double skyHeight)
 {
 	TriVertex *vertices = thread->FrameMemory->AllocMemory<TriVertex>(sub->numlines);
 
 	const auto &viewpoint = PolyRenderer::Instance()->Viewpoint;
-	double planeZ = plane.ZatPoint(viewpoint.Pos.XY());
-	if (viewpoint.Pos.Z < planeZ)
+	if (viewpoint.Pos.Z < skyHeight)
 	{
 		for (uint32_t i = 0; i < sub->numlines; i++)
 		{
 			seg_t *line = &sub->firstline[sub->numlines - 1 - i];
-			vertices[i] = transform.GetVertex(line->v1, plane.ZatPoint(line->v1));
+			vertices[i] = GetSkyVertex(line->v1, skyHeight);
 		}
 	}
 	else
@@ -352,24 +356,89 @@ TriVertex *RenderPolyPlane::CreatePlaneVertices(PolyRenderThread *thread, subsec
 		for (uint32_t i = 0; i < sub->numlines; i++)
 		{
 			seg_t *line = &sub->firstline[i];
-			vertices[i] = transform.GetVertex(line->v1, plane.ZatPoint(line->v1));
+			vertices[i] = GetSkyVertex(line->v1, skyHeight);
 		}
 	}
 
 	return vertices;
 }
 
-TriVertex *RenderPolyPlane::CreateSkyPlaneVertices(PolyRenderThread *thread, subsector_t *sub, double skyHeight)
+/////////////////////////////////////////////////////////////////////////////
+
+PolyPlaneVertexCache *PolyPlaneVertexCache::Instance()
 {
-	TriVertex *vertices = thread->FrameMemory->AllocMemory<TriVertex>(sub->numlines);
+	static PolyPlaneVertexCache cache;
+	return &cache;
+}
 
+void PolyPlaneVertexCache::Clear()
+{
+	Entries.clear();
+	Entries.shrink_to_fit();
+}
+
+void PolyPlaneVertexCache::BeginFrame()
+{
+	FrameNumber++;
+	if (Entries.size() != level.subsectors.Size() * 2)
+	{
+		Entries.clear();
+		Entries.resize(level.subsectors.Size() * 2);
+	}
+}
+
+TriVertex *PolyPlaneVertexCache::GetVertices(PolyRenderThread *thread, subsector_t *sub, const PolyPlaneUVTransform &transform, const secplane_t &plane, bool ceiling)
+{
 	const auto &viewpoint = PolyRenderer::Instance()->Viewpoint;
-	if (viewpoint.Pos.Z < skyHeight)
+	bool reverse = viewpoint.Pos.Z < plane.ZatPoint(viewpoint.Pos.XY());
+
+	// Poly object BSP subsectors are not part of the level arrays and never cached
+	unsigned int index = sub->Index() * 2 + (ceiling ? 1 : 0);
+	if (index >= Entries.size() || &level.subsectors[sub->Index()] != sub)
+	{
+		TriVertex *vertices = thread->FrameMemory->AllocMemory<TriVertex>(sub->numlines);
+		CreateVertices(vertices, sub, transform, plane, reverse);
+		return vertices;
+	}
+
+	Entry &entry = Entries[index];
+	if (!entry.Checked)
+	{
+		entry.Static = IsStatic(sub);
+		entry.Checked = true;
+	}
+
+	if (!entry.Valid || entry.Plane != plane || !(entry.Transform == transform))
+	{
+		// Keep the vertices already used by this frame's draw queues (fake flats or portals seeing the
+		// subsector differently) and the ones whose segs are moved around by poly objects
+		if (entry.FrameNumber == FrameNumber || !entry.Static)
+		{
+			TriVertex *vertices = thread->FrameMemory->AllocMemory<TriVertex>(sub->numlines);
+			CreateVertices(vertices, sub, transform, plane, reverse);
+			return vertices;
+		}
+
+		entry.Vertices.resize(sub->numlines * 2);
+		CreateVertices(entry.Vertices.data(), sub, transform, plane, false);
+		CreateVertices(entry.Vertices.data() + sub->numlines, sub, transform, plane, true);
+		entry.Plane = plane;
+		entry.Transform = transform;
+		entry.Valid = true;
+	}
+
+	entry.FrameNumber = FrameNumber;
+	return entry.Vertices.data() + (reverse ? sub->numlines : 0);
+}
+
+void PolyPlaneVertexCache::CreateVertices(TriVertex *vertices, subsector_t *sub, const PolyPlaneUVTransform &transform, const secplane_t &plane, bool reverse)
+{
+	if (reverse)
 	{
 		for (uint32_t i = 0; i < sub->numlines; i++)
 		{
 			seg_t *line = &sub->firstline[sub->numlines - 1 - i];
-			vertices[i] = GetSkyVertex(line->v1, skyHeight);
+			vertices[i] = transform.GetVertex(line->v1, plane.ZatPoint(line->v1));
 		}
 	}
 	else
@@ -377,11 +446,20 @@ TriVertex *RenderPolyPlane::CreateSkyPlaneVertices(PolyRenderThread *thread, sub
 		for (uint32_t i = 0; i < sub->numlines; i++)
 		{
 			seg_t *line = &sub->firstline[i];
-			vertices[i] = GetSkyVertex(line->v1, skyHeight);
+			vertices[i] = transform.GetVertex(line->v1, plane.ZatPoint(line->v1));
 		}
 	}
+}
 
-	return vertices;
+bool PolyPlaneVertexCache::IsStatic(subsector_t *sub)
+{
+	for (uint32_t i = 0; i < sub->numlines; i++)
+	{
+		side_t *side = sub->firstline[i].sidedef;
+		if (side && (side->Flags & WALLF_POLYOBJ))
+			return false;
+	}
+	return true;
 }
 
 /////////////////////////////////////////////////////////////////////////////
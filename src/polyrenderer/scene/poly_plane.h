@@ -29,8 +29,14 @@ class PolyDrawSectorPortal;
 class PolyPlaneUVTransform
 {
 public:
+	PolyPlaneUVTransform() { }
 	PolyPlaneUVTransform(const FTransform &transform, FTexture *tex);
 
+	bool operator==(const PolyPlaneUVTransform &other) const
+	{
+		return xscale == other.xscale && yscale == other.yscale && cosine == other.cosine && sine == other.sine && xOffs == other.xOffs && yOffs == other.yOffs;
+	}
+
 	TriVertex GetVertex(vertex_t *v1, double height) const
 	{
 		TriVertex v;
@@ -47,11 +53,45 @@ private:
 	float GetU(float x, float y) const { return (xOffs + x * cosine - y * sine) * xscale; }
 	float GetV(float x, float y) const { return (yOffs - x * sine - y * cosine) * yscale; }
 
-	float xscale;
-	float yscale;
-	float cosine;
-	float sine;
-	float xOffs, yOffs;
+	float xscale = 1.0f / 64.0f;
+	float yscale = 1.0f / 64.0f;
+	float cosine = 1.0f;
+	float sine = 0.0f;
+	float xOffs = 0.0f, yOffs = 0.0f;
+};
+
+// Floor and ceiling vertices for each subsector, kept between frames.
+//
+// An entry is only rebuilt when the plane or its texture transform no longer matches
+// what it was built from. Vertices already handed to the drawers stay untouched until
+// the next frame: a mismatch within the same frame gets frame memory instead.
+class PolyPlaneVertexCache
+{
+public:
+	static PolyPlaneVertexCache *Instance();
+
+	void Clear();
+	void BeginFrame();
+
+	TriVertex *GetVertices(PolyRenderThread *thread, subsector_t *sub, const PolyPlaneUVTransform &transform, const secplane_t &plane, bool ceiling);
+
+private:
+	struct Entry
+	{
+		std::vector<TriVertex> Vertices; // Front facing order followed by the reversed order
+		secplane_t Plane;
+		PolyPlaneUVTransform Transform;
+		int FrameNumber = -1;
+		bool Valid = false;
+		bool Checked = false;
+		bool Static = false;
+	};
+
+	static void CreateVertices(TriVertex *vertices, subsector_t *sub, const PolyPlaneUVTransform &transform, const secplane_t &plane, bool reverse);
+	static bool IsStatic(subsector_t *sub);
+
+	std::vector<Entry> Entries;
+	int FrameNumber = 0;
 };
 
 class RenderPolyPlane
@@ -70,7 +110,6 @@ private:
 	void SetLightLevel(PolyRenderThread *thread, PolyDrawArgs &args, const PolyTransferHeights &fakeflat, bool ceiling);
 	void SetDynLights(PolyRenderThread *thread, PolyDrawArgs &args, subsector_t *sub, bool ceiling);
 
-	TriVertex *CreatePlaneVertices(PolyRenderThread *thread, subsector_t *sub, const PolyPlaneUVTransform &transform, const secplane_t &plane);
 	TriVertex *CreateSkyPlaneVertices(PolyRenderThread *thread, subsector_t *sub, double skyHeight);
 
 	static TriVertex GetSkyVertex(vertex_t *v, double height) { return { (float)v->fX(), (float)v->fY(), (float)height, 1.0f, 0.0f, 0.0f }; }
@@ -62,21 +62,7 @@ void RenderPolyScene::Render(PolyPortalViewpoint *viewpoint)
 	PolyCullCycles.Unclock();
 
 	RenderSectors();
-
-	PolyMaskedCycles.Clock();
-	const auto &rviewpoint = PolyRenderer::Instance()->Viewpoint;
-	for (sector_t *sector : Cull.SeenSectors)
-	{
-		for (AActor *thing = sector->thinglist; thing != nullptr; thing = thing->snext)
-		{
-			DVector2 left, right;
-			if (!RenderPolySprite::GetLine(thing, left, right))
-				continue;
-			double distanceSquared = (thing->Pos() - rviewpoint.Pos).LengthSquared();
-			AddSprite(thread, thing, distanceSquared, left, right);
-		}
-	}
-	PolyMaskedCycles.Unclock();
+	RenderSprites();
 
 	CurrentViewpoint->ObjectsEnd = thread->TranslucentObjects.size();
 	CurrentViewpoint->SectorPortalsEnd = thread->SectorPortals.size();
@@ -111,10 +97,11 @@ void RenderPolyScene::RenderSectors()
 		if (thread != mainthread)
 		{
 			thread->TranslucentObjects.clear();
-			thread->SectorPortals.clear();
-			thread->LinePortals.clear();
 		}
 
+		// Each thread sets up a front to back slice of the visible subsectors into its own draw queue.
+		// The queues are executed in thread order and the translucent objects collected in thread order,
+		// which gives the same result as a single threaded walk.
 		int start = thread->Start;
 		int end = thread->End;
 		for (int i = start; i < end; i++)
@@ -130,8 +117,50 @@ void RenderPolyScene::RenderSectors()
 	PolyOpaqueCycles.Unclock();
 }
 
+void RenderPolyScene::RenderSprites()
+{
+	PolyRenderThread *mainthread = PolyRenderer::Instance()->Threads.MainThread();
+
+	int totalcount = (int)Cull.SeenSectors.size();
+	auto sectors = Cull.SeenSectors.data();
+
+	PolyMaskedCycles.Clock();
+
+	PolyRenderer::Instance()->Threads.RenderThreadSlices(totalcount, [&](PolyRenderThread *thread)
+	{
+		if (thread != mainthread)
+		{
+			thread->TranslucentObjects.clear();
+		}
+
+		const auto &viewpoint = PolyRenderer::Instance()->Viewpoint;
+		int start = thread->Start;
+		int end = thread->End;
+		for (int i = start; i < end; i++)
+		{
+			for (AActor *thing = sectors[i]->thinglist; thing != nullptr; thing = thing->snext)
+			{
+				DVector2 left, right;
+				if (!RenderPolySprite::GetLine(thing, left, right))
+					continue;
+				double distanceSquared = (thing->Pos() - viewpoint.Pos).LengthSquared();
+				AddSprite(thread, thing, distanceSquared, left, right);
+			}
+		}
+	}, [&](PolyRenderThread *thread)
+	{
+		const auto &objects = thread->TranslucentObjects;
+		mainthread->TranslucentObjects.insert(mainthread->TranslucentObjects.end(), objects.begin(), objects.end());
+	});
+
+	PolyMaskedCycles.Unclock();
+}
+
 void RenderPolyScene::RenderSubsector(PolyRenderThread *thread, subsector_t *sub, uint32_t subsectorDepth)
 {
+	// Portals are collected in the main thread's lists no matter which thread found them
+	PolyRenderThread *mainthread = PolyRenderer::Instance()->Threads.MainThread();
+
 	sector_t *frontsector = sub->sector;
 	frontsector->MoreFlags |= SECF_DRAWN;
 
@@ -161,14 +190,14 @@ void RenderPolyScene::RenderSubsector(PolyRenderThread *thread, subsector_t *sub
 		}
 
 		Render3DFloorPlane::RenderPlanes(thread, CurrentViewpoint->PortalPlane, sub, CurrentViewpoint->StencilValue, subsectorDepth, thread->TranslucentObjects);
-		RenderPolyPlane::RenderPlanes(thread, CurrentViewpoint->PortalPlane, sub, CurrentViewpoint->StencilValue, Cull.MaxCeilingHeight, Cull.MinFloorHeight, thread->SectorPortals);
+		RenderPolyPlane::RenderPlanes(thread, CurrentViewpoint->PortalPlane, sub, CurrentViewpoint->StencilValue, Cull.MaxCeilingHeight, Cull.MinFloorHeight, mainthread->SectorPortals);
 	}
 	else
 	{
 		PolyTransferHeights fakeflat(sub);
 
 		Render3DFloorPlane::RenderPlanes(thread, CurrentViewpoint->PortalPlane, sub, CurrentViewpoint->StencilValue, subsectorDepth, thread->TranslucentObjects);
-		RenderPolyPlane::RenderPlanes(thread, CurrentViewpoint->PortalPlane, fakeflat, CurrentViewpoint->StencilValue, Cull.MaxCeilingHeight, Cull.MinFloorHeight, thread->SectorPortals);
+		RenderPolyPlane::RenderPlanes(thread, CurrentViewpoint->PortalPlane, fakeflat, CurrentViewpoint->StencilValue, Cull.MaxCeilingHeight, Cull.MinFloorHeight, mainthread->SectorPortals);
 
 		for (uint32_t i = 0; i < sub->numlines; i++)
 		{
@@ -220,6 +249,7 @@ void RenderPolyScene::RenderPolyNode(PolyRenderThread *thread, void *node, uint3
 void RenderPolyScene::RenderPolySubsector(PolyRenderThread *thread, subsector_t *sub, uint32_t subsectorDepth, sector_t *frontsector)
 {
 	const auto &viewpoint = PolyRenderer::Instance()->Viewpoint;
+	PolyRenderThread *mainthread = PolyRenderer::Instance()->Threads.MainThread();
 
 	for (uint32_t i = 0; i < sub->numlines; i++)
 	{
@@ -239,7 +269,7 @@ void RenderPolyScene::RenderPolySubsector(PolyRenderThread *thread, subsector_t
 				sub->flags |= SSECF_DRAWN;
 			}
 
-			RenderPolyWall::RenderLine(thread, CurrentViewpoint->PortalPlane, line, frontsector, subsectorDepth, CurrentViewpoint->StencilValue, thread->TranslucentObjects, thread->LinePortals, CurrentViewpoint->LastPortalLine);
+			RenderPolyWall::RenderLine(thread, CurrentViewpoint->PortalPlane, line, frontsector, subsectorDepth, CurrentViewpoint->StencilValue, thread->TranslucentObjects, mainthread->LinePortals, CurrentViewpoint->LastPortalLine);
 		}
 	}
 }
@@ -300,6 +330,8 @@ void RenderPolyScene::AddSprite(PolyRenderThread *thread, AActor *thing, double
 
 void RenderPolyScene::RenderLine(PolyRenderThread *thread, subsector_t *sub, seg_t *line, sector_t *frontsector, uint32_t subsectorDepth)
 {
+	PolyRenderThread *mainthread = PolyRenderer::Instance()->Threads.MainThread();
+
 	// Tell automap we saw this
 	if (!PolyRenderer::Instance()->DontMapLines && line->linedef)
 	{
@@ -318,7 +350,7 @@ void RenderPolyScene::RenderLine(PolyRenderThread *thread, subsector_t *sub, seg
 	}
 
 	// Render wall, and update culling info if its an occlusion blocker
-	RenderPolyWall::RenderLine(thread, CurrentViewpoint->PortalPlane, line, frontsector, subsectorDepth, CurrentViewpoint->StencilValue, thread->TranslucentObjects, thread->LinePortals, CurrentViewpoint->LastPortalLine);
+	RenderPolyWall::RenderLine(thread, CurrentViewpoint->PortalPlane, line, frontsector, subsectorDepth, CurrentViewpoint->StencilValue, thread->TranslucentObjects, mainthread->LinePortals, CurrentViewpoint->LastPortalLine);
 }
 
 void RenderPolyScene::RenderPortals()
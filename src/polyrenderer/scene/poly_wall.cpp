@@ -59,6 +59,7 @@ bool RenderPolyWall::RenderLine(PolyRenderThread *thread, const PolyClipPlane &c
 			return false;
 		}
 
+		std::unique_lock<std::mutex> lock(PolyRenderThread::PortalMutex());
 		linePortals.push_back(std::unique_ptr<PolyDrawLinePortal>(new PolyDrawLinePortal(line->linedef)));
 		polyportal = linePortals.back().get();
 	}
@@ -72,6 +73,7 @@ bool RenderPolyWall::RenderLine(PolyRenderThread *thread, const PolyClipPlane &c
 		}
 
 		FLinePortal *portal = line->linedef->getPortal();
+		std::unique_lock<std::mutex> lock(PolyRenderThread::PortalMutex());
 		for (auto &p : linePortals)
 		{
 			if (p->Portal == portal) // To do: what other criterias do we need to check for?
@@ -347,6 +349,8 @@ void RenderPolyWall::Render(PolyRenderThread *thread, const PolyClipPlane &clipP
 		args.SetWriteColor(false);
 		args.SetWriteDepth(false);
 		args.DrawArray(thread, vertices, 4, PolyDrawMode::TriangleFan);
+
+		std::unique_lock<std::mutex> lock(PolyRenderThread::PortalMutex());
 		Polyportal->Shape.push_back({ vertices, 4 });
 	}
 	else if (!Masked)
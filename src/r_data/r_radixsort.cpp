@@ -0,0 +1,114 @@
+//
+//---------------------------------------------------------------------------
+//
+// Copyright(C) 2017 The GZDoom Development Team
+// All rights reserved.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program.  If not, see http://www.gnu.org/licenses/
+//
+//--------------------------------------------------------------------------
+//
+/*
+** r_radixsort.cpp
+** Key based sorting for the renderers' depth sorted draw lists
+**
+**/
+
+#include <string.h>
+#include <algorithm>
+#include "r_data/r_radixsort.h"
+
+//==========================================================================
+//
+// Sort parameters. Below RadixSortThreshold items the histogram setup
+// costs more than a plain comparison sort.
+//
+//==========================================================================
+
+enum
+{
+	RadixSortThreshold = 64,
+	RadixBits = 8,
+	RadixBuckets = 1 << RadixBits,
+	RadixPasses = 64 / RadixBits
+};
+
+//==========================================================================
+//
+//
+//
+//==========================================================================
+
+void FRadixSorter::Sort(TArray<FRadixSortItem> &items)
+{
+	unsigned int count = items.Size();
+	if (count < 2)
+		return;
+
+	if (count < RadixSortThreshold)
+	{
+		std::stable_sort(&items[0], &items[0] + count, [](const FRadixSortItem &a, const FRadixSortItem &b) -> bool
+		{
+			return a.Key < b.Key;
+		});
+		return;
+	}
+
+	// Build the histograms for all passes in one go
+	uint32_t histogram[RadixPasses][RadixBuckets];
+	memset(histogram, 0, sizeof(histogram));
+
+	FRadixSortItem *src = &items[0];
+	for (unsigned int i = 0; i < count; i++)
+	{
+		uint64_t key = src[i].Key;
+		for (int pass = 0; pass < RadixPasses; pass++)
+		{
+			histogram[pass][key & (RadixBuckets - 1)]++;
+			key >>= RadixBits;
+		}
+	}
+
+	Temp.Resize(count);
+	FRadixSortItem *dest = &Temp[0];
+
+	for (int pass = 0; pass < RadixPasses; pass++)
+	{
+		uint32_t *bucket = histogram[pass];
+		int shift = pass * RadixBits;
+
+		// Skip the pass if all keys share the same digit (common for the upper bits)
+		if (bucket[(src[0].Key >> shift) & (RadixBuckets - 1)] == count)
+			continue;
+
+		uint32_t offset = 0;
+		for (int i = 0; i < RadixBuckets; i++)
+		{
+			uint32_t size = bucket[i];
+			bucket[i] = offset;
+			offset += size;
+		}
+
+		for (unsigned int i = 0; i < count; i++)
+		{
+			const FRadixSortItem &item = src[i];
+			dest[bucket[(item.Key >> shift) & (RadixBuckets - 1)]++] = item;
+		}
+
+		std::swap(src, dest);
+	}
+
+	if (src != &items[0])
+		memcpy(&items[0], src, count * sizeof(FRadixSortItem));
+}
@@ -0,0 +1,69 @@
+//
+//---------------------------------------------------------------------------
+//
+// Copyright(C) 2017 The GZDoom Development Team
+// All rights reserved.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program.  If not, see http://www.gnu.org/licenses/
+//
+//--------------------------------------------------------------------------
+//
+
+#pragma once
+
+#include <stdint.h>
+#include <string.h>
+#include "tarray.h"
+
+// One entry to be sorted. Value is an index into the caller's own array.
+struct FRadixSortItem
+{
+	uint64_t Key;
+	uint32_t Value;
+};
+
+// Stable LSD radix sort over 64-bit keys.
+//
+// Items with equal keys keep their input order, which means a sort by key
+// gives exactly the same result as std::stable_sort with operator< on the key.
+class FRadixSorter
+{
+public:
+	// Sorts the items in ascending key order
+	void Sort(TArray<FRadixSortItem> &items);
+
+	// Maps a float to an unsigned key with the same ordering (-0 and +0 compare equal)
+	static uint32_t FloatKey(float value)
+	{
+		if (value == 0.0f) value = 0.0f;
+		uint32_t bits;
+		memcpy(&bits, &value, sizeof(uint32_t));
+		return (bits & 0x80000000) ? ~bits : (bits | 0x80000000);
+	}
+
+	// Maps a signed integer to an unsigned key with the same ordering
+	static uint32_t IntKey(int32_t value)
+	{
+		return (uint32_t)value ^ 0x80000000;
+	}
+
+	// Combines a primary and a secondary key into one sort key
+	static uint64_t MakeKey(uint32_t primary, uint32_t secondary)
+	{
+		return ((uint64_t)primary << 32) | secondary;
+	}
+
+private:
+	TArray<FRadixSortItem> Temp;
+};
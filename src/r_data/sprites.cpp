@@ -290,7 +290,7 @@ static void R_InstallSprite (int num, spriteframewithrotate *sprtemp, int &maxfr
 		{
 			for (int rot = 0; rot < 16; ++rot)
 			{
-				TexMan[sprtemp[frame].Texture[rot]]->Rotations = framestart + frame;
+				TexMan.SetRotations(sprtemp[frame].Texture[rot], framestart + frame);
 			}
 		}
 	}
@@ -312,7 +312,7 @@ static void R_InstallSprite (int num, spriteframewithrotate *sprtemp, int &maxfr
 //	letter/number appended.
 // The rotation character can be 0 to signify no rotations.
 //
-#define TEX_DWNAME(tex) MAKE_ID(tex->Name[0], tex->Name[1], tex->Name[2], tex->Name[3])
+#define TEX_DWNAME(name) MAKE_ID(name[0], name[1], name[2], name[3])
 
 void R_InitSpriteDefs () 
 {
@@ -334,12 +334,13 @@ void R_InitSpriteDefs ()
 	smax = TexMan.NumTextures();
 	hashes = new Hasher[smax];
 	memset(hashes, -1, sizeof(Hasher)*smax);
+	// This must not create any lazily added textures
 	for (i = 0; i < smax; ++i)
 	{
-		FTexture *tex = TexMan.ByIndex(i);
-		if (tex->UseType == FTexture::TEX_Sprite && strlen(tex->Name) >= 6)
+		const char *name = TexMan.GetTextureName(i);
+		if (TexMan.GetTextureUseType(i) == FTexture::TEX_Sprite && strlen(name) >= 6)
 		{
-			size_t bucket = TEX_DWNAME(tex) % smax;
+			size_t bucket = TEX_DWNAME(name) % smax;
 			hashes[i].Next = hashes[bucket].Head;
 			hashes[bucket].Head = i;
 		}
@@ -418,13 +419,13 @@ void R_InitSpriteDefs ()
 		int hash = hashes[intname % smax].Head;
 		while (hash != -1)
 		{
-			FTexture *tex = TexMan[hash];
-			if (TEX_DWNAME(tex) == intname)
+			const char *name = TexMan.GetTextureName(hash);
+			if (TEX_DWNAME(name) == intname)
 			{
-				bool res = R_InstallSpriteLump (FTextureID(hash), tex->Name[4] - 'A', tex->Name[5], false, sprtemp, maxframe);
+				bool res = R_InstallSpriteLump (FTextureID(hash), name[4] - 'A', name[5], false, sprtemp, maxframe);
 
-				if (tex->Name[6] && res)
-					R_InstallSpriteLump (FTextureID(hash), tex->Name[6] - 'A', tex->Name[7], true, sprtemp, maxframe);
+				if (name[6] && res)
+					R_InstallSpriteLump (FTextureID(hash), name[6] - 'A', name[7], true, sprtemp, maxframe);
 			}
 			hash = hashes[hash].Next;
 		}
@@ -846,13 +846,18 @@ public:
 	{
 		planes[pos].TexZ = val;
 		if (dirtify) SetAllVerticesDirty();
+		if (!planesmoved) MarkPlanesMoved();
 	}
 
 	void ChangePlaneTexZ(int pos, double val)
 	{
 		planes[pos].TexZ += val;
+		if (!planesmoved) MarkPlanesMoved();
 	}
 
+	// Adds the sector to level.movedsectors so the hardware renderer can update its plane vertices
+	void MarkPlanesMoved();
+
 	static inline short ClampLight(int level)
 	{
 		return (short)clamp(level, SHRT_MIN, SHRT_MAX);
@@ -1085,6 +1090,7 @@ public:
 	int				vboindex[4];	// VBO indices of the 4 planes this sector uses during rendering
 	double			vboheight[2];	// Last calculated height for the 2 planes of this actual sector
 	int				vbocount[2];	// Total count of vertices belonging to this sector's planes
+	bool			planesmoved;	// Sector is in level.movedsectors
 
 	float GetReflect(int pos) { return gl_plane_reflection_i? reflect[pos] : 0; }
 	bool VBOHeightcheck(int pos) const { return vboheight[pos] == GetPlaneTexZ(pos); }
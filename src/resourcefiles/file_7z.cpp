@@ -44,6 +44,7 @@
 #include "w_zip.h"
 #include "i_system.h"
 #include "w_wad.h"
+#include "lumpdecompressor.h"
 
 
 
@@ -171,6 +172,9 @@ struct F7ZLump : public FResourceLump
 	int		Position;
 
 	virtual int FillCache();
+	// Extraction needs the archive's reader, so 7z lumps are never prefetched.
+	// They are still kept in FLumpDecompressor's cache once released.
+	virtual bool IsCompressed() { return true; }
 
 };
 
@@ -328,6 +332,7 @@ bool F7ZFile::Open(bool quiet)
 
 F7ZFile::~F7ZFile()
 {
+	FLumpDecompressor::Cancel(this);
 	if (Lumps != NULL)
 	{
 		delete[] Lumps;
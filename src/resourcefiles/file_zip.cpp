@@ -42,6 +42,8 @@
 #include "w_zip.h"
 #include "i_system.h"
 #include "ancientzip.h"
+#include "lumpdecompressor.h"
+#include "lumpindexcache.h"
 
 #define BUFREADCOMMENT (0x400)
 
@@ -51,7 +53,7 @@
 //
 //==========================================================================
 
-static bool UncompressZipLump(char *Cache, FileReader *Reader, int Method, int LumpSize, int CompressedSize, int GPFlags)
+static bool UncompressZipLump(char *Cache, FileReader *Reader, int Method, int LumpSize, int CompressedSize, int GPFlags, bool quiet = false)
 {
 	try
 	{
@@ -104,7 +106,7 @@ static bool UncompressZipLump(char *Cache, FileReader *Reader, int Method, int L
 	}
 	catch (CRecoverableError &err)
 	{
-		Printf("%s\n", err.GetMessage());
+		if (!quiet) Printf("%s\n", err.GetMessage());
 		return false;
 	}
 	return true;
@@ -182,12 +184,40 @@ FZipFile::FZipFile(const char * filename, FileReader *file)
 
 bool FZipFile::Open(bool quiet)
 {
-	uint32_t centraldir = Zip_FindCentralDir(Reader);
 	FZipEndOfCentralDirectory info;
 	int skipped = 0;
 
 	Lumps = NULL;
 
+	// Skip reading the central directory if this archive has been seen before
+	const TArray<FLumpIndexEntry> *cached = FLumpIndexCache::Find(Filename);
+	if (cached != nullptr)
+	{
+		NumLumps = cached->Size();
+		Lumps = new FZipLump[NumLumps];
+		for (uint32_t i = 0; i < NumLumps; i++)
+		{
+			const FLumpIndexEntry &entry = (*cached)[i];
+			FZipLump *lump_p = &Lumps[i];
+
+			lump_p->FullName = entry.FullName;
+			memcpy(lump_p->Name, entry.Name, 8);
+			lump_p->Name[8] = 0;
+			lump_p->Namespace = entry.Namespace;
+			lump_p->LumpSize = entry.LumpSize;
+			lump_p->Owner = this;
+			lump_p->Flags = entry.Flags;
+			lump_p->Method = entry.Method;
+			lump_p->GPFlags = entry.GPFlags;
+			lump_p->CRC32 = entry.CRC32;
+			lump_p->CompressedSize = entry.CompressedSize;
+			lump_p->Position = entry.Position;
+		}
+		if (!quiet && !batchrun) Printf(TEXTCOLOR_NORMAL ", %d lumps\n", NumLumps);
+		return true;
+	}
+
+	uint32_t centraldir = Zip_FindCentralDir(Reader);
 	if (centraldir == 0)
 	{
 		if (!quiet) Printf(TEXTCOLOR_RED "\n%s: ZIP file corrupt!\n", Filename);
@@ -370,6 +400,25 @@ bool FZipFile::Open(bool quiet)
 	if (!quiet && !batchrun) Printf(TEXTCOLOR_NORMAL ", %d lumps\n", NumLumps);
 	
 	PostProcessArchive(&Lumps[0], sizeof(FZipLump));
+
+	TArray<FLumpIndexEntry> entries(NumLumps, true);
+	for (uint32_t i = 0; i < NumLumps; i++)
+	{
+		FLumpIndexEntry &entry = entries[i];
+		FZipLump *lump_p = &Lumps[i];
+
+		entry.FullName = lump_p->FullName;
+		memcpy(entry.Name, lump_p->Name, 8);
+		entry.Namespace = lump_p->Namespace;
+		entry.LumpSize = lump_p->LumpSize;
+		entry.Flags = lump_p->Flags;
+		entry.Method = lump_p->Method;
+		entry.GPFlags = lump_p->GPFlags;
+		entry.CRC32 = lump_p->CRC32;
+		entry.CompressedSize = lump_p->CompressedSize;
+		entry.Position = lump_p->Position;
+	}
+	FLumpIndexCache::Store(Filename, entries);
 	return true;
 }
 
@@ -381,6 +430,7 @@ bool FZipFile::Open(bool quiet)
 
 FZipFile::~FZipFile()
 {
+	FLumpDecompressor::Cancel(this);
 	if (Lumps != NULL) delete [] Lumps;
 }
 
@@ -399,6 +449,31 @@ FCompressedBuffer FZipLump::GetRawData()
 	return cbuf;
 }
 
+//==========================================================================
+//
+// Decompression through FLumpDecompressor
+//
+//==========================================================================
+
+bool FZipLump::IsCompressed()
+{
+	return Method != METHOD_STORED;
+}
+
+bool FZipLump::ReadCompressedData(FCompressedBuffer &raw)
+{
+	if (Method == METHOD_STORED) return false;
+	raw = GetRawData();
+	return true;
+}
+
+bool FZipLump::DecompressData(const FCompressedBuffer &raw, char *dest)
+{
+	// Errors are reported when the main thread decompresses the lump again
+	MemoryReader mr(raw.mBuffer, raw.mCompressedSize);
+	return UncompressZipLump(dest, &mr, Method, LumpSize, CompressedSize, GPFlags, true);
+}
+
 //==========================================================================
 //
 // SetLumpAddress
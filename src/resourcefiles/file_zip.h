@@ -24,6 +24,9 @@ struct FZipLump : public FResourceLump
 
 	virtual FileReader *GetReader();
 	virtual int FillCache();
+	virtual bool IsCompressed();
+	virtual bool ReadCompressedData(FCompressedBuffer &raw);
+	virtual bool DecompressData(const FCompressedBuffer &raw, char *dest);
 
 private:
 	void SetLumpAddress();
@@ -0,0 +1,398 @@
+//
+//---------------------------------------------------------------------------
+//
+// Copyright(C) 2017 The GZDoom Development Team
+// All rights reserved.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program.  If not, see http://www.gnu.org/licenses/
+//
+//--------------------------------------------------------------------------
+//
+/*
+** lumpdecompressor.cpp
+** Worker threads and an LRU cache for compressed archive members
+**
+**/
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <vector>
+#include <list>
+#include "templates.h"
+#include "c_cvars.h"
+#include "i_system.h"
+#include "stats.h"
+#include "resourcefiles/resourcefile.h"
+#include "resourcefiles/lumpdecompressor.h"
+
+CUSTOM_CVAR(Int, lump_cachesize, 64, CVAR_ARCHIVE | CVAR_GLOBALCONFIG)
+{
+	if (self < 0) self = 0;
+}
+
+CVAR(Bool, lump_prefetch, true, CVAR_ARCHIVE | CVAR_GLOBALCONFIG)
+
+namespace
+{
+	struct FLumpJob
+	{
+		enum EState
+		{
+			Queued,
+			Running,
+			Done,
+			Failed
+		};
+
+		FResourceLump *Lump = nullptr;
+		FCompressedBuffer Raw = { 0, 0, 0, 0, 0, nullptr };
+		char *Buffer = nullptr;
+		EState State = Queued;
+		bool Prefetched = false;				// Queued by Prefetch and not claimed yet
+		std::list<FLumpJob *>::iterator LruPos;	// Position in the LRU list once done
+	};
+
+	std::mutex Mutex;
+	std::condition_variable WorkCondition;
+	std::condition_variable DoneCondition;
+	std::vector<std::thread> Workers;
+	bool StopWorkers;
+	bool TermRegistered;
+	bool IsShutDown;					// No new jobs are accepted after Shutdown
+
+	TMap<FResourceLump *, FLumpJob *> Jobs;
+	TArray<FLumpJob *> Queue;
+	unsigned int QueueHead;
+	std::list<FLumpJob *> Lru;			// Finished buffers, least recently used first
+	size_t CachedMemory;				// Size of all finished buffers still owned by this class
+	size_t UnclaimedMemory;				// Part of CachedMemory that was prefetched and not claimed yet
+
+	int PrefetchCount, WaitCount, HitCount, EvictCount;
+
+	size_t Budget()
+	{
+		return (size_t)lump_cachesize * 1024 * 1024;
+	}
+
+	// All functions below must be called with the mutex locked
+
+	void FreeJob(FLumpJob *job)
+	{
+		if (job->State == FLumpJob::Done)
+		{
+			CachedMemory -= job->Lump->LumpSize;
+			if (job->Prefetched) UnclaimedMemory -= job->Lump->LumpSize;
+			Lru.erase(job->LruPos);
+			WorkCondition.notify_all();
+		}
+		job->Raw.Clean();
+		delete[] job->Buffer;
+		Jobs.Remove(job->Lump);
+		// Lump::Decompressing is left alone here since workers may evict jobs too
+		delete job;
+	}
+
+	void EvictOldest(size_t needed)
+	{
+		while (!Lru.empty() && CachedMemory + needed > Budget())
+		{
+			FreeJob(Lru.front());
+			EvictCount++;
+		}
+	}
+
+	void WorkerMain()
+	{
+		std::unique_lock<std::mutex> lock(Mutex);
+		while (true)
+		{
+			// Wait for the main thread to pick up earlier results before the budget is filled with prefetched lumps
+			WorkCondition.wait(lock, []() { return StopWorkers || (QueueHead < Queue.Size() && UnclaimedMemory < Budget() / 2); });
+			if (StopWorkers)
+				break;
+
+			FLumpJob *job = Queue[QueueHead++];
+			if (QueueHead == Queue.Size())
+			{
+				Queue.Clear();
+				QueueHead = 0;
+			}
+
+			job->State = FLumpJob::Running;
+			lock.unlock();
+
+			char *buffer = new char[job->Lump->LumpSize];
+			bool success = job->Lump->DecompressData(job->Raw, buffer);
+
+			lock.lock();
+			job->Raw.Clean();
+			if (success)
+			{
+				EvictOldest(job->Lump->LumpSize);
+				job->Buffer = buffer;
+				job->State = FLumpJob::Done;
+				job->LruPos = Lru.insert(Lru.end(), job);
+				CachedMemory += job->Lump->LumpSize;
+				UnclaimedMemory += job->Lump->LumpSize;
+			}
+			else
+			{
+				// The main thread decompresses it again, which also reports the error
+				delete[] buffer;
+				job->State = FLumpJob::Failed;
+			}
+			DoneCondition.notify_all();
+		}
+	}
+
+	void StartWorkers()
+	{
+		if (!Workers.empty())
+			return;
+
+		if (!TermRegistered)
+		{
+			atterm(FLumpDecompressor::Shutdown);
+			TermRegistered = true;
+		}
+
+		StopWorkers = false;
+		int numthreads = MAX((int)std::thread::hardware_concurrency() - 1, 1);
+		for (int i = 0; i < numthreads; i++)
+			Workers.push_back(std::thread(WorkerMain));
+	}
+}
+
+ADD_STAT(lumpcache)
+{
+	std::unique_lock<std::mutex> lock(Mutex);
+	FString out;
+	out.Format("prefetched=%d  waited=%d  hits=%d  evicted=%d  cached=%u KB", PrefetchCount, WaitCount, HitCount, EvictCount, (unsigned)(CachedMemory / 1024));
+	return out;
+}
+
+//==========================================================================
+//
+//
+//
+//==========================================================================
+
+void FLumpDecompressor::Prefetch(FResourceLump *lump)
+{
+	if (!lump_prefetch || IsShutDown || lump->Cache != nullptr || lump->LumpSize <= 0 || !lump->IsCompressed() || (size_t)lump->LumpSize > Budget() / 4)
+		return;
+
+	std::unique_lock<std::mutex> lock(Mutex);
+	if (Jobs.CheckKey(lump) != nullptr)
+		return;
+	lock.unlock();
+
+	// Reading the compressed data uses the resource file's reader
+	FLumpJob *job = new FLumpJob;
+	job->Lump = lump;
+	job->Prefetched = true;
+	if (!lump->ReadCompressedData(job->Raw))
+	{
+		delete job;
+		return;
+	}
+
+	lock.lock();
+	StartWorkers();
+	lump->Decompressing = true;
+	Jobs[lump] = job;
+	Queue.Push(job);
+	PrefetchCount++;
+	WorkCondition.notify_one();
+}
+
+//==========================================================================
+//
+// Lumps from an earlier prefetch that were never claimed become
+// regular cache entries, so that they can be evicted again.
+//
+//==========================================================================
+
+void FLumpDecompressor::ExpirePrefetched()
+{
+	std::unique_lock<std::mutex> lock(Mutex);
+	for (auto job : Lru)
+	{
+		if (job->Prefetched)
+		{
+			job->Prefetched = false;
+			UnclaimedMemory -= job->Lump->LumpSize;
+		}
+	}
+	WorkCondition.notify_all();
+}
+
+//==========================================================================
+//
+//
+//
+//==========================================================================
+
+bool FLumpDecompressor::Claim(FResourceLump *lump)
+{
+	// Most lumps were never seen here, which must not cost a lock
+	if (!lump->Decompressing)
+		return false;
+	lump->Decompressing = false;
+
+	std::unique_lock<std::mutex> lock(Mutex);
+	FLumpJob **pjob = Jobs.CheckKey(lump);
+	if (pjob == nullptr)
+		return false;
+
+	FLumpJob *job = *pjob;
+	if (job->State == FLumpJob::Queued)
+	{
+		// Faster to do it right here than to wait for the workers to get to it
+		for (unsigned int i = QueueHead; i < Queue.Size(); i++)
+		{
+			if (Queue[i] == job)
+			{
+				Queue.Delete(i);
+				break;
+			}
+		}
+		FreeJob(job);
+		return false;
+	}
+
+	if (job->State == FLumpJob::Running)
+	{
+		WaitCount++;
+		DoneCondition.wait(lock, [=]() { return job->State != FLumpJob::Running; });
+	}
+
+	if (job->State != FLumpJob::Done)
+	{
+		FreeJob(job);
+		return false;
+	}
+
+	HitCount++;
+	lump->Cache = job->Buffer;
+	lump->RefCount = 1;
+	job->Buffer = nullptr;
+	FreeJob(job);
+	return true;
+}
+
+//==========================================================================
+//
+//
+//
+//==========================================================================
+
+bool FLumpDecompressor::Retain(FResourceLump *lump)
+{
+	if (lump->Cache == nullptr || IsShutDown || !lump->IsCompressed() || (size_t)lump->LumpSize > Budget() / 4)
+		return false;
+
+	std::unique_lock<std::mutex> lock(Mutex);
+	if (Jobs.CheckKey(lump) != nullptr)
+		return false;
+
+	EvictOldest(lump->LumpSize);
+
+	FLumpJob *job = new FLumpJob;
+	job->Lump = lump;
+	job->Buffer = lump->Cache;
+	job->State = FLumpJob::Done;
+	job->LruPos = Lru.insert(Lru.end(), job);
+	Jobs[lump] = job;
+	CachedMemory += lump->LumpSize;
+	lump->Decompressing = true;
+
+	lump->Cache = nullptr;
+	return true;
+}
+
+//==========================================================================
+//
+//
+//
+//==========================================================================
+
+void FLumpDecompressor::Cancel(FResourceFile *file)
+{
+	std::unique_lock<std::mutex> lock(Mutex);
+
+	TArray<FLumpJob *> remove;
+	TMap<FResourceLump *, FLumpJob *>::Iterator it(Jobs);
+	TMap<FResourceLump *, FLumpJob *>::Pair *pair;
+	while (it.NextPair(pair))
+	{
+		if (pair->Key->Owner == file)
+			remove.Push(pair->Value);
+	}
+
+	for (auto job : remove)
+	{
+		if (job->State == FLumpJob::Queued)
+		{
+			for (unsigned int i = QueueHead; i < Queue.Size(); i++)
+			{
+				if (Queue[i] == job)
+				{
+					Queue.Delete(i);
+					break;
+				}
+			}
+		}
+		else if (job->State == FLumpJob::Running)
+		{
+			DoneCondition.wait(lock, [=]() { return job->State != FLumpJob::Running; });
+		}
+		job->Lump->Decompressing = false;
+		FreeJob(job);
+	}
+}
+
+//==========================================================================
+//
+//
+//
+//==========================================================================
+
+void FLumpDecompressor::Shutdown()
+{
+	std::unique_lock<std::mutex> lock(Mutex);
+	IsShutDown = true;
+	StopWorkers = true;
+	WorkCondition.notify_all();
+	lock.unlock();
+
+	for (auto &thread : Workers)
+		thread.join();
+	Workers.clear();
+
+	lock.lock();
+	TArray<FLumpJob *> remove;
+	TMap<FResourceLump *, FLumpJob *>::Iterator it(Jobs);
+	TMap<FResourceLump *, FLumpJob *>::Pair *pair;
+	while (it.NextPair(pair))
+		remove.Push(pair->Value);
+	for (auto job : remove)
+	{
+		job->Lump->Decompressing = false;
+		FreeJob(job);
+	}
+	Queue.Clear();
+	QueueHead = 0;
+}
@@ -0,0 +1,62 @@
+//
+//---------------------------------------------------------------------------
+//
+// Copyright(C) 2017 The GZDoom Development Team
+// All rights reserved.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program.  If not, see http://www.gnu.org/licenses/
+//
+//--------------------------------------------------------------------------
+//
+
+#pragma once
+
+struct FResourceLump;
+class FResourceFile;
+
+// Decompresses archive members on worker threads and keeps recently used ones around.
+//
+// Prefetch queues compressed lumps that are likely to be needed soon. Their compressed
+// data is read on the main thread, since the resource files cannot be accessed
+// concurrently, and inflated by the workers. FResourceLump::CacheLump then picks up the
+// result, waiting only if the lump is still being decompressed.
+//
+// When the last reference to a compressed lump's cache is released the buffer is handed
+// to this class instead of being freed. Those buffers are kept in least recently used
+// order until lump_cachesize is exceeded.
+//
+// Nothing new is accepted after Shutdown.
+//
+// All functions must be called from the main thread.
+class FLumpDecompressor
+{
+public:
+	// Queues a compressed lump for decompression. Lumps that are stored uncompressed are ignored
+	static void Prefetch(FResourceLump *lump);
+
+	// Turns unclaimed lumps of earlier Prefetch calls into regular cache entries. Call before prefetching a new set
+	static void ExpirePrefetched();
+
+	// Moves the decompressed data of a lump into its cache. Returns false if the caller must decompress it
+	static bool Claim(FResourceLump *lump);
+
+	// Takes over the cache of a compressed lump when its reference count reaches zero
+	static bool Retain(FResourceLump *lump);
+
+	// Drops everything belonging to a resource file that is about to be closed
+	static void Cancel(FResourceFile *file);
+
+	// Stops the workers and frees all buffers
+	static void Shutdown();
+};
@@ -0,0 +1,465 @@
+//
+//---------------------------------------------------------------------------
+//
+// Copyright(C) 2017 The GZDoom Development Team
+// All rights reserved.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program.  If not, see http://www.gnu.org/licenses/
+//
+//--------------------------------------------------------------------------
+//
+/*
+** lumpindexcache.cpp
+** Persistent cache of archive directories
+**
+**/
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <stdio.h>
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#include <process.h>
+#else
+#include <unistd.h>
+#endif
+#include "doomtype.h"
+#include "c_cvars.h"
+#include "c_dispatch.h"
+#include "cmdlib.h"
+#include "m_misc.h"
+#include "files.h"
+#include "gi.h"
+#include "doomstat.h"
+#include "resourcefiles/lumpindexcache.h"
+
+CVAR(Bool, lump_indexcache, true, CVAR_ARCHIVE | CVAR_GLOBALCONFIG)
+
+namespace
+{
+	enum
+	{
+		CacheVersion = 2
+	};
+
+	struct FCachedArchive
+	{
+		FString Path;
+		FString Filter;
+		uint64_t Size;
+		int64_t MTime;		// in nanoseconds, as far as the file system goes
+		TArray<FLumpIndexEntry> Entries;
+	};
+
+	bool Loaded;
+	bool Dirty;
+	TMap<FString, FCachedArchive *> Archives;
+
+	// The file between BeginFile and EndFile
+	FString CurrentPath;
+	uint64_t CurrentSize;
+	int64_t CurrentMTime;
+	bool CurrentValid;
+
+	FString CacheFileName(bool create)
+	{
+		FString path = M_GetCachePath(create);
+		if (create) CreatePath(path);
+		path << "/lumpindex.cache";
+		return path;
+	}
+
+	// The filters decide which archive members get hidden or renamed by PostProcessArchive
+	FString CurrentFilter()
+	{
+		FString filter;
+		filter.Format("%d:%s", gameinfo.gametype, LumpFilterIWAD.GetChars());
+		return filter;
+	}
+
+	// A whole second is too coarse to notice an archive that gets rebuilt right after it was loaded
+	bool GetFileInfo(const char *filename, uint64_t &size, int64_t &mtime)
+	{
+#ifdef _WIN32
+		WIN32_FILE_ATTRIBUTE_DATA data;
+		if (!GetFileAttributesExA(filename, GetFileExInfoStandard, &data))
+			return false;
+
+		size = (uint64_t(data.nFileSizeHigh) << 32) | data.nFileSizeLow;
+		mtime = int64_t((uint64_t(data.ftLastWriteTime.dwHighDateTime) << 32) | data.ftLastWriteTime.dwLowDateTime) * 100;
+#else
+		struct stat info;
+		if (stat(filename, &info) != 0)
+			return false;
+
+		size = (uint64_t)info.st_size;
+#ifdef __APPLE__
+		mtime = (int64_t)info.st_mtimespec.tv_sec * 1000000000 + info.st_mtimespec.tv_nsec;
+#else
+		mtime = (int64_t)info.st_mtim.tv_sec * 1000000000 + info.st_mtim.tv_nsec;
+#endif
+#endif
+		return true;
+	}
+
+	FString ArchiveKey(const FString &path, const FString &filter)
+	{
+		FString key = path;
+		key << '\n' << filter;
+		return key;
+	}
+
+	void ClearArchives()
+	{
+		TMap<FString, FCachedArchive *>::Iterator it(Archives);
+		TMap<FString, FCachedArchive *>::Pair *pair;
+		while (it.NextPair(pair))
+			delete pair->Value;
+		Archives.Clear();
+	}
+
+	//==========================================================================
+	//
+	// Serialization
+	//
+	//==========================================================================
+
+	class FIndexWriter
+	{
+	public:
+		TArray<uint8_t> Data;
+
+		void Write(const void *src, unsigned int size)
+		{
+			unsigned int pos = Data.Reserve(size);
+			memcpy(&Data[pos], src, size);
+		}
+
+		void WriteLong(uint32_t v) { v = LittleLong(v); Write(&v, 4); }
+		void WriteQuad(uint64_t v) { WriteLong(uint32_t(v)); WriteLong(uint32_t(v >> 32)); }
+		void WriteWord(uint16_t v) { v = LittleShort(v); Write(&v, 2); }
+		void WriteByte(uint8_t v) { Write(&v, 1); }
+
+		void WriteString(const FString &s)
+		{
+			WriteLong(s.Len());
+			Write(s.GetChars(), s.Len());
+		}
+	};
+
+	class FIndexReader
+	{
+	public:
+		FIndexReader(const uint8_t *data, size_t size) : Pos(data), End(data + size) { }
+
+		bool Failed = false;
+
+		bool Read(void *dest, size_t size)
+		{
+			if (Failed || size > size_t(End - Pos))
+			{
+				Failed = true;
+				memset(dest, 0, size);
+				return false;
+			}
+			memcpy(dest, Pos, size);
+			Pos += size;
+			return true;
+		}
+
+		uint32_t ReadLong() { uint32_t v; Read(&v, 4); return LittleLong(v); }
+		uint64_t ReadQuad() { uint64_t lo = ReadLong(); uint64_t hi = ReadLong(); return lo | (hi << 32); }
+		uint16_t ReadWord() { uint16_t v; Read(&v, 2); return LittleShort(v); }
+		uint8_t ReadByte() { uint8_t v; Read(&v, 1); return v; }
+
+		FString ReadString()
+		{
+			uint32_t len = ReadLong();
+			if (Failed || len > size_t(End - Pos))
+			{
+				Failed = true;
+				return FString();
+			}
+			FString s((const char *)Pos, len);
+			Pos += len;
+			return s;
+		}
+
+	private:
+		const uint8_t *Pos;
+		const uint8_t *End;
+	};
+}
+
+//==========================================================================
+//
+// The whole file is read at once and parsed from memory
+//
+//==========================================================================
+
+void FLumpIndexCache::Load()
+{
+	ClearArchives();
+	Loaded = lump_indexcache;
+	Dirty = false;
+	if (!Loaded)
+		return;
+
+	FileReader fr;
+	if (!fr.Open(CacheFileName(false)))
+		return;
+
+	long length = fr.GetLength();
+	if (length < 12)
+		return;
+
+	TArray<uint8_t> data(length, true);
+	if (fr.Read(&data[0], length) != length)
+		return;
+
+	FIndexReader reader(&data[0], length);
+	char magic[4];
+	reader.Read(magic, 4);
+	if (memcmp(magic, "LIDX", 4) != 0 || reader.ReadLong() != CacheVersion)
+		return;
+
+	uint32_t numarchives = reader.ReadLong();
+	for (uint32_t i = 0; i < numarchives && !reader.Failed; i++)
+	{
+		FCachedArchive *archive = new FCachedArchive;
+		archive->Path = reader.ReadString();
+		archive->Filter = reader.ReadString();
+		archive->Size = reader.ReadQuad();
+		archive->MTime = (int64_t)reader.ReadQuad();
+
+		uint32_t numentries = reader.ReadLong();
+		if (reader.Failed || numentries > (uint32_t)length)
+		{
+			delete archive;
+			break;
+		}
+
+		archive->Entries.Resize(numentries);
+		for (auto &entry : archive->Entries)
+		{
+			entry.FullName = reader.ReadString();
+			reader.Read(entry.Name, 8);
+			entry.Namespace = (int)reader.ReadLong();
+			entry.LumpSize = (int)reader.ReadLong();
+			entry.Flags = reader.ReadByte();
+			entry.Method = reader.ReadByte();
+			entry.GPFlags = reader.ReadWord();
+			entry.CompressedSize = (int)reader.ReadLong();
+			entry.Position = (int)reader.ReadLong();
+			entry.CRC32 = reader.ReadLong();
+		}
+
+		if (reader.Failed)
+		{
+			delete archive;
+			break;
+		}
+		Archives[ArchiveKey(archive->Path, archive->Filter)] = archive;
+	}
+
+	if (reader.Failed)
+	{
+		// Truncated or damaged. Everything gets written again.
+		ClearArchives();
+		Dirty = true;
+	}
+}
+
+//==========================================================================
+//
+// Writes to a temporary file first so that other instances starting
+// at the same time never see a partially written cache.
+//
+//==========================================================================
+
+void FLumpIndexCache::Save()
+{
+	if (Loaded)
+	{
+		// Drop archives that were deleted or changed since they got cached
+		TArray<FString> stale;
+		TMap<FString, FCachedArchive *>::Iterator it(Archives);
+		TMap<FString, FCachedArchive *>::Pair *pair;
+		while (it.NextPair(pair))
+		{
+			uint64_t size;
+			int64_t mtime;
+			FCachedArchive *archive = pair->Value;
+			if (!GetFileInfo(archive->Path, size, mtime) || size != archive->Size || mtime != archive->MTime)
+				stale.Push(pair->Key);
+		}
+		for (auto &key : stale)
+		{
+			delete Archives[key];
+			Archives.Remove(key);
+			Dirty = true;
+		}
+	}
+
+	if (Loaded && Dirty)
+	{
+		FIndexWriter writer;
+		writer.Write("LIDX", 4);
+		writer.WriteLong(CacheVersion);
+		writer.WriteLong(Archives.CountUsed());
+
+		TMap<FString, FCachedArchive *>::Iterator it(Archives);
+		TMap<FString, FCachedArchive *>::Pair *pair;
+		while (it.NextPair(pair))
+		{
+			FCachedArchive *archive = pair->Value;
+			writer.WriteString(archive->Path);
+			writer.WriteString(archive->Filter);
+			writer.WriteQuad(archive->Size);
+			writer.WriteQuad((uint64_t)archive->MTime);
+			writer.WriteLong(archive->Entries.Size());
+			for (auto &entry : archive->Entries)
+			{
+				writer.WriteString(entry.FullName);
+				writer.Write(entry.Name, 8);
+				writer.WriteLong(entry.Namespace);
+				writer.WriteLong(entry.LumpSize);
+				writer.WriteByte(entry.Flags);
+				writer.WriteByte(entry.Method);
+				writer.WriteWord(entry.GPFlags);
+				writer.WriteLong(entry.CompressedSize);
+				writer.WriteLong(entry.Position);
+				writer.WriteLong(entry.CRC32);
+			}
+		}
+
+		FString path = CacheFileName(true);
+		FString temppath;
+		temppath.Format("%s.%d", path.GetChars(), (int)getpid());
+
+		FileWriter *fw = FileWriter::Open(temppath);
+		if (fw != nullptr)
+		{
+			bool success = fw->Write(&writer.Data[0], writer.Data.Size()) == writer.Data.Size();
+			delete fw;
+
+			if (success)
+			{
+#ifdef _WIN32
+				remove(path);
+#endif
+				success = rename(temppath, path) == 0;
+			}
+			if (!success)
+			{
+				remove(temppath);
+				DPrintf(DMSG_NOTIFY, "Could not write lump index cache %s\n", path.GetChars());
+			}
+		}
+	}
+
+	ClearArchives();
+	Loaded = false;
+	Dirty = false;
+}
+
+//==========================================================================
+//
+//
+//
+//==========================================================================
+
+void FLumpIndexCache::BeginFile(const char *filename)
+{
+	CurrentPath = filename;
+	CurrentValid = false;
+	if (!Loaded)
+		return;
+
+	CurrentValid = GetFileInfo(filename, CurrentSize, CurrentMTime);
+}
+
+void FLumpIndexCache::EndFile()
+{
+	CurrentPath = "";
+	CurrentValid = false;
+}
+
+//==========================================================================
+//
+//
+//
+//==========================================================================
+
+const TArray<FLumpIndexEntry> *FLumpIndexCache::Find(const char *filename)
+{
+	if (!CurrentValid || CurrentPath.Compare(filename) != 0)
+		return nullptr;
+
+	FCachedArchive **parchive = Archives.CheckKey(ArchiveKey(CurrentPath, CurrentFilter()));
+	if (parchive == nullptr)
+		return nullptr;
+
+	FCachedArchive *archive = *parchive;
+	if (archive->Size != CurrentSize || archive->MTime != CurrentMTime)
+		return nullptr;
+
+	return &archive->Entries;
+}
+
+//==========================================================================
+//
+//
+//
+//==========================================================================
+
+void FLumpIndexCache::Store(const char *filename, TArray<FLumpIndexEntry> &entries)
+{
+	if (!CurrentValid || CurrentPath.Compare(filename) != 0)
+		return;
+
+	FString filter = CurrentFilter();
+	FString key = ArchiveKey(CurrentPath, filter);
+
+	FCachedArchive **parchive = Archives.CheckKey(key);
+	FCachedArchive *archive;
+	if (parchive != nullptr)
+	{
+		archive = *parchive;
+	}
+	else
+	{
+		archive = new FCachedArchive;
+		Archives[key] = archive;
+	}
+
+	archive->Path = CurrentPath;
+	archive->Filter = filter;
+	archive->Size = CurrentSize;
+	archive->MTime = CurrentMTime;
+	archive->Entries = std::move(entries);
+	Dirty = true;
+}
+
+//==========================================================================
+//
+//
+//
+//==========================================================================
+
+CCMD(clearlumpindexcache)
+{
+	remove(CacheFileName(false));
+}
@@ -0,0 +1,73 @@
+//
+//---------------------------------------------------------------------------
+//
+// Copyright(C) 2017 The GZDoom Development Team
+// All rights reserved.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program.  If not, see http://www.gnu.org/licenses/
+//
+//--------------------------------------------------------------------------
+//
+
+#pragma once
+
+#include "tarray.h"
+#include "zstring.h"
+
+// One archive member as it looks after the archive has been opened and post processed
+struct FLumpIndexEntry
+{
+	FString FullName;
+	char Name[8];
+	int Namespace;
+	int LumpSize;
+	uint8_t Flags;
+
+	// Archive specific
+	uint8_t Method;
+	uint16_t GPFlags;
+	int CompressedSize;
+	int Position;
+	uint32_t CRC32;
+};
+
+// Persistent cache of archive directories.
+//
+// Opening a large zip means reading its central directory, sorting it and applying the
+// filter/ rules, which dominates startup when many archives are loaded. The result of that
+// is stored in a single file in the cache directory, keyed by the archive's path, size,
+// modification time and the active lump filters. The whole cache file is read with one
+// read when the lump directory gets built.
+//
+// Only archives opened straight from a file on disk are cached. BeginFile/EndFile bracket
+// the opening of such a file, so that archives embedded in other archives never match.
+class FLumpIndexCache
+{
+public:
+	// Reads the cache file. Called before any resource file is opened
+	static void Load();
+
+	// Writes the cache file if anything changed and frees the loaded entries
+	static void Save();
+
+	// Marks filename as the file on disk that is about to be opened
+	static void BeginFile(const char *filename);
+	static void EndFile();
+
+	// Returns the cached directory of the file passed to BeginFile, if it is still valid
+	static const TArray<FLumpIndexEntry> *Find(const char *filename);
+
+	// Remembers the directory of the file passed to BeginFile
+	static void Store(const char *filename, TArray<FLumpIndexEntry> &entries);
+};
@@ -35,6 +35,7 @@
 */
 
 #include "resourcefile.h"
+#include "lumpdecompressor.h"
 #include "cmdlib.h"
 #include "w_wad.h"
 #include "doomerrors.h"
@@ -246,7 +247,7 @@ void *FResourceLump::CacheLump()
 	}
 	else if (LumpSize > 0)
 	{
-		FillCache();
+		if (!FLumpDecompressor::Claim(this)) FillCache();
 	}
 	return Cache;
 }
@@ -263,7 +264,7 @@ int FResourceLump::ReleaseCache()
 	{
 		if (--RefCount == 0)
 		{
-			delete [] Cache;
+			if (!FLumpDecompressor::Retain(this)) delete [] Cache;
 			Cache = NULL;
 		}
 	}
@@ -45,6 +45,7 @@ struct FResourceLump
 	};
 	uint8_t			Flags;
 	int8_t			RefCount;
+	bool			Decompressing;	// May have an entry in FLumpDecompressor, only used by the main thread
 	char *			Cache;
 	FResourceFile *	Owner;
 	FTexture *		LinkedTexture;
@@ -56,6 +57,7 @@ struct FResourceLump
 		Owner = NULL;
 		Flags = 0;
 		RefCount = 0;
+		Decompressing = false;
 		Namespace = 0;	// ns_global
 		*Name = 0;
 		LinkedTexture = NULL;
@@ -70,6 +72,12 @@ struct FResourceLump
 	void CheckEmbedded();
 	virtual FCompressedBuffer GetRawData();
 
+	// Decompression on worker threads (see lumpdecompressor.h). ReadCompressedData gets called on the
+	// main thread and may use the owner's reader, DecompressData runs on a worker and must not.
+	virtual bool IsCompressed() { return false; }
+	virtual bool ReadCompressedData(FCompressedBuffer &raw) { return false; }
+	virtual bool DecompressData(const FCompressedBuffer &raw, char *dest) { return false; }
+
 	void *CacheLump();
 	int ReleaseCache();
 
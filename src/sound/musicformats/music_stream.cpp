@@ -33,6 +33,12 @@
 
 #include "i_musicinterns.h"
 
+// Size of the blocks read ahead of the decoders, in KB
+CUSTOM_CVAR(Int, snd_streamreadahead, 256, CVAR_ARCHIVE | CVAR_GLOBALCONFIG)
+{
+	if (self < 4) self = 4;
+}
+
 void StreamSong::Play (bool looping, int subsong)
 {
 	m_Status = STATE_Stopped;
@@ -87,6 +93,12 @@ StreamSong::~StreamSong ()
 
 StreamSong::StreamSong (FileReader *reader)
 {
+	// Music in memory needs no readahead. For files the decoders would otherwise
+	// do a small blocking read whenever the stream runs low.
+	if (reader->GetBuffer() == NULL)
+	{
+		reader = new BufferedFileReader(reader, true, snd_streamreadahead * 1024);
+	}
     m_Stream = GSnd->OpenStream (reader, SoundStream::Loop);
 }
 
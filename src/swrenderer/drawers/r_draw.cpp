@@ -33,6 +33,7 @@
 */
 
 #include <stddef.h>
+#include <float.h>
 
 #include "templates.h"
 #include "doomdef.h"
@@ -216,6 +217,29 @@ namespace swrenderer
 		}
 	}
 
+	// The depth commands write the z buffer a row at a time, while the poly triangle drawer
+	// keeps the depth range of every 64 consecutive values for its early out. Blocks whose
+	// values get overwritten are marked as having an unknown range. A block is only marked by
+	// the thread that owns its block row in the triangle drawer.
+	static void InvalidateDepthBlocks(DrawerThread *thread, int first, int last)
+	{
+		auto zbuffer = PolyZBuffer::Instance();
+		int blockpitch = PolyStencilBuffer::Instance()->BlockWidth();
+		int blockcount = zbuffer->BlockWidth() * zbuffer->BlockHeight();
+		float *blockmin = zbuffer->BlockMin();
+		float *blockmax = zbuffer->BlockMax();
+
+		int end = MIN(last >> 6, blockcount - 1);
+		for (int block = first >> 6; block <= end; block++)
+		{
+			if (!thread->line_skipped_by_thread(block / blockpitch))
+			{
+				blockmin[block] = -FLT_MAX;
+				blockmax[block] = FLT_MAX;
+			}
+		}
+	}
+
 	class DepthColumnCommand : public DrawerCommand
 	{
 	public:
@@ -272,6 +296,12 @@ namespace swrenderer
 			float *values = zbuffer->Values() + y * pitch + x;
 			int cnt = count;
 
+			for (int i = 0; i < cnt; i++)
+			{
+				int index = (y + i) * pitch + x;
+				InvalidateDepthBlocks(thread, index, index);
+			}
+
 			values = thread->dest_for_thread(y, pitch, values);
 			cnt = thread->count_for_thread(y, cnt);
 			pitch *= thread->num_cores;
@@ -303,11 +333,13 @@ namespace swrenderer
 
 		void Execute(DrawerThread *thread) override
 		{
+			int pitch = PolyStencilBuffer::Instance()->BlockWidth() * 8;
+			InvalidateDepthBlocks(thread, y * pitch + x1, y * pitch + x2);
+
 			if (thread->skipped_by_thread(y))
 				return;
 
 			auto zbuffer = PolyZBuffer::Instance();
-			int pitch = PolyStencilBuffer::Instance()->BlockWidth() * 8;
 			float *values = zbuffer->Values() + y * pitch;
 			int end = x2;
 
@@ -957,11 +957,31 @@ namespace swrenderer
 			drawer.args.dc_dest_y = block.y;
 			drawer.args.dc_dest = destorig + (block.x + block.y * pitch) * 4;
 
-			for (int j = 0; j < block.width; j++)
-			{
-				drawer.Execute(thread);
-				drawer.args.dc_dest += 4;
-			}
+			// All columns in a block are identical. Draw the first one and copy it to the rest.
+			drawer.Execute(thread);
+			if (block.width > 1)
+				FillVoxelBlockColumns(thread, (uint32_t*)drawer.args.dc_dest, pitch, block.y, block.height, block.width);
+		}
+	}
+
+	void DrawVoxelBlocksRGBACommand::FillVoxelBlockColumns(DrawerThread *thread, uint32_t *dest, int pitch, int y, int height, int width)
+	{
+		int count = thread->count_for_thread(y, height);
+		dest = thread->dest_for_thread(y, pitch, dest);
+		pitch *= thread->num_cores;
+
+		for (int i = 0; i < count; i++)
+		{
+			uint32_t color = dest[0];
+			int x = 1;
+#ifndef NO_SSE
+			__m128i fill = _mm_set1_epi32(color);
+			for (; x + 4 <= width; x += 4)
+				_mm_storeu_si128((__m128i*)(dest + x), fill);
+#endif
+			for (; x < width; x++)
+				dest[x] = color;
+			dest += pitch;
 		}
 	}
 
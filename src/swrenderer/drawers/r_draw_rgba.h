@@ -239,6 +239,8 @@ namespace swrenderer
 		FString DebugInfo() override;
 
 	private:
+		static void FillVoxelBlockColumns(DrawerThread *thread, uint32_t *dest, int pitch, int y, int height, int width);
+
 		SpriteDrawerArgs args;
 		const VoxelBlock *blocks;
 		int blockcount;
@@ -41,9 +41,10 @@ namespace swrenderer
 		struct NearestFilter { static const int Mode = (int)FilterModes::Nearest; };
 		struct LinearFilter { static const int Mode = (int)FilterModes::Linear; };
 
-		enum class ShadeMode { Simple, Advanced };
+		enum class ShadeMode { Simple, Advanced, Ramp };
 		struct SimpleShade { static const int Mode = (int)ShadeMode::Simple; };
 		struct AdvancedShade { static const int Mode = (int)ShadeMode::Advanced; };
+		struct RampShade { static const int Mode = (int)ShadeMode::Ramp; };
 
 		enum class SpanTextureSize { SizeAny, Size64x64 };
 		struct TextureSizeAny { static const int Mode = (int)SpanTextureSize::SizeAny; };
@@ -114,21 +115,39 @@ namespace swrenderer
 			bool is_64x64 = texdata.width == 64 && texdata.height == 64;
 			
 			auto shade_constants = args.ColormapConstants();
-			if (shade_constants.simple_shade)
+			const ShadeRamp *shade_ramp = args.ColormapShadeRamp();
+			if (shade_ramp)
 			{
 				if (is_nearest_filter)
 				{
 					if (is_64x64)
-						Loop<SimpleShade, NearestFilter, TextureSize64x64>(thread, texdata, shade_constants);
+						Loop<RampShade, NearestFilter, TextureSize64x64>(thread, texdata, shade_constants, shade_ramp);
 					else
-						Loop<SimpleShade, NearestFilter, TextureSizeAny>(thread, texdata, shade_constants);
+						Loop<RampShade, NearestFilter, TextureSizeAny>(thread, texdata, shade_constants, shade_ramp);
 				}
 				else
 				{
 					if (is_64x64)
-						Loop<SimpleShade, LinearFilter, TextureSize64x64>(thread, texdata, shade_constants);
+						Loop<RampShade, LinearFilter, TextureSize64x64>(thread, texdata, shade_constants, shade_ramp);
 					else
-						Loop<SimpleShade, LinearFilter, TextureSizeAny>(thread, texdata, shade_constants);
+						Loop<RampShade, LinearFilter, TextureSizeAny>(thread, texdata, shade_constants, shade_ramp);
+				}
+			}
+			else if (shade_constants.simple_shade)
+			{
+				if (is_nearest_filter)
+				{
+					if (is_64x64)
+						Loop<SimpleShade, NearestFilter, TextureSize64x64>(thread, texdata, shade_constants, nullptr);
+					else
+						Loop<SimpleShade, NearestFilter, TextureSizeAny>(thread, texdata, shade_constants, nullptr);
+				}
+				else
+				{
+					if (is_64x64)
+						Loop<SimpleShade, LinearFilter, TextureSize64x64>(thread, texdata, shade_constants, nullptr);
+					else
+						Loop<SimpleShade, LinearFilter, TextureSizeAny>(thread, texdata, shade_constants, nullptr);
 				}
 			}
 			else
@@ -136,22 +155,22 @@ namespace swrenderer
 				if (is_nearest_filter)
 				{
 					if (is_64x64)
-						Loop<AdvancedShade, NearestFilter, TextureSize64x64>(thread, texdata, shade_constants);
+						Loop<AdvancedShade, NearestFilter, TextureSize64x64>(thread, texdata, shade_constants, nullptr);
 					else
-						Loop<AdvancedShade, NearestFilter, TextureSizeAny>(thread, texdata, shade_constants);
+						Loop<AdvancedShade, NearestFilter, TextureSizeAny>(thread, texdata, shade_constants, nullptr);
 				}
 				else
 				{
 					if (is_64x64)
-						Loop<AdvancedShade, LinearFilter, TextureSize64x64>(thread, texdata, shade_constants);
+						Loop<AdvancedShade, LinearFilter, TextureSize64x64>(thread, texdata, shade_constants, nullptr);
 					else
-						Loop<AdvancedShade, LinearFilter, TextureSizeAny>(thread, texdata, shade_constants);
+						Loop<AdvancedShade, LinearFilter, TextureSizeAny>(thread, texdata, shade_constants, nullptr);
 				}
 			}
 		}
 
 		template<typename ShadeModeT, typename FilterModeT, typename TextureSizeT>
-		FORCEINLINE void Loop(DrawerThread *thread, TextureData texdata, ShadeConstants shade_constants)
+		FORCEINLINE void Loop(DrawerThread *thread, TextureData texdata, ShadeConstants shade_constants, const ShadeRamp *shade_ramp)
 		{
 			using namespace DrawSpan32TModes;
 
@@ -191,7 +210,6 @@ namespace swrenderer
 			float step_viewpos_x = args.dc_viewpos_step.X;
 
 			int count = args.DestX2() - args.DestX1() + 1;
-			int pitch = args.Viewport()->RenderTarget->GetPitch();
 			uint32_t *dest = (uint32_t*)args.Viewport()->GetDest(args.DestX1(), args.DestY());
 
 			if (FilterModeT::Mode == (int)FilterModes::Linear)
@@ -216,7 +234,7 @@ namespace swrenderer
 				}
 
 				uint32_t ifgcolor = Sample<FilterModeT, TextureSizeT>(texdata.width, texdata.height, texdata.xone, texdata.yone, texdata.xstep, texdata.ystep, texdata.xfrac, texdata.yfrac, texdata.source);
-				BgraColor fgcolor = Shade<ShadeModeT>(ifgcolor, light, desaturate, inv_desaturate, shade_fade, shade_light, lights, num_lights, viewpos_x);
+				BgraColor fgcolor = Shade<ShadeModeT>(ifgcolor, light, desaturate, inv_desaturate, shade_fade, shade_light, shade_ramp, lights, num_lights, viewpos_x);
 				BgraColor outcolor = Blend(fgcolor, bgcolor, srcalpha, destalpha, ifgcolor);
 
 				*dest = outcolor;
@@ -291,7 +309,7 @@ namespace swrenderer
 		}
 
 		template<typename ShadeModeT>
-		FORCEINLINE BgraColor Shade(BgraColor fgcolor, uint32_t light, uint32_t desaturate, uint32_t inv_desaturate, BgraColor shade_fade, BgraColor shade_light, const DrawerLight *lights, int num_lights, float viewpos_x)
+		FORCEINLINE BgraColor Shade(BgraColor fgcolor, uint32_t light, uint32_t desaturate, uint32_t inv_desaturate, BgraColor shade_fade, BgraColor shade_light, const ShadeRamp *shade_ramp, const DrawerLight *lights, int num_lights, float viewpos_x)
 		{
 			using namespace DrawSpan32TModes;
 
@@ -302,6 +320,12 @@ namespace swrenderer
 				fgcolor.g = (fgcolor.g * light) >> 8;
 				fgcolor.b = (fgcolor.b * light) >> 8;
 			}
+			else if (ShadeModeT::Mode == (int)ShadeMode::Ramp)
+			{
+				fgcolor.r = shade_ramp->red[fgcolor.r];
+				fgcolor.g = shade_ramp->green[fgcolor.g];
+				fgcolor.b = shade_ramp->blue[fgcolor.b];
+			}
 			else
 			{
 				uint32_t intensity = ((fgcolor.r * 77 + fgcolor.g * 143 + fgcolor.b * 37) >> 8) * desaturate;
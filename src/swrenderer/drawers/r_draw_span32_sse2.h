@@ -41,9 +41,10 @@ namespace swrenderer
 		struct NearestFilter { static const int Mode = (int)FilterModes::Nearest; };
 		struct LinearFilter { static const int Mode = (int)FilterModes::Linear; };
 
-		enum class ShadeMode { Simple, Advanced };
+		enum class ShadeMode { Simple, Advanced, Ramp };
 		struct SimpleShade { static const int Mode = (int)ShadeMode::Simple; };
 		struct AdvancedShade { static const int Mode = (int)ShadeMode::Advanced; };
+		struct RampShade { static const int Mode = (int)ShadeMode::Ramp; };
 
 		enum class SpanTextureSize { SizeAny, Size64x64 };
 		struct TextureSizeAny { static const int Mode = (int)SpanTextureSize::SizeAny; };
@@ -114,21 +115,39 @@ namespace swrenderer
 			bool is_64x64 = texdata.width == 64 && texdata.height == 64;
 			
 			auto shade_constants = args.ColormapConstants();
-			if (shade_constants.simple_shade)
+			const ShadeRamp *shade_ramp = args.ColormapShadeRamp();
+			if (shade_ramp)
 			{
 				if (is_nearest_filter)
 				{
 					if (is_64x64)
-						Loop<SimpleShade, NearestFilter, TextureSize64x64>(thread, texdata, shade_constants);
+						Loop<RampShade, NearestFilter, TextureSize64x64>(thread, texdata, shade_constants, shade_ramp);
 					else
-						Loop<SimpleShade, NearestFilter, TextureSizeAny>(thread, texdata, shade_constants);
+						Loop<RampShade, NearestFilter, TextureSizeAny>(thread, texdata, shade_constants, shade_ramp);
 				}
 				else
 				{
 					if (is_64x64)
-						Loop<SimpleShade, LinearFilter, TextureSize64x64>(thread, texdata, shade_constants);
+						Loop<RampShade, LinearFilter, TextureSize64x64>(thread, texdata, shade_constants, shade_ramp);
 					else
-						Loop<SimpleShade, LinearFilter, TextureSizeAny>(thread, texdata, shade_constants);
+						Loop<RampShade, LinearFilter, TextureSizeAny>(thread, texdata, shade_constants, shade_ramp);
+				}
+			}
+			else if (shade_constants.simple_shade)
+			{
+				if (is_nearest_filter)
+				{
+					if (is_64x64)
+						Loop<SimpleShade, NearestFilter, TextureSize64x64>(thread, texdata, shade_constants, nullptr);
+					else
+						Loop<SimpleShade, NearestFilter, TextureSizeAny>(thread, texdata, shade_constants, nullptr);
+				}
+				else
+				{
+					if (is_64x64)
+						Loop<SimpleShade, LinearFilter, TextureSize64x64>(thread, texdata, shade_constants, nullptr);
+					else
+						Loop<SimpleShade, LinearFilter, TextureSizeAny>(thread, texdata, shade_constants, nullptr);
 				}
 			}
 			else
@@ -136,22 +155,22 @@ namespace swrenderer
 				if (is_nearest_filter)
 				{
 					if (is_64x64)
-						Loop<AdvancedShade, NearestFilter, TextureSize64x64>(thread, texdata, shade_constants);
+						Loop<AdvancedShade, NearestFilter, TextureSize64x64>(thread, texdata, shade_constants, nullptr);
 					else
-						Loop<AdvancedShade, NearestFilter, TextureSizeAny>(thread, texdata, shade_constants);
+						Loop<AdvancedShade, NearestFilter, TextureSizeAny>(thread, texdata, shade_constants, nullptr);
 				}
 				else
 				{
 					if (is_64x64)
-						Loop<AdvancedShade, LinearFilter, TextureSize64x64>(thread, texdata, shade_constants);
+						Loop<AdvancedShade, LinearFilter, TextureSize64x64>(thread, texdata, shade_constants, nullptr);
 					else
-						Loop<AdvancedShade, LinearFilter, TextureSizeAny>(thread, texdata, shade_constants);
+						Loop<AdvancedShade, LinearFilter, TextureSizeAny>(thread, texdata, shade_constants, nullptr);
 				}
 			}
 		}
 
 		template<typename ShadeModeT, typename FilterModeT, typename TextureSizeT>
-		FORCEINLINE void VECTORCALL Loop(DrawerThread *thread, TextureData texdata, ShadeConstants shade_constants)
+		FORCEINLINE void VECTORCALL Loop(DrawerThread *thread, TextureData texdata, ShadeConstants shade_constants, const ShadeRamp *shade_ramp)
 		{
 			using namespace DrawSpan32TModes;
 
@@ -187,7 +206,6 @@ namespace swrenderer
 			__m128 step_viewpos_x = _mm_set1_ps(stepvpx * 2.0f);
 
 			int count = args.DestX2() - args.DestX1() + 1;
-			int pitch = args.Viewport()->RenderTarget->GetPitch();
 			uint32_t *dest = (uint32_t*)args.Viewport()->GetDest(args.DestX1(), args.DestY());
 
 			if (FilterModeT::Mode == (int)FilterModes::Linear)
@@ -225,7 +243,7 @@ namespace swrenderer
 
 				__m128i fgcolor = _mm_unpacklo_epi8(_mm_loadl_epi64((__m128i*)ifgcolor), _mm_setzero_si128());
 
-				fgcolor = Shade<ShadeModeT>(fgcolor, mlight, ifgcolor[0], ifgcolor[1], desaturate, inv_desaturate, shade_fade, shade_light, lights, num_lights, viewpos_x);
+				fgcolor = Shade<ShadeModeT>(fgcolor, mlight, ifgcolor[0], ifgcolor[1], desaturate, inv_desaturate, shade_fade, shade_light, shade_ramp, lights, num_lights, viewpos_x);
 				__m128i outcolor = Blend(fgcolor, bgcolor, srcalpha, destalpha, ifgcolor[0], ifgcolor[1]);
 
 				_mm_storel_epi64((__m128i*)(dest + offset), outcolor);
@@ -254,7 +272,7 @@ namespace swrenderer
 
 				__m128i fgcolor = _mm_unpacklo_epi8(_mm_loadl_epi64((__m128i*)ifgcolor), _mm_setzero_si128());
 
-				fgcolor = Shade<ShadeModeT>(fgcolor, mlight, ifgcolor[0], ifgcolor[1], desaturate, inv_desaturate, shade_fade, shade_light, lights, num_lights, viewpos_x);
+				fgcolor = Shade<ShadeModeT>(fgcolor, mlight, ifgcolor[0], ifgcolor[1], desaturate, inv_desaturate, shade_fade, shade_light, shade_ramp, lights, num_lights, viewpos_x);
 				__m128i outcolor = Blend(fgcolor, bgcolor, srcalpha, destalpha, ifgcolor[0], ifgcolor[1]);
 
 				dest[offset] = _mm_cvtsi128_si32(outcolor);
@@ -325,7 +343,7 @@ namespace swrenderer
 		}
 
 		template<typename ShadeModeT>
-		FORCEINLINE __m128i VECTORCALL Shade(__m128i fgcolor, __m128i mlight, unsigned int ifgcolor0, unsigned int ifgcolor1, int desaturate, __m128i inv_desaturate, __m128i shade_fade, __m128i shade_light, const DrawerLight *lights, int num_lights, __m128 viewpos_x)
+		FORCEINLINE __m128i VECTORCALL Shade(__m128i fgcolor, __m128i mlight, unsigned int ifgcolor0, unsigned int ifgcolor1, int desaturate, __m128i inv_desaturate, __m128i shade_fade, __m128i shade_light, const ShadeRamp *shade_ramp, const DrawerLight *lights, int num_lights, __m128 viewpos_x)
 		{
 			using namespace DrawSpan32TModes;
 
@@ -334,6 +352,12 @@ namespace swrenderer
 			{
 				fgcolor = _mm_srli_epi16(_mm_mullo_epi16(fgcolor, mlight), 8);
 			}
+			else if (ShadeModeT::Mode == (int)ShadeMode::Ramp)
+			{
+				fgcolor = _mm_set_epi16(
+					APART(ifgcolor1), shade_ramp->red[RPART(ifgcolor1)], shade_ramp->green[GPART(ifgcolor1)], shade_ramp->blue[BPART(ifgcolor1)],
+					APART(ifgcolor0), shade_ramp->red[RPART(ifgcolor0)], shade_ramp->green[GPART(ifgcolor0)], shade_ramp->blue[BPART(ifgcolor0)]);
+			}
 			else
 			{
 				int blue0 = BPART(ifgcolor0);
@@ -40,9 +40,10 @@ namespace swrenderer
 		struct NearestFilter { static const int Mode = (int)FilterModes::Nearest; };
 		struct LinearFilter { static const int Mode = (int)FilterModes::Linear; };
 
-		enum class ShadeMode { Simple, Advanced };
+		enum class ShadeMode { Simple, Advanced, Ramp };
 		struct SimpleShade { static const int Mode = (int)ShadeMode::Simple; };
 		struct AdvancedShade { static const int Mode = (int)ShadeMode::Advanced; };
+		struct RampShade { static const int Mode = (int)ShadeMode::Ramp; };
 	}
 
 	template<typename BlendT>
@@ -61,24 +62,32 @@ namespace swrenderer
 			const uint32_t *source2 = (const uint32_t*)args.TexturePixels2();
 			bool is_nearest_filter = (source2 == nullptr);
 			auto shade_constants = args.ColormapConstants();
-			if (shade_constants.simple_shade)
+			const ShadeRamp *shade_ramp = args.ColormapShadeRamp();
+			if (shade_ramp)
 			{
 				if (is_nearest_filter)
-					Loop<SimpleShade, NearestFilter>(thread, shade_constants);
+					Loop<RampShade, NearestFilter>(thread, shade_constants, shade_ramp);
 				else
-					Loop<SimpleShade, LinearFilter>(thread, shade_constants);
+					Loop<RampShade, LinearFilter>(thread, shade_constants, shade_ramp);
+			}
+			else if (shade_constants.simple_shade)
+			{
+				if (is_nearest_filter)
+					Loop<SimpleShade, NearestFilter>(thread, shade_constants, nullptr);
+				else
+					Loop<SimpleShade, LinearFilter>(thread, shade_constants, nullptr);
 			}
 			else
 			{
 				if (is_nearest_filter)
-					Loop<AdvancedShade, NearestFilter>(thread, shade_constants);
+					Loop<AdvancedShade, NearestFilter>(thread, shade_constants, nullptr);
 				else
-					Loop<AdvancedShade, LinearFilter>(thread, shade_constants);
+					Loop<AdvancedShade, LinearFilter>(thread, shade_constants, nullptr);
 			}
 		}
 
 		template<typename ShadeModeT, typename FilterModeT>
-		FORCEINLINE void Loop(DrawerThread *thread, ShadeConstants shade_constants)
+		FORCEINLINE void Loop(DrawerThread *thread, ShadeConstants shade_constants, const ShadeRamp *shade_ramp)
 		{
 			using namespace DrawWall32TModes;
 
@@ -158,7 +167,7 @@ namespace swrenderer
 				}
 
 				uint32_t ifgcolor = Sample<FilterModeT>(frac, source, source2, textureheight, one, texturefracx);
-				BgraColor fgcolor = Shade<ShadeModeT>(ifgcolor, light, desaturate, inv_desaturate, shade_fade, shade_light, lights, num_lights, viewpos_z);
+				BgraColor fgcolor = Shade<ShadeModeT>(ifgcolor, light, desaturate, inv_desaturate, shade_fade, shade_light, shade_ramp, lights, num_lights, viewpos_z);
 				BgraColor outcolor = Blend(fgcolor, bgcolor, ifgcolor, srcalpha, destalpha);
 
 				*dest = outcolor;
@@ -205,7 +214,7 @@ namespace swrenderer
 		}
 
 		template<typename ShadeModeT>
-		FORCEINLINE BgraColor Shade(BgraColor fgcolor, uint32_t light, uint32_t desaturate, uint32_t inv_desaturate, BgraColor shade_fade, BgraColor shade_light, const DrawerLight *lights, int num_lights, float viewpos_z)
+		FORCEINLINE BgraColor Shade(BgraColor fgcolor, uint32_t light, uint32_t desaturate, uint32_t inv_desaturate, BgraColor shade_fade, BgraColor shade_light, const ShadeRamp *shade_ramp, const DrawerLight *lights, int num_lights, float viewpos_z)
 		{
 			using namespace DrawWall32TModes;
 
@@ -216,6 +225,12 @@ namespace swrenderer
 				fgcolor.g = (fgcolor.g * light) >> 8;
 				fgcolor.b = (fgcolor.b * light) >> 8;
 			}
+			else if (ShadeModeT::Mode == (int)ShadeMode::Ramp)
+			{
+				fgcolor.r = shade_ramp->red[fgcolor.r];
+				fgcolor.g = shade_ramp->green[fgcolor.g];
+				fgcolor.b = shade_ramp->blue[fgcolor.b];
+			}
 			else
 			{
 				uint32_t intensity = ((fgcolor.r * 77 + fgcolor.g * 143 + fgcolor.b * 37) >> 8) * desaturate;
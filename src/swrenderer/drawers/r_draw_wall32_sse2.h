@@ -40,9 +40,10 @@ namespace swrenderer
 		struct NearestFilter { static const int Mode = (int)FilterModes::Nearest; };
 		struct LinearFilter { static const int Mode = (int)FilterModes::Linear; };
 
-		enum class ShadeMode { Simple, Advanced };
+		enum class ShadeMode { Simple, Advanced, Ramp };
 		struct SimpleShade { static const int Mode = (int)ShadeMode::Simple; };
 		struct AdvancedShade { static const int Mode = (int)ShadeMode::Advanced; };
+		struct RampShade { static const int Mode = (int)ShadeMode::Ramp; };
 	}
 
 	template<typename BlendT>
@@ -61,24 +62,32 @@ namespace swrenderer
 			const uint32_t *source2 = (const uint32_t*)args.TexturePixels2();
 			bool is_nearest_filter = (source2 == nullptr);
 			auto shade_constants = args.ColormapConstants();
-			if (shade_constants.simple_shade)
+			const ShadeRamp *shade_ramp = args.ColormapShadeRamp();
+			if (shade_ramp)
 			{
 				if (is_nearest_filter)
-					Loop<SimpleShade, NearestFilter>(thread, shade_constants);
+					Loop<RampShade, NearestFilter>(thread, shade_constants, shade_ramp);
 				else
-					Loop<SimpleShade, LinearFilter>(thread, shade_constants);
+					Loop<RampShade, LinearFilter>(thread, shade_constants, shade_ramp);
+			}
+			else if (shade_constants.simple_shade)
+			{
+				if (is_nearest_filter)
+					Loop<SimpleShade, NearestFilter>(thread, shade_constants, nullptr);
+				else
+					Loop<SimpleShade, LinearFilter>(thread, shade_constants, nullptr);
 			}
 			else
 			{
 				if (is_nearest_filter)
-					Loop<AdvancedShade, NearestFilter>(thread, shade_constants);
+					Loop<AdvancedShade, NearestFilter>(thread, shade_constants, nullptr);
 				else
-					Loop<AdvancedShade, LinearFilter>(thread, shade_constants);
+					Loop<AdvancedShade, LinearFilter>(thread, shade_constants, nullptr);
 			}
 		}
 
 		template<typename ShadeModeT, typename FilterModeT>
-		FORCEINLINE void VECTORCALL Loop(DrawerThread *thread, ShadeConstants shade_constants)
+		FORCEINLINE void VECTORCALL Loop(DrawerThread *thread, ShadeConstants shade_constants, const ShadeRamp *shade_ramp)
 		{
 			using namespace DrawWall32TModes;
 
@@ -168,7 +177,7 @@ namespace swrenderer
 
 				__m128i fgcolor = _mm_unpacklo_epi8(_mm_loadl_epi64((__m128i*)ifgcolor), _mm_setzero_si128());
 
-				fgcolor = Shade<ShadeModeT>(fgcolor, mlight, ifgcolor[0], ifgcolor[1], desaturate, inv_desaturate, shade_fade, shade_light, lights, num_lights, viewpos_z);
+				fgcolor = Shade<ShadeModeT>(fgcolor, mlight, ifgcolor[0], ifgcolor[1], desaturate, inv_desaturate, shade_fade, shade_light, shade_ramp, lights, num_lights, viewpos_z);
 				__m128i outcolor = Blend(fgcolor, bgcolor, ifgcolor[0], ifgcolor[1], srcalpha, destalpha);
 
 				_mm_storel_epi64((__m128i*)desttmp, outcolor);
@@ -197,7 +206,7 @@ namespace swrenderer
 				ifgcolor[1] = 0;
 				__m128i fgcolor = _mm_unpacklo_epi8(_mm_loadl_epi64((__m128i*)ifgcolor), _mm_setzero_si128());
 
-				fgcolor = Shade<ShadeModeT>(fgcolor, mlight, ifgcolor[0], ifgcolor[1], desaturate, inv_desaturate, shade_fade, shade_light, lights, num_lights, viewpos_z);
+				fgcolor = Shade<ShadeModeT>(fgcolor, mlight, ifgcolor[0], ifgcolor[1], desaturate, inv_desaturate, shade_fade, shade_light, shade_ramp, lights, num_lights, viewpos_z);
 				__m128i outcolor = Blend(fgcolor, bgcolor, ifgcolor[0], ifgcolor[1], srcalpha, destalpha);
 
 				dest[offset] = _mm_cvtsi128_si32(outcolor);
@@ -241,7 +250,7 @@ namespace swrenderer
 		}
 
 		template<typename ShadeModeT>
-		FORCEINLINE __m128i VECTORCALL Shade(__m128i fgcolor, __m128i mlight, unsigned int ifgcolor0, unsigned int ifgcolor1, int desaturate, __m128i inv_desaturate, __m128i shade_fade, __m128i shade_light, const DrawerLight *lights, int num_lights, __m128 viewpos_z)
+		FORCEINLINE __m128i VECTORCALL Shade(__m128i fgcolor, __m128i mlight, unsigned int ifgcolor0, unsigned int ifgcolor1, int desaturate, __m128i inv_desaturate, __m128i shade_fade, __m128i shade_light, const ShadeRamp *shade_ramp, const DrawerLight *lights, int num_lights, __m128 viewpos_z)
 		{
 			using namespace DrawWall32TModes;
 
@@ -250,6 +259,12 @@ namespace swrenderer
 			{
 				fgcolor = _mm_srli_epi16(_mm_mullo_epi16(fgcolor, mlight), 8);
 			}
+			else if (ShadeModeT::Mode == (int)ShadeMode::Ramp)
+			{
+				fgcolor = _mm_set_epi16(
+					APART(ifgcolor1), shade_ramp->red[RPART(ifgcolor1)], shade_ramp->green[GPART(ifgcolor1)], shade_ramp->blue[BPART(ifgcolor1)],
+					APART(ifgcolor0), shade_ramp->red[RPART(ifgcolor0)], shade_ramp->green[GPART(ifgcolor0)], shade_ramp->blue[BPART(ifgcolor0)]);
+			}
 			else
 			{
 				int blue0 = BPART(ifgcolor0);
@@ -3,6 +3,7 @@
 #include "r_swcanvas.cpp"
 #include "r_swrenderer.cpp"
 #include "r_swcolormaps.cpp"
+#include "r_swbenchmark.cpp"
 #include "drawers/r_draw.cpp"
 #include "drawers/r_draw_pal.cpp"
 #include "drawers/r_draw_rgba.cpp"
@@ -0,0 +1,289 @@
+//
+//---------------------------------------------------------------------------
+//
+// Copyright(C) 2017 The GZDoom Development Team
+// All rights reserved.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program.  If not, see http://www.gnu.org/licenses/
+//
+//--------------------------------------------------------------------------
+//
+/*
+** r_swbenchmark.cpp
+** Offscreen render benchmark for the software renderers
+**
+** Usage:
+**
+**   -benchrender <demo>  plays back a demo and renders every tic offscreen
+**                        with each renderer listed in bench_modes
+**   benchrender [frames] renders a full turn around the current camera position
+**
+** The report lists frame time percentiles, the split between scene setup and
+** waiting for the drawers, and a checksum of all rendered frames.
+**
+*/
+
+#include <algorithm>
+#include "templates.h"
+#include "doomstat.h"
+#include "i_system.h"
+#include "d_player.h"
+#include "g_game.h"
+#include "c_cvars.h"
+#include "c_dispatch.h"
+#include "v_video.h"
+#include "m_crc32.h"
+#include "r_utility.h"
+#include "r_renderer.h"
+#include "stats.h"
+#include "swrenderer/r_swrenderer.h"
+#include "swrenderer/r_swbenchmark.h"
+#include "swrenderer/scene/r_scene.h"
+#include "polyrenderer/poly_renderer.h"
+
+CVAR(Int, bench_width, 640, 0)
+CVAR(Int, bench_height, 400, 0)
+CVAR(String, bench_modes, "sw,swtruecolor,poly", 0)
+CVAR(Bool, bench_checksums, false, 0)
+
+EXTERN_CVAR(Bool, swtruecolor)
+
+extern int currentrenderer;
+
+namespace
+{
+	struct BenchmarkMode
+	{
+		FString Name;
+		bool Bgra = false;
+		bool Poly = false;
+		DSimpleCanvas *Canvas = nullptr;
+		TArray<double> FrameTimes;
+		TArray<double> DrawerTimes;
+		uint32_t Checksum = 0;
+	};
+
+	bool BenchmarkActive;
+	TArray<BenchmarkMode> BenchmarkModes;
+
+	void FreeBenchmarkModes()
+	{
+		for (auto &mode : BenchmarkModes)
+			delete mode.Canvas;
+		BenchmarkModes.Clear();
+	}
+
+	bool InitBenchmarkModes()
+	{
+		FreeBenchmarkModes();
+
+		if (currentrenderer != 0)
+		{
+			Printf("The render benchmark requires the software renderer (vid_renderer 0)\n");
+			return false;
+		}
+
+		int width = clamp<int>(bench_width, 16, MAXWIDTH);
+		int height = clamp<int>(bench_height, 16, MAXHEIGHT);
+
+		FString modes = *bench_modes;
+		for (auto &name : modes.Split(","))
+		{
+			name.StripLeftRight();
+
+			BenchmarkMode mode;
+			mode.Name = name;
+			if (name.CompareNoCase("sw") == 0)
+			{
+			}
+			else if (name.CompareNoCase("swtruecolor") == 0)
+			{
+				mode.Bgra = true;
+			}
+			else if (name.CompareNoCase("poly") == 0)
+			{
+				mode.Bgra = swtruecolor;
+				mode.Poly = true;
+			}
+			else
+			{
+				Printf("Unknown benchmark mode '%s'\n", name.GetChars());
+				continue;
+			}
+			mode.Canvas = new DSimpleCanvas(width, height, mode.Bgra);
+			BenchmarkModes.Push(mode);
+		}
+
+		if (BenchmarkModes.Size() == 0)
+		{
+			Printf("No render benchmark modes selected\n");
+			return false;
+		}
+		return true;
+	}
+
+	uint32_t CanvasChecksum(DCanvas *canvas, uint32_t crc)
+	{
+		int bytesperpixel = canvas->IsBgra() ? 4 : 1;
+		const uint8_t *pixels = canvas->GetBuffer();
+		for (int y = 0; y < canvas->GetHeight(); y++)
+		{
+			crc = AddCRC32(crc, pixels, canvas->GetWidth() * bytesperpixel);
+			pixels += canvas->GetPitch() * bytesperpixel;
+		}
+		return crc;
+	}
+
+	double Percentile(const TArray<double> &sorted, double percent)
+	{
+		unsigned int index = (unsigned int)(percent / 100.0 * (sorted.Size() - 1) + 0.5);
+		return sorted[MIN(index, sorted.Size() - 1)];
+	}
+
+	void RenderBenchmarkFrame(AActor *camera)
+	{
+		FSoftwareRenderer *renderer = static_cast<FSoftwareRenderer*>(Renderer);
+
+		DAngle fov = 90.f;
+		if (camera->player)
+			fov = camera->player->FOV;
+		else fov = camera->CameraFOV;
+		R_SetFOV(r_viewpoint, fov);
+
+		// Render exactly the current camera state so checksums are reproducible
+		R_ResetViewInterpolation();
+
+		for (auto &mode : BenchmarkModes)
+		{
+			cycle_t frametime;
+			frametime.Reset();
+			frametime.Clock();
+			renderer->RenderViewToCanvas(camera, mode.Canvas, mode.Poly);
+			frametime.Unclock();
+
+			double drawertime = mode.Poly ? PolyDrawerWaitCycles.TimeMS() : swrenderer::DrawerWaitCycles.TimeMS();
+			mode.FrameTimes.Push(frametime.TimeMS());
+			mode.DrawerTimes.Push(drawertime);
+
+			uint32_t checksum = CanvasChecksum(mode.Canvas, 0);
+			mode.Checksum = CanvasChecksum(mode.Canvas, mode.Checksum);
+			if (bench_checksums)
+				Printf(PRINT_LOG, "bench %s frame %u: %08x\n", mode.Name.GetChars(), mode.FrameTimes.Size() - 1, checksum);
+		}
+	}
+}
+
+//==========================================================================
+//
+// Benchmark a demo. Each tic gets rendered offscreen by all selected
+// renderers while the regular display is skipped like with -nodraw.
+//
+//==========================================================================
+
+bool R_BenchmarkActive()
+{
+	return BenchmarkActive;
+}
+
+void R_BenchmarkDemo(const char *demoname)
+{
+	if (!InitBenchmarkModes())
+		I_FatalError("Could not start the render benchmark\n");
+
+	G_TimeDemo(demoname);
+	nodrawers = true;
+	BenchmarkActive = true;
+}
+
+void R_BenchmarkFrame()
+{
+	if (!BenchmarkActive || gamestate != GS_LEVEL || gametic == 0)
+		return;
+
+	AActor *camera = players[consoleplayer].camera;
+	if (camera == nullptr)
+		camera = players[consoleplayer].mo;
+	if (camera == nullptr)
+		return;
+
+	RenderBenchmarkFrame(camera);
+}
+
+void R_BenchmarkReport()
+{
+	for (auto &mode : BenchmarkModes)
+	{
+		unsigned int count = mode.FrameTimes.Size();
+		if (count == 0)
+		{
+			Printf("%s: no frames rendered\n", mode.Name.GetChars());
+			continue;
+		}
+
+		double frametotal = 0.0, drawertotal = 0.0;
+		for (unsigned int i = 0; i < count; i++)
+		{
+			frametotal += mode.FrameTimes[i];
+			drawertotal += mode.DrawerTimes[i];
+		}
+
+		TArray<double> sorted = mode.FrameTimes;
+		std::sort(sorted.begin(), sorted.end());
+
+		Printf("%s: %u frames at %dx%d, avg=%.2f ms  p50=%.2f ms  p90=%.2f ms  p99=%.2f ms  max=%.2f ms\n",
+			mode.Name.GetChars(), count, mode.Canvas->GetWidth(), mode.Canvas->GetHeight(),
+			frametotal / count, Percentile(sorted, 50.0), Percentile(sorted, 90.0), Percentile(sorted, 99.0), sorted[count - 1]);
+		Printf("%s: scene=%.2f ms  drawers=%.2f ms  checksum=%08x\n",
+			mode.Name.GetChars(), (frametotal - drawertotal) / count, drawertotal / count, mode.Checksum);
+	}
+
+	FreeBenchmarkModes();
+	BenchmarkActive = false;
+}
+
+//==========================================================================
+//
+// Benchmark a fixed camera path: one full turn around the current camera
+//
+//==========================================================================
+
+CCMD(benchrender)
+{
+	if (gamestate != GS_LEVEL || players[consoleplayer].camera == nullptr)
+	{
+		Printf("benchrender can only be used inside a level\n");
+		return;
+	}
+
+	int frames = argv.argc() > 1 ? atoi(argv[1]) : 360;
+	if (frames <= 0)
+		return;
+
+	if (!InitBenchmarkModes())
+		return;
+
+	AActor *camera = players[consoleplayer].camera;
+	DRotator savedangles = camera->Angles;
+	DAngle startyaw = camera->Angles.Yaw;
+
+	BenchmarkActive = true;
+	for (int i = 0; i < frames; i++)
+	{
+		camera->Angles.Yaw = startyaw + 360. * i / frames;
+		RenderBenchmarkFrame(camera);
+	}
+	camera->Angles = savedangles;
+
+	R_BenchmarkReport();
+}
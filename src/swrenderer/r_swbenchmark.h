@@ -0,0 +1,33 @@
+//
+//---------------------------------------------------------------------------
+//
+// Copyright(C) 2017 The GZDoom Development Team
+// All rights reserved.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program.  If not, see http://www.gnu.org/licenses/
+//
+//--------------------------------------------------------------------------
+//
+
+#pragma once
+
+// Offscreen render benchmark for the software, truecolor and poly renderers.
+//
+// Frames are rendered into system memory canvases instead of the screen, so the
+// benchmark can run without presenting anything (for example with SDL_VIDEODRIVER=dummy).
+
+bool R_BenchmarkActive();
+void R_BenchmarkDemo(const char *demoname);
+void R_BenchmarkFrame();
+void R_BenchmarkReport();
@@ -51,11 +51,13 @@
 #include "colormatcher.h"
 #include "r_data/colormaps.h"
 #include "r_swcolormaps.h"
+#include "swrenderer/viewport/r_drawerargs.h"
 #include "v_video.h"
 #include "templates.h"
 #include "r_utility.h"
 #include "r_renderer.h"
 #include <atomic>
+#include <mutex>
 
 FDynamicColormap NormalLight;
 FDynamicColormap FullNormalLight; //[SP] Emulate GZDoom brightness
@@ -154,6 +156,8 @@ void FDynamicColormap::BuildLights ()
 	PalEntry colors[256], basecolors[256];
 	uint8_t *shade;
 
+	swrenderer::DrawerArgs::UpdateShadeRamps(this);
+
 	if (Maps == NULL)
 		return;
 
@@ -454,6 +458,12 @@ static void InitBoomColormaps ()
 static void DeinitSWColorMaps()
 {
 	FreeSpecialLights();
+	swrenderer::DrawerArgs::FreeShadeRamps();
+	NormalLight.ShadeRamps = nullptr;
+	FullNormalLight.ShadeRamps = nullptr;
+	realcolormaps.ShadeRamps = nullptr;
+	realfbcolormaps.ShadeRamps = nullptr;
+	for (auto &cm : SpecialSWColormaps) cm.ShadeRamps = nullptr;
 	if (realcolormaps.Maps != nullptr)
 	{
 		delete[] realcolormaps.Maps;
@@ -497,6 +507,11 @@ void InitSWColorMaps()
 	{
 		SpecialSWColormaps[i].Maps = SpecialColormaps[i].Colormap;
 	}
+
+	swrenderer::DrawerArgs::UpdateShadeRamps(&NormalLight);
+	swrenderer::DrawerArgs::UpdateShadeRamps(&FullNormalLight);
+	swrenderer::DrawerArgs::UpdateShadeRamps(&realcolormaps);
+	for (auto &cm : SpecialSWColormaps) swrenderer::DrawerArgs::UpdateShadeRamps(&cm);
 }
 
 //==========================================================================
@@ -3,12 +3,15 @@
 
 #include "g_levellocals.h"
 
+namespace swrenderer { struct ShadeRampSet; }
+
 struct FSWColormap
 {
 	uint8_t *Maps = nullptr;
 	PalEntry Color = 0xffffffff;
 	PalEntry Fade = 0xff000000;
 	int Desaturate = 0;
+	swrenderer::ShadeRampSet *ShadeRamps = nullptr;	// truecolor shade ramps for Color and Fade, built with the colormap
 };
 
 struct FDynamicColormap : FSWColormap
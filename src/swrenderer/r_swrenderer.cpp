@@ -45,9 +45,11 @@
 #include "scene/r_3dfloors.h"
 #include "scene/r_portal.h"
 #include "textures/textures.h"
+#include "textures/precachedecoder.h"
 #include "r_data/voxels.h"
 #include "drawers/r_draw_rgba.h"
 #include "polyrenderer/poly_renderer.h"
+#include "polyrenderer/scene/poly_plane.h"
 #include "p_setup.h"
 #include "g_levellocals.h"
 
@@ -164,10 +166,25 @@ void FSoftwareRenderer::Precache(uint8_t *texhitlist, TMap<PClassActor*, bool> &
 	delete[] spritelist;
 
 	int cnt = TexMan.NumTextures();
+
+	// Only the true color images can be decoded in the background
+	if (screen->IsBgra())
+	{
+		TArray<FTexture *> decodelist;
+		for (int i = cnt - 1; i >= 0; i--)
+		{
+			if (texhitlist[i] != 0)
+				decodelist.Push(TexMan.ByIndex(i));
+		}
+		FPrecacheDecoder::Start(decodelist);
+	}
+
 	for (int i = cnt - 1; i >= 0; i--)
 	{
-		PrecacheTexture(TexMan.ByIndex(i), texhitlist[i]);
+		// Textures that were never created have nothing to unload
+		PrecacheTexture(texhitlist[i] ? TexMan.ByIndex(i) : TexMan.ByIndexIfCreated(i), texhitlist[i]);
 	}
+	FPrecacheDecoder::Finish();
 }
 
 void FSoftwareRenderer::RenderView(player_t *player)
@@ -227,6 +244,26 @@ void FSoftwareRenderer::WriteSavePic (player_t *player, FileWriter *file, int wi
 	M_CreatePNG (file, pic.GetBuffer(), palette, SS_PAL, width, height, pic.GetPitch(), Gamma);
 }
 
+void FSoftwareRenderer::RenderViewToCanvas(AActor *viewpoint, DCanvas *canvas, bool polyrenderer)
+{
+	if (polyrenderer)
+	{
+		PolyRenderer::Instance()->Viewpoint = r_viewpoint;
+		PolyRenderer::Instance()->Viewwindow = r_viewwindow;
+		PolyRenderer::Instance()->RenderViewToCanvas(viewpoint, canvas, 0, 0, canvas->GetWidth(), canvas->GetHeight(), true);
+		r_viewpoint = PolyRenderer::Instance()->Viewpoint;
+		r_viewwindow = PolyRenderer::Instance()->Viewwindow;
+	}
+	else
+	{
+		mScene.MainThread()->Viewport->viewpoint = r_viewpoint;
+		mScene.MainThread()->Viewport->viewwindow = r_viewwindow;
+		mScene.RenderViewToCanvas(viewpoint, canvas, 0, 0, canvas->GetWidth(), canvas->GetHeight(), true);
+		r_viewpoint = mScene.MainThread()->Viewport->viewpoint;
+		r_viewwindow = mScene.MainThread()->Viewport->viewwindow;
+	}
+}
+
 void FSoftwareRenderer::DrawRemainingPlayerSprites()
 {
 	if (!r_polyrenderer)
@@ -375,6 +412,7 @@ void FSoftwareRenderer::PreprocessLevel()
 
 void FSoftwareRenderer::CleanLevelData()
 {
+	PolyPlaneVertexCache::Instance()->Clear();
 }
 
 uint32_t FSoftwareRenderer::GetCaps()
@@ -74,6 +74,8 @@
 EXTERN_CVAR(Bool, r_fullbrightignoresectorcolor);
 EXTERN_CVAR(Bool, r_drawvoxels);
 EXTERN_CVAR(Bool, r_debug_disable_vis_filter);
+
+CVAR(Bool, r_coverageculling, true, 0);
 extern uint32_t r_renderercaps;
 
 namespace
@@ -20,6 +20,7 @@
 //-----------------------------------------------------------------------------
 
 #include <stdlib.h>
+#include <string.h>
 #include "templates.h"
 #include "doomdef.h"
 #include "m_bbox.h"
@@ -49,6 +50,73 @@ namespace swrenderer
 		solidsegs[1].first = right;
 		solidsegs[1].last = 0x7fff;
 		newend = solidsegs+2;
+
+		memset(CoverageColumns, 0, sizeof(CoverageColumns));
+		memset(CoverageBlocks, 0, sizeof(CoverageBlocks));
+		MarkCovered(-0x7fff, left);
+		MarkCovered(right, 0x7fff);
+	}
+
+	// Mask with bits first to last (inclusive) set
+	static inline uint64_t CoverageMask(int first, int last)
+	{
+		return (~(uint64_t)0 << first) & (~(uint64_t)0 >> (63 - last));
+	}
+
+	void RenderClipSegment::MarkCovered(int x1, int x2)
+	{
+		x1 = MAX(x1, 0);
+		x2 = MIN(x2, (int)MAXWIDTH);
+		if (x1 >= x2)
+			return;
+
+		int w0 = x1 >> 6;
+		int w1 = (x2 - 1) >> 6;
+		for (int w = w0; w <= w1; w++)
+		{
+			uint64_t mask = CoverageMask(w == w0 ? (x1 & 63) : 0, w == w1 ? ((x2 - 1) & 63) : 63);
+			CoverageColumns[w] |= mask;
+			if (CoverageColumns[w] == ~(uint64_t)0)
+				CoverageBlocks[w >> 6] |= (uint64_t)1 << (w & 63);
+		}
+	}
+
+	bool RenderClipSegment::IsCovered(int x1, int x2) const
+	{
+		x1 = MAX(x1, 0);
+		x2 = MIN(x2, (int)MAXWIDTH);
+		if (x1 >= x2)
+			return true;
+
+		int w0 = x1 >> 6;
+		int w1 = (x2 - 1) >> 6;
+
+		if (w0 == w1)
+		{
+			uint64_t mask = CoverageMask(x1 & 63, (x2 - 1) & 63);
+			return (CoverageColumns[w0] & mask) == mask;
+		}
+
+		uint64_t mask0 = CoverageMask(x1 & 63, 63);
+		uint64_t mask1 = CoverageMask(0, (x2 - 1) & 63);
+		if ((CoverageColumns[w0] & mask0) != mask0 || (CoverageColumns[w1] & mask1) != mask1)
+			return false;
+
+		// Whole words in between are tested 64 at a time using the block level
+		int first = w0 + 1;
+		int last = w1 - 1;
+		if (first > last)
+			return true;
+
+		int b0 = first >> 6;
+		int b1 = last >> 6;
+		for (int b = b0; b <= b1; b++)
+		{
+			uint64_t mask = CoverageMask(b == b0 ? (first & 63) : 0, b == b1 ? (last & 63) : 63);
+			if ((CoverageBlocks[b] & mask) != mask)
+				return false;
+		}
+		return true;
 	}
 
 	bool RenderClipSegment::Check(int first, int last)
@@ -118,6 +186,7 @@ namespace swrenderer
 				// Insert a new clippost for solid walls.
 				if (solid)
 				{
+					MarkCovered(first, last);
 					if (last == start->first)
 					{
 						start->first = first;
@@ -141,6 +210,7 @@ namespace swrenderer
 			// There is a fragment above *start.
 			if (visitor->RenderWallSegment(first, start->first) && solid)
 			{
+				MarkCovered(first, start->first);
 				start->first = first; // Adjust the clip size for solid walls
 			}
 		}
@@ -176,6 +246,7 @@ namespace swrenderer
 		if (solid)
 		{
 			// Adjust the clip size.
+			MarkCovered(start->last, last);
 			start->last = last;
 
 			if (next != start)
@@ -39,6 +39,10 @@ namespace swrenderer
 		bool Clip(int x1, int x2, bool solid, VisibleSegmentRenderer *visitor);
 		bool Check(int first, int last);
 		bool IsVisible(int x1, int x2);
+
+		// True if solid walls already cover all columns from x1 to x2 (exclusive).
+		// Used to reject sprites and particles before projecting them.
+		bool IsCovered(int x1, int x2) const;
 		
 	private:
 		struct cliprange_t
@@ -46,7 +50,19 @@ namespace swrenderer
 			short first, last;
 		};
 
+		void MarkCovered(int x1, int x2);
+
 		cliprange_t *newend; // newend is one past the last valid seg
 		cliprange_t solidsegs[MAXWIDTH / 2 + 2];
+
+		// Coverage buffer mirroring the solid segs. Each bit in CoverageColumns is one
+		// column, and each bit in CoverageBlocks marks a fully covered 64 column word.
+		enum
+		{
+			CoverageWords = (MAXWIDTH + 63) / 64,
+			CoverageBlockWords = (CoverageWords + 63) / 64
+		};
+		uint64_t CoverageColumns[CoverageWords];
+		uint64_t CoverageBlocks[CoverageBlockWords];
 	};
 }
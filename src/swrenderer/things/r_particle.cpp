@@ -64,8 +64,10 @@
 #include "swrenderer/drawers/r_draw_pal.h"
 #include "swrenderer/r_memory.h"
 #include "swrenderer/r_renderthread.h"
+#include "swrenderer/segments/r_clipsegment.h"
 
 EXTERN_CVAR(Bool, r_fullbrightignoresectorcolor);
+EXTERN_CVAR(Bool, r_coverageculling);
 
 namespace swrenderer
 {
@@ -125,6 +127,9 @@ namespace swrenderer
 
 		if (x1 >= x2)
 			return;
+
+		if (r_coverageculling && thread->ClipSegments->IsCovered(x1, x2))
+			return;
 		
 		auto viewport = thread->Viewport.get();
 
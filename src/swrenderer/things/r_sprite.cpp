@@ -64,11 +64,13 @@
 #include "swrenderer/viewport/r_viewport.h"
 #include "swrenderer/r_memory.h"
 #include "swrenderer/r_renderthread.h"
+#include "swrenderer/segments/r_clipsegment.h"
 #include "a_dynlight.h"
 #include "r_data/r_vanillatrans.h"
 
 EXTERN_CVAR(Bool, r_fullbrightignoresectorcolor)
 EXTERN_CVAR(Bool, gl_light_sprites)
+EXTERN_CVAR(Bool, r_coverageculling)
 
 namespace swrenderer
 {
@@ -168,6 +170,10 @@ namespace swrenderer
 		if ((x2 < renderportal->WindowLeft || x2 <= x1))
 			return;
 
+		// hidden behind solid walls drawn so far?
+		if (r_coverageculling && thread->ClipSegments->IsCovered(x1, x2))
+			return;
+
 		xscale = spriteScale.X * xscale / tex->Scale.X;
 		fixed_t iscale = (fixed_t)(FRACUNIT / xscale); // Round towards zero to avoid wrapping in edge cases
 
@@ -33,6 +33,7 @@
 #include "swrenderer/things/r_visiblesprite.h"
 #include "swrenderer/things/r_visiblespritelist.h"
 #include "swrenderer/r_memory.h"
+#include "r_data/r_radixsort.h"
 
 namespace swrenderer
 {
@@ -83,9 +84,20 @@ namespace swrenderer
 				SortedSprites[i] = Sprites[first + count - i - 1];
 		}
 
-		std::stable_sort(&SortedSprites[0], &SortedSprites[count], [](VisibleSprite *a, VisibleSprite *b) -> bool
+		// Sort on depth with the array position as tiebreak. The radix sort is stable,
+		// so this gives the same order as a stable sort with SortDist() as the key.
+		SortItems.Resize(count);
+		for (unsigned int i = 0; i < count; i++)
 		{
-			return a->SortDist() > b->SortDist();
-		});
+			SortItems[i].Key = ~FRadixSorter::FloatKey(SortedSprites[i]->SortDist());
+			SortItems[i].Value = i;
+		}
+
+		Sorter.Sort(SortItems);
+
+		UnsortedSprites.Resize(count);
+		memcpy(&UnsortedSprites[0], &SortedSprites[0], count * sizeof(VisibleSprite *));
+		for (unsigned int i = 0; i < count; i++)
+			SortedSprites[i] = UnsortedSprites[SortItems[i].Value];
 	}
 }
@@ -1,5 +1,7 @@
 #pragma once
 
+#include "r_data/r_radixsort.h"
+
 namespace swrenderer
 {
 	struct DrawSegment;
@@ -19,5 +21,8 @@ namespace swrenderer
 	private:
 		TArray<VisibleSprite *> Sprites;
 		TArray<unsigned int> StartIndices;
+		TArray<VisibleSprite *> UnsortedSprites;
+		TArray<FRadixSortItem> SortItems;
+		FRadixSorter Sorter;
 	};
 }
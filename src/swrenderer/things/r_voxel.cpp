@@ -608,6 +608,16 @@ namespace swrenderer
 										break;
 								}
 
+								// Extend the previous block if this one continues it (happens across strip boundaries)
+								VoxelBlock *prevblock = nextoutblock > 0 ? &outblocks[nextoutblock - 1] : nullptr;
+								if (prevblock && prevblock->x + prevblock->width == lxt + xxl && prevblock->y == z1 && prevblock->height == z2 - z1 &&
+									prevblock->vPos == yplc[xxl] && prevblock->vStep == yinc && prevblock->voxels == columnColors)
+								{
+									prevblock->width += xxr - xxl;
+									xxl = xxr;
+									continue;
+								}
+
 								outblocks[nextoutblock].x = lxt + xxl;
 								outblocks[nextoutblock].y = z1;
 								outblocks[nextoutblock].width = xxr - xxl;
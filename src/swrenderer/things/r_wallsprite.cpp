@@ -66,8 +66,10 @@
 #include "swrenderer/viewport/r_viewport.h"
 #include "swrenderer/r_memory.h"
 #include "swrenderer/r_renderthread.h"
+#include "swrenderer/segments/r_clipsegment.h"
 
 EXTERN_CVAR(Bool, r_fullbrightignoresectorcolor);
+EXTERN_CVAR(Bool, r_coverageculling);
 
 namespace swrenderer
 {
@@ -103,6 +105,9 @@ namespace swrenderer
 		if (wallc.sx1 >= renderportal->WindowRight || wallc.sx2 <= renderportal->WindowLeft)
 			return;
 
+		if (r_coverageculling && thread->ClipSegments->IsCovered(wallc.sx1, wallc.sx2))
+			return;
+
 		// Sprite sorting should probably treat these as walls, not sprites,
 		// but right now, I just want to get them drawing.
 		tz = (pos.X - thread->Viewport->viewpoint.Pos.X) * thread->Viewport->viewpoint.TanCos + (pos.Y - thread->Viewport->viewpoint.Pos.Y) * thread->Viewport->viewpoint.TanSin;
@@ -20,10 +20,132 @@
 //-----------------------------------------------------------------------------
 
 #include <stddef.h>
+#include <mutex>
 #include "r_drawerargs.h"
 
+// Use precomputed shade ramps in the truecolor drawers
+CVAR(Bool, r_shaderamps, true, 0)
+
 namespace swrenderer
 {
+	// All shade ramps for one set of colormap constants, one ramp per light level
+	struct ShadeRampSet
+	{
+		uint16_t light_red, light_green, light_blue;
+		uint16_t fade_red, fade_green, fade_blue;
+		ShadeRamp Ramps[257];
+		ShadeRampSet *Next;
+		int RefCount;		// number of colormaps using this set
+	};
+
+	// Each set takes about 200 KB. Colormaps that do not get one use the advanced shade mode.
+	enum { MaxShadeRampSets = 64 };
+
+	static ShadeRampSet *ShadeRampList;
+	static int NumShadeRampSets;
+	static std::mutex ShadeRampMutex;
+
+	static bool ShadeRampMatches(const ShadeRampSet *set, const ShadeConstants &constants)
+	{
+		return set->light_red == constants.light_red && set->light_green == constants.light_green && set->light_blue == constants.light_blue &&
+			set->fade_red == constants.fade_red && set->fade_green == constants.fade_green && set->fade_blue == constants.fade_blue;
+	}
+
+	static void ReleaseShadeRamps(ShadeRampSet *set)
+	{
+		if (set == nullptr || --set->RefCount > 0)
+			return;
+
+		for (ShadeRampSet **prev = &ShadeRampList; *prev != nullptr; prev = &(*prev)->Next)
+		{
+			if (*prev == set)
+			{
+				*prev = set->Next;
+				break;
+			}
+		}
+		delete set;
+		NumShadeRampSets--;
+	}
+
+	// Finds or builds the ramps for a colormap's current colors and attaches them to it.
+	// Called whenever a colormap gets built, so that the drawer threads only ever read them.
+	void DrawerArgs::UpdateShadeRamps(FSWColormap *colormap)
+	{
+		DrawerArgs args;
+		args.mBaseColormap = colormap;
+		ShadeConstants constants = args.ColormapConstants();
+
+		// Colormaps are created by the scene threads
+		std::unique_lock<std::mutex> lock(ShadeRampMutex);
+
+		ShadeRampSet *old = colormap->ShadeRamps;
+		if (old != nullptr && ShadeRampMatches(old, constants))
+			return;
+
+		colormap->ShadeRamps = nullptr;
+		ReleaseShadeRamps(old);
+
+		// Desaturation mixes the channels and cannot be expressed as a per channel ramp
+		if (constants.desaturate != 0)
+			return;
+
+		ShadeRampSet *set;
+		for (set = ShadeRampList; set != nullptr; set = set->Next)
+		{
+			if (ShadeRampMatches(set, constants))
+				break;
+		}
+
+		if (set == nullptr)
+		{
+			if (NumShadeRampSets >= MaxShadeRampSets)
+				return;
+
+			set = new ShadeRampSet;
+			set->RefCount = 0;
+			set->light_red = constants.light_red;
+			set->light_green = constants.light_green;
+			set->light_blue = constants.light_blue;
+			set->fade_red = constants.fade_red;
+			set->fade_green = constants.fade_green;
+			set->fade_blue = constants.fade_blue;
+
+			// Same math as the advanced shade mode in the drawers, minus desaturation
+			for (uint32_t light = 0; light <= 256; light++)
+			{
+				uint32_t inv_light = 256 - light;
+				ShadeRamp &ramp = set->Ramps[light];
+				for (uint32_t c = 0; c < 256; c++)
+				{
+					ramp.red[c] = (((constants.fade_red * inv_light + c * light) >> 8) * constants.light_red) >> 8;
+					ramp.green[c] = (((constants.fade_green * inv_light + c * light) >> 8) * constants.light_green) >> 8;
+					ramp.blue[c] = (((constants.fade_blue * inv_light + c * light) >> 8) * constants.light_blue) >> 8;
+				}
+			}
+			set->Next = ShadeRampList;
+			ShadeRampList = set;
+			NumShadeRampSets++;
+		}
+
+		set->RefCount++;
+		colormap->ShadeRamps = set;
+	}
+
+	// Called when the colormaps get freed. No drawers may be running.
+	void DrawerArgs::FreeShadeRamps()
+	{
+		std::unique_lock<std::mutex> lock(ShadeRampMutex);
+		ShadeRampSet *set, *next;
+		for (set = ShadeRampList; set != nullptr; set = next)
+		{
+			next = set->Next;
+			delete set;
+		}
+		ShadeRampList = nullptr;
+		NumShadeRampSets = 0;
+	}
+
 	void DrawerArgs::SetLight(FSWColormap *base_colormap, float light, int shade)
 	{
 		mBaseColormap = base_colormap;
@@ -83,4 +205,25 @@ namespace swrenderer
 		}
 		return shadeConstants;
 	}
+
+	const ShadeRamp *DrawerArgs::ColormapShadeRamp() const
+	{
+		if (!r_shaderamps || mBaseColormap == nullptr)
+			return nullptr;
+
+		// Desaturation mixes the channels and cannot be expressed as a per channel ramp
+		ShadeConstants shadeConstants = ColormapConstants();
+		if (shadeConstants.desaturate != 0)
+			return nullptr;
+
+		uint32_t light = 256 - (Light() >> (FRACBITS - 8));
+		if (light > 256)
+			return nullptr;
+
+		// The ramps are built together with the colormap, never here on a drawer thread
+		const ShadeRampSet *set = mBaseColormap->ShadeRamps;
+		if (set == nullptr || !ShadeRampMatches(set, shadeConstants))
+			return nullptr;
+		return &set->Ramps[light];
+	}
 }
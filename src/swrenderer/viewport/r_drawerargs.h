@@ -19,6 +19,7 @@ namespace swrenderer
 	class SWPixelFormatDrawers;
 	class DrawerArgs;
 	struct ShadeConstants;
+	struct ShadeRamp;
 
 	struct DrawerLight
 	{
@@ -37,6 +38,9 @@ namespace swrenderer
 		uint8_t *TranslationMap() const { return mTranslation; }
 
 		ShadeConstants ColormapConstants() const;
+		const ShadeRamp *ColormapShadeRamp() const;
+		static void UpdateShadeRamps(FSWColormap *colormap);
+		static void FreeShadeRamps();
 		fixed_t Light() const { return LIGHTSCALE(mLight, mShade); }
 
 	private:
@@ -59,4 +63,12 @@ namespace swrenderer
 		uint16_t desaturate;
 		bool simple_shade;
 	};
+
+	// Precomputed truecolor shading of one color channel value for a given colormap and light level
+	struct ShadeRamp
+	{
+		uint8_t red[256];
+		uint8_t green[256];
+		uint8_t blue[256];
+	};
 }
@@ -37,6 +37,16 @@
 #include "r_data/r_translate.h"
 #include "v_palette.h"
 #include "r_data/colormaps.h"
+#include "x86.h"
+#include "c_dispatch.h"
+#include "stats.h"
+#include "v_text.h"
+
+#include <type_traits>
+
+#ifndef NO_SSE
+#include <emmintrin.h>
+#endif
 
 
 //===========================================================================
@@ -213,6 +223,150 @@ static const CopyFunc copyfuncs[][10]={
 };
 #undef COPY_FUNCS
 
+#ifndef NO_SSE
+//===========================================================================
+//
+// SSE2 versions of the most common copy operations.
+// They must produce exactly the same result as the templates above.
+// bench_bitmapcopy checks this.
+//
+//===========================================================================
+
+// Exact x/255 for 0 <= x <= 255*255
+static __forceinline __m128i Div255_SSE2(__m128i x)
+{
+	x = _mm_add_epi16(x, _mm_add_epi16(_mm_set1_epi16(1), _mm_srli_epi16(x, 8)));
+	return _mm_srli_epi16(x, 8);
+}
+
+// (s*a + d*(255-a))/255 for two BGRA pixels unpacked to 16 bit
+static __forceinline __m128i AlphaBlend_SSE2(__m128i s, __m128i d)
+{
+	__m128i a = _mm_shufflehi_epi16(_mm_shufflelo_epi16(s, _MM_SHUFFLE(3,3,3,3)), _MM_SHUFFLE(3,3,3,3));
+	__m128i inva = _mm_sub_epi16(_mm_set1_epi16(255), a);
+	return Div255_SSE2(_mm_add_epi16(_mm_mullo_epi16(s, a), _mm_mullo_epi16(d, inva)));
+}
+
+//===========================================================================
+//
+// 32 bit source with 4 byte step and no blend, for OP_COPY, OP_OVERWRITE,
+// OP_COPYALPHA and OP_OVERLAY. Swap is set for RGBA sources.
+//
+//===========================================================================
+
+template<int op, bool swap>
+static void CopyColors32_SSE2(uint8_t *pout, const uint8_t *pin, int count, int step, FCopyInfo *inf, uint8_t r, uint8_t g, uint8_t b)
+{
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i alphamask = _mm_set1_epi32(0xff000000);
+	const __m128i rbmask = _mm_set1_epi32(0xff);
+	const __m128i agmask = _mm_set1_epi32(0xff00ff00);
+
+	int i = 0;
+	for (; i + 4 <= count; i += 4, pin += 16, pout += 16)
+	{
+		__m128i s = _mm_loadu_si128((const __m128i*)pin);
+		if (swap)
+		{
+			s = _mm_or_si128(_mm_and_si128(s, agmask),
+				_mm_or_si128(_mm_slli_epi32(_mm_and_si128(s, rbmask), 16), _mm_and_si128(_mm_srli_epi32(s, 16), rbmask)));
+		}
+		if (op == OP_OVERWRITE)
+		{
+			_mm_storeu_si128((__m128i*)pout, s);
+			continue;
+		}
+
+		__m128i d = _mm_loadu_si128((const __m128i*)pout);
+		__m128i skip = _mm_cmpeq_epi32(_mm_and_si128(s, alphamask), zero);
+		__m128i c;
+		if (op == OP_COPY)
+		{
+			c = s;
+		}
+		else
+		{
+			__m128i lo = AlphaBlend_SSE2(_mm_unpacklo_epi8(s, zero), _mm_unpacklo_epi8(d, zero));
+			__m128i hi = AlphaBlend_SSE2(_mm_unpackhi_epi8(s, zero), _mm_unpackhi_epi8(d, zero));
+			c = _mm_andnot_si128(alphamask, _mm_packus_epi16(lo, hi));
+			if (op == OP_COPYALPHA) c = _mm_or_si128(c, _mm_and_si128(s, alphamask));
+			else c = _mm_or_si128(c, _mm_and_si128(_mm_max_epu8(s, d), alphamask));
+		}
+		c = _mm_or_si128(_mm_and_si128(skip, d), _mm_andnot_si128(skip, c));
+		_mm_storeu_si128((__m128i*)pout, c);
+	}
+
+	typedef typename std::conditional<swap, cRGBA, cBGRA>::type TSrc;
+	switch (op)
+	{
+	case OP_COPY: iCopyColors<TSrc, cBGRA, bCopy>(pout, pin, count - i, 4, NULL, 0, 0, 0); break;
+	case OP_OVERWRITE: iCopyColors<TSrc, cBGRA, bOverwrite>(pout, pin, count - i, 4, NULL, 0, 0, 0); break;
+	case OP_COPYALPHA: iCopyColors<TSrc, cBGRA, bCopyAlpha>(pout, pin, count - i, 4, NULL, 0, 0, 0); break;
+	case OP_OVERLAY: iCopyColors<TSrc, cBGRA, bOverlay>(pout, pin, count - i, 4, NULL, 0, 0, 0); break;
+	}
+}
+
+static CopyFunc GetCopyFunc_SSE2(int op, int ct, int step, FCopyInfo *inf)
+{
+	if (!CPU.bSSE2 || step != 4 || (inf != NULL && inf->blend != BLEND_NONE)) return NULL;
+	if (ct != CF_RGBA && ct != CF_BGRA) return NULL;
+
+	static const CopyFunc funcs[2][4] =
+	{
+		{ CopyColors32_SSE2<OP_COPY, false>, CopyColors32_SSE2<OP_OVERWRITE, false>, CopyColors32_SSE2<OP_COPYALPHA, false>, CopyColors32_SSE2<OP_OVERLAY, false> },
+		{ CopyColors32_SSE2<OP_COPY, true>, CopyColors32_SSE2<OP_OVERWRITE, true>, CopyColors32_SSE2<OP_COPYALPHA, true>, CopyColors32_SSE2<OP_OVERLAY, true> }
+	};
+
+	int swap = ct == CF_RGBA;
+	switch (op)
+	{
+	case OP_COPY: return funcs[swap][0];
+	case OP_OVERWRITE: return funcs[swap][1];
+	case OP_COPYALPHA: return funcs[swap][2];
+	case OP_OVERLAY: return funcs[swap][3];
+	default: return NULL;
+	}
+}
+
+//===========================================================================
+//
+// Paletted source for OP_COPY and OP_OVERWRITE. The palette entries
+// already are in BGRA order, so each pixel is a single lookup.
+//
+//===========================================================================
+
+static void CopyPaletted_SSE2(uint8_t *buffer, const uint8_t *patch, int srcwidth, int srcheight, int Pitch,
+	int step_x, int step_y, const PalEntry *palette, bool overwrite)
+{
+	const uint32_t *pal = (const uint32_t *)palette;
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i alphamask = _mm_set1_epi32(0xff000000);
+
+	for (int y = 0; y < srcheight; y++)
+	{
+		uint32_t *dest = (uint32_t *)(buffer + y*Pitch);
+		const uint8_t *src = patch + y*step_y;
+		int x = 0;
+		for (; x + 4 <= srcwidth; x += 4, src += 4 * step_x)
+		{
+			__m128i c = _mm_setr_epi32(pal[src[0]], pal[src[step_x]], pal[src[2 * step_x]], pal[src[3 * step_x]]);
+			if (!overwrite)
+			{
+				__m128i skip = _mm_cmpeq_epi32(_mm_and_si128(c, alphamask), zero);
+				__m128i d = _mm_loadu_si128((const __m128i*)(dest + x));
+				c = _mm_or_si128(_mm_and_si128(skip, d), _mm_andnot_si128(skip, c));
+			}
+			_mm_storeu_si128((__m128i*)(dest + x), c);
+		}
+		for (; x < srcwidth; x++, src += step_x)
+		{
+			uint32_t c = pal[*src];
+			if (overwrite || (c & 0xff000000)) dest[x] = c;
+		}
+	}
+}
+#endif
+
 //===========================================================================
 //
 // Clips the copy area for CopyPixelData functions
@@ -379,9 +533,14 @@ void FBitmap::CopyPixelDataRGB(int originx, int originy, const uint8_t *patch, i
 	{
 		uint8_t *buffer = data + 4 * originx + Pitch * originy;
 		int op = inf==NULL? OP_COPY : inf->op;
+		CopyFunc func = copyfuncs[op][ct];
+#ifndef NO_SSE
+		CopyFunc simdfunc = GetCopyFunc_SSE2(op, ct, step_x, inf);
+		if (simdfunc != NULL) func = simdfunc;
+#endif
 		for (int y=0;y<srcheight;y++)
 		{
-			copyfuncs[op][ct](&buffer[y*Pitch], &patch[y*step_y], srcwidth, step_x, inf, r, g, b);
+			func(&buffer[y*Pitch], &patch[y*step_y], srcwidth, step_x, inf, r, g, b);
 		}
 	}
 }
@@ -430,6 +589,18 @@ static const CopyPalettedFunc copypalettedfuncs[]=
 	iCopyPaletted<cBGRA, bOverwrite>
 };
 
+//===========================================================================
+//
+// Applies the blend of a copy operation to a palette
+//
+//===========================================================================
+
+void BlendPalette(PalEntry *dest, const PalEntry *palette, FCopyInfo *inf)
+{
+	memset(dest, 0, 256 * sizeof(PalEntry));
+	iCopyColors<cPalEntry, cBGRA, bCopy>((uint8_t*)dest, (const uint8_t*)palette, 256, 4, inf, 0, 0, 0);
+}
+
 //===========================================================================
 //
 // Paletted to True Color texture copy function
@@ -443,12 +614,11 @@ void FBitmap::CopyPixelData(int originx, int originy, const uint8_t * patch, int
 		uint8_t *buffer = data + 4*originx + Pitch*originy;
 		PalEntry penew[256];
 
-		memset(penew, 0, sizeof(penew));
 		if (inf)
 		{
 			if (inf->blend)
 			{
-				iCopyColors<cPalEntry, cBGRA, bCopy>((uint8_t*)penew, (const uint8_t*)palette, 256, 4, inf, 0, 0, 0);
+				BlendPalette(penew, palette, inf);
 				palette = penew;
 			}
 			else if (inf->palette)
@@ -457,7 +627,15 @@ void FBitmap::CopyPixelData(int originx, int originy, const uint8_t * patch, int
 			}
 		}
 
-		copypalettedfuncs[inf==NULL? OP_COPY : inf->op](buffer, patch, srcwidth, srcheight, Pitch, 
+		int op = inf==NULL? OP_COPY : inf->op;
+#ifndef NO_SSE
+		if (CPU.bSSE2 && (op == OP_COPY || op == OP_OVERWRITE))
+		{
+			CopyPaletted_SSE2(buffer, patch, srcwidth, srcheight, Pitch, step_x, step_y, palette, op == OP_OVERWRITE);
+			return;
+		}
+#endif
+		copypalettedfuncs[op](buffer, patch, srcwidth, srcheight, Pitch, 
 														step_x, step_y, rotate, palette, inf);
 	}
 }
@@ -476,3 +654,102 @@ void FBitmap::Zero()
 		buffer += Pitch;
 	}
 }
+
+//===========================================================================
+//
+// Compares the SIMD copy functions with the templates they replace
+//
+//===========================================================================
+
+CCMD(bench_bitmapcopy)
+{
+	int iterations = argv.argc() > 1 ? atoi(argv[1]) : 100;
+	if (iterations <= 0)
+		return;
+
+#ifdef NO_SSE
+	Printf("This build has no SIMD copy functions\n");
+#else
+	if (!CPU.bSSE2)
+	{
+		Printf("This CPU does not support SSE2\n");
+		return;
+	}
+
+	const int width = 256, height = 256, count = width * height;
+	TArray<uint8_t> src(count * 4, true), indices(count, true), dest(count * 4, true), ref(count * 4, true), out(count * 4, true);
+	PalEntry palette[256];
+
+	// Alpha must include the special cases 0 and 255 often enough
+	auto randomalpha = []() { int v = rand() % 4; return v == 0 ? 0 : v == 1 ? 255 : rand() & 255; };
+	for (int i = 0; i < count * 4; i++)
+	{
+		src[i] = (i & 3) == 3 ? randomalpha() : rand() & 255;
+		dest[i] = rand() & 255;
+	}
+	for (int i = 0; i < count; i++) indices[i] = rand() & 255;
+	for (int i = 0; i < 256; i++) palette[i] = PalEntry(randomalpha(), rand() & 255, rand() & 255, rand() & 255);
+
+	static const struct { const char *Name; int Op; } ops[] =
+	{
+		{ "copy", OP_COPY }, { "overwrite", OP_OVERWRITE }, { "copyalpha", OP_COPYALPHA }, { "overlay", OP_OVERLAY }
+	};
+
+	int errors = 0;
+	for (int ct : { CF_RGBA, CF_BGRA })
+	{
+		for (auto &op : ops)
+		{
+			CopyFunc scalar = copyfuncs[op.Op][ct];
+			CopyFunc simd = GetCopyFunc_SSE2(op.Op, ct, 4, NULL);
+			cycle_t scalartime, simdtime;
+			scalartime.Reset();
+			simdtime.Reset();
+			for (int n = 0; n < iterations; n++)
+			{
+				memcpy(&ref[0], &dest[0], count * 4);
+				memcpy(&out[0], &dest[0], count * 4);
+
+				scalartime.Clock();
+				for (int y = 0; y < height; y++) scalar(&ref[y * width * 4], &src[y * width * 4], width, 4, NULL, 0, 0, 0);
+				scalartime.Unclock();
+
+				simdtime.Clock();
+				for (int y = 0; y < height; y++) simd(&out[y * width * 4], &src[y * width * 4], width, 4, NULL, 0, 0, 0);
+				simdtime.Unclock();
+			}
+			bool same = memcmp(&ref[0], &out[0], count * 4) == 0;
+			if (!same) errors++;
+			Printf("%s %-10s scalar %.2f ns, SSE2 %.2f ns per pixel%s\n", ct == CF_RGBA ? "RGBA" : "BGRA", op.Name,
+				scalartime.TimeMS() * 1e6 / ((double)count * iterations), simdtime.TimeMS() * 1e6 / ((double)count * iterations),
+				same ? "" : TEXTCOLOR_RED " MISMATCH");
+		}
+	}
+
+	for (int overwrite = 0; overwrite < 2; overwrite++)
+	{
+		cycle_t scalartime, simdtime;
+		scalartime.Reset();
+		simdtime.Reset();
+		for (int n = 0; n < iterations; n++)
+		{
+			memcpy(&ref[0], &dest[0], count * 4);
+			memcpy(&out[0], &dest[0], count * 4);
+
+			scalartime.Clock();
+			copypalettedfuncs[overwrite ? OP_OVERWRITE : OP_COPY](&ref[0], &indices[0], width, height, width * 4, 1, width, 0, palette, NULL);
+			scalartime.Unclock();
+
+			simdtime.Clock();
+			CopyPaletted_SSE2(&out[0], &indices[0], width, height, width * 4, 1, width, palette, !!overwrite);
+			simdtime.Unclock();
+		}
+		bool same = memcmp(&ref[0], &out[0], count * 4) == 0;
+		if (!same) errors++;
+		Printf("Pal  %-10s scalar %.2f ns, SSE2 %.2f ns per pixel%s\n", overwrite ? "overwrite" : "copy",
+			scalartime.TimeMS() * 1e6 / ((double)count * iterations), simdtime.TimeMS() * 1e6 / ((double)count * iterations),
+			same ? "" : TEXTCOLOR_RED " MISMATCH");
+	}
+	if (errors > 0) Printf(TEXTCOLOR_RED "%d SIMD functions do not match the scalar code\n", errors);
+#endif
+}
@@ -177,6 +177,8 @@ bool ClipCopyPixelRect(const FClipRect *cr, int &originx, int &originy,
 						const uint8_t *&patch, int &srcwidth, int &srcheight, 
 						int &step_x, int &step_y, int rotate);
 
+void BlendPalette(PalEntry *dest, const PalEntry *palette, FCopyInfo *inf);
+
 //===========================================================================
 // 
 // True color conversion classes for the different pixel formats
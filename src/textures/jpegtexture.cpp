@@ -46,6 +46,7 @@ extern "C"
 #include "bitmap.h"
 #include "v_video.h"
 #include "textures/textures.h"
+#include "textures/precachedecoder.h"
 
 
 struct FLumpSourceMgr : public jpeg_source_mgr
@@ -190,6 +191,8 @@ public:
 	void Unload ();
 	FTextureFormat GetFormat ();
 	int CopyTrueColorPixels(FBitmap *bmp, int x, int y, int rotate, FCopyInfo *inf = NULL);
+	bool CanDecodeLumpData();
+	bool DecodeLumpData(FileReader &lump, FBitmap *bmp, int &trans);
 	bool UseBasePalette();
 
 protected:
@@ -198,6 +201,7 @@ protected:
 	Span DummySpans[2];
 
 	void MakeTexture ();
+	bool ReadTrueColorPixels(FileReader *lump, FBitmap *bmp, int x, int y, int rotate, FCopyInfo *inf, bool quiet);
 
 	friend class FTexture;
 };
@@ -466,29 +470,72 @@ void FJPEGTexture::MakeTexture ()
 
 int FJPEGTexture::CopyTrueColorPixels(FBitmap *bmp, int x, int y, int rotate, FCopyInfo *inf)
 {
-	PalEntry pe[256];
+	int trans;
+	if (inf == NULL && FPrecacheDecoder::CopyDecoded(this, bmp, x, y, rotate, trans))
+	{
+		return trans;
+	}
 
 	FWadLump lump = Wads.OpenLumpNum (SourceLump);
+	ReadTrueColorPixels(&lump, bmp, x, y, rotate, inf, false);
+	return 0;
+}
+
+//===========================================================================
+//
+// FJPEGTexture :: DecodeLumpData
+//
+// Used by the precache decoder. Errors are not printed from the worker
+// thread. The texture gets decoded again on the main thread instead,
+// which reports them.
+//
+//===========================================================================
+
+bool FJPEGTexture::CanDecodeLumpData()
+{
+	return true;
+}
+
+bool FJPEGTexture::DecodeLumpData(FileReader &lump, FBitmap *bmp, int &trans)
+{
+	trans = 0;
+	return ReadTrueColorPixels(&lump, bmp, 0, 0, 0, NULL, true);
+}
+
+//===========================================================================
+//
+// FJPEGTexture :: ReadTrueColorPixels
+//
+//===========================================================================
+
+static void JPEG_QuietMessage (j_common_ptr cinfo)
+{
+}
+
+bool FJPEGTexture::ReadTrueColorPixels(FileReader *lump, FBitmap *bmp, int x, int y, int rotate, FCopyInfo *inf, bool quiet)
+{
+	PalEntry pe[256];
 	JSAMPLE *buff = NULL;
+	bool result = false;
 
 	jpeg_decompress_struct cinfo;
 	jpeg_error_mgr jerr;
 
 	cinfo.err = jpeg_std_error(&jerr);
-	cinfo.err->output_message = JPEG_OutputMessage;
+	cinfo.err->output_message = quiet ? JPEG_QuietMessage : JPEG_OutputMessage;
 	cinfo.err->error_exit = JPEG_ErrorExit;
 	jpeg_create_decompress(&cinfo);
 
 	try
 	{
-		FLumpSourceMgr sourcemgr(&lump, &cinfo);
+		FLumpSourceMgr sourcemgr(lump, &cinfo);
 		jpeg_read_header(&cinfo, TRUE);
 
 		if (!((cinfo.out_color_space == JCS_RGB && cinfo.num_components == 3) ||
 			  (cinfo.out_color_space == JCS_CMYK && cinfo.num_components == 4) ||
 			  (cinfo.out_color_space == JCS_GRAYSCALE && cinfo.num_components == 1)))
 		{
-			Printf (TEXTCOLOR_ORANGE "Unsupported color format\n");
+			if (!quiet) Printf (TEXTCOLOR_ORANGE "Unsupported color format\n");
 			throw -1;
 		}
 		jpeg_start_decompress(&cinfo);
@@ -527,14 +574,15 @@ int FJPEGTexture::CopyTrueColorPixels(FBitmap *bmp, int x, int y, int rotate, FC
 			break;
 		}
 		jpeg_finish_decompress(&cinfo);
+		result = true;
 	}
 	catch(int)
 	{
-		Printf (TEXTCOLOR_ORANGE "   in JPEG texture %s\n", Name.GetChars());
+		if (!quiet) Printf (TEXTCOLOR_ORANGE "   in JPEG texture %s\n", Name.GetChars());
 	}
 	jpeg_destroy_decompress(&cinfo);
 	if (buff != NULL) delete [] buff;
-	return 0;
+	return result;
 }
 
 
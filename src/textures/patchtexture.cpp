@@ -77,22 +77,21 @@ protected:
 
 //==========================================================================
 //
-// Checks if the currently open lump can be a Doom patch
+// Checks if the currently open lump can be a Doom patch. Only the header
+// and the column directory get read.
 //
 //==========================================================================
 
-static bool CheckIfPatch(FileReader & file)
+bool CheckIfPatch(FileReader & file)
 {
 	if (file.GetLength() < 13) return false;	// minimum length of a valid Doom patch
 	
-	uint8_t *data = new uint8_t[file.GetLength()];
+	int16_t dims[2];
 	file.Seek(0, SEEK_SET);
-	file.Read(data, file.GetLength());
+	file.Read(dims, 4);
 	
-	const patch_t *foo = (const patch_t *)data;
-	
-	int height = LittleShort(foo->height);
-	int width = LittleShort(foo->width);
+	int width = LittleShort(dims[0]);
+	int height = LittleShort(dims[1]);
 	
 	if (height > 0 && height <= 2048 && width > 0 && width <= 2048 && width < file.GetLength()/4)
 	{
@@ -100,26 +99,27 @@ static bool CheckIfPatch(FileReader & file)
 		// check the column directory for extra security. At least one
 		// column must begin exactly at the end of the column directory,
 		// and none of them must point past the end of the patch.
+		TArray<uint32_t> columnofs(width, true);
+		file.Seek(8, SEEK_SET);
+		if (file.Read(&columnofs[0], width * 4) != width * 4) return false;
+
 		bool gapAtStart = true;
 		int x;
 	
 		for (x = 0; x < width; ++x)
 		{
-			uint32_t ofs = LittleLong(foo->columnofs[x]);
+			uint32_t ofs = LittleLong(columnofs[x]);
 			if (ofs == (uint32_t)width * 4 + 8)
 			{
 				gapAtStart = false;
 			}
 			else if (ofs >= (uint32_t)(file.GetLength()))	// Need one byte for an empty column (but there's patches that don't know that!)
 			{
-				delete [] data;
 				return false;
 			}
 		}
-		delete [] data;
 		return !gapAtStart;
 	}
-	delete [] data;
 	return false;
 }
 
@@ -250,7 +250,7 @@ void FPatchTexture::MakeTexture ()
 	const column_t *maxcol;
 	int x;
 
-	FMemLump lump = Wads.ReadLump (SourceLump);
+	FMemLump lump = Wads.ReadLumpView (SourceLump);
 	const patch_t *patch = (const patch_t *)lump.GetMem();
 
 	maxcol = (const column_t *)((const uint8_t *)patch + Wads.LumpLength (SourceLump) - 3);
@@ -366,7 +366,7 @@ void FPatchTexture::HackHack (int newheight)
 	// Check if this patch is likely to be a problem.
 	// It must be 256 pixels tall, and all its columns must have exactly
 	// one post, where each post has a supposed length of 0.
-	FMemLump lump = Wads.ReadLump (SourceLump);
+	FMemLump lump = Wads.ReadLumpView (SourceLump);
 	const patch_t *realpatch = (patch_t *)lump.GetMem();
 	const uint32_t *cofs = realpatch->columnofs;
 	int x, x2 = LittleShort(realpatch->width);
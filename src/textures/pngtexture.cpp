@@ -33,6 +33,9 @@
 **
 */
 
+#include <thread>
+#include <atomic>
+#include <vector>
 #include "doomtype.h"
 #include "files.h"
 #include "w_wad.h"
@@ -41,6 +44,10 @@
 #include "bitmap.h"
 #include "v_palette.h"
 #include "textures/textures.h"
+#include "textures/precachedecoder.h"
+#include "c_dispatch.h"
+#include "stats.h"
+#include "v_text.h"
 
 //==========================================================================
 //
@@ -59,6 +66,8 @@ public:
 	void Unload ();
 	FTextureFormat GetFormat ();
 	int CopyTrueColorPixels(FBitmap *bmp, int x, int y, int rotate, FCopyInfo *inf = NULL);
+	bool CanDecodeLumpData();
+	bool DecodeLumpData(FileReader &lump, FBitmap *bmp, int &trans);
 	bool UseBasePalette();
 
 protected:
@@ -79,6 +88,7 @@ protected:
 	uint32_t StartOfIDAT;
 
 	void MakeTexture ();
+	int ReadTrueColorPixels(FileReader *lump, FBitmap *bmp, int x, int y, int rotate, FCopyInfo *inf);
 
 	friend class FTexture;
 };
@@ -613,13 +623,13 @@ void FPNGTexture::MakeTexture ()
 
 int FPNGTexture::CopyTrueColorPixels(FBitmap *bmp, int x, int y, int rotate, FCopyInfo *inf)
 {
-	// Parse pre-IDAT chunks. I skip the CRCs. Is that bad?
-	PalEntry pe[256];
-	uint32_t len, id;
 	FileReader *lump;
-	static char bpp[] = {1, 0, 3, 1, 2, 0, 4};
-	int pixwidth = Width * bpp[ColorType];
-	int transpal = false;
+	int trans;
+
+	if (inf == NULL && FPrecacheDecoder::CopyDecoded(this, bmp, x, y, rotate, trans))
+	{
+		return trans;
+	}
 
 	if (SourceLump >= 0)
 	{
@@ -630,10 +640,56 @@ int FPNGTexture::CopyTrueColorPixels(FBitmap *bmp, int x, int y, int rotate, FCo
 		lump = fr;// new FileReader(SourceFile.GetChars());
 	}
 
-	lump->Seek(33, SEEK_SET);
-	for(int i = 0; i < 256; i++)	// default to a gray map
+	trans = ReadTrueColorPixels(lump, bmp, x, y, rotate, inf);
+	if (lump != fr) delete lump;
+	return trans;
+}
+
+//===========================================================================
+//
+// FPNGTexture :: DecodeLumpData
+//
+// Used by the precache decoder. ReadTrueColorPixels only reads from the
+// passed lump so this is safe to call from a worker thread.
+//
+//===========================================================================
+
+bool FPNGTexture::CanDecodeLumpData()
+{
+	return SourceLump >= 0;
+}
+
+bool FPNGTexture::DecodeLumpData(FileReader &lump, FBitmap *bmp, int &trans)
+{
+	trans = ReadTrueColorPixels(&lump, bmp, 0, 0, 0, NULL);
+	return true;
+}
+
+//===========================================================================
+//
+// ReadPNGPalette
+//
+// Parses the chunks between IHDR and the first IDAT for the palette and
+// transparency information that decoding needs. The reader must be
+// positioned right after the IHDR chunk. On success it is left at the
+// start of the first IDAT's data.
+//
+//===========================================================================
+
+static bool ReadPNGPalette(FileReader *lump, uint8_t colortype, PalEntry *pe, uint16_t *nonpalettetrans,
+	bool &havetrans, int &transpal, uint32_t &idatlen)
+{
+	uint32_t len, id;
+	uint8_t trans[6] = { 0 };
+
+	for (int i = 0; i < 256; i++)	// default to a gray map
 		pe[i] = PalEntry(255,i,i,i);
+	havetrans = false;
+	transpal = false;
 
+	// I skip the CRCs. Is that bad?
+	len = 0;
+	id = MAKE_ID('I','E','N','D');
 	lump->Read(&len, 4);
 	lump->Read(&id, 4);
 	while (id != MAKE_ID('I','D','A','T') && id != MAKE_ID('I','E','N','D'))
@@ -646,25 +702,34 @@ int FPNGTexture::CopyTrueColorPixels(FBitmap *bmp, int x, int y, int rotate, FCo
 			break;
 
 		case MAKE_ID('P','L','T','E'):
-			for(int i = 0; i < PaletteSize; i++)
+		{
+			uint32_t count = MIN<uint32_t>(len / 3, 256);
+			for (uint32_t i = 0; i < count; i++)
 			{
 				(*lump) >> pe[i].r >> pe[i].g >> pe[i].b;
 			}
+			lump->Seek (len - count * 3, SEEK_CUR);
 			break;
+		}
 
 		case MAKE_ID('t','R','N','S'):
-			if (ColorType == 3)
+			if (colortype == 3)
 			{
-				for(uint32_t i = 0; i < len; i++)
+				uint32_t count = MIN<uint32_t>(len, 256);
+				for (uint32_t i = 0; i < count; i++)
 				{
 					(*lump) >> pe[i].a;
 					if (pe[i].a != 0 && pe[i].a != 255)
 						transpal = true;
 				}
+				lump->Seek (len - count, SEEK_CUR);
 			}
 			else
 			{
-				lump->Seek(len, SEEK_CUR);
+				uint32_t count = MIN<uint32_t>(len, 6);
+				lump->Read (trans, count);
+				lump->Seek (len - count, SEEK_CUR);
+				havetrans = true;
 			}
 			break;
 		}
@@ -673,56 +738,166 @@ int FPNGTexture::CopyTrueColorPixels(FBitmap *bmp, int x, int y, int rotate, FCo
 		id = MAKE_ID('I','E','N','D');
 		lump->Read(&id, 4);
 	}
+	if (id != MAKE_ID('I','D','A','T'))
+	{
+		return false;
+	}
 
-	if (ColorType == 0 && HaveTrans && NonPaletteTrans[0] < 256)
+	for (int i = 0; i < 3; i++)
+	{
+		nonpalettetrans[i] = uint16_t(trans[i * 2] * 256 + trans[i * 2 + 1]);
+	}
+	if (colortype == 0 && havetrans && nonpalettetrans[0] < 256)
 	{
-		pe[NonPaletteTrans[0]].a = 0;
+		pe[nonpalettetrans[0]].a = 0;
 		transpal = true;
 	}
+	idatlen = BigLong((unsigned int)len);
+	return true;
+}
 
-	uint8_t * Pixels = new uint8_t[pixwidth * Height];
+//===========================================================================
+//
+// FPNGBitmapSink
+//
+// Copies decoded PNG pixels into a bitmap. Images that M_ReadIDATRows can
+// handle go straight into the bitmap a row at a time, everything else is
+// decoded into a temporary buffer first.
+//
+//===========================================================================
 
-	lump->Seek (StartOfIDAT, SEEK_SET);
-	lump->Read(&len, 4);
-	lump->Read(&id, 4);
-	M_ReadIDAT (lump, Pixels, Width, Height, pixwidth, BitDepth, ColorType, Interlace, BigLong((unsigned int)len));
-	if (lump != fr) delete lump;
+class FPNGBitmapSink : public FPNGRowSink
+{
+public:
+	FBitmap *Bmp;
+	int X, Y;
+	int Width, Height;
+	uint8_t ColorType;
+	PalEntry *Palette;
+	const uint16_t *Trans;		// Transparent color of RGB images or NULL
+	FCopyInfo *Inf;
+	FCopyInfo *PalInf;			// Inf for paletted images
+
+	// CopyPixelData would blend the palette again for every row,
+	// so paletted images get a palette that is blended only once.
+	void SetPalette (PalEntry *pe, FCopyInfo *inf)
+	{
+		Palette = pe;
+		Inf = PalInf = inf;
+		if (inf != NULL && inf->blend != BLEND_NONE && (ColorType == 0 || ColorType == 3))
+		{
+			BlendPalette (BlendedPalette, pe, inf);
+			BlendedInf = *inf;
+			BlendedInf.blend = BLEND_NONE;
+			BlendedInf.palette = NULL;
+			Palette = BlendedPalette;
+			PalInf = &BlendedInf;
+		}
+	}
 
-	switch (ColorType)
+	void Row (int y, const uint8_t *row) override
 	{
-	case 0:
-	case 3:
-		bmp->CopyPixelData(x, y, Pixels, Width, Height, 1, Width, rotate, pe, inf);
-		break;
+		Copy (row, y, 1, 0);
+	}
+
+	void Copy (const uint8_t *pixels, int top, int height, int rotate)
+	{
+		static const char bpp[] = {1, 0, 3, 1, 2, 0, 4};
+		int pixwidth = Width * bpp[ColorType];
 
-	case 2:
-		if (!HaveTrans)
+		switch (ColorType)
 		{
-			bmp->CopyPixelDataRGB(x, y, Pixels, Width, Height, 3, pixwidth, rotate, CF_RGB, inf);
+		case 0:
+		case 3:
+			Bmp->CopyPixelData(X, Y + top, pixels, Width, height, 1, Width, rotate, Palette, PalInf);
+			break;
+
+		case 2:
+			if (Trans == NULL)
+			{
+				Bmp->CopyPixelDataRGB(X, Y + top, pixels, Width, height, 3, pixwidth, rotate, CF_RGB, Inf);
+			}
+			else
+			{
+				Bmp->CopyPixelDataRGB(X, Y + top, pixels, Width, height, 3, pixwidth, rotate, CF_RGBT, Inf,
+					Trans[0], Trans[1], Trans[2]);
+			}
+			break;
+
+		case 4:
+			Bmp->CopyPixelDataRGB(X, Y + top, pixels, Width, height, 2, pixwidth, rotate, CF_IA, Inf);
+			break;
+
+		case 6:
+			Bmp->CopyPixelDataRGB(X, Y + top, pixels, Width, height, 4, pixwidth, rotate, CF_RGBA, Inf);
+			break;
+
+		default:
+			break;
 		}
-		else
+	}
+
+	// The reader must be positioned at the start of the first IDAT's data
+	bool Read (FileReader *lump, uint8_t bitdepth, uint8_t interlace, unsigned int idatlen, int rotate, bool scalarunfilter = false)
+	{
+		if (!interlace && bitdepth == 8 && rotate == 0)
 		{
-			bmp->CopyPixelDataRGB(x, y, Pixels, Width, Height, 3, pixwidth, rotate, CF_RGBT, inf,
-				NonPaletteTrans[0], NonPaletteTrans[1], NonPaletteTrans[2]);
-			transpal = true;
+			return M_ReadIDATRows (lump, this, Width, Height, bitdepth, ColorType, interlace, idatlen, scalarunfilter);
 		}
-		break;
 
-	case 4:
-		bmp->CopyPixelDataRGB(x, y, Pixels, Width, Height, 2, pixwidth, rotate, CF_IA, inf);
-		transpal = -1;
-		break;
+		static const char bpp[] = {1, 0, 3, 1, 2, 0, 4};
+		int pixwidth = Width * bpp[ColorType];
+		uint8_t *pixels = new uint8_t[pixwidth * Height];
+		bool success = M_ReadIDAT (lump, pixels, Width, Height, pixwidth, bitdepth, ColorType, interlace, idatlen, scalarunfilter);
+		Copy (pixels, 0, Height, rotate);
+		delete[] pixels;
+		return success;
+	}
 
-	case 6:
-		bmp->CopyPixelDataRGB(x, y, Pixels, Width, Height, 4, pixwidth, rotate, CF_RGBA, inf);
-		transpal = -1;
-		break;
+private:
+	PalEntry BlendedPalette[256];
+	FCopyInfo BlendedInf;
+};
 
-	default:
-		break;
+//===========================================================================
+//
+// FPNGTexture :: ReadTrueColorPixels
+//
+//===========================================================================
+
+int FPNGTexture::ReadTrueColorPixels(FileReader *lump, FBitmap *bmp, int x, int y, int rotate, FCopyInfo *inf)
+{
+	PalEntry pe[256];
+	uint16_t nonpalettetrans[3];
+	bool havetrans;
+	int transpal;
+	uint32_t idatlen;
 
+	lump->Seek(33, SEEK_SET);
+	if (!ReadPNGPalette(lump, ColorType, pe, nonpalettetrans, havetrans, transpal, idatlen))
+	{
+		return 0;
+	}
+
+	FPNGBitmapSink sink;
+	sink.Bmp = bmp;
+	sink.X = x;
+	sink.Y = y;
+	sink.Width = Width;
+	sink.Height = Height;
+	sink.ColorType = ColorType;
+	sink.Trans = (ColorType == 2 && havetrans) ? nonpalettetrans : NULL;
+	sink.SetPalette (pe, inf);
+	sink.Read (lump, BitDepth, Interlace, idatlen, rotate);
+
+	if (ColorType == 2 && havetrans)
+	{
+		transpal = true;
+	}
+	else if (ColorType == 4 || ColorType == 6)
+	{
+		transpal = -1;
 	}
-	delete[] Pixels;
 	return transpal;
 }
 
@@ -739,3 +914,217 @@ bool FPNGTexture::UseBasePalette()
 { 
 	return false; 
 }
+
+//===========================================================================
+//
+// M_DecodePNG
+//
+// Decodes a PNG without creating a texture for it. Like
+// ReadTrueColorPixels this only touches the passed reader.
+//
+//===========================================================================
+
+bool M_DecodePNG(FileReader *file, FBitmap *bmp, bool scalarunfilter)
+{
+	uint32_t sig[2], len, id;
+	uint32_t width, height;
+	uint8_t bitdepth, colortype, compression, filter, interlace;
+
+	file->Seek(0, SEEK_SET);
+	if (file->Read(sig, 8) != 8 || sig[0] != MAKE_ID(137,'P','N','G') || sig[1] != MAKE_ID(13,10,26,10))
+	{
+		return false;
+	}
+	if (file->Read(&len, 4) != 4 || file->Read(&id, 4) != 4 || len != MAKE_ID(0,0,0,13) || id != MAKE_ID('I','H','D','R'))
+	{
+		return false;
+	}
+	file->Read(&width, 4);
+	file->Read(&height, 4);
+	(*file) >> bitdepth >> colortype >> compression >> filter >> interlace;
+	width = BigLong((unsigned int)width);
+	height = BigLong((unsigned int)height);
+
+	if (compression != 0 || filter != 0 || interlace > 1 || !((1 << colortype) & 0x5D) || !((1 << bitdepth) & 0x116))
+	{
+		return false;
+	}
+	if (width == 0 || height == 0 || width > 65535 || height > 65535)
+	{
+		return false;
+	}
+	file->Seek(4, SEEK_CUR);		// Skip CRC
+
+	PalEntry pe[256];
+	uint16_t nonpalettetrans[3];
+	bool havetrans;
+	int transpal;
+	uint32_t idatlen;
+	if (!ReadPNGPalette(file, colortype, pe, nonpalettetrans, havetrans, transpal, idatlen))
+	{
+		return false;
+	}
+
+	if (!bmp->Create(width, height))
+	{
+		return false;
+	}
+
+	FPNGBitmapSink sink;
+	sink.Bmp = bmp;
+	sink.X = 0;
+	sink.Y = 0;
+	sink.Width = width;
+	sink.Height = height;
+	sink.ColorType = colortype;
+	sink.Trans = (colortype == 2 && havetrans) ? nonpalettetrans : NULL;
+	sink.SetPalette (pe, NULL);
+	return sink.Read (file, bitdepth, interlace, idatlen, 0, scalarunfilter);
+}
+
+//===========================================================================
+//
+// M_DecodePNGs
+//
+//===========================================================================
+
+void M_DecodePNGs(FPNGDecodeJob *jobs, int count)
+{
+	std::atomic<int> next(0);
+	auto work = [&]()
+	{
+		int i;
+		while ((i = next++) < count)
+		{
+			jobs[i].Success = M_DecodePNG(jobs[i].File, jobs[i].Bitmap);
+		}
+	};
+
+	int numthreads = MIN(MAX((int)std::thread::hardware_concurrency(), 1), count) - 1;
+	std::vector<std::thread> threads;
+	for (int i = 0; i < numthreads; i++)
+	{
+		threads.push_back(std::thread(work));
+	}
+	work();
+	for (auto &thread : threads)
+	{
+		thread.join();
+	}
+}
+
+//==========================================================================
+//
+// CCMD bench_png
+//
+// Decodes all PNGs in the engine's own resource file, which is built from
+// wadsrc, to compare the SIMD and scalar unfilters and single threaded
+// against batched decoding. The SIMD results are checked against the
+// scalar ones first.
+//
+//==========================================================================
+
+CCMD (bench_png)
+{
+	int iterations = argv.argc() > 1 ? atoi (argv[1]) : 10;
+	if (iterations <= 0)
+		return;
+
+	TArray<TArray<uint8_t>> corpus;
+	int64_t pixels = 0;
+	for (int i = 0, numlumps = Wads.GetNumLumps (); i < numlumps; ++i)
+	{
+		if (Wads.GetLumpFile (i) != 0 || Wads.LumpLength (i) < 8)
+			continue;
+
+		FMemLump lump = Wads.ReadLumpView (i);
+		const uint32_t *sig = (const uint32_t *)lump.GetMem ();
+		if (sig[0] != MAKE_ID(137,'P','N','G') || sig[1] != MAKE_ID(13,10,26,10))
+			continue;
+
+		TArray<uint8_t> &data = corpus[corpus.Reserve (1)];
+		data.Resize (Wads.LumpLength (i));
+		memcpy (&data[0], sig, data.Size ());
+	}
+	if (corpus.Size () == 0)
+	{
+		Printf ("No PNGs found in %s\n", Wads.GetWadName (0));
+		return;
+	}
+
+	unsigned int count = corpus.Size ();
+	TArray<MemoryReader *> readers(count, true);
+	TArray<FBitmap> reference, bitmaps;
+	reference.Resize (count);
+	bitmaps.Resize (count);
+	TArray<FPNGDecodeJob> jobs(count, true);
+	for (unsigned int i = 0; i < count; ++i)
+	{
+		readers[i] = new MemoryReader ((const char *)&corpus[i][0], corpus[i].Size ());
+		jobs[i].File = readers[i];
+		jobs[i].Bitmap = &bitmaps[i];
+	}
+
+	// Verify the SIMD path against the scalar one
+	int failed = 0, mismatched = 0;
+	for (unsigned int i = 0; i < count; ++i)
+	{
+		if (!M_DecodePNG (readers[i], &reference[i], true))
+			failed++;
+		pixels += reference[i].GetWidth () * reference[i].GetHeight ();
+	}
+	for (unsigned int i = 0; i < count; ++i)
+	{
+		FBitmap bmp;
+		M_DecodePNG (readers[i], &bmp);
+		if (bmp.GetWidth () != reference[i].GetWidth () || bmp.GetHeight () != reference[i].GetHeight () ||
+			(bmp.GetPixels () != NULL && memcmp (bmp.GetPixels (), reference[i].GetPixels (), bmp.GetPitch () * bmp.GetHeight ()) != 0))
+		{
+			mismatched++;
+		}
+	}
+
+	Printf ("%u PNGs, %.1f MPixels, %d failed to decode\n", count, pixels / 1000000.0, failed);
+	if (mismatched > 0)
+	{
+		Printf (TEXTCOLOR_RED "%d images differ between the SIMD and scalar unfilter\n", mismatched);
+	}
+
+	auto report = [&](const char *name, cycle_t &timer)
+	{
+		double ms = timer.TimeMS () / iterations;
+		Printf ("%-16s %8.2f ms  %7.1f MPixels/s\n", name, ms, ms > 0 ? pixels / (ms * 1000) : 0.);
+	};
+
+	cycle_t timer;
+	for (int pass = 0; pass < 2; ++pass)
+	{
+		timer.Reset ();
+		timer.Clock ();
+		for (int it = 0; it < iterations; ++it)
+		{
+			for (unsigned int i = 0; i < count; ++i)
+			{
+				FBitmap bmp;
+				M_DecodePNG (readers[i], &bmp, pass == 0);
+			}
+		}
+		timer.Unclock ();
+		report (pass == 0 ? "scalar" : "simd", timer);
+	}
+
+	timer.Reset ();
+	timer.Clock ();
+	for (int it = 0; it < iterations; ++it)
+	{
+		M_DecodePNGs (&jobs[0], count);
+		for (auto &bmp : bitmaps) bmp.Destroy ();
+	}
+	timer.Unclock ();
+	report ("simd, batched", timer);
+
+	for (auto reader : readers)
+	{
+		delete reader;
+	}
+}
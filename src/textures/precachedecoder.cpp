@@ -0,0 +1,295 @@
+//
+//---------------------------------------------------------------------------
+//
+// Copyright(C) 2017 The GZDoom Development Team
+// All rights reserved.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program.  If not, see http://www.gnu.org/licenses/
+//
+//--------------------------------------------------------------------------
+//
+/*
+** precachedecoder.cpp
+** Decodes the textures of a level on worker threads while it gets precached
+**
+**/
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <vector>
+#include "templates.h"
+#include "c_cvars.h"
+#include "w_wad.h"
+#include "files.h"
+#include "textures/textures.h"
+#include "textures/bitmap.h"
+#include "textures/precachedecoder.h"
+
+CVAR(Bool, r_precache_threaded, true, CVAR_ARCHIVE | CVAR_GLOBALCONFIG)
+
+namespace
+{
+	// Decoded images waiting for the renderer are limited to this size.
+	// Workers wait until the renderer catches up when it is exceeded, and
+	// no more lumps are read while the lumps and images together exceed it.
+	enum { DecodedMemoryBudget = 256 * 1024 * 1024 };
+
+	struct FDecodeJob
+	{
+		enum EState
+		{
+			Queued,
+			Running,
+			Done,
+			Cancelled
+		};
+
+		FTexture *Texture = nullptr;
+		int Lump = -1;
+		TArray<uint8_t> LumpData;
+		FBitmap Bitmap;
+		int Trans = 0;
+		bool Success = false;
+		EState State = Queued;
+	};
+
+	std::mutex Mutex;
+	std::condition_variable WorkCondition;
+	std::condition_variable DoneCondition;
+	std::vector<std::thread> Workers;
+	bool StopWorkers;
+	bool Active;
+
+	TArray<FDecodeJob *> Jobs;
+	TMap<FTexture *, unsigned int> JobIndex;
+	unsigned int NextJob;				// next job for the workers
+	unsigned int NextRead;				// next job whose lump must be read, the workers stop there
+	unsigned int FirstUnclaimed;		// everything before this was either picked up or skipped by the renderer
+	size_t DecodedMemory;
+	size_t LumpMemory;					// lumps read but not decoded yet
+
+	size_t BitmapSize(const FDecodeJob *job)
+	{
+		return (size_t)job->Bitmap.GetPitch() * job->Bitmap.GetHeight();
+	}
+
+	// Must be called with the mutex locked
+	void DropJob(FDecodeJob *job)
+	{
+		if (job->State == FDecodeJob::Done)
+		{
+			DecodedMemory -= BitmapSize(job);
+			job->Bitmap.Destroy();
+			WorkCondition.notify_all();
+		}
+		if (job->State != FDecodeJob::Running)
+		{
+			LumpMemory -= job->LumpData.Size();
+			job->LumpData.Reset();
+		}
+		job->State = FDecodeJob::Cancelled;
+	}
+
+	// Reads the lumps of the next jobs as long as the memory budget allows.
+	// Must be called on the main thread, without the mutex locked.
+	void ReadAhead()
+	{
+		std::unique_lock<std::mutex> lock(Mutex);
+		while (NextRead < Jobs.Size() && DecodedMemory + LumpMemory < DecodedMemoryBudget)
+		{
+			FDecodeJob *job = Jobs[NextRead];
+			if (job->State == FDecodeJob::Queued)
+			{
+				// Only this thread touches the lumps of jobs at or after NextRead
+				lock.unlock();
+				TArray<uint8_t> data(Wads.LumpLength(job->Lump), true);
+				Wads.ReadLump(job->Lump, &data[0]);
+				lock.lock();
+
+				if (job->State == FDecodeJob::Queued)
+				{
+					LumpMemory += data.Size();
+					job->LumpData = std::move(data);
+				}
+			}
+			NextRead++;
+			WorkCondition.notify_one();
+		}
+	}
+
+	void WorkerMain()
+	{
+		std::unique_lock<std::mutex> lock(Mutex);
+		while (true)
+		{
+			WorkCondition.wait(lock, []() { return StopWorkers || (NextJob < NextRead && DecodedMemory < DecodedMemoryBudget); });
+			if (StopWorkers)
+				break;
+
+			FDecodeJob *job = Jobs[NextJob++];
+			if (job->State != FDecodeJob::Queued)
+				continue;
+
+			job->State = FDecodeJob::Running;
+			lock.unlock();
+
+			FTexture *tex = job->Texture;
+			MemoryReader reader((const char *)&job->LumpData[0], job->LumpData.Size());
+			job->Success = job->Bitmap.Create(tex->GetWidth(), tex->GetHeight()) && tex->DecodeLumpData(reader, &job->Bitmap, job->Trans);
+
+			lock.lock();
+			LumpMemory -= job->LumpData.Size();
+			job->LumpData.Reset();
+			if (job->State == FDecodeJob::Cancelled || !job->Success)
+			{
+				// Failed images get decoded again by the renderer, which also reports the error
+				job->Bitmap.Destroy();
+				job->State = FDecodeJob::Cancelled;
+			}
+			else
+			{
+				job->State = FDecodeJob::Done;
+				DecodedMemory += BitmapSize(job);
+			}
+			DoneCondition.notify_all();
+		}
+	}
+}
+
+//==========================================================================
+//
+//
+//
+//==========================================================================
+
+void FPrecacheDecoder::Start(const TArray<FTexture *> &textures)
+{
+	Finish();
+	if (!r_precache_threaded)
+		return;
+
+	int numthreads = MAX((int)std::thread::hardware_concurrency() - 1, 1);
+
+	StopWorkers = false;
+	NextJob = 0;
+	NextRead = 0;
+	FirstUnclaimed = 0;
+	DecodedMemory = 0;
+	LumpMemory = 0;
+	Active = true;
+
+	for (unsigned int i = 0; i < textures.Size(); i++)
+	{
+		FTexture *tex = textures[i];
+		if (tex == nullptr || !tex->CanDecodeLumpData() || JobIndex.CheckKey(tex) != nullptr)
+			continue;
+
+		int lump = tex->GetSourceLump();
+		if (lump < 0 || Wads.LumpLength(lump) <= 0)
+			continue;
+
+		FDecodeJob *job = new FDecodeJob;
+		job->Texture = tex;
+		job->Lump = lump;
+		JobIndex[tex] = Jobs.Size();
+		Jobs.Push(job);
+	}
+
+	if (Jobs.Size() == 0)
+		return;
+
+	for (int i = 0; i < numthreads; i++)
+	{
+		Workers.push_back(std::thread(WorkerMain));
+	}
+
+	// The rest gets read as the renderer picks up the images
+	ReadAhead();
+}
+
+//==========================================================================
+//
+//
+//
+//==========================================================================
+
+void FPrecacheDecoder::Finish()
+{
+	if (!Active)
+		return;
+
+	std::unique_lock<std::mutex> lock(Mutex);
+	StopWorkers = true;
+	WorkCondition.notify_all();
+	lock.unlock();
+
+	for (auto &thread : Workers)
+		thread.join();
+	Workers.clear();
+
+	for (unsigned int i = 0; i < Jobs.Size(); i++)
+		delete Jobs[i];
+	Jobs.Clear();
+	JobIndex.Clear();
+	Active = false;
+}
+
+//==========================================================================
+//
+//
+//
+//==========================================================================
+
+bool FPrecacheDecoder::CopyDecoded(FTexture *tex, FBitmap *bmp, int x, int y, int rotate, int &trans)
+{
+	if (!Active)
+		return false;
+
+	std::unique_lock<std::mutex> lock(Mutex);
+
+	unsigned int *pindex = JobIndex.CheckKey(tex);
+	if (pindex == nullptr || *pindex < FirstUnclaimed)
+		return false;
+
+	// The renderer has moved past everything before this texture
+	unsigned int index = *pindex;
+	for (unsigned int i = FirstUnclaimed; i < index; i++)
+		DropJob(Jobs[i]);
+	FirstUnclaimed = index + 1;
+
+	FDecodeJob *job = Jobs[index];
+	if (job->State == FDecodeJob::Queued)
+	{
+		// Decoding it right here is faster than waiting for the workers to get to it
+		DropJob(job);
+		lock.unlock();
+		ReadAhead();
+		return false;
+	}
+
+	DoneCondition.wait(lock, [=]() { return job->State != FDecodeJob::Running; });
+	if (job->State != FDecodeJob::Done)
+		return false;
+
+	lock.unlock();
+	bmp->CopyPixelDataRGB(x, y, job->Bitmap.GetPixels(), job->Bitmap.GetWidth(), job->Bitmap.GetHeight(), 4, job->Bitmap.GetPitch(), rotate, CF_BGRA);
+	trans = job->Trans;
+	lock.lock();
+
+	DropJob(job);
+	lock.unlock();
+	ReadAhead();
+	return true;
+}
@@ -0,0 +1,50 @@
+//
+//---------------------------------------------------------------------------
+//
+// Copyright(C) 2017 The GZDoom Development Team
+// All rights reserved.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program.  If not, see http://www.gnu.org/licenses/
+//
+//--------------------------------------------------------------------------
+//
+
+#pragma once
+
+#include "tarray.h"
+
+class FTexture;
+class FBitmap;
+
+// Decodes the textures of a precache list on worker threads.
+//
+// The lumps are read on the main thread, since the resource files cannot be
+// accessed concurrently, while the workers convert them to true color. They are
+// read only shortly before they are needed, as the renderer picks up images.
+// FTexture::CopyTrueColorPixels picks up the decoded image when the renderer
+// gets to the texture. The renderers must process the textures in the
+// order they were passed to Start, as anything before the texture being
+// picked up is discarded to keep the memory use bounded.
+class FPrecacheDecoder
+{
+public:
+	// Starts decoding all textures in the list that support it
+	static void Start(const TArray<FTexture *> &textures);
+
+	// Stops the workers and frees all unused images
+	static void Finish();
+
+	// Copies the decoded image of a texture into bmp. Returns false if the texture was not decoded in the background.
+	static bool CopyDecoded(FTexture *tex, FBitmap *bmp, int x, int y, int rotate, int &trans);
+};
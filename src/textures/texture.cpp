@@ -45,6 +45,7 @@
 #include "v_video.h"
 #include "m_fixed.h"
 #include "textures/textures.h"
+#include "textures/textureatlas.h"
 #include "v_palette.h"
 
 typedef bool (*CheckFunc)(FileReader & file);
@@ -77,6 +78,7 @@ FTexture *FlatTexture_TryCreate(FileReader &, int lumpnum);
 FTexture *PatchTexture_TryCreate(FileReader &, int lumpnum);
 FTexture *EmptyTexture_TryCreate(FileReader &, int lumpnum);
 FTexture *AutomapTexture_TryCreate(FileReader &, int lumpnum);
+bool CheckIfPatch(FileReader &file);
 
 
 // Examines the lump contents to decide what type of texture to create,
@@ -135,6 +137,38 @@ FTexture * FTexture::CreateTexture (int lumpnum, int usetype)
 	return NULL;
 }
 
+//==========================================================================
+//
+// Checks if a lump can be turned into a texture without creating it.
+// Doom patches and the formats with a signature are recognized from their
+// headers, which is what nearly all sprites are. A lump in a signature
+// format that turns out to be damaged later becomes an invalid texture
+// when it gets created. Everything else goes through the full probe.
+//
+//==========================================================================
+
+bool FTexture::CheckLumpHeader (int lumpnum, int usetype)
+{
+	if (lumpnum == -1) return false;
+
+	FWadLump data = Wads.OpenLumpNum (lumpnum);
+
+	uint8_t sig[4];
+	if (data.GetLength() >= 4 && data.Read(sig, 4) == 4)
+	{
+		if (!memcmp(sig, "\x89PNG", 4) || !memcmp(sig, "IMGZ", 4) || !memcmp(sig, "DDS ", 4) ||
+			(sig[0] == 0xFF && sig[1] == 0xD8 && sig[2] == 0xFF))
+		{
+			return true;
+		}
+	}
+	if (CheckIfPatch(data)) return true;
+
+	FTexture *tex = CreateTexture (lumpnum, usetype);
+	delete tex;
+	return tex != NULL;
+}
+
 FTexture * FTexture::CreateTexture (const char *name, int lumpnum, int usetype)
 {
 	FTexture *tex = CreateTexture(lumpnum, usetype);
@@ -173,6 +207,7 @@ FTexture::~FTexture ()
 {
 	FTexture *link = Wads.GetLinkedTexture(SourceLump);
 	if (link == this) Wads.SetLinkedTexture(SourceLump, NULL);
+	FTextureAtlas::Remove(this);
 	KillNative();
 }
 
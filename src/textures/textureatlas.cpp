@@ -0,0 +1,479 @@
+//
+//---------------------------------------------------------------------------
+//
+// Copyright(C) 2017 The GZDoom Development Team
+// All rights reserved.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program.  If not, see http://www.gnu.org/licenses/
+//
+//--------------------------------------------------------------------------
+//
+/*
+** textureatlas.cpp
+** Packs font glyphs and small 2D graphics into shared pages
+**
+**/
+
+#include "templates.h"
+#include "stats.h"
+#include "SkylineBinPack.h"
+#include "textures/textures.h"
+#include "textures/bitmap.h"
+#include "textures/textureatlas.h"
+
+namespace
+{
+	enum
+	{
+		PageSize = 512,
+		MaxImageSize = 64,
+		MaxPages = 16
+	};
+
+	//==========================================================================
+	//
+	// A page of the atlas
+	//
+	// The paletted image is built from the parts' paletted images, so that
+	// translations can be applied to the page. The true color image is
+	// composited from the parts' true color images, which are decoded only
+	// once and kept with their border for later updates of the page.
+	//
+	//==========================================================================
+
+	class FAtlasPage : public FTexture
+	{
+	public:
+		FAtlasPage();
+		~FAtlasPage();
+
+		const uint8_t *GetColumn(unsigned int column, const Span **spans_out);
+		const uint8_t *GetPixels();
+		void Unload();
+		FTextureFormat GetFormat();
+		int CopyTrueColorPixels(FBitmap *bmp, int x, int y, int rotate = 0, FCopyInfo *inf = NULL);
+
+		bool Add(FTexture *tex, FAtlasEntry &entry);
+		void Remove(FTexture *tex);
+		float Occupancy() const { return Packer.Occupancy(); }
+
+		bool Changed = true;
+
+	private:
+		struct FPart
+		{
+			FTexture *Texture;
+			int X, Y;
+			TArray<uint8_t> TrueColor;	// BGRA including the border, empty until first needed
+		};
+
+		TArray<FPart> Parts;
+		SkylineBinPack Packer;
+		uint8_t *Pixels = nullptr;
+		Span **Spans = nullptr;
+
+		void MakeTexture();
+		const uint8_t *GetTrueColor(FPart &part);
+	};
+
+	// Allocated on first use, so that textures deleted during shutdown never
+	// find a destroyed map
+	struct FAtlasState
+	{
+		TArray<FAtlasPage *> Pages;
+		TMap<FTexture *, FAtlasEntry> Entries;	// Page is NULL for images that were not packed
+		int NumPacked = 0;
+		int NumRejected = 0;
+	};
+
+	FAtlasState *State;
+
+	bool CanPack(FTexture *tex)
+	{
+		if (tex->bHasCanvas || tex->bWarped || tex->bComplex)
+			return false;
+
+		switch (tex->UseType)
+		{
+		case FTexture::TEX_FontChar:
+		case FTexture::TEX_MiscPatch:
+		case FTexture::TEX_Sprite:
+			break;
+
+		default:
+			return false;
+		}
+
+		int width = tex->GetWidth();
+		int height = tex->GetHeight();
+		return width > 0 && height > 0 && width <= MaxImageSize && height <= MaxImageSize;
+	}
+}
+
+//==========================================================================
+//
+//
+//
+//==========================================================================
+
+FAtlasPage::FAtlasPage()
+{
+	Width = PageSize;
+	Height = PageSize;
+	CalcBitSize();
+	UseType = TEX_FontChar;
+	bMasked = true;
+	Packer.Init(PageSize, PageSize, false);		// the waste map may rotate images
+}
+
+FAtlasPage::~FAtlasPage()
+{
+	Unload();
+}
+
+void FAtlasPage::Unload()
+{
+	delete[] Pixels;
+	Pixels = nullptr;
+	if (Spans != nullptr)
+	{
+		FreeSpans(Spans);
+		Spans = nullptr;
+	}
+	FTexture::Unload();
+}
+
+//==========================================================================
+//
+// One pixel is added around each image for the repeated edge
+//
+//==========================================================================
+
+bool FAtlasPage::Add(FTexture *tex, FAtlasEntry &entry)
+{
+	int width = tex->GetWidth();
+	int height = tex->GetHeight();
+
+	Rect box = Packer.Insert(width + 2, height + 2);
+	if (box.width == 0 || box.height == 0)
+		return false;
+
+	FPart &part = Parts[Parts.Reserve(1)];
+	part.Texture = tex;
+	part.X = box.x + 1;
+	part.Y = box.y + 1;
+
+	entry.Page = this;
+	entry.U1 = float(part.X) / Width;
+	entry.V1 = float(part.Y) / Height;
+	entry.U2 = float(part.X + width) / Width;
+	entry.V2 = float(part.Y + height) / Height;
+
+	Unload();
+	Changed = true;
+	return true;
+}
+
+//==========================================================================
+//
+// The space of a removed image is not reused. There is no need to
+// update the page either, as nothing refers to that area anymore.
+//
+//==========================================================================
+
+void FAtlasPage::Remove(FTexture *tex)
+{
+	for (unsigned int i = 0; i < Parts.Size(); i++)
+	{
+		if (Parts[i].Texture == tex)
+		{
+			Parts.Delete(i);
+			Unload();
+			break;
+		}
+	}
+}
+
+//==========================================================================
+//
+//
+//
+//==========================================================================
+
+const uint8_t *FAtlasPage::GetColumn(unsigned int column, const Span **spans_out)
+{
+	if (Pixels == nullptr)
+	{
+		MakeTexture();
+	}
+	if ((unsigned)column >= (unsigned)Width)
+	{
+		column &= WidthMask;
+	}
+	if (spans_out != nullptr)
+	{
+		if (Spans == nullptr)
+		{
+			Spans = CreateSpans(Pixels);
+		}
+		*spans_out = Spans[column];
+	}
+	return Pixels + column * Height;
+}
+
+const uint8_t *FAtlasPage::GetPixels()
+{
+	if (Pixels == nullptr)
+	{
+		MakeTexture();
+	}
+	return Pixels;
+}
+
+//==========================================================================
+//
+// Pixels are stored in columns
+//
+//==========================================================================
+
+void FAtlasPage::MakeTexture()
+{
+	Pixels = new uint8_t[Width * Height];
+	memset(Pixels, 0, Width * Height);
+
+	for (auto &part : Parts)
+	{
+		const uint8_t *src = part.Texture->GetPixels();
+		int width = part.Texture->GetWidth();
+		int height = part.Texture->GetHeight();
+
+		for (int x = -1; x <= width; x++)
+		{
+			const uint8_t *srccol = src + clamp(x, 0, width - 1) * height;
+			uint8_t *dest = Pixels + (part.X + x) * Height + part.Y;
+			dest[-1] = srccol[0];
+			memcpy(dest, srccol, height);
+			dest[height] = srccol[height - 1];
+		}
+	}
+}
+
+//==========================================================================
+//
+//
+//
+//==========================================================================
+
+FTextureFormat FAtlasPage::GetFormat()
+{
+	for (auto &part : Parts)
+	{
+		if (part.Texture->GetFormat() != TEX_Pal)
+			return TEX_RGB;
+	}
+	return TEX_Pal;
+}
+
+//==========================================================================
+//
+// Decodes the true color image of a part and repeats its edge in the
+// border, the same way MakeTexture does for the paletted image.
+//
+//==========================================================================
+
+const uint8_t *FAtlasPage::GetTrueColor(FPart &part)
+{
+	if (part.TrueColor.Size() == 0)
+	{
+		int width = part.Texture->GetWidth();
+		int height = part.Texture->GetHeight();
+		int pitch = (width + 2) * 4;
+
+		part.TrueColor.Resize(pitch * (height + 2));
+		memset(&part.TrueColor[0], 0, part.TrueColor.Size());
+		uint8_t *pixels = &part.TrueColor[0];
+
+		FBitmap bmp(pixels + pitch + 4, pitch, width, height);
+		part.Texture->CopyTrueColorPixels(&bmp, 0, 0);
+
+		for (int y = 1; y <= height; y++)
+		{
+			uint8_t *row = pixels + y * pitch;
+			memcpy(row, row + 4, 4);
+			memcpy(row + (width + 1) * 4, row + width * 4, 4);
+		}
+		memcpy(pixels, pixels + pitch, pitch);
+		memcpy(pixels + (height + 1) * pitch, pixels + height * pitch, pitch);
+	}
+	return &part.TrueColor[0];
+}
+
+//==========================================================================
+//
+//
+//
+//==========================================================================
+
+int FAtlasPage::CopyTrueColorPixels(FBitmap *bmp, int x, int y, int rotate, FCopyInfo *inf)
+{
+	if (rotate != 0 || inf != NULL)
+	{
+		FBitmap tbmp;
+		if (tbmp.Create(Width, Height))
+		{
+			CopyTrueColorPixels(&tbmp, 0, 0);
+			bmp->CopyPixelDataRGB(x, y, tbmp.GetPixels(), Width, Height, 4, tbmp.GetPitch(), rotate, CF_BGRA, inf);
+		}
+		return -1;
+	}
+
+	FCopyInfo overwrite;
+	memset(&overwrite, 0, sizeof(overwrite));
+	overwrite.op = OP_OVERWRITE;
+	overwrite.blend = BLEND_NONE;
+	overwrite.alpha = BLENDUNIT;
+
+	for (auto &part : Parts)
+	{
+		int width = part.Texture->GetWidth() + 2;
+		int height = part.Texture->GetHeight() + 2;
+		bmp->CopyPixelDataRGB(x + part.X - 1, y + part.Y - 1, GetTrueColor(part), width, height, 4, width * 4, 0, CF_BGRA, &overwrite);
+	}
+	return -1;
+}
+
+//==========================================================================
+//
+//
+//
+//==========================================================================
+
+bool FTextureAtlas::Get(FTexture *tex, FAtlasEntry &entry)
+{
+	if (State == nullptr)
+		State = new FAtlasState;
+
+	FAtlasEntry *found = State->Entries.CheckKey(tex);
+	if (found == nullptr)
+	{
+		FAtlasEntry added = { nullptr, 0, 0, 0, 0 };
+		if (CanPack(tex))
+		{
+			for (auto page : State->Pages)
+			{
+				if (page->Add(tex, added))
+					break;
+			}
+			if (added.Page == nullptr && State->Pages.Size() < MaxPages)
+			{
+				FAtlasPage *page = new FAtlasPage;
+				State->Pages.Push(page);
+				page->Add(tex, added);
+			}
+		}
+
+		if (added.Page != nullptr) State->NumPacked++;
+		else State->NumRejected++;
+		found = &(State->Entries[tex] = added);
+	}
+
+	entry = *found;
+	return entry.Page != nullptr;
+}
+
+//==========================================================================
+//
+//
+//
+//==========================================================================
+
+void FTextureAtlas::Remove(FTexture *tex)
+{
+	if (State == nullptr)
+		return;
+
+	FAtlasEntry *found = State->Entries.CheckKey(tex);
+	if (found != nullptr)
+	{
+		if (found->Page != nullptr)
+		{
+			static_cast<FAtlasPage *>(found->Page)->Remove(tex);
+			State->NumPacked--;
+		}
+		else
+		{
+			State->NumRejected--;
+		}
+		State->Entries.Remove(tex);
+	}
+}
+
+//==========================================================================
+//
+//
+//
+//==========================================================================
+
+void FTextureAtlas::GetChangedPages(TArray<FTexture *> &pages)
+{
+	if (State == nullptr)
+		return;
+
+	for (auto page : State->Pages)
+	{
+		if (page->Changed)
+		{
+			pages.Push(page);
+			page->Changed = false;
+		}
+	}
+}
+
+//==========================================================================
+//
+//
+//
+//==========================================================================
+
+void FTextureAtlas::Clear()
+{
+	if (State == nullptr)
+		return;
+
+	// The pages are textures as well and would try to remove themselves
+	FAtlasState *state = State;
+	State = nullptr;
+	for (auto page : state->Pages)
+		delete page;
+	delete state;
+}
+
+ADD_STAT(atlas)
+{
+	FString out;
+	if (State == nullptr)
+	{
+		out = "empty";
+		return out;
+	}
+
+	float occupancy = 0;
+	for (auto page : State->Pages)
+		occupancy += page->Occupancy();
+	if (State->Pages.Size() > 0)
+		occupancy /= State->Pages.Size();
+
+	out.Format("pages=%u  images=%d  rejected=%d  occupancy=%.1f%%", State->Pages.Size(), State->NumPacked, State->NumRejected, occupancy * 100);
+	return out;
+}
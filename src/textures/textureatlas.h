@@ -0,0 +1,61 @@
+//
+//---------------------------------------------------------------------------
+//
+// Copyright(C) 2017 The GZDoom Development Team
+// All rights reserved.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program.  If not, see http://www.gnu.org/licenses/
+//
+//--------------------------------------------------------------------------
+//
+
+#pragma once
+
+#include "tarray.h"
+
+class FTexture;
+
+// Where an image ended up in the atlas
+struct FAtlasEntry
+{
+	FTexture *Page;
+	float U1, V1, U2, V2;	// Texture coordinates of the image on its page
+};
+
+// Packs font glyphs and small 2D graphics into shared pages.
+//
+// The pages are regular textures, so a renderer can draw everything on a page with a
+// single texture binding. Images are added on first use and keep their place until
+// Clear is called. Every image gets a one pixel border that repeats its edge, so
+// filtering does not pick up the neighbouring images.
+//
+// Translations work the same way as for the image itself, since a translated page
+// is built from the translated paletted images.
+class FTextureAtlas
+{
+public:
+	// Gets the image's place in the atlas, adding it if needed. Returns false for
+	// images that need a texture of their own.
+	static bool Get(FTexture *tex, FAtlasEntry &entry);
+
+	// Called when a texture is deleted
+	static void Remove(FTexture *tex);
+
+	// Collects the pages that got new images since the last call. Textures the
+	// renderer made of these pages must be recreated.
+	static void GetChangedPages(TArray<FTexture *> &pages);
+
+	// Removes all images and deletes the pages
+	static void Clear();
+};
@@ -34,6 +34,7 @@
 **
 */
 
+#include <mutex>
 #include "doomtype.h"
 #include "doomstat.h"
 #include "w_wad.h"
@@ -53,7 +54,9 @@
 #include "r_renderer.h"
 #include "r_sky.h"
 #include "textures/textures.h"
+#include "textures/textureatlas.h"
 #include "vm.h"
+#include "stats.h"
 
 FTextureManager TexMan;
 
@@ -71,7 +74,7 @@ CUSTOM_CVAR(Bool, vid_nopalsubstitutions, false, CVAR_ARCHIVE)
 
 FTextureManager::FTextureManager ()
 {
-	memset (HashFirst, -1, sizeof(HashFirst));
+	LazyCount = LazyCreated = 0;
 
 	for (int i = 0; i < 2048; ++i)
 	{
@@ -98,6 +101,7 @@ FTextureManager::~FTextureManager ()
 
 void FTextureManager::DeleteAll()
 {
+	FTextureAtlas::Clear();
 	for (unsigned int i = 0; i < Textures.Size(); ++i)
 	{
 		delete Textures[i].Texture;
@@ -105,7 +109,8 @@ void FTextureManager::DeleteAll()
 	Textures.Clear();
 	Translation.Clear();
 	FirstTextureForFile.Clear();
-	memset (HashFirst, -1, sizeof(HashFirst));
+	HashFirst.Clear();
+	LazyCount = LazyCreated = 0;
 	DefaultTexture.SetInvalid();
 
 	for (unsigned i = 0; i < mAnimations.Size(); i++)
@@ -168,13 +173,14 @@ FTextureID FTextureManager::CheckForTexture (const char *name, int usetype, BITF
 	{
 		return FTextureID(0);
 	}
-	i = HashFirst[MakeKey (name) % HASH_SIZE];
+	unsigned int key = MakeKey (name);
+	i = HashFirst.Size() == 0 ? HASH_END : HashFirst[key & (HashFirst.Size() - 1)];
 
 	while (i != HASH_END)
 	{
-		const FTexture *tex = Textures[i].Texture;
+		const FTexture *tex = CheckName(i, key, name);
 
-		if (stricmp (tex->Name, name) == 0)
+		if (tex != NULL)
 		{
 			// The name matches, so check the texture type
 			if (usetype == FTexture::TEX_Any)
@@ -292,13 +298,14 @@ int FTextureManager::ListTextures (const char *name, TArray<FTextureID> &list, b
 	{
 		return 0;
 	}
-	i = HashFirst[MakeKey (name) % HASH_SIZE];
+	unsigned int key = MakeKey (name);
+	i = HashFirst.Size() == 0 ? HASH_END : HashFirst[key & (HashFirst.Size() - 1)];
 
 	while (i != HASH_END)
 	{
-		const FTexture *tex = Textures[i].Texture;
+		const FTexture *tex = CheckName(i, key, name);
 
-		if (stricmp (tex->Name, name) == 0)
+		if (tex != NULL)
 		{
 			// NULL textures must be ignored.
 			if (tex->UseType!=FTexture::TEX_Null) 
@@ -309,7 +316,7 @@ int FTextureManager::ListTextures (const char *name, TArray<FTextureID> &list, b
 					for (j = 0; j < list.Size(); j++)
 					{
 						// Check for overriding definitions from newer WADs
-						if (Textures[list[j].GetIndex()].Texture->UseType == tex->UseType) break;
+						if (Texture(list[j])->UseType == tex->UseType) break;
 					}
 				}
 				if (j==list.Size()) list.Push(FTextureID(i));
@@ -357,7 +364,7 @@ FTextureID FTextureManager::GetTexture (const char *name, int usetype, BITFIELD
 FTexture *FTextureManager::FindTexture(const char *texname, int usetype, BITFIELD flags)
 {
 	FTextureID texnum = CheckForTexture (texname, usetype, flags);
-	return !texnum.isValid()? NULL : Textures[texnum.GetIndex()].Texture;
+	return !texnum.isValid()? NULL : Texture(texnum);
 }
 
 //==========================================================================
@@ -370,7 +377,62 @@ void FTextureManager::UnloadAll ()
 {
 	for (unsigned int i = 0; i < Textures.Size(); ++i)
 	{
-		Textures[i].Texture->Unload ();
+		if (Textures[i].Texture != NULL) Textures[i].Texture->Unload ();
+	}
+}
+
+//==========================================================================
+//
+// FTextureManager :: PushTexture
+//
+// Later textures take precedence over earlier ones, so each chain is
+// kept in descending index order.
+//
+//==========================================================================
+
+int FTextureManager::PushTexture (TextureHash &entry)
+{
+	int trans = Textures.Push (entry);
+	Translation.Push (trans);
+
+	if (Textures.Size() > HashFirst.Size())
+	{
+		// Keeps the chains short no matter how many graphics the loaded files contain
+		RehashTextures(MAX(1024u, HashFirst.Size() * 2));
+	}
+	// Textures without name can't be looked for
+	else if (GetTextureName(trans)[0] != '\0')
+	{
+		int &bucket = HashFirst[entry.Key & (HashFirst.Size() - 1)];
+		Textures[trans].HashNext = bucket;
+		bucket = trans;
+	}
+	return trans;
+}
+
+//==========================================================================
+//
+// FTextureManager :: RehashTextures
+//
+//==========================================================================
+
+void FTextureManager::RehashTextures (unsigned int size)
+{
+	HashFirst.Resize(size);
+	for (unsigned int i = 0; i < size; i++)
+	{
+		HashFirst[i] = HASH_END;
+	}
+	for (unsigned int i = 0; i < Textures.Size(); i++)
+	{
+		TextureHash &entry = Textures[i];
+		entry.HashNext = HASH_END;
+		if (!entry.Invalid && GetTextureName(i)[0] != '\0')
+		{
+			int &bucket = HashFirst[entry.Key & (size - 1)];
+			entry.HashNext = bucket;
+			bucket = i;
+		}
 	}
 }
 
@@ -382,30 +444,126 @@ void FTextureManager::UnloadAll ()
 
 FTextureID FTextureManager::AddTexture (FTexture *texture)
 {
-	int bucket;
-	int hash;
-
 	if (texture == NULL) return FTextureID(-1);
 
-	// Later textures take precedence over earlier ones
+	TextureHash entry;
+	entry.Texture = texture;
+	entry.HashNext = HASH_END;
+	entry.Key = MakeKey (texture->Name);
+	entry.Lump = -1;
+	entry.Rotations = 0xFFFF;
+	entry.UseType = texture->UseType;
+	entry.Invalid = false;
+	entry.Name[0] = '\0';
+	return (texture->id = FTextureID(PushTexture (entry)));
+}
 
-	// Textures without name can't be looked for
-	if (texture->Name[0] != '\0')
+//==========================================================================
+//
+// FTextureManager :: AddLazyTexture
+//
+// Only records where the texture comes from. Looking at the lump's
+// contents is deferred until the texture is actually needed.
+//
+//==========================================================================
+
+FTextureID FTextureManager::AddLazyTexture (int lumpnum, int usetype)
+{
+	if (lumpnum < 0) return FTextureID(-1);
+
+	TextureHash entry;
+	entry.Texture = NULL;
+	entry.HashNext = HASH_END;
+	entry.Lump = lumpnum;
+	entry.Rotations = 0xFFFF;
+	entry.UseType = usetype;
+	entry.Invalid = false;
+	Wads.GetLumpName (entry.Name, lumpnum);
+	entry.Name[8] = '\0';
+	entry.Key = MakeKey (entry.Name);
+	LazyCount++;
+	return FTextureID(PushTexture (entry));
+}
+
+//==========================================================================
+//
+// FTextureManager :: CreateLazyTexture
+//
+// If the lump turns out not to be a graphic, the slot gets a nameless
+// null texture so that lookups by name behave as if it had never been
+// added.
+//
+//==========================================================================
+
+FTexture *FTextureManager::CreateLazyTexture (int index)
+{
+	// The GL scene setup may get here from several threads at once.
+	static std::mutex lazymutex;
+	std::lock_guard<std::mutex> lock(lazymutex);
+
+	TextureHash &entry = Textures[index];
+	if (entry.Texture != NULL) return entry.Texture;
+
+	FTexture *tex = FTexture::CreateTexture (entry.Lump, entry.UseType);
+
+	if (tex == NULL)
 	{
-		bucket = int(MakeKey (texture->Name) % HASH_SIZE);
-		hash = HashFirst[bucket];
+		if (entry.UseType != FTexture::TEX_MiscPatch && entry.UseType != FTexture::TEX_SkinGraphic)
+		{
+			Printf (TEXTCOLOR_ORANGE "Invalid data encountered for texture %s\n", Wads.GetLumpFullPath(entry.Lump).GetChars());
+		}
+		tex = new FDummyTexture;
+		tex->Name = "";
+		entry.Invalid = true;
 	}
 	else
 	{
-		bucket = -1;
-		hash = -1;
+		tex->Rotations = entry.Rotations;
 	}
+	tex->id = FTextureID(index);
+	entry.Texture = tex;
+	LazyCreated++;
+	return tex;
+}
 
-	TextureHash hasher = { texture, hash };
-	int trans = Textures.Push (hasher);
-	Translation.Push (trans);
-	if (bucket >= 0) HashFirst[bucket] = trans;
-	return (texture->id = FTextureID(trans));
+//==========================================================================
+//
+// FTextureManager :: CheckName
+//
+// Returns the texture if its name matches. Lazily added textures get
+// created here, since only then it is known whether they are valid.
+//
+//==========================================================================
+
+FTexture *FTextureManager::CheckName (int index, unsigned int key, const char *name)
+{
+	TextureHash &entry = Textures[index];
+	if (entry.Key != key || entry.Invalid || stricmp (GetTextureName(index), name) != 0)
+	{
+		return NULL;
+	}
+	FTexture *tex = Texture(FTextureID(index));
+	return entry.Invalid ? NULL : tex;
+}
+
+//==========================================================================
+//
+// FTextureManager :: SetRotations
+//
+//==========================================================================
+
+void FTextureManager::SetRotations (FTextureID texnum, int rotations)
+{
+	TextureHash &entry = Textures[texnum.GetIndex()];
+	if (entry.Texture != NULL) entry.Texture->Rotations = rotations;
+	else entry.Rotations = rotations;
+}
+
+ADD_STAT(texman)
+{
+	FString out;
+	out.Format("textures=%d  lazy=%d  created=%d", TexMan.NumTextures(), TexMan.NumLazyTextures(), TexMan.NumCreatedLazyTextures());
+	return out;
 }
 
 //==========================================================================
@@ -444,7 +602,7 @@ void FTextureManager::ReplaceTexture (FTextureID picnum, FTexture *newtexture, b
 	if (unsigned(index) >= Textures.Size())
 		return;
 
-	FTexture *oldtexture = Textures[index].Texture;
+	FTexture *oldtexture = Texture(picnum);
 
 	newtexture->Name = oldtexture->Name;
 	newtexture->UseType = oldtexture->UseType;
@@ -476,8 +634,8 @@ bool FTextureManager::AreTexturesCompatible (FTextureID picnum1, FTextureID picn
 	if (unsigned(index1) >= Textures.Size() || unsigned(index2) >= Textures.Size())
 		return false;
 
-	FTexture *texture1 = Textures[index1].Texture;
-	FTexture *texture2 = Textures[index2].Texture;
+	FTexture *texture1 = Texture(picnum1);
+	FTexture *texture2 = Texture(picnum2);
 
 	// both textures must be the same type.
 	if (texture1 == NULL || texture2 == NULL || texture1->UseType != texture2->UseType)
@@ -520,7 +678,15 @@ void FTextureManager::AddGroup(int wadnum, int ns, int usetype)
 
 			if (Wads.CheckNumForName (Name, ns) == firsttx)
 			{
-				CreateTexture (firsttx, usetype);
+				// Sprite setup has to know which frames are valid, so their headers get checked right away.
+				if (usetype != FTexture::TEX_Sprite || FTexture::CheckLumpHeader (firsttx, usetype))
+				{
+					AddLazyTexture (firsttx, usetype);
+				}
+				else
+				{
+					Printf (TEXTCOLOR_ORANGE "Invalid data encountered for texture %s\n", Wads.GetLumpFullPath(firsttx).GetChars());
+				}
 			}
 			StartScreen->Progress();
 		}
@@ -528,7 +694,7 @@ void FTextureManager::AddGroup(int wadnum, int ns, int usetype)
 		{
 			if (Wads.CheckNumForName (Name, ns) < firsttx)
 			{
-				CreateTexture (firsttx, usetype);
+				AddLazyTexture (firsttx, usetype);
 			}
 			StartScreen->Progress();
 		}
@@ -581,7 +747,7 @@ void FTextureManager::AddHiresTextures (int wadnum)
 						FTexture * newtex = FTexture::CreateTexture (firsttx, FTexture::TEX_Any);
 						if (newtex != NULL)
 						{
-							FTexture * oldtex = Textures[tlist[i].GetIndex()].Texture;
+							FTexture * oldtex = Texture(tlist[i]);
 
 							// Replace the entire texture and adjust the scaling and offset factors.
 							newtex->bWorldPanning = true;
@@ -658,7 +824,7 @@ void FTextureManager::LoadTextureDefs(int wadnum, const char *lumpname)
 					{
 						for(unsigned int i = 0; i < tlist.Size(); i++)
 						{
-							FTexture * oldtex = Textures[tlist[i].GetIndex()].Texture;
+							FTexture * oldtex = Texture(tlist[i]);
 							int sl;
 
 							// only replace matching types. For sprites also replace any MiscPatches
@@ -896,14 +1062,9 @@ void FTextureManager::AddTexturesForWad(int wadnum)
 		}
 		else continue;
 
-		// Try to create a texture from this lump and add it.
-		// Unfortunately we have to look at everything that comes through here...
-		FTexture *out = FTexture::CreateTexture(i, skin ? FTexture::TEX_SkinGraphic : FTexture::TEX_MiscPatch);
-
-		if (out != NULL) 
-		{
-			AddTexture (out);
-		}
+		// This may be anything, so whether it really is a graphic only gets
+		// checked when the texture is first used.
+		AddLazyTexture (i, skin ? FTexture::TEX_SkinGraphic : FTexture::TEX_MiscPatch);
 	}
 
 	// Check for text based texture definitions
@@ -926,48 +1087,52 @@ void FTextureManager::AddTexturesForWad(int wadnum)
 
 void FTextureManager::SortTexturesByType(int start, int end)
 {
-	TArray<FTexture *> newtextures;
+	TArray<TextureHash> newtextures;
 
-	// First unlink all newly added textures from the hash chain
-	for (int i = 0; i < HASH_SIZE; i++)
-	{
-		while (HashFirst[i] >= start && HashFirst[i] != HASH_END)
-		{
-			HashFirst[i] = Textures[HashFirst[i]].HashNext;
-		}
-	}
 	newtextures.Resize(end-start);
 	for(int i=start; i<end; i++)
 	{
-		newtextures[i-start] = Textures[i].Texture;
+		newtextures[i-start] = Textures[i];
 	}
 	Textures.Resize(start);
 	Translation.Resize(start);
 
+	// Unlink all newly added textures from the hash chains
+	RehashTextures(HashFirst.Size());
+
 	static int texturetypes[] = {
 		FTexture::TEX_Sprite, FTexture::TEX_Null, FTexture::TEX_FirstDefined, 
 		FTexture::TEX_WallPatch, FTexture::TEX_Wall, FTexture::TEX_Flat, 
 		FTexture::TEX_Override, FTexture::TEX_MiscPatch, FTexture::TEX_SkinGraphic
 	};
 
+	TArray<bool> done;
+	done.Resize(newtextures.Size());
+	for (unsigned j = 0; j < done.Size(); j++) done[j] = false;
+
 	for(unsigned int i=0;i<countof(texturetypes);i++)
 	{
 		for(unsigned j = 0; j<newtextures.Size(); j++)
 		{
-			if (newtextures[j] != NULL && newtextures[j]->UseType == texturetypes[i])
+			TextureHash &entry = newtextures[j];
+			int usetype = entry.Texture != NULL ? entry.Texture->UseType : entry.UseType;
+			if (!done[j] && usetype == texturetypes[i])
 			{
-				AddTexture(newtextures[j]);
-				newtextures[j] = NULL;
+				int index = PushTexture(entry);
+				if (entry.Texture != NULL) entry.Texture->id = FTextureID(index);
+				done[j] = true;
 			}
 		}
 	}
 	// This should never happen. All other UseTypes are only used outside
 	for(unsigned j = 0; j<newtextures.Size(); j++)
 	{
-		if (newtextures[j] != NULL)
+		if (!done[j])
 		{
-			Printf("Texture %s has unknown type!\n", newtextures[j]->Name.GetChars());
-			AddTexture(newtextures[j]);
+			TextureHash &entry = newtextures[j];
+			Printf("Texture %s has unknown type!\n", entry.Texture != NULL ? entry.Texture->Name.GetChars() : entry.Name);
+			int index = PushTexture(entry);
+			if (entry.Texture != NULL) entry.Texture->id = FTextureID(index);
 		}
 	}
 }
@@ -1004,7 +1169,8 @@ void FTextureManager::Init()
 	}
 	for (unsigned i = 0; i < Textures.Size(); i++)
 	{
-		Textures[i].Texture->ResolvePatches();
+		// Lazily added textures never consist of patches
+		if (Textures[i].Texture != NULL) Textures[i].Texture->ResolvePatches();
 	}
 
 	// Add one marker so that the last WAD is easier to handle and treat
@@ -1037,7 +1203,7 @@ void FTextureManager::Init()
 			FTextureID picnum = CheckForTexture (wadlevelinfos[i].SkyPic1, FTexture::TEX_Wall, false);
 			if (picnum.isValid())
 			{
-				Textures[picnum.GetIndex()].Texture->SetFrontSkyLayer ();
+				Texture(picnum)->SetFrontSkyLayer ();
 			}
 		}
 	}
@@ -171,6 +171,7 @@ class FTexture
 public:
 	static FTexture *CreateTexture(const char *name, int lumpnum, int usetype);
 	static FTexture *CreateTexture(int lumpnum, int usetype);
+	static bool CheckLumpHeader(int lumpnum, int usetype);	// Cheap check whether CreateTexture would succeed
 	virtual ~FTexture ();
 
 	int16_t LeftOffset, TopOffset;
@@ -245,6 +246,11 @@ public:
 	int CopyTrueColorTranslated(FBitmap *bmp, int x, int y, int rotate, PalEntry *remap, FCopyInfo *inf = NULL);
 	virtual bool UseBasePalette();
 	virtual int GetSourceLump() { return SourceLump; }
+
+	// Converts a copy of the source lump's data to true color. This must not access anything
+	// but the passed data, so that the precache decoder can run it on a worker thread.
+	virtual bool CanDecodeLumpData() { return false; }
+	virtual bool DecodeLumpData(FileReader &lump, FBitmap *bmp, int &trans) { return false; }
 	virtual FTexture *GetRedirect(bool wantwarped);
 	virtual FTexture *GetRawTexture();		// for FMultiPatchTexture to override
 
@@ -407,15 +413,21 @@ public:
 	FTexture *operator[] (FTextureID texnum)
 	{
 		if ((unsigned)texnum.GetIndex() >= Textures.Size()) return NULL;
-		return Textures[texnum.GetIndex()].Texture;
+		return Texture(texnum);
 	}
 	FTexture *operator[] (const char *texname)
 	{
 		FTextureID texnum = GetTexture (texname, FTexture::TEX_MiscPatch);
 		if (!texnum.Exists()) return NULL;
-		return Textures[texnum.GetIndex()].Texture;
+		return Texture(texnum);
 	}
 	FTexture *ByIndex(int i)
+	{
+		if (unsigned(i) >= Textures.Size()) return NULL;
+		return Texture(FTextureID(i));
+	}
+	// Returns NULL for lazily added textures that have not been created yet
+	FTexture *ByIndexIfCreated(int i)
 	{
 		if (unsigned(i) >= Textures.Size()) return NULL;
 		return Textures[i].Texture;
@@ -431,20 +443,31 @@ public:
 		{
 			picnum = PalCheck(picnum).GetIndex();
 		}
-		return Textures[picnum].Texture;
+		return Texture(FTextureID(picnum));
 	}
 	FTexture *operator() (const char *texname)
 	{
 		FTextureID texnum = GetTexture (texname, FTexture::TEX_MiscPatch);
 		if (texnum.texnum == -1) return NULL;
-		return Textures[Translation[texnum.texnum]].Texture;
+		return Texture(FTextureID(Translation[texnum.texnum]));
 	}
 
 	FTexture *ByIndexTranslated(int i)
 	{
 		if (unsigned(i) >= Textures.Size()) return NULL;
-		return Textures[Translation[i]].Texture;
+		return Texture(FTextureID(Translation[i]));
+	}
+
+	// Name and use type of a texture. These do not create lazily added textures.
+	const char *GetTextureName(int i) const
+	{
+		return Textures[i].Texture != NULL ? Textures[i].Texture->Name.GetChars() : Textures[i].Name;
+	}
+	int GetTextureUseType(int i) const
+	{
+		return Textures[i].Texture != NULL ? Textures[i].Texture->UseType : Textures[i].UseType;
 	}
+	void SetRotations(FTextureID texnum, int rotations);
 
 	FTextureID PalCheck(FTextureID tex);
 
@@ -484,6 +507,7 @@ public:
 
 	FTextureID CreateTexture (int lumpnum, int usetype=FTexture::TEX_Any);	// Also calls AddTexture
 	FTextureID AddTexture (FTexture *texture);
+	FTextureID AddLazyTexture (int lumpnum, int usetype);	// The texture gets created on first access
 	FTextureID GetDefaultTexture() const { return DefaultTexture; }
 
 	void LoadTextureX(int wadnum);
@@ -503,6 +527,8 @@ public:
 	void UnloadAll ();
 
 	int NumTextures () const { return (int)Textures.Size(); }
+	int NumLazyTextures () const { return LazyCount; }
+	int NumCreatedLazyTextures () const { return LazyCreated; }
 
 	void UpdateAnimations (uint64_t mstime);
 	int GuesstimateNumTextures ();
@@ -536,7 +562,13 @@ private:
 	void ParseCameraTexture(FScanner &sc);
 	FTextureID ParseFramenum (FScanner &sc, FTextureID basepicnum, int usetype, bool allowMissing);
 	void ParseTime (FScanner &sc, uint32_t &min, uint32_t &max);
-	FTexture *Texture(FTextureID id) { return Textures[id.GetIndex()].Texture; }
+	FTexture *Texture(FTextureID id)
+	{
+		FTexture *tex = Textures[id.GetIndex()].Texture;
+		return tex != NULL ? tex : CreateLazyTexture(id.GetIndex());
+	}
+	FTexture *CreateLazyTexture(int index);
+	FTexture *CheckName(int index, unsigned int key, const char *name);
 	void SetTranslation (FTextureID fromtexnum, FTextureID totexnum);
 	void ParseAnimatedDoor(FScanner &sc);
 
@@ -549,15 +581,29 @@ private:
 	FSwitchDef *ParseSwitchDef (FScanner &sc, bool ignoreBad);
 	void AddSwitchPair (FSwitchDef *def1, FSwitchDef *def2);
 
+	// Textures from graphics lumps (sprites, flats, patches and so on) are only
+	// added as a descriptor. The FTexture gets created when the slot is first
+	// accessed, or when a lookup by name hits it.
 	struct TextureHash
 	{
-		FTexture *Texture;
+		FTexture *Texture;		// NULL until a lazily added texture has been created
 		int HashNext;
+		unsigned int Key;		// MakeKey of the name, so that most mismatches need no string compare
+		int Lump;				// Source of a lazily added texture, -1 for everything else
+		uint16_t Rotations;		// Passed on to a lazily added texture when it gets created
+		uint8_t UseType;
+		bool Invalid;			// The lump did not contain a usable graphic
+		char Name[9];
 	};
-	enum { HASH_END = -1, HASH_SIZE = 1027 };
+	enum { HASH_END = -1 };
 	TArray<TextureHash> Textures;
 	TArray<int> Translation;
-	int HashFirst[HASH_SIZE];
+	TArray<int> HashFirst;		// Power of two sized, grows with Textures
+	int LazyCount;
+	int LazyCreated;
+
+	int PushTexture(TextureHash &entry);
+	void RehashTextures(unsigned int size);
 	FTextureID DefaultTexture;
 	TArray<int> FirstTextureForFile;
 	TMap<int,int> PalettedVersions;		// maps from normal -> paletted version
@@ -55,14 +55,21 @@
 #include "gi.h"
 #include "doomerrors.h"
 #include "resourcefiles/resourcefile.h"
+#include "resourcefiles/lumpdecompressor.h"
+#include "resourcefiles/lumpindexcache.h"
 #include "md5.h"
 #include "doomstat.h"
 #include "vm.h"
+#include "stats.h"
 
 // MACROS ------------------------------------------------------------------
 
 #define NULL_INDEX		(0xffffffff)
 
+// Key under which global lumps not coming from a Zip are entered a second time.
+// CheckNumForName falls back to those for the special Zip namespaces.
+#define NS_GLOBALNOTZIP	(-0x7fffffff)
+
 //
 // WADFILE I/O related stuff.
 //
@@ -107,9 +114,7 @@ void uppercopy (char *to, const char *from)
 }
 
 FWadCollection::FWadCollection ()
-: FirstLumpIndex(NULL), NextLumpIndex(NULL),
-  FirstLumpIndex_FullName(NULL), NextLumpIndex_FullName(NULL), 
-  NumLumps(0)
+: NumLumps(0)
 {
 }
 
@@ -120,26 +125,10 @@ FWadCollection::~FWadCollection ()
 
 void FWadCollection::DeleteAll ()
 {
-	if (FirstLumpIndex != NULL)
-	{
-		delete[] FirstLumpIndex;
-		FirstLumpIndex = NULL;
-	}
-	if (NextLumpIndex != NULL)
-	{
-		delete[] NextLumpIndex;
-		NextLumpIndex = NULL;
-	}
-	if (FirstLumpIndex_FullName != NULL)
-	{
-		delete[] FirstLumpIndex_FullName;
-		FirstLumpIndex_FullName = NULL;
-	}
-	if (NextLumpIndex_FullName != NULL)
-	{
-		delete[] NextLumpIndex_FullName;
-		NextLumpIndex_FullName = NULL;
-	}
+	NameTable.Clear();
+	NextLumpIndex.Clear();
+	FullNameTable.Clear();
+	NextLumpIndex_FullName.Clear();
 
 	LumpInfo.Clear();
 	NumLumps = 0;
@@ -172,11 +161,13 @@ void FWadCollection::InitMultipleFiles (TArray<FString> &filenames)
 	DeleteAll();
 	numfiles = 0;
 
+	FLumpIndexCache::Load();
 	for(unsigned i=0;i<filenames.Size(); i++)
 	{
 		int baselump = NumLumps;
 		AddFile (filenames[i]);
 	}
+	FLumpIndexCache::Save();
 
 	NumLumps = LumpInfo.Size();
 	if (NumLumps == 0)
@@ -188,10 +179,6 @@ void FWadCollection::InitMultipleFiles (TArray<FString> &filenames)
 	FixMacHexen();
 
 	// [RH] Set up hash table
-	FirstLumpIndex = new uint32_t[NumLumps];
-	NextLumpIndex = new uint32_t[NumLumps];
-	FirstLumpIndex_FullName = new uint32_t[NumLumps];
-	NextLumpIndex_FullName = new uint32_t[NumLumps];
 	InitHashChains ();
 	LumpInfo.ShrinkToFit();
 	Files.ShrinkToFit();
@@ -229,6 +216,7 @@ void FWadCollection::AddFile (const char *filename, FileReader *wadinfo)
 {
 	int startlump;
 	bool isdir = false;
+	bool cacheable = wadinfo == NULL;
 
 	if (wadinfo == NULL)
 	{
@@ -242,15 +230,24 @@ void FWadCollection::AddFile (const char *filename, FileReader *wadinfo)
 
 		if (!isdir)
 		{
-			try
+			// Map the file so that uncompressed lumps need no copy. This keeps the file open
+			// for the rest of the session, same as the FileReader does.
+			if (!Args->CheckParm("-nommap"))
 			{
-				wadinfo = new FileReader(filename);
+				wadinfo = MappedFileReader::Open(filename);
 			}
-			catch (CRecoverableError &err)
-			{ // Didn't find file
-				Printf (TEXTCOLOR_RED "%s\n", err.GetMessage());
-				PrintLastError ();
-				return;
+			if (wadinfo == NULL)
+			{
+				try
+				{
+					wadinfo = new FileReader(filename);
+				}
+				catch (CRecoverableError &err)
+				{ // Didn't find file
+					Printf (TEXTCOLOR_RED "%s\n", err.GetMessage());
+					PrintLastError ();
+					return;
+				}
 			}
 		}
 	}
@@ -261,7 +258,12 @@ void FWadCollection::AddFile (const char *filename, FileReader *wadinfo)
 	FResourceFile *resfile;
 	
 	if (!isdir)
+	{
+		// Only files opened from disk here can be identified by their path
+		if (cacheable) FLumpIndexCache::BeginFile(filename);
 		resfile = FResourceFile::OpenResourceFile(filename, wadinfo);
+		FLumpIndexCache::EndFile();
+	}
 	else
 		resfile = FResourceFile::OpenDirectory(filename);
 
@@ -445,24 +447,17 @@ int FWadCollection::CheckNumForName (const char *name, int space)
 	}
 
 	uppercopy (uname, name);
-	i = FirstLumpIndex[LumpNameHash (uname) % NumLumps];
+	i = FirstLumpForName (qname, space);
 
-	while (i != NULL_INDEX)
+	// If the lump is from one of the special namespaces exclusive to Zips
+	// the check has to be done differently:
+	// If we find a lump with this name in the global namespace that does not come
+	// from a Zip return that. WADs don't know these namespaces and single lumps must
+	// work as well. Whichever of the two was added last wins.
+	if (space > ns_specialzipdirectory)
 	{
-		FResourceLump *lump = LumpInfo[i].lump;
-
-		if (lump->qwName == qname)
-		{
-			if (lump->Namespace == space) break;
-			// If the lump is from one of the special namespaces exclusive to Zips
-			// the check has to be done differently:
-			// If we find a lump with this name in the global namespace that does not come
-			// from a Zip return that. WADs don't know these namespaces and single lumps must
-			// work as well.
-			if (space > ns_specialzipdirectory && lump->Namespace == ns_global && 
-				!(lump->Flags & LUMPF_ZIPFILE)) break;
-		}
-		i = NextLumpIndex[i];
+		uint32_t j = FirstLumpForName (qname, NS_GLOBALNOTZIP);
+		if (j != NULL_INDEX && (i == NULL_INDEX || j > i)) i = j;
 	}
 
 	return i != NULL_INDEX ? i : -1;
@@ -470,7 +465,6 @@ int FWadCollection::CheckNumForName (const char *name, int space)
 
 int FWadCollection::CheckNumForName (const char *name, int space, int wadnum, bool exact)
 {
-	FResourceLump *lump;
 	union
 	{
 		char uname[8];
@@ -484,15 +478,13 @@ int FWadCollection::CheckNumForName (const char *name, int space, int wadnum, bo
 	}
 
 	uppercopy (uname, name);
-	i = FirstLumpIndex[LumpNameHash (uname) % NumLumps];
+	i = FirstLumpForName (qname, space);
 
 	// If exact is true if will only find lumps in the same WAD, otherwise
 	// also those in earlier WADs.
 
 	while (i != NULL_INDEX &&
-		(lump = LumpInfo[i].lump, lump->qwName != qname ||
-		lump->Namespace != space ||
-		 (exact? (LumpInfo[i].wadnum != wadnum) : (LumpInfo[i].wadnum > wadnum)) ))
+		 (exact? (LumpInfo[i].wadnum != wadnum) : (LumpInfo[i].wadnum > wadnum)))
 	{
 		i = NextLumpIndex[i];
 	}
@@ -549,13 +541,7 @@ int FWadCollection::CheckNumForFullName (const char *name, bool trynormal, int n
 		return -1;
 	}
 
-	i = FirstLumpIndex_FullName[MakeKey(name) % NumLumps];
-
-	while (i != NULL_INDEX && stricmp(name, LumpInfo[i].lump->FullName))
-	{
-		i = NextLumpIndex_FullName[i];
-	}
-
+	i = FirstLumpForFullName(name);
 	if (i != NULL_INDEX) return i;
 
 	if (trynormal && strlen(name) <= 8 && !strpbrk(name, "./"))
@@ -581,10 +567,9 @@ int FWadCollection::CheckNumForFullName (const char *name, int wadnum)
 		return CheckNumForFullName (name);
 	}
 
-	i = FirstLumpIndex_FullName[MakeKey (name) % NumLumps];
+	i = FirstLumpForFullName (name);
 
-	while (i != NULL_INDEX && 
-		(stricmp(name, LumpInfo[i].lump->FullName) || LumpInfo[i].wadnum != wadnum))
+	while (i != NULL_INDEX && LumpInfo[i].wadnum != wadnum)
 	{
 		i = NextLumpIndex_FullName[i];
 	}
@@ -698,65 +683,155 @@ int FWadCollection::GetLumpFlags (int lump)
 
 //==========================================================================
 //
-// W_LumpNameHash
+// W_InitHashChains
 //
-// NOTE: s should already be uppercase, in contrast to the BOOM version.
+// Prepares the lumpinfos for hashing.
+// (Hey! This looks suspiciously like something from Boom! :-)
 //
-// Hash function used for lump names.
-// Must be mod'ed with table size.
-// Can be used for any 8-character names.
+// Both tables are sized to a power of two of at least twice the number
+// of keys and use linear probing. Since lumps are entered in order, each
+// slot ends up pointing at the last lump with its key.
 //
 //==========================================================================
 
-uint32_t FWadCollection::LumpNameHash (const char *s)
+static inline uint32_t NameSlotHash (uint64_t name, int namespc)
 {
-	const uint32_t *table = GetCRCTable ();;
-	uint32_t hash = 0xffffffff;
-	int i;
+	uint64_t h = (name ^ (uint32_t)namespc) * 0x9E3779B97F4A7C15ull;
+	return uint32_t(h >> 32);
+}
+
+static unsigned int HashTableSize (unsigned int keys)
+{
+	unsigned int size = 16;
+	while (size < keys * 2)
+		size <<= 1;
+	return size;
+}
+
+void FWadCollection::InitHashChains (void)
+{
+	unsigned int i, j, mask;
+
+	NextLumpIndex.Resize(NumLumps);
+	NextLumpIndex_FullName.Resize(NumLumps);
 
-	for (i = 8; i > 0 && *s; --i, ++s)
+	unsigned int numnamekeys = NumLumps, numfullnamekeys = 0;
+	for (i = 0; i < (unsigned)NumLumps; i++)
 	{
-		hash = CRC1 (hash, *s, table);
+		FResourceLump *lump = LumpInfo[i].lump;
+		if (lump->Namespace == ns_global && !(lump->Flags & LUMPF_ZIPFILE)) numnamekeys++;
+		if (lump->FullName.IsNotEmpty()) numfullnamekeys++;
+	}
+
+	// Mark all buckets as empty
+	NameTable.Resize(HashTableSize(numnamekeys));
+	FullNameTable.Resize(HashTableSize(numfullnamekeys));
+	memset (&NameTable[0], 255, NameTable.Size() * sizeof(NameTable[0]));
+	memset (&FullNameTable[0], 255, FullNameTable.Size() * sizeof(FullNameTable[0]));
+	memset (&NextLumpIndex[0], 255, NumLumps * sizeof(NextLumpIndex[0]));
+	memset (&NextLumpIndex_FullName[0], 255, NumLumps * sizeof(NextLumpIndex_FullName[0]));
+
+	// Now set up the chains
+	for (i = 0; i < (unsigned)NumLumps; i++)
+	{
+		FResourceLump *lump = LumpInfo[i].lump;
+
+		for (int pass = 0; pass < 2; pass++)
+		{
+			int namespc = lump->Namespace;
+			if (pass == 1)
+			{
+				if (namespc != ns_global || (lump->Flags & LUMPF_ZIPFILE)) break;
+				namespc = NS_GLOBALNOTZIP;
+			}
+
+			mask = NameTable.Size() - 1;
+			j = NameSlotHash(lump->qwName, namespc) & mask;
+			while (NameTable[j].Lump != NULL_INDEX && (NameTable[j].Name != lump->qwName || NameTable[j].Namespace != namespc))
+			{
+				j = (j + 1) & mask;
+			}
+			// The second entry only serves the fallback in CheckNumForName and is never walked.
+			if (pass == 0) NextLumpIndex[i] = NameTable[j].Lump;
+			NameTable[j].Name = lump->qwName;
+			NameTable[j].Namespace = namespc;
+			NameTable[j].Lump = i;
+		}
+
+		// Do the same for the full paths
+		if (lump->FullName.IsNotEmpty())
+		{
+			uint32_t hash = MakeKey(lump->FullName);
+			mask = FullNameTable.Size() - 1;
+			j = hash & mask;
+			while (FullNameTable[j].Lump != NULL_INDEX &&
+				(FullNameTable[j].Hash != hash || stricmp(LumpInfo[FullNameTable[j].Lump].lump->FullName, lump->FullName)))
+			{
+				j = (j + 1) & mask;
+			}
+			NextLumpIndex_FullName[i] = FullNameTable[j].Lump;
+			FullNameTable[j].Hash = hash;
+			FullNameTable[j].Lump = i;
+		}
 	}
-	return hash ^ 0xffffffff;
 }
 
 //==========================================================================
 //
-// W_InitHashChains
+// FirstLumpForName
 //
-// Prepares the lumpinfos for hashing.
-// (Hey! This looks suspiciously like something from Boom! :-)
+// Returns the last lump with exactly this name and namespace. Earlier
+// ones are found by following NextLumpIndex.
 //
 //==========================================================================
 
-void FWadCollection::InitHashChains (void)
+uint32_t FWadCollection::FirstLumpForName (uint64_t name, int namespc) const
 {
-	char name[8];
-	unsigned int i, j;
+	if (NameTable.Size() == 0)
+	{
+		return NULL_INDEX;
+	}
 
-	// Mark all buckets as empty
-	memset (FirstLumpIndex, 255, NumLumps*sizeof(FirstLumpIndex[0]));
-	memset (NextLumpIndex, 255, NumLumps*sizeof(NextLumpIndex[0]));
-	memset (FirstLumpIndex_FullName, 255, NumLumps*sizeof(FirstLumpIndex_FullName[0]));
-	memset (NextLumpIndex_FullName, 255, NumLumps*sizeof(NextLumpIndex_FullName[0]));
+	unsigned int mask = NameTable.Size() - 1;
+	unsigned int j = NameSlotHash(name, namespc) & mask;
+	while (NameTable[j].Lump != NULL_INDEX)
+	{
+		if (NameTable[j].Name == name && NameTable[j].Namespace == namespc)
+		{
+			return NameTable[j].Lump;
+		}
+		j = (j + 1) & mask;
+	}
+	return NULL_INDEX;
+}
 
-	// Now set up the chains
-	for (i = 0; i < (unsigned)NumLumps; i++)
+//==========================================================================
+//
+// FirstLumpForFullName
+//
+// Same for full names, which are compared case insensitively.
+//
+//==========================================================================
+
+uint32_t FWadCollection::FirstLumpForFullName (const char *name) const
+{
+	if (FullNameTable.Size() == 0)
 	{
-		uppercopy (name, LumpInfo[i].lump->Name);
-		j = LumpNameHash (name) % NumLumps;
-		NextLumpIndex[i] = FirstLumpIndex[j];
-		FirstLumpIndex[j] = i;
+		return NULL_INDEX;
+	}
 
-		// Do the same for the full paths
-		if (LumpInfo[i].lump->FullName.IsNotEmpty())
+	uint32_t hash = MakeKey(name);
+	unsigned int mask = FullNameTable.Size() - 1;
+	unsigned int j = hash & mask;
+	while (FullNameTable[j].Lump != NULL_INDEX)
+	{
+		if (FullNameTable[j].Hash == hash && !stricmp(name, LumpInfo[FullNameTable[j].Lump].lump->FullName))
 		{
-			j = MakeKey(LumpInfo[i].lump->FullName) % NumLumps;
-			NextLumpIndex_FullName[i] = FirstLumpIndex_FullName[j];
-			FirstLumpIndex_FullName[j] = i;
+			return FullNameTable[j].Lump;
 		}
+		j = (j + 1) & mask;
 	}
+	return NULL_INDEX;
 }
 
 //==========================================================================
@@ -1295,6 +1370,61 @@ FMemLump FWadCollection::ReadLump (int lump)
 	return FMemLump(FString(ELumpNum(lump)));
 }
 
+//==========================================================================
+//
+// PrefetchLumps
+//
+// Hints that the given lumps will be read soon. Compressed ones get
+// decompressed in the background in the order given, anything that was
+// prefetched before and not read yet becomes evictable.
+//
+//==========================================================================
+
+void FWadCollection::PrefetchLumps (const TArray<int> &lumps)
+{
+	FLumpDecompressor::ExpirePrefetched();
+	for (unsigned i = 0; i < lumps.Size(); i++)
+	{
+		if ((unsigned)lumps[i] < (unsigned)NumLumps)
+		{
+			FLumpDecompressor::Prefetch(LumpInfo[lumps[i]].lump);
+		}
+	}
+}
+
+void FWadCollection::PrefetchNamespace (int namespc)
+{
+	TArray<int> lumps;
+	for (unsigned i = 0; i < NumLumps; i++)
+	{
+		if (LumpInfo[i].lump->Namespace == namespc)
+		{
+			lumps.Push(i);
+		}
+	}
+	PrefetchLumps(lumps);
+}
+
+//==========================================================================
+//
+// ReadLumpView
+//
+// Returns a reference to the lump's cache. For lumps stored uncompressed
+// in a memory mapped file this points directly into the mapping, so no
+// data gets copied at all. The data is read only and GetSize() returns
+// the exact lump size.
+//
+//==========================================================================
+
+FMemLump FWadCollection::ReadLumpView (int lump)
+{
+	if ((unsigned)lump >= (unsigned)NumLumps)
+	{
+		I_Error ("ReadLumpView: %u >= NumLumps", lump);
+	}
+	return FMemLump(LumpInfo[lump].lump);
+}
+
 DEFINE_ACTION_FUNCTION(_Wads, ReadLump)
 {
 	PARAM_PROLOGUE;
@@ -1314,7 +1444,7 @@ DEFINE_ACTION_FUNCTION(_Wads, ReadLump)
 
 FWadLump FWadCollection::OpenLumpNum (int lump)
 {
-	if ((unsigned)lump >= (unsigned)LumpInfo.Size())
+	if ((unsigned)lump >= (unsigned)NumLumps)
 	{
 		I_Error ("W_OpenLumpNum: %u >= NumLumps", lump);
 	}
@@ -1334,7 +1464,7 @@ FWadLump FWadCollection::OpenLumpNum (int lump)
 
 FWadLump *FWadCollection::ReopenLumpNum (int lump)
 {
-	if ((unsigned)lump >= (unsigned)LumpInfo.Size())
+	if ((unsigned)lump >= (unsigned)NumLumps)
 	{
 		I_Error ("W_ReopenLumpNum: %u >= NumLumps", lump);
 	}
@@ -1344,7 +1474,7 @@ FWadLump *FWadCollection::ReopenLumpNum (int lump)
 
 FWadLump *FWadCollection::ReopenLumpNumNewFile (int lump)
 {
-	if ((unsigned)lump >= (unsigned)LumpInfo.Size())
+	if ((unsigned)lump >= (unsigned)NumLumps)
 	{
 		return NULL;
 	}
@@ -1636,6 +1766,23 @@ char *FWadLump::Gets(char *strbuf, int len)
 	return strbuf;
 }
 
+bool FWadLump::CanReadAt() const
+{
+	return Lump != NULL || FileReader::CanReadAt();
+}
+
+long FWadLump::ReadAt(void *buffer, long len, long offset)
+{
+	if (Lump != NULL)
+	{
+		if (offset < 0 || offset >= Length || len <= 0) return 0;
+		if (len > Length - offset) len = Length - offset;
+		memcpy(buffer, Lump->Cache + offset, len);
+		return len;
+	}
+	return FileReader::ReadAt(buffer, len, offset);
+}
+
 // FMemLump -----------------------------------------------------------------
 
 FMemLump::FMemLump ()
@@ -1645,11 +1792,15 @@ FMemLump::FMemLump ()
 FMemLump::FMemLump (const FMemLump &copy)
 {
 	Block = copy.Block;
+	if ((View = copy.View)) View->CacheLump();
 }
 
 FMemLump &FMemLump::operator = (const FMemLump &copy)
 {
+	if (copy.View != NULL) copy.View->CacheLump();
+	if (View != NULL) View->ReleaseCache();
 	Block = copy.Block;
+	View = copy.View;
 	return *this;
 }
 
@@ -1658,8 +1809,33 @@ FMemLump::FMemLump (const FString &source)
 {
 }
 
+FMemLump::FMemLump (FResourceLump *view)
+: View (view)
+{
+	View->CacheLump();
+}
+
 FMemLump::~FMemLump ()
 {
+	if (View != NULL) View->ReleaseCache();
+}
+
+void *FMemLump::GetMem ()
+{
+	if (View != NULL) return View->Cache;
+	return Block.Len() == 0 ? NULL : (void *)Block.GetChars();
+}
+
+size_t FMemLump::GetSize ()
+{
+	if (View != NULL) return View->LumpSize;
+	return Block.Len();
+}
+
+FString FMemLump::GetString ()
+{
+	if (View != NULL) return View->Cache != NULL ? FString(View->Cache, View->LumpSize) : FString();
+	return Block;
 }
 
 FString::FString (ELumpNum lumpnum)
@@ -1754,3 +1930,84 @@ CCMD(lumpnumfull)
 	}
 }
 #endif
+
+//==========================================================================
+//
+// CCMD bench_lumplookup
+//
+// Looks up every loaded lump by name and by full name, plus the same
+// number of names that don't exist.
+//
+//==========================================================================
+
+CCMD(bench_lumplookup)
+{
+	int iterations = argv.argc() > 1 ? atoi(argv[1]) : 10;
+	if (iterations <= 0)
+		return;
+
+	int numlumps = Wads.GetNumLumps();
+	TArray<FString> names, missingnames, fullnames;
+	TArray<int> namespaces, namelumps, fullnamelumps;
+	for (int i = 0; i < numlumps; i++)
+	{
+		FString name;
+		Wads.GetLumpName(name, i);
+		if (name.IsEmpty())
+			continue;
+
+		names.Push(name);
+		namespaces.Push(Wads.GetLumpNamespace(i));
+		namelumps.Push(i);
+		missingnames.Push(name.Len() < 8 ? name + "~" : "~" + name.Mid(1));
+
+		const char *fullname = Wads.GetLumpFullName(i);
+		if (fullname != nullptr && *fullname != 0 && strcmp(fullname, name) != 0)
+		{
+			fullnames.Push(fullname);
+			fullnamelumps.Push(i);
+		}
+	}
+
+	if (names.Size() == 0)
+		return;
+
+	cycle_t nametime, misstime, fullnametime;
+	nametime.Reset();
+	misstime.Reset();
+	fullnametime.Reset();
+	int errors = 0;
+	for (int n = 0; n < iterations; n++)
+	{
+		nametime.Clock();
+		for (unsigned i = 0; i < names.Size(); i++)
+		{
+			// A later lump may override this one, but never an earlier one
+			int lump = Wads.CheckNumForName(names[i], namespaces[i]);
+			if (lump >= 0 && lump < namelumps[i]) errors++;
+		}
+		nametime.Unclock();
+
+		misstime.Clock();
+		for (unsigned i = 0; i < missingnames.Size(); i++)
+		{
+			if (Wads.CheckNumForName(missingnames[i], namespaces[i]) >= 0) errors++;
+		}
+		misstime.Unclock();
+
+		fullnametime.Clock();
+		for (unsigned i = 0; i < fullnames.Size(); i++)
+		{
+			if (Wads.CheckNumForFullName(fullnames[i]) < fullnamelumps[i]) errors++;
+		}
+		fullnametime.Unclock();
+	}
+
+	double count = (double)names.Size() * iterations;
+	double fullcount = (double)MAX(fullnames.Size(), 1u) * iterations;
+	Printf("%d lumps, %u names, %u full names\n", numlumps, names.Size(), fullnames.Size());
+	Printf("name hits: %.1f ns per lookup\n", nametime.TimeMS() * 1e6 / count);
+	Printf("name misses: %.1f ns per lookup\n", misstime.TimeMS() * 1e6 / count);
+	Printf("full names: %.1f ns per lookup\n", fullnametime.TimeMS() * 1e6 / fullcount);
+	if (errors > 0) Printf(TEXTCOLOR_RED "%d lookups returned a wrong result\n", errors);
+}
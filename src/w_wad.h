@@ -95,6 +95,8 @@ public:
 	long Seek (long offset, int origin);
 	long Read (void *buffer, long len);
 	char *Gets(char *strbuf, int len);
+	long ReadAt (void *buffer, long len, long offset);
+	bool CanReadAt () const;
 
 private:
 	FWadLump (FResourceLump *Lump, bool alwayscache = false);
@@ -115,14 +117,16 @@ public:
 	FMemLump (const FMemLump &copy);
 	FMemLump &operator= (const FMemLump &copy);
 	~FMemLump ();
-	void *GetMem () { return Block.Len() == 0 ? NULL : (void *)Block.GetChars(); }
-	size_t GetSize () { return Block.Len(); }
-	FString GetString () { return Block; }
+	void *GetMem ();
+	size_t GetSize ();
+	FString GetString ();
 
 private:
 	FMemLump (const FString &source);
+	FMemLump (FResourceLump *view);
 
 	FString Block;
+	FResourceLump *View = nullptr;	// Set by ReadLumpView. Holds a reference to the lump's cache instead of a copy.
 
 	friend class FWadCollection;
 };
@@ -175,6 +179,10 @@ public:
 	void ReadLump (int lump, void *dest);
 	FMemLump ReadLump (int lump);
 	FMemLump ReadLump (const char *name) { return ReadLump (GetNumForName (name)); }
+	FMemLump ReadLumpView (int lump);	// Same as ReadLump but without copying the data or appending a 0 byte
+
+	void PrefetchLumps (const TArray<int> &lumps);	// Decompresses these lumps on worker threads ahead of their use
+	void PrefetchNamespace (int namespc);			// Same for all lumps in a namespace, e.g. ns_sprites
 
 	FWadLump OpenLumpNum (int lump);
 	FWadLump OpenLumpName (const char *name) { return OpenLumpNum (GetNumForName (name)); }
@@ -187,8 +195,6 @@ public:
 	int FindLumpMulti (const char **names, int *lastlump, bool anyns = false, int *nameindex = NULL); // same with multiple possible names
 	bool CheckLumpName (int lump, const char *name);	// [RH] True if lump's name == name
 
-	static uint32_t LumpNameHash (const char *name);		// [RH] Create hash key from an 8-char name
-
 	int LumpLength (int lump) const;
 	int GetLumpOffset (int lump);					// [RH] Returns offset of lump in the wadfile
 	int GetLumpFlags (int lump);					// Return the flags for this lump
@@ -216,11 +222,27 @@ protected:
 	TArray<FResourceFile *> Files;
 	TArray<LumpRecord> LumpInfo;
 
-	uint32_t *FirstLumpIndex;	// [RH] Hashing stuff moved out of lumpinfo structure
-	uint32_t *NextLumpIndex;
+	// [RH] Hashing stuff moved out of lumpinfo structure
+	// Open addressed tables that map each distinct key to the last lump using it. Lumps sharing
+	// a key are linked from there to the earlier ones through NextLumpIndex.
+	struct NameSlot
+	{
+		uint64_t Name;			// The 8 character name, compared as a whole
+		int Namespace;
+		uint32_t Lump;			// NULL_INDEX for empty slots
+	};
+
+	struct FullNameSlot
+	{
+		uint32_t Hash;			// MakeKey of the full name, so that most mismatches need no string compare
+		uint32_t Lump;
+	};
+
+	TArray<NameSlot> NameTable;
+	TArray<uint32_t> NextLumpIndex;
 
-	uint32_t *FirstLumpIndex_FullName;	// The same information for fully qualified paths from .zips
-	uint32_t *NextLumpIndex_FullName;
+	TArray<FullNameSlot> FullNameTable;	// The same information for fully qualified paths from .zips
+	TArray<uint32_t> NextLumpIndex_FullName;
 
 	uint32_t NumLumps;					// Not necessarily the same as LumpInfo.Size()
 	uint32_t NumWads;
@@ -229,6 +251,8 @@ protected:
 
 	void SkinHack (int baselump);
 	void InitHashChains ();								// [RH] Set up the lumpinfo hashing
+	uint32_t FirstLumpForName (uint64_t name, int namespc) const;	// Last lump with this exact name and namespace
+	uint32_t FirstLumpForFullName (const char *name) const;
 
 private:
 	void RenameSprites();